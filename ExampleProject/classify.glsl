@@ -0,0 +1,50 @@
+#version 330 core
+
+// Marks the tiles of the hit buffers that can be shaded at a reduced rate:
+// one material, normals that hardly vary and no depth edge. Outputs 1 for
+// those and 0 for tiles that need every pixel shaded. One fragment per
+// tile, see color.glsl for how the rate is used.
+
+in vec2 texCoords;
+out vec4 rate;
+
+uniform sampler2D posMatTex;
+uniform sampler2D normalTex;
+uniform int rateTile;        // tile size in hit buffer pixels
+uniform float maxVariance;   // of the normals in a coarse tile
+
+const float MAX_DEPTH_RANGE = .05;
+const float FAR = 10.;       // the sdf pass puts sky hits this far
+
+void main() {
+    ivec2 size = textureSize(posMatTex, 0);
+    ivec2 origin = ivec2(gl_FragCoord.xy) * rateTile;
+
+    vec3 sum = vec3(0.);
+    float sumSquares = 0.;
+    float material = -1.;
+    float zMin = 1e9, zMax = -1e9;
+    bool mixed = false;
+    int count = 0;
+    for (int y = 0; y < rateTile; y++) {
+        for (int x = 0; x < rateTile; x++) {
+            ivec2 p = min(origin + ivec2(x, y), size - 1);
+            vec4 posMat = texelFetch(posMatTex, p, 0);
+            vec3 normal = texelFetch(normalTex, p, 0).xyz;
+            if (material < 0.)
+                material = posMat.a;
+            mixed = mixed || abs(posMat.a - material) > 1e-3;
+            sum += normal;
+            sumSquares += dot(normal, normal);
+            zMin = min(zMin, posMat.z);
+            zMax = max(zMax, posMat.z);
+            count++;
+        }
+    }
+    vec3 mean = sum / float(count);
+    float variance = sumSquares / float(count) - dot(mean, mean);
+    // the sky is flat wherever it is, its normals mean nothing
+    bool sky = zMin >= FAR;
+    bool uniformTile = sky || (variance <= maxVariance && zMax - zMin <= MAX_DEPTH_RANGE);
+    rate = vec4(!mixed && uniformTile ? 1. : 0.);
+}
@@ -1,4 +1,5 @@
 #version 330 core
+// @begin shading, scene() and what it needs, direct.glsl includes it
 
 #define SKY       0.
 #define DIRT      1.
@@ -26,6 +27,27 @@ uniform int renderSwitch;
 uniform sampler2D posMatTex;
 uniform sampler2D normalTex;
 uniform sampler2D customTex;
+uniform samplerCube skyMap;
+uniform int hasSkyMap;   // 0 until the skybox cubemap has loaded
+uniform float skyLod;    // skyMap mip level, higher is blurrier
+uniform int qs_columns;
+uniform int qs_rows;
+uniform int qs_totalViews;
+uniform int keyViewStep; // > 1: only key views are shaded, see interpolate.glsl
+uniform int viewIndex;   // >= 0: texCoords cover only this view, drawn into
+                         // its own rect when views differ in size
+
+// adaptive shading: tiles classify.glsl found flat are shaded at half the
+// resolution in both directions by a coarse pass and upsampled
+uniform int shadingPass; // 0: every pixel, 1: coarse pass, flat tiles only,
+                         // 2: detailed tiles, flat ones from coarseTex
+uniform sampler2D rateTex;   // 1 for flat tiles
+uniform sampler2D coarseTex;
+uniform int rateTile;        // tile size in hit buffer pixels
+uniform vec2 coarseSize;     // pixels of coarseTex rendered into
+
+// where the fragment is in the regular quilt of the hit buffers
+vec2 quiltCoords;
 
 vec3 scene(Hit hit) {
     hit.material *= NUM_MATERIALS;
@@ -58,8 +80,12 @@ vec3 scene(Hit hit) {
     
     // SKY render
     if (hit.position.z >= 10.) {
+        if (hasSkyMap == 1) {
+            // direction from the center camera of the sdf pass
+            vec3 ray_dir = normalize(hit.position - vec3(0., .2, -1.));
+            return textureLod(skyMap, ray_dir, skyLod).rgb;
+        }
         return skyGradient;
-        // return texture(iChannel1, ray_dir).rgb;
         // color = texture(iChannel0, ray_dir); // color = vec4(index, 0., 1.);
     }
     
@@ -71,7 +97,7 @@ vec3 scene(Hit hit) {
         color = mix(dirtBrown, copper, lightContrib);
         color = mix(deepBlue, color, color.r * 1.2);
 
-        color *= texture(customTex, texCoords * vec2(8., 6.)).rgb;
+        color *= texture(customTex, quiltCoords * vec2(8., 6.)).rgb;
         
         color.r += .2;
         color.b += .2;
@@ -128,12 +154,43 @@ vec3 scene(Hit hit) {
     
     return color;
 }
+// @end shading
 
 
 void main() {
 
-    vec4 posMat = texture(posMatTex, texCoords);
-    vec4 normal = texture(normalTex, texCoords);
+    vec2 tiles = vec2(qs_columns, qs_rows);
+    quiltCoords = texCoords;
+    if (viewIndex >= 0)
+        quiltCoords = (vec2(viewIndex % qs_columns, viewIndex / qs_columns) + texCoords) / tiles;
+
+    if (keyViewStep > 1) {
+        vec2 tile = floor(quiltCoords * tiles);
+        int view = int(tile.y) * qs_columns + int(tile.x);
+        if (view % keyViewStep != 0 && view != qs_totalViews - 1)
+            discard;
+    }
+
+    if (shadingPass != 0) {
+        vec2 hitSize = vec2(textureSize(posMatTex, 0));
+        vec2 tile = floor(quiltCoords * hitSize / float(rateTile));
+        bool uniformTile = texelFetch(rateTex, ivec2(tile), 0).r > .5;
+        if (shadingPass == 1 && !uniformTile)
+            discard;
+        if (shadingPass == 2 && uniformTile) {
+            // bilinear, but only between coarse pixels of this tile: the
+            // ones of detailed tiles were never shaded
+            vec2 toCoarse = coarseSize / hitSize;
+            vec2 lo = tile * float(rateTile) * toCoarse + .5;
+            vec2 hi = (tile + 1.) * float(rateTile) * toCoarse - .5;
+            vec2 p = clamp(texCoords * coarseSize, lo, max(lo, hi));
+            fragColor = texture(coarseTex, p / vec2(textureSize(coarseTex, 0)));
+            return;
+        }
+    }
+
+    vec4 posMat = texture(posMatTex, quiltCoords);
+    vec4 normal = texture(normalTex, quiltCoords);
 
     if (renderSwitch == 1) {
         fragColor = posMat;
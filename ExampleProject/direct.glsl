@@ -0,0 +1,34 @@
+#version 330 core
+
+// Shades the subpixel hits of direct_hits.glsl with color.glsl's scene()
+// and puts each channel of the pixel together from its own subpixel, as
+// the light field shader does with quilt samples.
+
+// @include color.glsl shading
+
+uniform sampler2D posMat0; // one per subpixel
+uniform sampler2D posMat1;
+uniform sampler2D posMat2;
+uniform sampler2D normal0;
+uniform sampler2D normal1;
+uniform sampler2D normal2;
+uniform int ri;
+uniform int bi;
+
+vec3 shade(vec4 posMat, vec4 normal) {
+    if (renderSwitch == 1)
+        return posMat.rgb;
+    if (renderSwitch == 2)
+        return normal.rgb;
+    return scene(Hit(posMat.rgb, normal.rgb, normal.a)) * 1.2;
+}
+
+void main() {
+    // the panel stands in for the quilt in screen space lookups
+    quiltCoords = texCoords;
+    vec3 rgb[3];
+    rgb[0] = shade(texture(posMat0, texCoords), texture(normal0, texCoords));
+    rgb[1] = shade(texture(posMat1, texCoords), texture(normal1, texCoords));
+    rgb[2] = shade(texture(posMat2, texCoords), texture(normal2, texCoords));
+    fragColor = vec4(rgb[ri].r, rgb[1].g, rgb[bi].b, 1.);
+}
@@ -0,0 +1,52 @@
+#version 330 core
+
+// Marches the scene for every RGB subpixel of the panel with no quilt in
+// between. The view a subpixel shows follows from the calibration as in the
+// light field shader, continuously rather than rounded to a quilt view, and
+// its ray from that view as in sdf_shader.glsl. The hits are kept like the
+// hit buffers of a quilt, direct.glsl shades them every frame.
+
+// @include sdf_shader.glsl model
+
+in vec2 texCoords;
+layout (location = 0) out vec4 posMat0; // one per subpixel
+layout (location = 1) out vec4 posMat1;
+layout (location = 2) out vec4 posMat2;
+layout (location = 3) out vec4 normal0;
+layout (location = 4) out vec4 normal1;
+layout (location = 5) out vec4 normal2;
+
+// calibration of the panel
+uniform float pitch;
+uniform float tilt;
+uniform float center;
+uniform int invView;
+uniform float subp;
+uniform float displayAspect;
+
+// the hit for subpixel i of this pixel
+Hit subpixelHit(int i) {
+    // position in the view cone, 0 to 1 from the leftmost view
+    float cone = (texCoords.x + float(i) * subp + texCoords.y * tilt) * pitch - center;
+    cone = mod(cone + ceil(abs(cone)), 1.);
+    if (invView == 1)
+        cone = 1. - cone;
+
+    // the cameras of the quilt views, see sdf_shader.glsl
+    vec3 ro = vec3(1.17 * (cone - .5), .2, -1.);
+    vec2 focal_plane_dimensions = 1.8 * vec2(displayAspect, 1.);
+    vec3 ray_destination = vec3((texCoords - .5) * focal_plane_dimensions, ro.z + 1.3);
+    return rayMarchScene(ro, normalize(ray_destination - ro));
+}
+
+void main() {
+    Hit hit = subpixelHit(0);
+    posMat0 = vec4(hit.position, hit.material / NUM_MATERIALS);
+    normal0 = vec4(hit.normal, hit.material / NUM_MATERIALS);
+    hit = subpixelHit(1);
+    posMat1 = vec4(hit.position, hit.material / NUM_MATERIALS);
+    normal1 = vec4(hit.normal, hit.material / NUM_MATERIALS);
+    hit = subpixelHit(2);
+    posMat2 = vec4(hit.position, hit.material / NUM_MATERIALS);
+    normal2 = vec4(hit.normal, hit.material / NUM_MATERIALS);
+}
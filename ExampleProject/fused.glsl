@@ -0,0 +1,130 @@
+#version 330 core
+
+// The HoloPlayCore light field shader shading the hit buffers itself: each
+// subpixel shades the two quilt samples it blends with color.glsl's scene()
+// instead of reading a color quilt, one texel each except at view tile edges.
+// Neighbouring subpixels mostly need the same views, those are shaded once.
+
+// @include color.glsl shading
+
+// Calibration values
+uniform float pitch;
+uniform float tilt;
+uniform float center;
+uniform int invView;
+uniform float subp;
+uniform float displayAspect;
+uniform int ri;
+uniform int bi;
+
+// Quilt settings
+uniform vec3 tile;
+uniform vec2 viewPortion;
+uniform float quiltAspect;
+uniform int overscan;
+uniform int quiltInvert;
+
+uniform int debug;
+
+vec2 texArr(vec3 uvz)
+{
+	// decide which section to take from based on the z.
+	float x = (mod(uvz.z, tile.x) + uvz.x) / tile.x;
+	float y = (floor(uvz.z / tile.x) + uvz.y) / tile.y;
+	return vec2(x, y) * viewPortion.xy;
+}
+
+// the color quilt texel at texel, shaded from the hit buffers
+vec4 shadeTexel(ivec2 texel, vec2 size)
+{
+	quiltCoords = (vec2(texel) + 0.5) / size;
+	vec4 posMat = texelFetch(posMatTex, texel, 0);
+	vec4 normal = texelFetch(normalTex, texel, 0);
+	if (renderSwitch == 1)
+		return posMat;
+	if (renderSwitch == 2)
+		return normal;
+	return vec4(scene(Hit(posMat.rgb, normal.rgb, normal.a)) * 1.2, 1.);
+}
+
+// the color quilt at uv. Inside a view its linear filter barely differs from
+// the nearest texel, which is shaded alone; where the filter reaches into a
+// neighbouring view, the four texels are shaded and blended like the quilt
+// path does, so tile edges match it
+vec4 shadeAt(vec2 uv)
+{
+	ivec2 size = textureSize(posMatTex, 0);
+	vec2 texel = uv * vec2(size) - 0.5;
+	ivec2 base = ivec2(floor(texel));
+	ivec2 lo = clamp(base, ivec2(0), size - 1);
+	ivec2 hi = clamp(base + 1, ivec2(0), size - 1);
+	vec2 tileTexels = vec2(size) * viewPortion / tile.xy;
+	if (floor((vec2(lo) + 0.5) / tileTexels) == floor((vec2(hi) + 0.5) / tileTexels))
+		return shadeTexel(clamp(ivec2(floor(uv * vec2(size))), ivec2(0), size - 1), vec2(size));
+	vec2 f = texel - vec2(base);
+	vec4 c00 = shadeTexel(lo, vec2(size));
+	vec4 c10 = shadeTexel(ivec2(hi.x, lo.y), vec2(size));
+	vec4 c01 = shadeTexel(ivec2(lo.x, hi.y), vec2(size));
+	vec4 c11 = shadeTexel(hi, vec2(size));
+	return mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);
+}
+
+// the last two views shaded, every subpixel reuses them when it can
+float cachedView[2] = float[2](-1e9, -1e9);
+vec4 cachedColor[2];
+
+vec4 view(vec3 uvz)
+{
+	if (uvz.z == cachedView[0])
+		return cachedColor[0];
+	if (uvz.z == cachedView[1])
+		return cachedColor[1];
+	cachedView[1] = cachedView[0];
+	cachedColor[1] = cachedColor[0];
+	cachedView[0] = uvz.z;
+	cachedColor[0] = shadeAt(texArr(uvz));
+	return cachedColor[0];
+}
+
+// recreate CG clip function (clear pixel if any component is negative)
+void clip(vec3 toclip)
+{
+	if (any(lessThan(toclip, vec3(0,0,0)))) discard;
+}
+
+void main()
+{
+	if (debug == 1)
+	{
+		fragColor = shadeAt(texCoords.xy);
+	}
+	else {
+		float invert = 1.0;
+		if (invView + quiltInvert == 1) invert = -1.0;
+		vec3 nuv = vec3(texCoords.xy, 0.0);
+		nuv -= 0.5;
+		float modx = clamp (step(quiltAspect, displayAspect) * step(float(overscan), 0.5) + step(displayAspect, quiltAspect) * step(0.5, float(overscan)), 0, 1);
+		nuv.x = modx * nuv.x * displayAspect / quiltAspect + (1.0-modx) * nuv.x;
+		nuv.y = modx * nuv.y + (1.0-modx) * nuv.y * quiltAspect / displayAspect;
+		nuv += 0.5;
+		clip (nuv);
+		clip (1.0-nuv);
+		vec4 rgb[3];
+		for (int i=0; i < 3; i++)
+		{
+			nuv.z = (texCoords.x + i * subp + texCoords.y * tilt) * pitch - center;
+			nuv.z = mod(nuv.z + ceil(abs(nuv.z)), 1.0);
+			nuv.z *= invert;
+			nuv.z *= tile.z;
+			vec3 coords1 = nuv;
+			vec3 coords2 = nuv;
+			coords1.y = coords2.y = clamp(nuv.y, 0.005, 0.995);
+			coords1.z = floor(nuv.z);
+			coords2.z = ceil(nuv.z);
+			vec4 col1 = view(coords1);
+			vec4 col2 = view(coords2);
+			rgb[i] = mix(col1, col2, nuv.z - coords1.z);
+		}
+		fragColor = vec4(rgb[ri].r, rgb[1].g, rgb[bi].b, 1.0);
+	}
+}
@@ -0,0 +1,146 @@
+#version 420 core
+#extension GL_ARB_compute_shader : require
+
+// The HoloPlayCore light field shader as a compute shader, writing the
+// interlaced panel into an image.
+//
+// Neighbouring pixels sample all views of the quilt but only a few texels of
+// each, around the same uv. So each 16x16 tile of the panel first works out
+// the rows and columns of every view it reaches, stages them in shared memory
+// (packed RGBA8), and then every pixel filters its six samples from there
+// instead of fetching them from the quilt. Tiles whose footprint doesn't fit
+// fetch from the quilt directly. Quilt texels wrap like GL_REPEAT, as the
+// rendered quilts do.
+
+layout(local_size_x = 16, local_size_y = 16) in;
+
+layout(rgba8) uniform writeonly image2D panel;
+uniform sampler2D screenTex;
+
+// Calibration values
+uniform float pitch;
+uniform float tilt;
+uniform float center;
+uniform int invView;
+uniform float subp;
+uniform float displayAspect;
+uniform int ri;
+uniform int bi;
+
+// Quilt settings
+uniform vec3 tile;
+uniform vec2 viewPortion;
+uniform float quiltAspect;
+uniform int overscan;
+uniform int quiltInvert;
+
+const int TILE = 16;
+const int SHARED_TEXELS = 4096; // 16 KB, room for 46 views of 9x9 texels
+shared uint staged[SHARED_TEXELS];
+
+uint pack(vec4 c) {
+    uvec4 b = uvec4(clamp(c, 0., 1.) * 255. + .5);
+    return b.r | (b.g << 8) | (b.b << 16) | (b.a << 24);
+}
+vec4 unpack(uint p) {
+    return vec4(uvec4(p, p >> 8, p >> 16, p >> 24) & 255u) / 255.;
+}
+
+vec4 fetch(ivec2 texel) {
+    ivec2 size = textureSize(screenTex, 0);
+    // % is undefined for negative operands
+    return texelFetch(screenTex, texel - size * ivec2(floor(vec2(texel) / vec2(size))), 0);
+}
+
+// uv on the quilt views of a pixel, as the fragment shader works it out
+vec2 viewUV(vec2 texCoords) {
+    vec2 nuv = texCoords - .5;
+    float modx = clamp(step(quiltAspect, displayAspect) * step(float(overscan), .5) +
+                       step(displayAspect, quiltAspect) * step(.5, float(overscan)), 0., 1.);
+    nuv.x = modx * nuv.x * displayAspect / quiltAspect + (1. - modx) * nuv.x;
+    nuv.y = modx * nuv.y + (1. - modx) * nuv.y * quiltAspect / displayAspect;
+    return nuv + .5;
+}
+
+// quilt texel coordinates of uv in view z (integral, negative when
+// inverted), texel centers on integers
+vec2 texelOf(float z, vec2 uv) {
+    vec2 cell = vec2(mod(z, tile.x), floor(z / tile.x));
+    return (cell + uv) / tile.xy * viewPortion * vec2(textureSize(screenTex, 0)) - .5;
+}
+
+// bilinear sample of view z at uv. Staged views are in slots of span texels
+// from the floor of their texel at uvMin
+vec4 view(float z, vec2 uv, bool staging, vec2 uvMin, ivec2 span) {
+    vec2 t = texelOf(z, uv);
+    ivec2 i0 = ivec2(floor(t));
+    vec2 f = t - floor(t);
+    vec4 c00, c10, c01, c11;
+    if (staging) {
+        int slot = min(int(abs(z)), int(tile.z));
+        ivec2 local = clamp(i0 - ivec2(floor(texelOf(z, uvMin))), ivec2(0), span - 2);
+        int i = (slot * span.y + local.y) * span.x + local.x;
+        c00 = unpack(staged[i]);
+        c10 = unpack(staged[i + 1]);
+        c01 = unpack(staged[i + span.x]);
+        c11 = unpack(staged[i + span.x + 1]);
+    } else {
+        c00 = fetch(i0);
+        c10 = fetch(i0 + ivec2(1, 0));
+        c01 = fetch(i0 + ivec2(0, 1));
+        c11 = fetch(i0 + ivec2(1, 1));
+    }
+    return mix(mix(c00, c10, f.x), mix(c01, c11, f.x), f.y);
+}
+
+void main() {
+    ivec2 size = imageSize(panel);
+    float invert = invView + quiltInvert == 1 ? -1. : 1.;
+
+    // the uv range every view is sampled in by this tile, the same in the
+    // whole workgroup. Views are the floor and ceil of z, 0 to tile.z
+    // counting away from 0
+    ivec2 first = ivec2(gl_WorkGroupID.xy) * TILE;
+    vec2 uvA = viewUV((vec2(first) + .5) / vec2(size));
+    vec2 uvB = viewUV((vec2(first + TILE - 1) + .5) / vec2(size));
+    vec2 uvMin = clamp(min(uvA, uvB), vec2(0., .005), vec2(1., .995));
+    vec2 uvMax = clamp(max(uvA, uvB), vec2(0., .005), vec2(1., .995));
+    vec2 scale = viewPortion * vec2(textureSize(screenTex, 0)) / tile.xy;
+    ivec2 span = ivec2(ceil((uvMax - uvMin) * scale)) + 2;
+    int slots = int(tile.z) + 1;
+    int texels = slots * span.x * span.y;
+    bool staging = texels <= SHARED_TEXELS;
+
+    if (staging) {
+        for (int i = int(gl_LocalInvocationIndex); i < texels; i += TILE * TILE) {
+            int slot = i / (span.x * span.y);
+            int r = i % (span.x * span.y);
+            ivec2 origin = ivec2(floor(texelOf(invert * float(slot), uvMin)));
+            staged[i] = pack(fetch(origin + ivec2(r % span.x, r / span.x)));
+        }
+    }
+    memoryBarrierShared();
+    barrier();
+
+    ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+    if (any(greaterThanEqual(pixel, size)))
+        return;
+    vec2 texCoords = (vec2(pixel) + .5) / vec2(size);
+    vec2 uv = viewUV(texCoords);
+    if (any(lessThan(uv, vec2(0.))) || any(greaterThan(uv, vec2(1.)))) {
+        imageStore(panel, pixel, vec4(0., 0., 0., 1.));
+        return;
+    }
+    uv.y = clamp(uv.y, .005, .995);
+
+    vec4 rgb[3];
+    for (int i = 0; i < 3; i++) {
+        float z = (texCoords.x + float(i) * subp + texCoords.y * tilt) * pitch - center;
+        z = mod(z + ceil(abs(z)), 1.);
+        z *= invert * tile.z;
+        float z1 = floor(z);
+        float z2 = ceil(z);
+        rgb[i] = mix(view(z1, uv, staging, uvMin, span), view(z2, uv, staging, uvMin, span), z - z1);
+    }
+    imageStore(panel, pixel, vec4(rgb[ri].r, rgb[1].g, rgb[bi].b, 1.));
+}
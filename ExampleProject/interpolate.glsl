@@ -0,0 +1,111 @@
+#version 330 core
+
+// Fills in the views between key views (every keyViewStep-th view and the
+// last one) by warping the two nearest key views with the hit positions of
+// the sdf pass and blending them. Key views are copied as they are.
+
+in vec2 texCoords;
+out vec4 fragColor;
+
+uniform sampler2D keyTex;    // shaded key views
+uniform sampler2D posMatTex; // hit positions, only key views are needed
+uniform int qs_columns;
+uniform int qs_rows;
+uniform int qs_totalViews;
+uniform int qs_width;
+uniform int qs_height;
+uniform int keyViewStep;
+uniform int fillBackground;  // 1: holes take the far side of the edge
+                             // 0: the near surface is stretched over them
+uniform vec2 keyPortion;     // of keyTex rendered into, from the lower left
+
+const int STEPS = 48;
+const float W_NEAR = -1.;    // nearest point searched for, z = -.35
+const float W_FAR = 1.;      // infinitely far
+const float EDGE = .1;       // jump in w treated as an occlusion edge
+
+// camera of a view and width of the focal plane, as in sdf_shader.glsl
+float cameraX(int view) {
+    return 1.17 * (float(view) / float(qs_rows * qs_columns) - .5);
+}
+float focalWidth() {
+    return 1.8 * (float(qs_width) / float(qs_height)) * (float(qs_rows) / float(qs_columns));
+}
+
+// uv within a view to quilt texture coordinates, kept off the tile edges.
+// keyTex coordinates are these times keyPortion
+vec2 quiltCoords(int view, vec2 uv) {
+    vec2 tiles = vec2(qs_columns, qs_rows);
+    vec2 texel = tiles / (vec2(qs_width, qs_height) * keyPortion);
+    uv = clamp(uv, .5 * texel, 1. - .5 * texel);
+    return (vec2(view % qs_columns, view / qs_columns) + uv) / tiles;
+}
+
+// a point moves by (camera x difference) * w across the focal plane, with
+// w = 1 - 1.3 / (z + 1) for cameras at z = -1 focused at z = .3
+float wAt(int view, vec2 uv) {
+    float z = texture(posMatTex, quiltCoords(view, uv)).z;
+    return 1. - 1.3 / max(z + 1., 1e-3);
+}
+
+// the color key view shows at what view sees through uv
+vec3 warp(int key, int view, vec2 uv, out bool hole) {
+    float shift = (cameraX(key) - cameraX(view)) / focalWidth();
+
+    // march from near to far, stop at the first surface crossed
+    float wPrev = W_NEAR;
+    float diffPrev = wAt(key, vec2(uv.x + shift * wPrev, uv.y)) - wPrev;
+    float w = W_NEAR;
+    if (diffPrev > 0.) {
+        w = W_FAR;
+        for (int i = 1; i <= STEPS; i++) {
+            float wi = mix(W_NEAR, W_FAR, float(i) / float(STEPS));
+            float diff = wAt(key, vec2(uv.x + shift * wi, uv.y)) - wi;
+            if (diff <= 0.) {
+                w = mix(wPrev, wi, diffPrev / (diffPrev - diff));
+                break;
+            }
+            wPrev = wi;
+            diffPrev = diff;
+        }
+    }
+    float x = uv.x + shift * w;
+
+    // landing on the wall between a near and a far surface means the key
+    // view doesn't see this point
+    float texel = float(qs_columns) / (float(qs_width) * keyPortion.x);
+    float left = wAt(key, vec2(x - texel, uv.y));
+    float right = wAt(key, vec2(x + texel, uv.y));
+    hole = abs(left - right) > EDGE;
+    if (hole && fillBackground == 1)
+        x += left > right ? -1.5 * texel : 1.5 * texel;
+
+    return texture(keyTex, quiltCoords(key, vec2(x, uv.y)) * keyPortion).rgb;
+}
+
+void main() {
+    vec2 tile = texCoords * vec2(qs_columns, qs_rows);
+    int view = int(floor(tile.y)) * qs_columns + int(floor(tile.x));
+    if (view >= qs_totalViews) {
+        fragColor = vec4(0., 0., 0., 1.);
+        return;
+    }
+    int a = view - view % keyViewStep;
+    int b = min(a + keyViewStep, qs_totalViews - 1);
+    if (view == a || view == b) {
+        fragColor = texture(keyTex, texCoords * keyPortion);
+        return;
+    }
+
+    vec2 uv = fract(tile);
+    bool holeA, holeB;
+    vec3 colorA = warp(a, view, uv, holeA);
+    vec3 colorB = warp(b, view, uv, holeB);
+    float t = float(view - a) / float(b - a);
+    // a point only one key view sees comes from that one
+    if (holeA && !holeB)
+        t = 1.;
+    else if (holeB && !holeA)
+        t = 0.;
+    fragColor = vec4(mix(colorA, colorB, t), 1.);
+}
@@ -0,0 +1,176 @@
+#version 330 core
+
+// The HoloPlayCore light field shader, reading views of different sizes
+// through a table of their rects (see ViewWeighting.hpp) or from the layers
+// of a texture array. With useRects and useLayers 0 it reads a regular grid
+// of tiles like the original.
+//
+// A variant specialized for one device defines CALIBRATED and its
+// calibration as constants (see loadLightFieldShaders()): PITCH, TILT,
+// CENTER and SUBP, INVERT (1 or -1), the aspect correction ASPECT_X and
+// ASPECT_Y, CLIP when that leaves part of the panel black, and RI and BI.
+// It has no calibration uniforms, and no branches or dynamic indexing per
+// pixel on them. The view layout is compiled in as well, RECTS for the rect
+// table, LAYERS for the texture array and neither for a grid of tiles, and
+// the debug view is a variant of its own that defines DEBUG. The generic
+// shader takes those as the uniforms useRects, useLayers and debug.
+
+in vec2 texCoords;
+out vec4 fragColor;
+
+#ifndef CALIBRATED
+// Calibration values
+uniform float pitch;
+uniform float tilt;
+uniform float center;
+uniform int invView;
+uniform float subp;
+uniform float displayAspect;
+uniform int ri;
+uniform int bi;
+#endif
+
+// Quilt settings
+uniform vec3 tile;
+uniform vec2 viewPortion;
+#ifndef CALIBRATED
+uniform float quiltAspect;
+uniform int overscan;
+uniform int quiltInvert;
+uniform int useRects;
+uniform int useLayers;
+uniform int debug;
+#endif
+
+const int MAX_VIEWS = 128;
+uniform vec4 viewRects[MAX_VIEWS]; // x, y, width, height in texture coordinates
+uniform sampler2DArray viewLayers; // one view per layer
+uniform vec2 layerPortion;         // of each layer rendered into
+
+uniform sampler2D screenTex;
+
+vec2 texArr(vec3 uvz)
+{
+	// decide which section to take from based on the z.
+	float x = (mod(uvz.z, tile.x) + uvz.x) / tile.x;
+	float y = (floor(uvz.z / tile.x) + uvz.y) / tile.y;
+	return vec2(x, y) * viewPortion.xy;
+}
+
+vec2 rectCoords(vec3 uvz)
+{
+	vec4 rect = viewRects[clamp(int(uvz.z), 0, int(tile.z) - 1)];
+	// stay half a texel inside so the neighbouring view doesn't bleed in
+	vec2 texel = .5 / vec2(textureSize(screenTex, 0));
+	return rect.xy + clamp(uvz.xy * rect.zw, texel, rect.zw - texel);
+}
+
+vec4 layerView(vec3 uvz)
+{
+	// clamped to what was rendered, the layer edges clamp by themselves
+	vec2 texel = .5 / vec2(textureSize(viewLayers, 0).xy);
+	vec2 uv = min(uvz.xy * layerPortion, layerPortion - texel);
+	return texture(viewLayers, vec3(uv, clamp(floor(uvz.z), 0., tile.z - 1.)));
+}
+
+vec4 view(vec3 uvz)
+{
+#if defined(LAYERS)
+	return layerView(uvz);
+#elif defined(RECTS)
+	return texture(screenTex, rectCoords(uvz));
+#elif defined(CALIBRATED)
+	return texture(screenTex, texArr(uvz));
+#else
+	if (useLayers == 1)
+		return layerView(uvz);
+	return texture(screenTex, useRects == 1 ? rectCoords(uvz) : texArr(uvz));
+#endif
+}
+
+// the quilt as it is, or the layers laid out like one
+vec4 debugView()
+{
+	vec2 tiles = texCoords.xy * tile.xy;
+	vec3 layer = vec3(fract(tiles), floor(tiles.y) * tile.x + floor(tiles.x));
+#if defined(LAYERS)
+	return view(layer);
+#elif defined(CALIBRATED)
+	return texture(screenTex, texCoords.xy);
+#else
+	if (useLayers == 1)
+		return view(layer);
+	return texture(screenTex, texCoords.xy);
+#endif
+}
+
+#ifdef CALIBRATED
+// blend of the two views subpixel i of the pixel at texCoords sees
+vec4 subpixel(vec2 nuv, float i)
+{
+	float z = (texCoords.x + i * SUBP + texCoords.y * TILT) * PITCH - CENTER;
+	z = mod(z + ceil(abs(z)), 1.0) * (INVERT * tile.z);
+	vec3 coords1 = vec3(nuv, floor(z));
+	vec3 coords2 = vec3(nuv, ceil(z));
+#ifndef LAYERS
+	// quilt tiles bleed into each other at their edges, layers don't
+	coords1.y = coords2.y = clamp(nuv.y, 0.005, 0.995);
+#endif
+	return mix(view(coords1), view(coords2), z - coords1.z);
+}
+#endif
+
+// recreate CG clip function (clear pixel if any component is negative)
+void clip(vec3 toclip)
+{
+	if (any(lessThan(toclip, vec3(0,0,0)))) discard;
+}
+
+void main()
+{
+#if defined(DEBUG)
+	fragColor = debugView();
+#elif defined(CALIBRATED)
+	vec2 nuv = (texCoords.xy - 0.5) * vec2(ASPECT_X, ASPECT_Y) + 0.5;
+#ifdef CLIP
+	if (any(lessThan(nuv, vec2(0.0))) || any(greaterThan(nuv, vec2(1.0)))) discard;
+#endif
+	fragColor = vec4(subpixel(nuv, float(RI)).r, subpixel(nuv, 1.0).g,
+	                 subpixel(nuv, float(BI)).b, 1.0);
+#else
+	if (debug == 1)
+	{
+		fragColor = debugView();
+		return;
+	}
+	float invert = 1.0;
+	if (invView + quiltInvert == 1) invert = -1.0;
+	vec3 nuv = vec3(texCoords.xy, 0.0);
+	nuv -= 0.5;
+	float modx = clamp (step(quiltAspect, displayAspect) * step(float(overscan), 0.5) + step(displayAspect, quiltAspect) * step(0.5, float(overscan)), 0, 1);
+	nuv.x = modx * nuv.x * displayAspect / quiltAspect + (1.0-modx) * nuv.x;
+	nuv.y = modx * nuv.y + (1.0-modx) * nuv.y * quiltAspect / displayAspect;
+	nuv += 0.5;
+	clip (nuv);
+	clip (1.0-nuv);
+	vec4 rgb[3];
+	for (int i=0; i < 3; i++)
+	{
+		nuv.z = (texCoords.x + i * subp + texCoords.y * tilt) * pitch - center;
+		nuv.z = mod(nuv.z + ceil(abs(nuv.z)), 1.0);
+		nuv.z *= invert;
+		nuv.z *= tile.z;
+		vec3 coords1 = nuv;
+		vec3 coords2 = nuv;
+		// quilt tiles bleed into each other at their edges, layers don't
+		if (useLayers == 0)
+			coords1.y = coords2.y = clamp(nuv.y, 0.005, 0.995);
+		coords1.z = floor(nuv.z);
+		coords2.z = ceil(nuv.z);
+		vec4 col1 = view(coords1);
+		vec4 col2 = view(coords2);
+		rgb[i] = mix(col1, col2, nuv.z - coords1.z);
+	}
+	fragColor = vec4(rgb[ri].r, rgb[1].g, rgb[bi].b, 1.0);
+#endif
+}
@@ -0,0 +1,130 @@
+#version 330 core
+
+// Forward shading of the mesh scene (SampleScene): every view lights every
+// pixel of every object it sees. With GPU_DRAWS (GLSL 4.30) the object comes
+// from the draw of mesh_draws_vertex.glsl instead of uniforms.
+
+#ifdef GPU_DRAWS
+// @include mesh_cull.glsl draws
+#endif
+
+// @begin lighting, what mesh_atlas.glsl and mesh_shaded.glsl share
+
+#define POINT_LIGHTS 16
+#define LIGHT_GRID 16 // cells per side of the light grid
+#define OCCLUDERS 6
+
+// What every view of a frame shares, filled once per frame by
+// SampleScene::prepareFrame() (FrameBlock)
+layout(std140) uniform Frame {
+    mat4 lightSpace;      // world to the sun's shadow map clip space
+    vec4 sunDirection;    // xyz towards the sun
+    vec4 sunColor;
+    vec4 skyColor;
+    vec4 lightPositions[POINT_LIGHTS]; // xyz, w the range
+    vec4 lightColors[POINT_LIGHTS];
+    vec4 lightGrid;       // xy the xz corner of the grid, z the cell size
+    // bit i of a cell for the point lights reaching it, four cells a vector
+    uvec4 lightCells[LIGHT_GRID * LIGHT_GRID / 4];
+};
+uniform sampler2DShadow shadowMap; // the sun's, drawn once per frame
+
+// of the object drawn
+#ifdef GPU_DRAWS
+flat in int fObject;
+#define albedo (objects[fObject].color.rgb)
+#define specularity (objects[fObject].color.a)
+#define occluders (objects[fObject].occluders)
+#else
+uniform vec3 albedo;
+uniform float specularity;
+uniform vec4 occluders[OCCLUDERS]; // bounding spheres of its nearest
+                                   // neighbours, radius 0 for none
+#endif
+
+// sky light the neighbours don't block, after
+// https://iquilezles.org/articles/sphereao/
+float skyVisibility(vec3 p, vec3 n) {
+    float occlusion = 0.;
+    for (int i = 0; i < OCCLUDERS; i++) {
+        vec3 d = occluders[i].xyz - p;
+        float l = length(d);
+        float r = occluders[i].w;
+        occlusion += max(dot(n, d) / l, 0.) * r * r / (l * l);
+    }
+    return clamp(1. - occlusion, 0., 1.);
+}
+
+// sunlight reaching p, 2x2 filtered by the comparison sampler
+float sunVisibility(vec3 p, vec3 n) {
+    // pushed off the surface against acne on slopes facing away
+    vec4 s = lightSpace * vec4(p + .02 * n, 1.);
+    return texture(shadowMap, s.xyz / s.w * .5 + .5);
+}
+
+// the point lights whose range covers the grid cell of p
+uint cellLights(vec3 p) {
+    ivec2 cell = clamp(ivec2(floor((p.xz - lightGrid.xy) / lightGrid.z)), 0, LIGHT_GRID - 1);
+    int index = cell.y * LIGHT_GRID + cell.x;
+    return lightCells[index / 4][index % 4];
+}
+
+// inverse square, windowed to 0 at the range
+float attenuation(float l2, float range) {
+    float w = clamp(1. - l2 / (range * range), 0., 1.);
+    return w * w / (1. + l2);
+}
+
+// ambient and diffuse light, the same from every view
+vec3 diffuseLight(vec3 p, vec3 n) {
+    vec3 light = skyColor.rgb * (.6 + .4 * n.y) * skyVisibility(p, n);
+    light += sunColor.rgb * max(dot(n, sunDirection.xyz), 0.) * sunVisibility(p, n);
+    uint lights = cellLights(p);
+    for (int i = 0; i < POINT_LIGHTS; i++) {
+        if ((lights & (1u << uint(i))) == 0u)
+            continue;
+        vec3 d = lightPositions[i].xyz - p;
+        float l2 = dot(d, d);
+        light += lightColors[i].rgb * max(dot(n, d), 0.) * inversesqrt(l2) *
+                 attenuation(l2, lightPositions[i].w);
+    }
+    return albedo * light;
+}
+
+// Blinn-Phong highlights, toEye normalized
+vec3 specularLight(vec3 p, vec3 n, vec3 toEye) {
+    const float SHININESS = 48.;
+    vec3 h = normalize(sunDirection.xyz + toEye);
+    vec3 light = sunColor.rgb * pow(max(dot(n, h), 0.), SHININESS) * sunVisibility(p, n);
+    uint lights = cellLights(p);
+    for (int i = 0; i < POINT_LIGHTS; i++) {
+        if ((lights & (1u << uint(i))) == 0u)
+            continue;
+        vec3 d = lightPositions[i].xyz - p;
+        float l2 = dot(d, d);
+        h = normalize(d * inversesqrt(l2) + toEye);
+        light += lightColors[i].rgb * pow(max(dot(n, h), 0.), SHININESS) *
+                 attenuation(l2, lightPositions[i].w);
+    }
+    return specularity * light;
+}
+// @end lighting
+
+in vec3 fPosition;
+in vec3 fNormal;
+in vec2 fUV;
+
+#ifdef GPU_DRAWS
+flat in vec3 fEye;
+#define eye fEye
+#else
+uniform vec3 eye; // of the view, in world space
+#endif
+
+out vec4 color;
+
+void main() {
+    vec3 n = normalize(fNormal);
+    vec3 toEye = normalize(eye - fPosition);
+    color = vec4(diffuseLight(fPosition, n) + specularLight(fPosition, n, toEye), 1.);
+}
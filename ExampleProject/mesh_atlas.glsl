@@ -0,0 +1,16 @@
+#version 330 core
+
+// Texture space shading of the mesh scene, once per frame: the light that
+// doesn't depend on where it is seen from, into a texel of the object's
+// atlas tile. mesh_shaded.glsl adds the highlights in every view.
+
+// @include mesh.glsl lighting
+
+in vec3 fPosition;
+in vec3 fNormal;
+
+out vec4 color;
+
+void main() {
+    color = vec4(diffuseLight(fPosition, normalize(fNormal)), 1.);
+}
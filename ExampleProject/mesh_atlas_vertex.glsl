@@ -0,0 +1,19 @@
+#version 330 core
+
+// Rasterizes an object of the mesh scene in uv space, over the whole
+// viewport, which is its tile of the shading atlas. Mesh uv charts fill the
+// unit square (see Mesh.hpp), so every texel of the tile is covered. Reads
+// the world stream of mesh_transform.glsl.
+
+layout(location = 0) in vec3 position; // world space
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+out vec3 fPosition;
+out vec3 fNormal;
+
+void main() {
+    fPosition = position;
+    fNormal = normal;
+    gl_Position = vec4(uv * 2. - 1., 0., 1.);
+}
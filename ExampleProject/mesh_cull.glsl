@@ -0,0 +1,80 @@
+#version 430 core
+
+// Culls the objects of the mesh scene for every view of a quilt on the GPU
+// and writes the indirect draws of all views (SampleScene::drawViewsIndirect()).
+// One invocation per object tests its bounding sphere against the union of
+// the views' frusta, then against each view's frustum. Draw view * objects
+// + object gets one instance when the view sees the object and none when it
+// doesn't, and its own index as base instance, which is how
+// mesh_draws_vertex.glsl finds its object and view.
+
+// @begin draws, the buffers mesh_draws_vertex.glsl, mesh.glsl and mesh_shaded.glsl share
+
+// SampleScene::GpuObject, what doesn't change of an object
+struct Object {
+    vec4 color;        // rgb the albedo, a the specularity
+    vec4 atlasRect;    // its tile: origin and size in atlas uv
+    uvec4 draw;        // index count, first index, base vertex in the world stream
+    vec4 occluders[6]; // OCCLUDERS of mesh.glsl
+};
+layout(std430, binding = 1) readonly buffer Objects {
+    Object objects[];
+};
+
+// SampleScene::GpuView, of every view rendered into the quilt
+struct View {
+    mat4 viewProjection;
+    vec4 eye;          // xyz in world space
+    vec4 tile;         // xy scale and zw offset from the view's NDC to the quilt's
+    vec4 planes[6];    // of its frustum, facing in
+};
+layout(std430, binding = 2) readonly buffer Views {
+    View views[];
+};
+// @end draws
+
+layout(local_size_x = 64) in;
+
+// of every object at the current time: xyz the center, w the radius
+layout(std430, binding = 3) readonly buffer Bounds {
+    vec4 bounds[];
+};
+
+// DrawElementsIndirectCommand
+struct Command {
+    uint count;
+    uint instanceCount;
+    uint firstIndex;
+    int baseVertex;
+    uint baseInstance;
+};
+layout(std430, binding = 4) writeonly buffer Commands {
+    Command commands[];
+};
+
+uniform int objectCount;
+uniform int viewCount;
+uniform vec4 unionPlanes[6]; // of the union of the views' frusta
+
+bool inside(vec4 sphere, vec4 plane) {
+    return dot(plane.xyz, sphere.xyz) + plane.w + sphere.w >= 0.;
+}
+
+void main() {
+    int object = int(gl_GlobalInvocationID.x);
+    if (object >= objectCount)
+        return;
+    vec4 sphere = bounds[object];
+    bool inUnion = true;
+    for (int p = 0; p < 6; p++)
+        inUnion = inUnion && inside(sphere, unionPlanes[p]);
+
+    uvec4 draw = objects[object].draw;
+    for (int v = 0; v < viewCount; v++) {
+        bool visible = inUnion;
+        for (int p = 0; p < 6 && visible; p++)
+            visible = inside(sphere, views[v].planes[p]);
+        uint id = uint(v * objectCount + object);
+        commands[id] = Command(draw.x, visible ? 1u : 0u, draw.y, int(draw.z), id);
+    }
+}
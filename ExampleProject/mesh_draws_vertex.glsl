@@ -0,0 +1,41 @@
+#version 430 core
+
+// Puts the mesh scene into every view of the quilt at once, from the world
+// stream, for the indirect draws of mesh_cull.glsl. The draw's base
+// instance reads its index from an instanced attribute; the index names the
+// view and the object. The view is mapped into its tile of the quilt, with
+// clip distances at the tile's edges standing in for a viewport per view.
+
+// @include mesh_cull.glsl draws
+
+layout(location = 0) in vec3 position; // world space
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+layout(location = 3) in uint drawId;   // view * objectCount + object
+
+uniform int objectCount;
+
+out vec3 fPosition;
+out vec3 fNormal;
+out vec2 fUV;
+flat out int fObject;
+flat out vec3 fEye;
+out float gl_ClipDistance[4];
+
+void main() {
+    int view = int(drawId) / objectCount;
+    fObject = int(drawId) % objectCount;
+    fPosition = position;
+    fNormal = normal;
+    fUV = uv;
+    fEye = views[view].eye.xyz;
+
+    vec4 clip = views[view].viewProjection * vec4(position, 1.);
+    // inside the view's own NDC square
+    gl_ClipDistance[0] = clip.w + clip.x;
+    gl_ClipDistance[1] = clip.w - clip.x;
+    gl_ClipDistance[2] = clip.w + clip.y;
+    gl_ClipDistance[3] = clip.w - clip.y;
+    clip.xy = clip.xy * views[view].tile.xy + views[view].tile.zw * clip.w;
+    gl_Position = clip;
+}
@@ -0,0 +1,38 @@
+#version 330 core
+
+// The mesh scene in a view with texture space shading: the ambient and
+// diffuse light comes from the object's tile of the atlas mesh_atlas.glsl
+// shaded this frame, only the highlights are computed per view. GPU_DRAWS
+// as in mesh.glsl.
+
+#ifdef GPU_DRAWS
+// @include mesh_cull.glsl draws
+#endif
+
+// @include mesh.glsl lighting
+
+in vec3 fPosition;
+in vec3 fNormal;
+in vec2 fUV;
+
+uniform sampler2D atlas;
+#ifdef GPU_DRAWS
+flat in vec3 fEye;
+#define eye fEye
+#define atlasRect (objects[fObject].atlasRect)
+#else
+uniform vec3 eye;        // of the view, in world space
+uniform vec4 atlasRect;  // the object's tile: origin and size in atlas uv
+#endif
+
+out vec4 color;
+
+void main() {
+    // half a texel in from the tile's edges, so nothing of a neighbouring
+    // tile is filtered in
+    vec2 halfTexel = .5 / vec2(textureSize(atlas, 0));
+    vec2 uv = atlasRect.xy + clamp(fUV * atlasRect.zw, halfTexel, atlasRect.zw - halfTexel);
+    vec3 n = normalize(fNormal);
+    vec3 toEye = normalize(eye - fPosition);
+    color = vec4(texture(atlas, uv).rgb + specularLight(fPosition, n, toEye), 1.);
+}
@@ -0,0 +1,6 @@
+#version 330 core
+
+// The shadow map only keeps depth.
+
+void main() {
+}
@@ -0,0 +1,13 @@
+#version 330 core
+
+// An object of the mesh scene into the sun's shadow map, drawn once per
+// frame for every view (SampleScene::prepareFrame()) from the world stream
+// of mesh_transform.glsl.
+
+layout(location = 0) in vec3 position; // world space
+
+uniform mat4 lightSpace; // world to the shadow map's clip space
+
+void main() {
+    gl_Position = lightSpace * vec4(position, 1.);
+}
@@ -0,0 +1,34 @@
+#version 330 core
+
+// Skins and transforms the vertices of an object of the mesh scene into
+// world space, once per frame. Transform feedback captures the outputs
+// into the world stream every view then draws from
+// (SampleScene::transformFrame()).
+
+// @begin skinning, what mesh_vertex.glsl shares
+
+uniform mat4 model; // rotation, uniform scale and translation
+uniform mat4 sway;  // the top bone, the bottom one stays put
+
+// linear blend of the two bones by height, then into world space
+void skin(vec3 position, vec3 normal, out vec3 worldPosition, out vec3 worldNormal) {
+    float w = smoothstep(-1., 1., position.y);
+    mat4 bone = mat4(1.) + w * (sway - mat4(1.));
+    worldPosition = (model * (bone * vec4(position, 1.))).xyz;
+    worldNormal = mat3(model) * (mat3(bone) * normal);
+}
+// @end skinning
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+// interleaved like MeshVertex
+out vec3 wPosition;
+out vec3 wNormal;
+out vec2 wUV;
+
+void main() {
+    skin(position, normal, wPosition, wNormal);
+    wUV = uv;
+}
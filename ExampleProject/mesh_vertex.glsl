@@ -0,0 +1,23 @@
+#version 330 core
+
+// Puts the mesh scene (SampleScene) into one view of the quilt, skinning and
+// transforming the vertices again in every view (--mesh-transform view).
+// mesh_world_vertex.glsl reads them transformed once per frame instead.
+
+// @include mesh_transform.glsl skinning
+
+layout(location = 0) in vec3 position;
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+uniform mat4 viewProjection;
+
+out vec3 fPosition; // world space
+out vec3 fNormal;
+out vec2 fUV;
+
+void main() {
+    skin(position, normal, fPosition, fNormal);
+    fUV = uv;
+    gl_Position = viewProjection * vec4(fPosition, 1.);
+}
@@ -0,0 +1,22 @@
+#version 330 core
+
+// Puts the mesh scene (SampleScene) into one view of the quilt from the
+// world stream mesh_transform.glsl wrote this frame: all that is left to
+// do per view is the view's projection.
+
+layout(location = 0) in vec3 position; // world space
+layout(location = 1) in vec3 normal;
+layout(location = 2) in vec2 uv;
+
+uniform mat4 viewProjection;
+
+out vec3 fPosition;
+out vec3 fNormal;
+out vec2 fUV;
+
+void main() {
+    fPosition = position;
+    fNormal = normal;
+    fUV = uv;
+    gl_Position = viewProjection * vec4(position, 1.);
+}
@@ -0,0 +1,66 @@
+#version 330 core
+
+// Synthesizes the views of a quilt from a color image and its depth map, see
+// RgbdQuiltSource.hpp. Both images are already resampled to a view.
+
+in vec2 texCoords;
+out vec4 fragColor;
+
+uniform sampler2D colorTex;
+uniform sampler2D depthTex; // 0 far, 1 near
+uniform int columns;
+uniform int rows;
+uniform int views;
+uniform float strength;     // shift of the nearest points in the outermost views
+uniform float focus;        // depth that stays in place
+uniform float viewWidth;    // in pixels
+
+const int STEPS = 64;
+const float EDGE = 0.05;    // depth step treated as an occlusion edge
+
+void main()
+{
+    vec2 tile = texCoords * vec2(columns, rows);
+    int view = int(floor(tile.y)) * columns + int(floor(tile.x));
+    if (view >= views) {
+        fragColor = vec4(0.0, 0.0, 0.0, 1.0);
+        return;
+    }
+    vec2 uv = fract(tile);
+
+    // views go from left to right across the cone, points in front of the
+    // focus depth move against the viewer
+    float side = views > 1 ? float(view) / float(views - 1) * 2.0 - 1.0 : 0.0;
+    float k = -side * strength;
+
+    // a point at depth d seen through this pixel comes from
+    // uv.x - k * (d - focus) in the source. March from near to far and stop
+    // at the first surface crossed
+    float dPrev = 1.0;
+    float diffPrev = texture(depthTex, vec2(uv.x - k * (1.0 - focus), uv.y)).r - 1.0;
+    float hitD = 1.0;
+    if (diffPrev < 0.0) {
+        hitD = 0.0;
+        for (int i = 1; i <= STEPS; i++) {
+            float d = 1.0 - float(i) / float(STEPS);
+            float diff = texture(depthTex, vec2(uv.x - k * (d - focus), uv.y)).r - d;
+            if (diff >= 0.0) {
+                hitD = mix(dPrev, d, diffPrev / (diffPrev - diff));
+                break;
+            }
+            dPrev = d;
+            diffPrev = diff;
+        }
+    }
+    float x = uv.x - k * (hitD - focus);
+
+    // landing on the wall between a near and a far surface means this pixel
+    // was hidden in the source: fill it from the far side of the edge
+    float texel = 1.0 / viewWidth;
+    float left = texture(depthTex, vec2(x - texel, uv.y)).r;
+    float right = texture(depthTex, vec2(x + texel, uv.y)).r;
+    if (abs(left - right) > EDGE)
+        x += left < right ? -1.5 * texel : 1.5 * texel;
+
+    fragColor = vec4(texture(colorTex, vec2(x, uv.y)).rgb, 1.0);
+}
@@ -1,4 +1,5 @@
 #version 330 core
+// @begin model, the scene and its ray march, direct_hits.glsl includes it
     
 // from https://github.com/glslify/glsl-look-at/blob/gh-pages/index.glsl
 vec3 lookAt(vec3 origin, vec3 target) {
@@ -251,11 +252,15 @@ Hit rayMarchScene(vec3 ro, vec3 ray_dir) {
 
     return Hit(p, calcNormal(p), res.y);
 }
+// @end model
 
 uniform int qs_rows;
 uniform int qs_columns;
 uniform int qs_width;
 uniform int qs_height;
+uniform int qs_totalViews;
+uniform int keyViewStep; // > 1: only every keyViewStep-th view and the last
+                         // one are rendered, interpolate.glsl fills the rest
 
 in vec2 texCoords;
 layout (location = 0) out vec4 posMatOut;
@@ -273,6 +278,9 @@ void main() {
 
     vec2 index = vec2(floor(texCoords.x * numCols),
                       floor(texCoords.y * numRows));
+    int view = int(index.y) * qs_columns + int(index.x);
+    if (keyViewStep > 1 && view % keyViewStep != 0 && view != qs_totalViews - 1)
+        discard;
               
     // convert 2D index to 1D, flatIndex is from 0 -> 1
     float flatIndex = (index.y * numCols + index.x) / (numRows * numCols);
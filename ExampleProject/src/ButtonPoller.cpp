@@ -0,0 +1,118 @@
+/**
+ * ButtonPoller.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "ButtonPoller.hpp"
+
+#include <GLFW/glfw3.h>
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "HoloPlayCore.h"
+
+using namespace std;
+
+ButtonPoller::ButtonPoller(InputQueue &queue,
+                           const std::vector<int> &devices,
+                           float rateHz)
+    : queue(queue),
+      devices(devices),
+      rateHz(rateHz > 0.0f ? rateHz : 30.0f),
+      lastState(devices.size() * NUM_BUTTONS, 0),
+      reportedError(false),
+      running(false)
+{
+}
+
+ButtonPoller::~ButtonPoller()
+{
+  stop();
+}
+
+void ButtonPoller::start()
+{
+  if (running)
+    return;
+  cout << "[Info] polling Looking Glass buttons at " << rateHz << " Hz" << endl;
+  running = true;
+  thread = std::thread(&ButtonPoller::pollLoop, this);
+}
+
+void ButtonPoller::stop()
+{
+  if (!running)
+    return;
+  {
+    lock_guard<mutex> lock(wakeMutex);
+    running = false;
+  }
+  wake.notify_all();
+  thread.join();
+}
+
+void ButtonPoller::pollLoop()
+{
+  const chrono::microseconds period(long(1000000.0f / rateHz));
+  chrono::steady_clock::time_point next = chrono::steady_clock::now();
+
+  while (running)
+  {
+    pollOnce();
+
+    // fixed rate; if a refresh took longer than a period, don't try to catch up
+    next += period;
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    if (next < now)
+      next = now;
+
+    unique_lock<mutex> lock(wakeMutex);
+    wake.wait_until(lock, next, [this] { return !running; });
+  }
+}
+
+void ButtonPoller::pollOnce()
+{
+  // the blocking round trip to HoloPlay Service
+  hpc_client_error err = hpc_RefreshState();
+  if (err)
+  {
+    if (!reportedError)
+      cout << "[Warning] button poll failed to refresh state (code " << err
+           << ")" << endl;
+    reportedError = true;
+    return;
+  }
+  reportedError = false;
+
+  for (size_t d = 0; d < devices.size(); d++)
+  {
+    for (int b = 0; b < NUM_BUTTONS; b++)
+    {
+      string query = "/buttons/" + to_string(b);
+      int pressed = hpc_GetDevicePropertyInt(devices[d], query.c_str()) ? 1 : 0;
+      int &last = lastState[d * NUM_BUTTONS + size_t(b)];
+      if (pressed == last)
+        continue;
+      last = pressed;
+
+      InputEvent event;
+      event.source = InputEvent::DeviceButton;
+      event.window = NULL;
+      event.device = devices[d];
+      event.code = b;
+      event.scancode = 0;
+      event.action = pressed ? GLFW_PRESS : GLFW_RELEASE;
+      event.mods = 0;
+      queue.push(event);
+    }
+  }
+}
@@ -0,0 +1,60 @@
+/**
+ * ButtonPoller.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_BUTTON_POLLER_HPP
+#define HOLOPLAY_BUTTON_POLLER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "InputQueue.hpp"
+
+// Polls the hardware buttons of the driven Looking Glasses on a background
+// thread. hpc_RefreshState() blocks on a round trip to HoloPlay Service, so it
+// never runs on the render thread; changes in button state are turned into
+// press / release events and pushed into the input queue.
+//
+// HoloPlay Core keeps a single global state that hpc_RefreshState() replaces,
+// so while the poller runs the render thread must not query device
+// properties. Start it after initialization and stop it before hpc_CloseApp().
+class ButtonPoller
+{
+public:
+    static const int NUM_BUTTONS = 4; // /buttons/0..3
+
+    ButtonPoller(InputQueue &queue, const std::vector<int> &devices, float rateHz);
+    ~ButtonPoller();
+
+    void start();
+    void stop();
+    bool isRunning() const { return running; }
+
+private:
+    ButtonPoller(const ButtonPoller &);
+    ButtonPoller &operator=(const ButtonPoller &);
+
+    void pollLoop();
+    void pollOnce();
+
+    InputQueue &queue;
+    std::vector<int> devices;
+    float rateHz;
+
+    std::vector<int> lastState; // devices.size() * NUM_BUTTONS entries
+    bool reportedError;
+
+    std::atomic<bool> running;
+    std::thread thread;
+    std::mutex wakeMutex;
+    std::condition_variable wake; // lets stop() interrupt the sleep
+};
+
+#endif // HOLOPLAY_BUTTON_POLLER_HPP
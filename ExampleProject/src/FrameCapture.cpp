@@ -0,0 +1,497 @@
+/**
+ * FrameCapture.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "FrameCapture.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// png encoding
+// =========================================================
+static unsigned long pngCrc(const unsigned char *data, size_t size,
+                            unsigned long crc = 0xffffffffUL)
+{
+  static struct Table
+  {
+    unsigned long entries[256];
+    Table()
+    {
+      for (unsigned long n = 0; n < 256; n++)
+      {
+        unsigned long c = n;
+        for (int k = 0; k < 8; k++)
+          c = (c & 1) ? 0xedb88320UL ^ (c >> 1) : c >> 1;
+        entries[n] = c;
+      }
+    }
+  } table;
+  for (size_t i = 0; i < size; i++)
+    crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+  return crc;
+}
+
+static void putBigEndian(vector<unsigned char> &out, unsigned long value)
+{
+  out.push_back((unsigned char)(value >> 24));
+  out.push_back((unsigned char)(value >> 16));
+  out.push_back((unsigned char)(value >> 8));
+  out.push_back((unsigned char)value);
+}
+
+static void putChunk(FILE *file, const char *type, const vector<unsigned char> &data)
+{
+  vector<unsigned char> head;
+  putBigEndian(head, (unsigned long)data.size());
+  head.insert(head.end(), type, type + 4);
+  unsigned long crc = pngCrc(head.data() + 4, 4);
+  if (!data.empty())
+    crc = pngCrc(data.data(), data.size(), crc);
+  vector<unsigned char> tail;
+  putBigEndian(tail, crc ^ 0xffffffffUL);
+
+  fwrite(head.data(), 1, head.size(), file);
+  if (!data.empty())
+    fwrite(data.data(), 1, data.size(), file);
+  fwrite(tail.data(), 1, tail.size(), file);
+}
+
+FrameCapture::FrameCapture(const std::string &path, Format format, int width,
+                           int height, int fps, GpuMemoryRegistry *memory)
+    : path(path),
+      format(format),
+      width(width),
+      height(height),
+      fps(fps > 0 ? fps : 30),
+      memory(memory),
+      head(0),
+      pending(0),
+      captured(0),
+      dropped(0),
+      finished(false),
+      scaleFBO(0),
+      scaleTexture(0),
+      stopping(false),
+      stream(NULL),
+      streamFailed(false),
+      nextStreamFrame(0)
+{
+  const size_t frameBytes = size_t(width) * size_t(height) * 4;
+  for (int i = 0; i < SLOTS; i++)
+  {
+    glGenBuffers(1, &slots[i].pbo);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slots[i].pbo);
+    glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(frameBytes), NULL, GL_STREAM_READ);
+    slots[i].fence = 0;
+    slots[i].frame = 0;
+    if (memory)
+      memory->addBuffer("capture readback " + path, slots[i].pbo, frameBytes);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  cout << "[Info] capturing " << width << "x" << height << " frames to " << path
+       << (format == Png ? "_*.png" : format == Raw ? "_*.rgba" : ".y4m") << endl;
+  writer = std::thread(&FrameCapture::writerLoop, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+  finish();
+}
+
+bool FrameCapture::parseFormat(const std::string &name, Format &format)
+{
+  if (name == "png")
+    format = Png;
+  else if (name == "raw")
+    format = Raw;
+  else if (name == "y4m")
+    format = Y4m;
+  else
+    return false;
+  return true;
+}
+
+void FrameCapture::capture(GLuint framebuffer, GLenum readBuffer, int sourceWidth,
+                           int sourceHeight)
+{
+  if (finished)
+    return;
+
+  if (sourceWidth > 0 && sourceHeight > 0 &&
+      (sourceWidth != width || sourceHeight != height))
+  {
+    if (!scaleFBO)
+    {
+      glGenTextures(1, &scaleTexture);
+      glBindTexture(GL_TEXTURE_2D, scaleTexture);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, NULL);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glBindTexture(GL_TEXTURE_2D, 0);
+      glGenFramebuffers(1, &scaleFBO);
+      glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaleFBO);
+      glFramebufferTexture2D(GL_DRAW_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                             scaleTexture, 0);
+      if (memory)
+        memory->addTexture("capture scaling " + path, scaleTexture, GL_RGBA8, width,
+                           height);
+    }
+    // the same stretch the light field shader applies to the rendered part
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+    glReadBuffer(readBuffer);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, scaleFBO);
+    glBlitFramebuffer(0, 0, sourceWidth, sourceHeight, 0, 0, width, height,
+                      GL_COLOR_BUFFER_BIT, GL_LINEAR);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+    framebuffer = scaleFBO;
+    readBuffer = GL_COLOR_ATTACHMENT0;
+  }
+
+  // the ring is full, the oldest readback was queued SLOTS frames ago and has
+  // almost certainly finished
+  if (pending == SLOTS)
+    retire(slots[(head + SLOTS - pending) % SLOTS], true);
+
+  Slot &slot = slots[head];
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+  glReadBuffer(readBuffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  // with a pack buffer bound this returns immediately
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+
+  slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.frame = captured++;
+  head = (head + 1) % SLOTS;
+  pending++;
+
+  retireSignaled();
+}
+
+void FrameCapture::retireSignaled()
+{
+  while (pending > 0)
+  {
+    Slot &oldest = slots[(head + SLOTS - pending) % SLOTS];
+    GLenum status = glClientWaitSync(oldest.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      break;
+    retire(oldest, false);
+  }
+}
+
+void FrameCapture::retire(Slot &slot, bool wait)
+{
+  if (wait)
+  {
+    while (glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) ==
+           GL_TIMEOUT_EXPIRED)
+      ;
+  }
+  glDeleteSync(slot.fence);
+  slot.fence = 0;
+  pending--;
+
+  const size_t frameBytes = size_t(width) * size_t(height) * 4;
+  Frame frame;
+  frame.index = slot.frame;
+  {
+    lock_guard<mutex> lock(queueMutex);
+    if (queue.size() >= MAX_QUEUED)
+    {
+      // the writer can't keep up, losing a frame beats stalling the display
+      dropped++;
+      return;
+    }
+    if (!spare.empty())
+    {
+      frame.pixels.swap(spare.back());
+      spare.pop_back();
+    }
+  }
+  frame.pixels.resize(frameBytes);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+  const void *mapped = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0,
+                                        GLsizeiptr(frameBytes), GL_MAP_READ_BIT);
+  if (mapped)
+  {
+    memcpy(frame.pixels.data(), mapped, frameBytes);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!mapped)
+  {
+    cout << "[Error] couldn't map capture buffer for frame " << frame.index << endl;
+    dropped++;
+    return;
+  }
+
+  {
+    lock_guard<mutex> lock(queueMutex);
+    queue.push_back(Frame());
+    queue.back().index = frame.index;
+    queue.back().pixels.swap(frame.pixels);
+  }
+  wake.notify_one();
+}
+
+void FrameCapture::finish()
+{
+  if (finished)
+    return;
+  finished = true;
+
+  while (pending > 0)
+    retire(slots[(head + SLOTS - pending) % SLOTS], true);
+  for (int i = 0; i < SLOTS; i++)
+  {
+    if (memory)
+      memory->remove(GpuMemoryRegistry::Buffer, slots[i].pbo);
+    glDeleteBuffers(1, &slots[i].pbo);
+  }
+  if (scaleFBO)
+  {
+    if (memory)
+      memory->remove(GpuMemoryRegistry::Texture, scaleTexture);
+    glDeleteFramebuffers(1, &scaleFBO);
+    glDeleteTextures(1, &scaleTexture);
+  }
+
+  // the writer empties the queue before it stops
+  {
+    lock_guard<mutex> lock(queueMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  writer.join();
+  if (stream)
+    fclose(stream);
+  stream = NULL;
+
+  cout << "[Info] captured " << captured - dropped << " frames to " << path;
+  if (dropped)
+    cout << ", " << dropped << " dropped because writing fell behind";
+  cout << endl;
+}
+
+// writer thread
+// =========================================================
+void FrameCapture::writerLoop()
+{
+  for (;;)
+  {
+    Frame frame;
+    {
+      unique_lock<mutex> lock(queueMutex);
+      wake.wait(lock, [this] { return stopping || !queue.empty(); });
+      if (queue.empty())
+        return;
+      frame.index = queue.front().index;
+      frame.pixels.swap(queue.front().pixels);
+      queue.pop_front();
+    }
+
+    write(frame);
+
+    lock_guard<mutex> lock(queueMutex);
+    spare.push_back(std::vector<unsigned char>());
+    spare.back().swap(frame.pixels);
+  }
+}
+
+void FrameCapture::write(const Frame &frame)
+{
+  char number[16];
+  snprintf(number, sizeof(number), "_%06d", frame.index);
+  switch (format)
+  {
+  case Png:
+    writePng(path + number + ".png", frame);
+    break;
+  case Raw:
+    writeRaw(path + number + ".rgba", frame);
+    break;
+  case Y4m:
+    writeY4m(frame);
+    break;
+  }
+}
+
+void FrameCapture::writePng(const std::string &fileName, const Frame &frame)
+{
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    cout << "[Error] couldn't open " << fileName << " for writing" << endl;
+    return;
+  }
+
+  static const unsigned char signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+  fwrite(signature, 1, sizeof(signature), file);
+
+  vector<unsigned char> header;
+  putBigEndian(header, (unsigned long)width);
+  putBigEndian(header, (unsigned long)height);
+  header.push_back(8); // bit depth
+  header.push_back(6); // RGBA
+  header.push_back(0); // deflate
+  header.push_back(0); // adaptive filtering
+  header.push_back(0); // no interlacing
+  putChunk(file, "IHDR", header);
+
+  // zlib stream of stored (uncompressed) deflate blocks: compressing would
+  // cost more time than the writer has per frame at quilt sizes
+  const size_t rowBytes = size_t(width) * 4;
+  const size_t rawBytes = (rowBytes + 1) * size_t(height);
+  const size_t maxBlock = 65535;
+  vector<unsigned char> data;
+  data.reserve(2 + rawBytes + (rawBytes / maxBlock + 1) * 5 + 4);
+  data.push_back(0x78);
+  data.push_back(0x01);
+
+  unsigned long a = 1, b = 0; // adler32 of the filtered rows
+  size_t blockLeft = 0;
+  size_t written = 0;
+  for (int y = 0; y < height; y++)
+  {
+    // rows were read bottom up
+    const unsigned char *row = &frame.pixels[size_t(height - 1 - y) * rowBytes];
+    for (size_t x = 0; x <= rowBytes; x++)
+    {
+      if (blockLeft == 0)
+      {
+        blockLeft = min(maxBlock, rawBytes - written);
+        data.push_back(written + blockLeft == rawBytes ? 1 : 0);
+        data.push_back((unsigned char)(blockLeft & 0xff));
+        data.push_back((unsigned char)(blockLeft >> 8));
+        data.push_back((unsigned char)(~blockLeft & 0xff));
+        data.push_back((unsigned char)((~blockLeft >> 8) & 0xff));
+      }
+      unsigned char value = x == 0 ? 0 : row[x - 1]; // filter type none
+      data.push_back(value);
+      a = (a + value) % 65521;
+      b = (b + a) % 65521;
+      blockLeft--;
+      written++;
+    }
+  }
+  putBigEndian(data, (b << 16) | a);
+  putChunk(file, "IDAT", data);
+  putChunk(file, "IEND", vector<unsigned char>());
+  fclose(file);
+}
+
+void FrameCapture::writeRaw(const std::string &fileName, const Frame &frame)
+{
+  FILE *file = fopen(fileName.c_str(), "wb");
+  if (!file)
+  {
+    cout << "[Error] couldn't open " << fileName << " for writing" << endl;
+    return;
+  }
+  const size_t rowBytes = size_t(width) * 4;
+  for (int y = height - 1; y >= 0; y--)
+    fwrite(&frame.pixels[size_t(y) * rowBytes], 1, rowBytes, file);
+  fclose(file);
+}
+
+void FrameCapture::writeY4m(const Frame &frame)
+{
+  // 4:2:0 needs even dimensions
+  const bool subsample = width % 2 == 0 && height % 2 == 0;
+  static const char frameHeader[] = "FRAME\n";
+  if (streamFailed)
+    return;
+  if (!stream)
+  {
+    string fileName = path + ".y4m";
+    stream = fopen(fileName.c_str(), "wb");
+    if (!stream)
+    {
+      cout << "[Error] couldn't open " << fileName << " for writing" << endl;
+      streamFailed = true;
+      return;
+    }
+    // without XCOLORRANGE readers assume limited range and wash the colors out
+    fprintf(stream, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 %s XCOLORRANGE=FULL\n", width,
+            height, fps, subsample ? "C420jpeg" : "C444");
+  }
+
+  // the stream has no frame numbers, repeat the last frame for dropped ones
+  // so the timing stays right
+  for (; nextStreamFrame < frame.index && !planes.empty(); nextStreamFrame++)
+  {
+    fwrite(frameHeader, 1, sizeof(frameHeader) - 1, stream);
+    fwrite(planes.data(), 1, planes.size(), stream);
+  }
+  nextStreamFrame = frame.index + 1;
+
+  // full range BT.601, what C420jpeg means
+  const size_t pixels = size_t(width) * size_t(height);
+  const int cw = subsample ? width / 2 : width;
+  const int ch = subsample ? height / 2 : height;
+  const size_t chromaPixels = size_t(cw) * size_t(ch);
+  planes.resize(pixels + 2 * chromaPixels);
+  unsigned char *Y = &planes[0];
+  unsigned char *U = &planes[pixels];
+  unsigned char *V = &planes[pixels + chromaPixels];
+
+  for (int y = 0; y < height; y++)
+  {
+    const unsigned char *row = &frame.pixels[size_t(height - 1 - y) * size_t(width) * 4];
+    for (int x = 0; x < width; x++)
+    {
+      const unsigned char *p = row + x * 4;
+      float luma = 0.299f * p[0] + 0.587f * p[1] + 0.114f * p[2];
+      Y[size_t(y) * size_t(width) + size_t(x)] = (unsigned char)(luma + 0.5f);
+    }
+  }
+  for (int y = 0; y < ch; y++)
+  {
+    for (int x = 0; x < cw; x++)
+    {
+      // average the 2x2 block when subsampling
+      float r = 0, g = 0, b = 0;
+      int n = subsample ? 2 : 1;
+      for (int dy = 0; dy < n; dy++)
+      {
+        int sy = height - 1 - (y * n + dy);
+        for (int dx = 0; dx < n; dx++)
+        {
+          const unsigned char *p =
+              &frame.pixels[(size_t(sy) * size_t(width) + size_t(x * n + dx)) * 4];
+          r += p[0];
+          g += p[1];
+          b += p[2];
+        }
+      }
+      float scale = 1.0f / float(n * n);
+      r *= scale;
+      g *= scale;
+      b *= scale;
+      float cb = 128.0f - 0.168736f * r - 0.331264f * g + 0.5f * b;
+      float cr = 128.0f + 0.5f * r - 0.418688f * g - 0.081312f * b;
+      U[size_t(y) * size_t(cw) + size_t(x)] = (unsigned char)min(max(cb + 0.5f, 0.0f), 255.0f);
+      V[size_t(y) * size_t(cw) + size_t(x)] = (unsigned char)min(max(cr + 0.5f, 0.0f), 255.0f);
+    }
+  }
+
+  fwrite(frameHeader, 1, sizeof(frameHeader) - 1, stream);
+  fwrite(planes.data(), 1, planes.size(), stream);
+}
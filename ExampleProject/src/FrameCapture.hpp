@@ -0,0 +1,126 @@
+/**
+ * FrameCapture.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_FRAME_CAPTURE_HPP
+#define HOLOPLAY_FRAME_CAPTURE_HPP
+
+#include <GL/glew.h>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GpuMemory.hpp"
+
+// Records the color buffer of a framebuffer every frame without stalling the
+// render loop. capture() only queues a glReadPixels into one of a ring of
+// pixel pack buffers and fences it; the pixels are mapped a frame or two later
+// once the fence has signaled and handed to a writer thread that encodes
+// them. A synchronous glReadPixels would wait for the whole frame to finish.
+//
+// All GL calls must be made from the same context (or contexts sharing with
+// it). If the writer falls behind, frames are dropped rather than blocking
+// the render thread; the number is reported when the capture finishes.
+class FrameCapture
+{
+public:
+    enum Format
+    {
+        Png, // <path>_000000.png, RGBA8, uncompressed (stored) deflate
+        Raw, // <path>_000000.rgba, RGBA8 rows top to bottom
+        Y4m  // <path>.y4m, one stream, 4:2:0 (4:4:4 for odd sizes)
+    };
+
+    // creates the pack buffers in the current context
+    FrameCapture(const std::string &path, Format format, int width, int height,
+                 int fps = 30, GpuMemoryRegistry *memory = NULL);
+    ~FrameCapture(); // finish()es if that hasn't happened yet
+
+    // queues the readback of the color buffer readBuffer (GL_BACK,
+    // GL_COLOR_ATTACHMENT0, ...) of framebuffer, which has to be at least
+    // width x height. When only its lower left sourceWidth x sourceHeight
+    // was rendered (render scaling), that part is first scaled to width x
+    // height so every frame of the capture has the same size. Leaves
+    // GL_READ_FRAMEBUFFER bound to 0.
+    void capture(GLuint framebuffer, GLenum readBuffer, int sourceWidth = 0,
+                 int sourceHeight = 0);
+
+    // waits for the frames in flight, writes them and deletes the GL objects.
+    // Needs the capture's context current.
+    void finish();
+
+    int framesCaptured() const { return captured; }
+    int framesDropped() const { return dropped; }
+
+    static bool parseFormat(const std::string &name, Format &format);
+
+private:
+    FrameCapture(const FrameCapture &);
+    FrameCapture &operator=(const FrameCapture &);
+
+    struct Slot
+    {
+        GLuint pbo;
+        GLsync fence; // 0 while the slot is free
+        int frame;
+    };
+
+    struct Frame
+    {
+        int index;
+        std::vector<unsigned char> pixels; // RGBA8, bottom row first
+    };
+
+    void retire(Slot &slot, bool wait); // map a slot and hand it to the writer
+    void retireSignaled();              // retire finished slots in order
+    void writerLoop();
+    void write(const Frame &frame);
+    void writePng(const std::string &fileName, const Frame &frame);
+    void writeRaw(const std::string &fileName, const Frame &frame);
+    void writeY4m(const Frame &frame);
+
+    std::string path;
+    Format format;
+    int width;
+    int height;
+    int fps;
+    GpuMemoryRegistry *memory;
+
+    // readback ring, render thread only
+    static const int SLOTS = 3;
+    Slot slots[SLOTS];
+    int head;    // slot the next capture goes to
+    int pending; // slots with a readback in flight, the oldest at head - pending
+    int captured;
+    int dropped;
+    bool finished;
+
+    // width x height target for scaled sources, created on first use
+    GLuint scaleFBO;
+    GLuint scaleTexture;
+
+    // frames waiting for the writer and buffers to reuse for them
+    static const size_t MAX_QUEUED = 8;
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::deque<Frame> queue;
+    std::vector<std::vector<unsigned char>> spare;
+    bool stopping;
+    std::thread writer;
+
+    // y4m output, writer thread only
+    FILE *stream;
+    bool streamFailed;
+    int nextStreamFrame;
+    std::vector<unsigned char> planes; // the last frame written
+};
+
+#endif // HOLOPLAY_FRAME_CAPTURE_HPP
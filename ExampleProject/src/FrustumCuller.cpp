@@ -0,0 +1,211 @@
+/**
+ * FrustumCuller.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "FrustumCuller.hpp"
+
+#include <algorithm>
+#include <cfloat>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HOLOPLAY_CULL_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+
+static glm::vec4 normalizePlane(const glm::vec4 &plane)
+{
+  return plane / glm::length(glm::vec3(plane));
+}
+
+// Gribb and Hartmann: each plane is the last row of the matrix plus or
+// minus one of the others
+Frustum Frustum::fromMatrix(const glm::mat4 &m)
+{
+  glm::vec4 rows[4];
+  for (int i = 0; i < 4; i++)
+    rows[i] = glm::vec4(m[0][i], m[1][i], m[2][i], m[3][i]);
+  Frustum frustum;
+  for (int i = 0; i < 3; i++)
+  {
+    frustum.planes[2 * i] = normalizePlane(rows[3] + rows[i]);
+    frustum.planes[2 * i + 1] = normalizePlane(rows[3] - rows[i]);
+  }
+  return frustum;
+}
+
+// corner x + 2y + 4z of the frustum, each 0 for -1 and 1 for 1 in clip space
+static void corners(const glm::mat4 &viewProjection, glm::vec3 out[8])
+{
+  glm::mat4 inverse = glm::inverse(viewProjection);
+  for (int i = 0; i < 8; i++)
+  {
+    glm::vec4 p = inverse * glm::vec4(i & 1 ? 1.0f : -1.0f, i & 2 ? 1.0f : -1.0f,
+                                      i & 4 ? 1.0f : -1.0f, 1.0f);
+    out[i] = glm::vec3(p) / p.w;
+  }
+}
+
+// through a, b and c, facing inside
+static glm::vec4 planeThrough(const glm::vec3 &a, const glm::vec3 &b, const glm::vec3 &c,
+                              const glm::vec3 &inside)
+{
+  glm::vec3 n = glm::normalize(glm::cross(b - a, c - a));
+  glm::vec4 plane(n, -glm::dot(n, a));
+  return glm::dot(n, inside) + plane.w < 0.0f ? -plane : plane;
+}
+
+Frustum Frustum::unionOf(const glm::mat4 &first, const glm::mat4 &last)
+{
+  Frustum frustum = fromMatrix(first);
+  glm::vec3 points[2][8];
+  corners(first, points[0]);
+  corners(last, points[1]);
+  glm::vec3 center(0.0f);
+  for (int v = 0; v < 2; v++)
+    for (int i = 0; i < 8; i++)
+      center += points[v][i] / 16.0f;
+
+  // Which extreme view has the outer near edge on a side depends on the
+  // side and the direction the offsets go, so both ways are tried and the
+  // one holding all corners is kept
+  for (int side = 0; side < 2; side++)
+  {
+    float leastOutside = FLT_MAX;
+    for (int inner = 0; inner < 2; inner++)
+    {
+      const glm::vec3 *a = points[inner], *b = points[1 - inner];
+      glm::vec4 plane = planeThrough(a[side], a[side + 2], b[side + 4], center);
+      float outside = 0.0f;
+      for (int v = 0; v < 2; v++)
+        for (int i = 0; i < 8; i++)
+          outside = max(outside, -(glm::dot(glm::vec3(plane), points[v][i]) + plane.w));
+      if (outside < leastOutside)
+      {
+        leastOutside = outside;
+        frustum.planes[side] = plane;
+      }
+    }
+  }
+  return frustum;
+}
+
+void FrustumCuller::Spheres::resize(size_t count)
+{
+  const size_t padded = (count + 3) / 4 * 4;
+  x.resize(padded, 0.0f);
+  y.resize(padded, 0.0f);
+  z.resize(padded, 0.0f);
+  index.resize(padded, 0);
+  // a sphere of radius -FLT_MAX is outside every plane
+  radius.resize(count);
+  radius.resize(padded, -FLT_MAX);
+}
+
+void FrustumCuller::resize(size_t count)
+{
+  this->count = count;
+  spheres.resize(count);
+  for (size_t i = 0; i < count; i++)
+  {
+    spheres.index[i] = uint32_t(i);
+    spheres.radius[i] = -FLT_MAX;
+  }
+}
+
+void FrustumCuller::setSphere(size_t index, const glm::vec3 &center, float radius)
+{
+  spheres.x[index] = center.x;
+  spheres.y[index] = center.y;
+  spheres.z[index] = center.z;
+  spheres.radius[index] = radius;
+}
+
+void FrustumCuller::cull(const Spheres &spheres, size_t count, const Frustum &frustum,
+                         vector<uint32_t> &visible)
+{
+  size_t i = 0;
+#ifdef HOLOPLAY_CULL_SSE
+  __m128 nx[6], ny[6], nz[6], nw[6];
+  for (int p = 0; p < 6; p++)
+  {
+    nx[p] = _mm_set1_ps(frustum.planes[p].x);
+    ny[p] = _mm_set1_ps(frustum.planes[p].y);
+    nz[p] = _mm_set1_ps(frustum.planes[p].z);
+    nw[p] = _mm_set1_ps(frustum.planes[p].w);
+  }
+  const __m128 zero = _mm_setzero_ps();
+  // the padding makes whole groups of four
+  for (; i < count; i += 4)
+  {
+    const __m128 x = _mm_loadu_ps(&spheres.x[i]);
+    const __m128 y = _mm_loadu_ps(&spheres.y[i]);
+    const __m128 z = _mm_loadu_ps(&spheres.z[i]);
+    const __m128 r = _mm_loadu_ps(&spheres.radius[i]);
+    __m128 inside = _mm_cmpeq_ps(zero, zero);
+    for (int p = 0; p < 6; p++)
+    {
+      __m128 d = _mm_add_ps(_mm_mul_ps(nx[p], x), _mm_mul_ps(ny[p], y));
+      d = _mm_add_ps(d, _mm_add_ps(_mm_mul_ps(nz[p], z), _mm_add_ps(nw[p], r)));
+      inside = _mm_and_ps(inside, _mm_cmpge_ps(d, zero));
+    }
+    const int mask = _mm_movemask_ps(inside);
+    for (int b = 0; b < 4; b++)
+      if (mask & (1 << b))
+        visible.push_back(spheres.index[i + size_t(b)]);
+  }
+#endif
+  for (; i < count; i++)
+  {
+    bool inside = true;
+    for (int p = 0; p < 6 && inside; p++)
+    {
+      const glm::vec4 &plane = frustum.planes[p];
+      inside = plane.x * spheres.x[i] + plane.y * spheres.y[i] + plane.z * spheres.z[i] +
+                   plane.w + spheres.radius[i] >=
+               0.0f;
+    }
+    if (inside)
+      visible.push_back(spheres.index[i]);
+  }
+}
+
+void FrustumCuller::cull(const Frustum &frustum, vector<uint32_t> &visible) const
+{
+  cull(spheres, count, frustum, visible);
+}
+
+void FrustumCuller::cullViews(const vector<glm::mat4> &viewProjections, vector<uint32_t> &inUnion,
+                              vector<vector<uint32_t> > &visible)
+{
+  inUnion.clear();
+  visible.resize(viewProjections.size());
+  for (size_t v = 0; v < visible.size(); v++)
+    visible[v].clear();
+  if (viewProjections.empty())
+    return;
+
+  cull(spheres, count, Frustum::unionOf(viewProjections.front(), viewProjections.back()),
+       inUnion);
+  candidates.resize(inUnion.size());
+  for (size_t c = 0; c < inUnion.size(); c++)
+  {
+    const size_t i = inUnion[c];
+    candidates.x[c] = spheres.x[i];
+    candidates.y[c] = spheres.y[i];
+    candidates.z[c] = spheres.z[i];
+    candidates.radius[c] = spheres.radius[i];
+    candidates.index[c] = uint32_t(i);
+  }
+  for (size_t v = 0; v < viewProjections.size(); v++)
+    cull(candidates, inUnion.size(), Frustum::fromMatrix(viewProjections[v]), visible[v]);
+}
@@ -0,0 +1,74 @@
+/**
+ * FrustumCuller.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_FRUSTUM_CULLER_HPP
+#define HOLOPLAY_FRUSTUM_CULLER_HPP
+
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <vector>
+
+// Six planes, xyz the normal pointing in and w the distance: a point p is
+// inside when dot(xyz, p) + w >= 0 for all of them.
+struct Frustum
+{
+    glm::vec4 planes[6]; // left, right, bottom, top, near, far
+
+    // of a view-projection matrix
+    static Frustum fromMatrix(const glm::mat4 &viewProjection);
+
+    // The smallest convex volume holding the frusta of every view between
+    // first and last, views of the quilt that differ only by a sideways
+    // camera offset and the projection shear that keeps the focal plane in
+    // place (setupVirtualCameraForView()). Near, far, bottom and top are
+    // shared by all of them. Left and right each join the near edge of one
+    // extreme view to the far corners of the other.
+    static Frustum unionOf(const glm::mat4 &first, const glm::mat4 &last);
+};
+
+// Bounding spheres of objects, kept as a structure of arrays and tested
+// against frusta four at a time with SSE where the compiler targets it (a
+// scalar loop otherwise).
+//
+// For the views of a quilt, cullViews() tests every sphere once against the
+// union of the views' frusta. It then tests only those that survive against
+// each view, which is where most of the work was.
+class FrustumCuller
+{
+public:
+    void resize(size_t count); // spheres, all empty until set
+    void setSphere(size_t index, const glm::vec3 &center, float radius);
+    size_t size() const { return count; }
+
+    // appends the indices of the spheres not wholly outside frustum
+    void cull(const Frustum &frustum, std::vector<uint32_t> &visible) const;
+
+    // inUnion: the spheres in the union of the frusta of viewProjections,
+    // which go along the view cone in order. visible: of those, the ones in
+    // each view
+    void cullViews(const std::vector<glm::mat4> &viewProjections,
+                   std::vector<uint32_t> &inUnion,
+                   std::vector<std::vector<uint32_t> > &visible);
+
+private:
+    // padded to a multiple of four with spheres that are never inside
+    struct Spheres
+    {
+        std::vector<float> x, y, z, radius;
+        std::vector<uint32_t> index; // reported for each sphere
+        void resize(size_t count);
+    };
+    static void cull(const Spheres &spheres, size_t count,
+                     const Frustum &frustum, std::vector<uint32_t> &visible);
+
+    Spheres spheres;
+    size_t count = 0;
+    Spheres candidates; // the union's survivors, compacted for the views
+};
+
+#endif // HOLOPLAY_FRUSTUM_CULLER_HPP
@@ -0,0 +1,272 @@
+/**
+ * GpuMemory.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "GpuMemory.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace std;
+
+void GpuMemoryRegistry::addTexture(const std::string &name, GLuint id,
+                                   GLenum internalFormat, int width, int height,
+                                   int levels, int layers)
+{
+  addTexture(name, id, internalFormat, width, height, levels, layers,
+             textureBytes(internalFormat, width, height, levels, layers));
+}
+
+void GpuMemoryRegistry::addTexture(const std::string &name, GLuint id,
+                                   GLenum internalFormat, int width, int height,
+                                   int levels, int layers, size_t bytes)
+{
+  Resource resource;
+  resource.kind = Texture;
+  resource.id = id;
+  resource.name = name;
+  resource.internalFormat = internalFormat;
+  resource.width = width;
+  resource.height = height;
+  resource.layers = layers;
+  resource.levels = levels;
+  resource.bytes = bytes;
+  add(resource);
+}
+
+void GpuMemoryRegistry::addRenderbuffer(const std::string &name, GLuint id,
+                                        GLenum internalFormat, int width,
+                                        int height, int samples)
+{
+  Resource resource;
+  resource.kind = Renderbuffer;
+  resource.id = id;
+  resource.name = name;
+  resource.internalFormat = internalFormat;
+  resource.width = width;
+  resource.height = height;
+  resource.layers = 1;
+  resource.levels = 1;
+  resource.bytes = textureBytes(internalFormat, width, height) *
+                   size_t(samples > 1 ? samples : 1);
+  add(resource);
+}
+
+void GpuMemoryRegistry::addBuffer(const std::string &name, GLuint id,
+                                  size_t bytes)
+{
+  Resource resource;
+  resource.kind = Buffer;
+  resource.id = id;
+  resource.name = name;
+  resource.internalFormat = 0;
+  resource.width = int(bytes);
+  resource.height = 1;
+  resource.layers = 1;
+  resource.levels = 1;
+  resource.bytes = bytes;
+  add(resource);
+}
+
+void GpuMemoryRegistry::add(const Resource &resource)
+{
+  lock_guard<mutex> lock(entriesMutex);
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].kind == resource.kind && entries[i].id == resource.id)
+    {
+      entries[i] = resource;
+      return;
+    }
+  }
+  entries.push_back(resource);
+}
+
+void GpuMemoryRegistry::remove(Kind kind, GLuint id)
+{
+  lock_guard<mutex> lock(entriesMutex);
+  for (size_t i = 0; i < entries.size(); i++)
+  {
+    if (entries[i].kind == kind && entries[i].id == id)
+    {
+      entries.erase(entries.begin() + long(i));
+      return;
+    }
+  }
+}
+
+size_t GpuMemoryRegistry::totalBytes() const
+{
+  lock_guard<mutex> lock(entriesMutex);
+  size_t total = 0;
+  for (size_t i = 0; i < entries.size(); i++)
+    total += entries[i].bytes;
+  return total;
+}
+
+std::vector<GpuMemoryRegistry::Resource> GpuMemoryRegistry::resources() const
+{
+  lock_guard<mutex> lock(entriesMutex);
+  return entries;
+}
+
+void GpuMemoryRegistry::report(std::ostream &out) const
+{
+  vector<Resource> list = resources();
+  // largest first, that is what one looks for
+  sort(list.begin(), list.end(), [](const Resource &a, const Resource &b) {
+    return a.bytes > b.bytes;
+  });
+
+  size_t total = 0;
+  out << "[Info] GPU memory in use:" << endl;
+  for (size_t i = 0; i < list.size(); i++)
+  {
+    const Resource &r = list[i];
+    total += r.bytes;
+    out << "    " << setw(10) << formatBytes(r.bytes) << "  " << r.name;
+    if (r.kind == Buffer)
+    {
+      out << " (buffer)" << endl;
+      continue;
+    }
+    out << " (" << r.width << "x" << r.height;
+    if (r.layers > 1)
+      out << "x" << r.layers;
+    out << ", format 0x" << hex << r.internalFormat << dec;
+    if (r.levels > 1)
+      out << ", " << r.levels << " levels";
+    out << ")" << endl;
+  }
+  out << "[Info] GPU memory total: " << formatBytes(total) << " in "
+      << list.size() << " resources" << endl;
+
+  DeviceMemory device = queryDeviceMemory();
+  if (device.known)
+  {
+    out << "[Info] GPU memory reported by the driver: "
+        << formatBytes(device.available) << " available";
+    if (device.total)
+      out << " of " << formatBytes(device.total);
+    out << endl;
+  }
+}
+
+GpuMemoryRegistry::DeviceMemory GpuMemoryRegistry::queryDeviceMemory()
+{
+  DeviceMemory memory;
+  memory.known = false;
+  memory.total = 0;
+  memory.available = 0;
+
+  // both extensions report kilobytes
+  if (GLEW_NVX_gpu_memory_info)
+  {
+    GLint total = 0, available = 0;
+    glGetIntegerv(GL_GPU_MEMORY_INFO_DEDICATED_VIDMEM_NVX, &total);
+    glGetIntegerv(GL_GPU_MEMORY_INFO_CURRENT_AVAILABLE_VIDMEM_NVX, &available);
+    memory.known = true;
+    memory.total = size_t(total) * 1024;
+    memory.available = size_t(available) * 1024;
+  }
+  else if (GLEW_ATI_meminfo)
+  {
+    // total free, largest free block, total auxiliary free, largest
+    // auxiliary free block
+    GLint info[4] = {0, 0, 0, 0};
+    glGetIntegerv(GL_TEXTURE_FREE_MEMORY_ATI, info);
+    memory.known = true;
+    memory.available = size_t(info[0]) * 1024;
+  }
+  return memory;
+}
+
+size_t GpuMemoryRegistry::bytesPerPixel(GLenum internalFormat)
+{
+  switch (internalFormat)
+  {
+  case GL_R8:
+  case GL_STENCIL_INDEX8:
+    return 1;
+  case GL_RG8:
+  case GL_R16F:
+  case GL_DEPTH_COMPONENT16:
+    return 2;
+  case GL_RGB8:
+  case GL_SRGB8:
+  case GL_DEPTH_COMPONENT24: // padded to 4 bytes by most drivers
+  case GL_RGBA8:
+  case GL_SRGB8_ALPHA8:
+  case GL_RGB10_A2:
+  case GL_R11F_G11F_B10F:
+  case GL_RG16F:
+  case GL_R32F:
+  case GL_DEPTH_COMPONENT32F:
+  case GL_DEPTH24_STENCIL8:
+    return 4;
+  case GL_RGB16F:
+  case GL_RGBA16F:
+  case GL_RG32F:
+  case GL_DEPTH32F_STENCIL8:
+    return 8;
+  case GL_RGB32F:
+  case GL_RGBA32F:
+    return 16;
+  default:
+    return 0;
+  }
+}
+
+size_t GpuMemoryRegistry::textureBytes(GLenum internalFormat, int width,
+                                       int height, int levels, int layers)
+{
+  // block compressed formats store 4x4 blocks
+  size_t blockBytes = 0;
+  switch (internalFormat)
+  {
+  case GL_COMPRESSED_RGB_S3TC_DXT1_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT1_EXT:
+    blockBytes = 8;
+    break;
+  case GL_COMPRESSED_RGBA_S3TC_DXT3_EXT:
+  case GL_COMPRESSED_RGBA_S3TC_DXT5_EXT:
+    blockBytes = 16;
+    break;
+  }
+
+  size_t bytes = 0;
+  for (int level = 0; level < (levels > 0 ? levels : 1); level++)
+  {
+    size_t w = size_t(max(width >> level, 1));
+    size_t h = size_t(max(height >> level, 1));
+    if (blockBytes)
+      bytes += ((w + 3) / 4) * ((h + 3) / 4) * blockBytes;
+    else
+      bytes += w * h * bytesPerPixel(internalFormat);
+  }
+  return bytes * size_t(layers > 0 ? layers : 1);
+}
+
+std::string GpuMemoryRegistry::formatBytes(size_t bytes)
+{
+  ostringstream text;
+  text << fixed << setprecision(1);
+  if (bytes >= (size_t(1) << 30))
+    text << double(bytes) / double(size_t(1) << 30) << " GB";
+  else if (bytes >= (size_t(1) << 20))
+    text << double(bytes) / double(size_t(1) << 20) << " MB";
+  else if (bytes >= (size_t(1) << 10))
+    text << double(bytes) / double(size_t(1) << 10) << " KB";
+  else
+    text << bytes << " B";
+  return text.str();
+}
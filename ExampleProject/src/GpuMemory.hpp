@@ -0,0 +1,100 @@
+/**
+ * GpuMemory.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_GPU_MEMORY_HPP
+#define HOLOPLAY_GPU_MEMORY_HPP
+
+#include <GL/glew.h>
+#include <cstddef>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Book keeping of the GPU memory the application allocates. Every texture,
+// renderbuffer and buffer that matters is recorded with its format and size
+// so the totals can be reported and checked against a budget before large
+// quilts are allocated. The sizes are computed, not measured: drivers add
+// padding and alignment on top of them.
+//
+// Resources may be recorded from any thread (the texture loader uploads on
+// its own context).
+class GpuMemoryRegistry
+{
+public:
+    enum Kind
+    {
+        Texture,
+        Renderbuffer,
+        Buffer
+    };
+
+    struct Resource
+    {
+        Kind kind;
+        GLuint id;
+        std::string name;
+        GLenum internalFormat; // 0 for buffers
+        int width;             // bytes for buffers
+        int height;
+        int layers;            // array layers / cubemap faces
+        int levels;
+        size_t bytes;
+    };
+
+    // the memory reported by the driver, in bytes
+    struct DeviceMemory
+    {
+        bool known;      // false without NVX_gpu_memory_info / ATI_meminfo
+        size_t total;    // dedicated video memory, 0 if only free is known
+        size_t available;
+    };
+
+    GpuMemoryRegistry() {}
+
+    // records a resource, a second record of the same kind and id replaces
+    // the first
+    void addTexture(const std::string &name, GLuint id, GLenum internalFormat,
+                    int width, int height, int levels = 1, int layers = 1);
+    void addTexture(const std::string &name, GLuint id, GLenum internalFormat,
+                    int width, int height, int levels, int layers, size_t bytes);
+    void addRenderbuffer(const std::string &name, GLuint id,
+                         GLenum internalFormat, int width, int height,
+                         int samples = 1);
+    void addBuffer(const std::string &name, GLuint id, size_t bytes);
+    void remove(Kind kind, GLuint id);
+
+    size_t totalBytes() const;
+    std::vector<Resource> resources() const;
+
+    // prints every resource and the totals, along with the driver's numbers
+    // when it reports them. Needs a current context for the driver query.
+    void report(std::ostream &out) const;
+
+    // queries NVX_gpu_memory_info or ATI_meminfo in the current context
+    static DeviceMemory queryDeviceMemory();
+
+    // bytes per pixel of an uncompressed internal format, 0 if unknown
+    static size_t bytesPerPixel(GLenum internalFormat);
+    // size of a texture with the given mip levels, compressed formats included
+    static size_t textureBytes(GLenum internalFormat, int width, int height,
+                               int levels = 1, int layers = 1);
+
+    static std::string formatBytes(size_t bytes);
+
+private:
+    GpuMemoryRegistry(const GpuMemoryRegistry &);
+    GpuMemoryRegistry &operator=(const GpuMemoryRegistry &);
+
+    void add(const Resource &resource);
+
+    mutable std::mutex entriesMutex;
+    std::vector<Resource> entries;
+};
+
+#endif // HOLOPLAY_GPU_MEMORY_HPP
@@ -18,10 +18,17 @@
 #include <GLFW/glfw3.h>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/matrix_operation.hpp>
+#include <cmath>
+#include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <vector>
 
+#include "ButtonPoller.hpp"
+#include "FrameCapture.hpp"
+#include "QuiltPlayer.hpp"
+#include "SharedQuiltSource.hpp"
 #include "Shader.hpp"
 #include "glError.hpp"
 
@@ -32,6 +39,9 @@ using namespace std;
 
 #define UNUSED(x) [&x]{}()
 
+// hit buffer pixels per side of a tile classified for adaptive shading
+static const int RATE_TILE = 8;
+
 HoloPlayContext *currentApplication = NULL;
 
 HoloPlayContext &HoloPlayContext::getInstance()
@@ -53,19 +63,35 @@ HoloPlayContext &getInstance()
     throw std::runtime_error("There is no current Application");
 }
 
+// key events go through the input queue so they reach key_callback in the
+// same order as the Looking Glass button events
 static void external_key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-  getInstance().key_callback(window, key, scancode, action, mods);
+  InputEvent event;
+  event.source = InputEvent::Key;
+  event.window = window;
+  event.device = -1;
+  event.code = key;
+  event.scancode = scancode;
+  event.action = action;
+  event.mods = mods;
+  getInstance().getInputQueue().push(event);
 }
 
 
 void HoloPlayContext::key_callback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-  if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) exit();
+  // exit() releases everything the later events of this batch may touch, so
+  // only ask run() to quit
+  if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS) {
+    quitRequested = true;
+    return;
+  }
   if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS) {
     cout << "Recomputing hit buffers" << endl;
     glCheckError(__FILE__, __LINE__);
-    const char* shaderPaths[2] = { "../sdf_shader.glsl", "../color.glsl" };
-    ShaderProgram** shaders[2] = { &sdfShader, &colorShader };
-    for (int i = 0; i < 2; i++) {
+    const char* shaderPaths[4] = { "../sdf_shader.glsl", "../color.glsl", "../interpolate.glsl",
+                                   "../classify.glsl" };
+    ShaderProgram** shaders[4] = { &sdfShader, &colorShader, &interpolateShader, &classifyShader };
+    for (int i = 0; i < 4; i++) {
       const char* shaderPath = shaderPaths[i];
       Shader vertShader(GL_VERTEX_SHADER, (opengl_version_header + hpc_LightfieldVertShaderGLSL).c_str());
       Shader fragShader(shaderPath, GL_FRAGMENT_SHADER);
@@ -75,7 +101,33 @@ void HoloPlayContext::key_callback(GLFWwindow* window, int key, int scancode, in
         *shaders[i] = new ShaderProgram({vertShader, fragShader});
       }
     }
-    renderHitBuffers();
+    if (options.directRender) {
+      loadDirectShaders();
+      renderDirectHits();
+    }
+    for (size_t q = 0; !options.directRender && !options.meshScene && q < quilts.size(); q++) {
+      selectQuilt(int(q));
+      renderHitBuffers();
+    }
+    // the light field shaders include color.glsl
+    for (size_t i = 0; options.fusedRender && i < displays.size(); i++) {
+      selectQuilt(displays[i].quiltIndex);
+      loadLightFieldShaders(displays[i]);
+      loadCalibrationIntoShader(displays[i]);
+      passQuiltSettingsToShader(displays[i]);
+      setLightFieldDebug(debug);
+    }
+    for (size_t i = 0; options.computeInterlace && i < displays.size(); i++) {
+      selectQuilt(displays[i].quiltIndex);
+      loadInterlaceShader(displays[i]);
+      loadCalibrationIntoShader(displays[i]);
+      if (quiltSource)
+        passSourceLayoutToShaders();
+      else
+        passQuiltSettingsToShader(displays[i]);
+    }
+    lightFieldShader = displays[0].lightFieldShader;
+    selectQuilt(0);
     cout << "Done hit buffers" << endl;
     glCheckError(__FILE__, __LINE__);
 
@@ -87,6 +139,47 @@ void HoloPlayContext::key_callback(GLFWwindow* window, int key, int scancode, in
   if (glfwGetKey(window, GLFW_KEY_TAB) == GLFW_PRESS) {
     renderSwitch = (renderSwitch + 1) % 3;
   }
+  if (key == GLFW_KEY_M && action == GLFW_PRESS) {
+    gpuMemory.report(cout);
+  }
+  if (key == GLFW_KEY_C && action == GLFW_PRESS) {
+    if (quiltCapture || screenCapture)
+      stopCapture();
+    else
+      startCapture();
+  }
+  if (key == GLFW_KEY_I && action == GLFW_PRESS) {
+    measureInterpolationError();
+  }
+  if (key == GLFW_KEY_B && action == GLFW_PRESS) {
+    benchmarkInterlacers();
+  }
+  if (key == GLFW_KEY_P && action == GLFW_PRESS) {
+    SharedQuiltSource *shared = dynamic_cast<SharedQuiltSource *>(quiltSource);
+    if (shared)
+      shared->selectNext();
+  }
+}
+
+void HoloPlayContext::button_callback(int device, int button, int action) {
+  cout << "[Info] device " << device << " button " << button
+       << (action == GLFW_PRESS ? " pressed" : " released") << endl;
+  // the square button cycles through the debug renders like TAB does
+  if (button == 0 && action == GLFW_PRESS) {
+    renderSwitch = (renderSwitch + 1) % 3;
+  }
+}
+
+void HoloPlayContext::dispatchInputEvents() {
+  pendingEvents.clear();
+  inputQueue.drain(pendingEvents);
+  for (size_t i = 0; i < pendingEvents.size() && !quitRequested; i++) {
+    const InputEvent &event = pendingEvents[i];
+    if (event.source == InputEvent::Key)
+      key_callback(event.window, event.code, event.scancode, event.action, event.mods);
+    else
+      button_callback(event.device, event.code, event.action);
+  }
 }
 
 // wrapper for getting mouse movement callback
@@ -109,11 +202,13 @@ static void external_scroll_callback(GLFWwindow *window,
   getInstance().scroll_callback(window, xpos, ypos);
 }
 
-HoloPlayContext::HoloPlayContext(bool capture_mouse)
+HoloPlayContext::HoloPlayContext(bool capture_mouse,
+                                 const HoloPlayOptions &options)
     : state(State::Ready),
       title("Application"),
       opengl_version_major(3),
-      opengl_version_minor(3)
+      opengl_version_minor(3),
+      options(options)
 {
   currentApplication = this;
 
@@ -128,8 +223,13 @@ HoloPlayContext::HoloPlayContext(bool capture_mouse)
     hpc_TeardownMessagePipe();
     throw std::runtime_error("Couldn't find looking glass");
   }
-  // get the viewcone here, which is used as a const
-  viewCone = hpc_GetDevicePropertyFloat(DEV_INDEX, "/calibration/viewCone/value");
+  // decide which devices we drive and which of them can share a quilt
+  setupDisplays();
+  if (displays.empty())
+  {
+    hpc_CloseApp();
+    throw std::runtime_error("No looking glass matches the requested devices");
+  }
 
   cout << "[Info] GLFW initialisation" << endl;
 
@@ -151,23 +251,36 @@ HoloPlayContext::HoloPlayContext(bool capture_mouse)
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
   glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 
-  // create window on the first looking glass device
-  window = openWindowOnLKG();
-  if (!window)
+  // create one window per looking glass device, every window after the first
+  // shares the first one's context so scene resources exist only once
+  for (size_t i = 0; i < displays.size(); i++)
   {
-    glfwTerminate();
-    throw std::runtime_error(
-        "Couldn't create a window on looking glass device");
+    GLFWwindow *share = i == 0 ? NULL : displays[0].window;
+    displays[i].window = openWindowOnLKG(displays[i], share);
+    if (!displays[i].window)
+    {
+      glfwTerminate();
+      throw std::runtime_error(
+          "Couldn't create a window on looking glass device");
+    }
+    cout << "[Info] Window opened on lkg " << displays[i].devIndex << endl;
+
+    // set up the cursor callback
+    glfwSetCursorPosCallback(displays[i].window, external_mouse_callback);
+    glfwSetScrollCallback(displays[i].window, external_scroll_callback);
+    glfwSetKeyCallback(displays[i].window, external_key_callback);
   }
-  cout << "[Info] Window opened on lkg" << endl;
+
+  // the first display is the primary one, it owns the main context and the
+  // members mirroring the window
+  window = displays[0].window;
+  win_w = displays[0].win_w;
+  win_h = displays[0].win_h;
+  win_x = displays[0].win_x;
+  win_y = displays[0].win_y;
   glfwMakeContextCurrent(window);
   glCheckError(__FILE__, __LINE__);
 
-  // set up the cursor callback
-  glfwSetCursorPosCallback(window, external_mouse_callback);
-  glfwSetScrollCallback(window, external_scroll_callback);
-  glfwSetKeyCallback(window, external_key_callback);
-
   if (capture_mouse)
   {
       // tell GLFW to capture our mouse
@@ -197,14 +310,33 @@ HoloPlayContext::HoloPlayContext(bool capture_mouse)
   // opengl configuration
   glEnable(GL_DEPTH_TEST); // enable depth-testing
   glDepthFunc(GL_LESS);    // depth-testing interprets a smaller value as "closer"
+  glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS); // filter across skybox face edges
 
   // initialize the holoplay context
   initialize();
-  renderHitBuffers();
+  if (options.directRender)
+    renderDirectHits();
+  else if (!options.meshScene)
+    renderHitBuffers();
+
+  if (!options.capturePath.empty())
+    startCapture();
+
+  // device properties are all read by now, so the buttons can be polled in
+  // the background from here on
+  if (options.buttonPollRate > 0.0f)
+  {
+    vector<int> devices;
+    for (size_t i = 0; i < displays.size(); i++)
+      devices.push_back(displays[i].devIndex);
+    buttonPoller = new ButtonPoller(inputQueue, devices, options.buttonPollRate);
+    buttonPoller->start();
+  }
 }
 
 HoloPlayContext::~HoloPlayContext()
 {
+  delete buttonPoller;
 }
 
 void HoloPlayContext::onExit()
@@ -215,6 +347,9 @@ void HoloPlayContext::onExit()
 void HoloPlayContext::exit()
 {
   state = State::Exit;
+  // the poller uses HoloPlay Core, stop it before closing the connection
+  delete buttonPoller;
+  buttonPoller = NULL;
   cout << "[Info] Informing Holoplay Core to close app" << endl;
   hpc_CloseApp();
   // release all the objects created for setting up the HoloPlay Context
@@ -254,37 +389,130 @@ void HoloPlayContext::run()
     // glm::mat4 currentViewMatrix = getViewMatrixOfCurrentFrame();
     glCheckError(__FILE__, __LINE__);
 
+    // pick up anything that finished loading in the background
+    updateLoadedTextures();
+
     // do the update
     update();
 
-    // clear backbuffer
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glClearColor(0.0, 0.0, 0.0, 1.0);
+    // render every distinct quilt once, on the main context, unless the
+    // quilt comes from a source
+    if (quiltSource &&
+        quiltSource->update(quilts[0].quiltTexture, double(time) - sourceStartTime))
+    {
+      // sources such as shared quilts may switch layouts between frames
+      QuiltLayout layout = quiltSource->layout();
+      if (layout.width != sourceLayout.width || layout.height != sourceLayout.height ||
+          layout.columns != sourceLayout.columns || layout.rows != sourceLayout.rows ||
+          layout.views != sourceLayout.views)
+        passSourceLayoutToShaders();
+    }
+    // scale the views to what the GPU managed in the last frames
+    if (resolution && !quiltSource)
+    {
+      if (resolution->update())
+        applyRenderScale(resolution->scale());
+      resolution->beginFrame();
+    }
+    for (size_t q = 0; !quiltSource && !options.directRender && !options.fusedRender &&
+                       q < quilts.size(); q++)
+    {
+      selectQuilt(int(q));
+      if (tracker)
+        updateTrackedViews();
 
-    // bind quilt texture to frame buffer
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+      // bind quilt texture to frame buffer
+      glBindFramebuffer(GL_FRAMEBUFFER, FBO);
 
-    // save the viewport for the total quilt
-    GLint viewport[4];
-    glGetIntegerv(GL_VIEWPORT, viewport);
+      // save the viewport for the total quilt
+      GLint viewport[4];
+      glGetIntegerv(GL_VIEWPORT, viewport);
 
-    glViewport(0, 0, qs_width, qs_height);
+      glViewport(0, 0, renderWidth, renderHeight);
 
-    renderScene();
-    
-    glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+      renderScene();
+
+      glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
+    }
+    if (resolution && !quiltSource)
+      resolution->endFrame();
 
     // reset framebuffer
     glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-    // draw the light field image
-    drawLightField();
+    // queue the readback, the pixels are written out a few frames later
+    if (quiltCapture && !quiltSource && options.viewLayers)
+    {
+      selectQuilt(quiltShownOn(displays[0]));
+      copyLayersToQuilt();
+    }
+    if (quiltCapture)
+    {
+      // with render scaling only the lower left of the quilt is current
+      const QuiltTarget &captured = quilts[size_t(quiltShownOn(displays[0]))];
+      quiltCapture->capture(captured.FBO, GL_COLOR_ATTACHMENT0, captured.renderWidth,
+                            captured.renderHeight);
+    }
+
+    // the other windows read the quilts from their own contexts, make them
+    // wait on the GPU until the quilts are written
+    GLsync quiltsRendered = 0;
+    if (displays.size() > 1)
+    {
+      quiltsRendered = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+      glFlush();
+    }
+
+    for (size_t i = 0; i < displays.size(); i++)
+    {
+      if (i > 0)
+      {
+        glfwMakeContextCurrent(displays[i].window);
+        glWaitSync(quiltsRendered, 0, GL_TIMEOUT_IGNORED);
+      }
+
+      // clear backbuffer
+      glClearColor(0.0, 0.0, 0.0, 1.0);
+      glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+      // draw the light field image
+      if (options.directRender)
+        drawDirect(displays[i]);
+      else
+        drawLightField(displays[i]);
+
+      if (i == 0 && screenCapture)
+        screenCapture->capture(0, GL_BACK);
+    }
+
+    // Swap Front and Back buffers (double buffering), only the primary
+    // window waits for vsync so N displays don't cost N refresh intervals
+    for (size_t i = 0; i < displays.size(); i++)
+    {
+      if (i > 0)
+        glfwMakeContextCurrent(displays[i].window);
+      glfwSwapBuffers(displays[i].window);
+    }
+    glfwMakeContextCurrent(window);
+    if (quiltsRendered)
+      glDeleteSync(quiltsRendered);
+    if (!rateReadbacks.empty())
+      reportShadingRates();
 
-    // Swap Front and Back buffers (double buffering)
-    glfwSwapBuffers(window);
+    FrameCapture *counted = quiltCapture ? quiltCapture : screenCapture;
+    if (counted && options.captureFrames > 0 &&
+        counted->framesCaptured() >= options.captureFrames)
+      stopCapture();
 
     // Poll and process events
     glfwPollEvents();
+    dispatchInputEvents();
+    if (quitRequested)
+    {
+      exit();
+      onExit();
+      continue;
+    }
 
 
   //   // recompile sdf shader if it needs to be (do it every second)
@@ -314,18 +542,30 @@ void HoloPlayContext::run()
 // looking glass display is not, so we make this function here to detect the
 // window change and force our window to be full-screen again
 void HoloPlayContext::detectWindowChange()
+{
+  bool changed = false;
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    detectWindowChange(displays[i]);
+    changed = changed || windowChanged;
+  }
+  windowChanged = changed;
+}
+
+void HoloPlayContext::detectWindowChange(LKGDisplay &display)
 {
   int w, h;
   int x, y;
-  glfwGetWindowSize(getWindow(), &w, &h);
-  glfwGetWindowPos(getWindow(), &x, &y);
+  glfwGetWindowSize(display.window, &w, &h);
+  glfwGetWindowPos(display.window, &x, &y);
 
-  windowChanged = (w != win_w) || (h != win_h) || (x != win_x) || (y != win_y);
+  windowChanged = (w != display.win_w) || (h != display.win_h) ||
+                  (x != display.win_x) || (y != display.win_y);
   if (windowChanged)
   {
     cout << "[Info] Dimension changed: (" << w << "," << h << ")" << endl;
-    glfwSetWindowPos(getWindow(), win_x, win_y);
-    glfwSetWindowSize(getWindow(), win_w, win_h);
+    glfwSetWindowPos(display.window, display.win_x, display.win_y);
+    glfwSetWindowSize(display.window, display.win_w, display.win_h);
     cout << "[Info] force window to be full-screen again" << endl;
   }
 }
@@ -353,6 +593,8 @@ void HoloPlayContext::renderHitBuffers() {
   sdfShader->setUniform("qs_rows", qs_rows);
   sdfShader->setUniform("qs_width", qs_width);
   sdfShader->setUniform("qs_height", qs_height);
+  sdfShader->setUniform("qs_totalViews", qs_totalViews);
+  sdfShader->setUniform("keyViewStep", keyViewStep);
   glBindVertexArray(VAO);
   glDrawArrays(GL_TRIANGLES, 0, 6);
   sdfShader->unuse();
@@ -360,6 +602,195 @@ void HoloPlayContext::renderHitBuffers() {
   glViewport(viewport[0],viewport[1],viewport[2],viewport[3]);
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
   // glBindFramebuffer(GL_FRAMEBUFFER, curFBO);
+  if (rateTexture)
+    classifyTiles();
+}
+
+// the hit buffers only change with them, so the tiles are classified once
+void HoloPlayContext::classifyTiles()
+{
+  const int tilesX = (qs_width + RATE_TILE - 1) / RATE_TILE;
+  const int tilesY = (qs_height + RATE_TILE - 1) / RATE_TILE;
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, rateFBO);
+  glViewport(0, 0, tilesX, tilesY);
+  for (GLuint i = 0; i < 2; i++) {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, hitAttachments[i]);
+  }
+  classifyShader->use();
+  classifyShader->setUniform("posMatTex", 0);
+  classifyShader->setUniform("normalTex", 1);
+  classifyShader->setUniform("rateTile", RATE_TILE);
+  classifyShader->setUniform("maxVariance", options.adaptiveShading);
+  glBindVertexArray(VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  classifyShader->unuse();
+  glCheckError(__FILE__, __LINE__);
+
+  // how much of the quilt the coarse pass takes over, logged by
+  // reportShadingRates() once the copy has finished
+  RateReadback readback;
+  readback.quiltWidth = qs_width;
+  readback.quiltHeight = qs_height;
+  const size_t bytes = size_t(tilesX) * size_t(tilesY);
+  glGenBuffers(1, &readback.buffer);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+  glBufferData(GL_PIXEL_PACK_BUFFER, GLsizeiptr(bytes), NULL, GL_STREAM_READ);
+  gpuMemory.addBuffer("shading rate readback", readback.buffer, bytes);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, tilesX, tilesY, GL_RED, GL_UNSIGNED_BYTE, NULL);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  rateReadbacks.push_back(readback);
+
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+void HoloPlayContext::reportShadingRates()
+{
+  for (size_t i = 0; i < rateReadbacks.size();)
+  {
+    RateReadback &readback = rateReadbacks[i];
+    GLenum status = glClientWaitSync(readback.fence, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+    {
+      i++;
+      continue;
+    }
+    const int tilesX = (readback.quiltWidth + RATE_TILE - 1) / RATE_TILE;
+    const int tilesY = (readback.quiltHeight + RATE_TILE - 1) / RATE_TILE;
+    const size_t tiles = size_t(tilesX) * size_t(tilesY);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+    const unsigned char *rates = static_cast<const unsigned char *>(
+        glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, GLsizeiptr(tiles), GL_MAP_READ_BIT));
+    if (rates)
+    {
+      size_t coarse = 0;
+      for (size_t t = 0; t < tiles; t++)
+        coarse += rates[t] > 127 ? 1 : 0;
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+      cout << "[Info] adaptive shading: " << int(100.0 * double(coarse) / double(tiles) + 0.5)
+           << "% of the " << readback.quiltWidth << "x" << readback.quiltHeight
+           << " quilt is flat and shaded at a quarter of the pixels" << endl;
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    glDeleteSync(readback.fence);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, readback.buffer);
+    glDeleteBuffers(1, &readback.buffer);
+    rateReadbacks.erase(rateReadbacks.begin() + ptrdiff_t(i));
+  }
+}
+
+void HoloPlayContext::loadDirectShaders()
+{
+  const char *paths[2] = { "../direct_hits.glsl", "../direct.glsl" };
+  ShaderProgram **programs[2] = { &directHitShader, &directShader };
+  for (int i = 0; i < 2; i++)
+  {
+    // both include code of the quilt shaders, see readShaderSource()
+    Shader vertShader(GL_VERTEX_SHADER, (opengl_version_header + hpc_LightfieldVertShaderGLSL).c_str());
+    Shader fragShader(GL_FRAGMENT_SHADER, readShaderSource(paths[i]).c_str());
+    if (fragShader.checkCompileError(paths[i]))
+      continue;
+    delete *programs[i];
+    *programs[i] = new ShaderProgram({vertShader, fragShader});
+  }
+  glCheckError(__FILE__, __LINE__);
+}
+
+// the hits of the three subpixels of every pixel of the panel, at its
+// framebuffer size. Textures are shared, the framebuffer belongs to the main
+// context
+void HoloPlayContext::setupDirectHits(LKGDisplay &display)
+{
+  glfwGetFramebufferSize(display.window, &display.directWidth, &display.directHeight);
+  glGenFramebuffers(1, &display.directFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, display.directFBO);
+  glGenTextures(6, display.directHits);
+  GLenum attachments[6];
+  for (GLuint i = 0; i < 6; i++)
+  {
+    glBindTexture(GL_TEXTURE_2D, display.directHits[i]);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, display.directWidth, display.directHeight, 0,
+                 GL_RGBA, GL_FLOAT, NULL);
+    gpuMemory.addTexture(i < 3 ? "subpixel hit positions / materials" : "subpixel hit normals",
+                         display.directHits[i], GL_RGBA32F, display.directWidth,
+                         display.directHeight);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D,
+                           display.directHits[i], 0);
+    attachments[i] = GL_COLOR_ATTACHMENT0 + i;
+  }
+  glDrawBuffers(6, attachments);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    cout << "[Error] the subpixel hit framebuffer is incomplete" << endl;
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  cout << "[Info] rendering directly: " << display.directWidth * display.directHeight * 3
+       << " subpixel rays for device " << display.devIndex << endl;
+}
+
+void HoloPlayContext::renderDirectHits()
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glBindVertexArray(VAO);
+  directHitShader->use();
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    const LKGDisplay &display = displays[i];
+    glBindFramebuffer(GL_FRAMEBUFFER, display.directFBO);
+    glViewport(0, 0, display.directWidth, display.directHeight);
+    directHitShader->setUniform("pitch", display.pitch);
+    directHitShader->setUniform("tilt", display.tilt);
+    directHitShader->setUniform("center", display.center);
+    directHitShader->setUniform("invView", display.invView);
+    directHitShader->setUniform("subp", display.subp);
+    directHitShader->setUniform("displayAspect", display.displayAspect);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glCheckError(__FILE__, __LINE__);
+  }
+  directHitShader->unuse();
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// shades display's subpixel hits into its window, in its context
+void HoloPlayContext::drawDirect(const LKGDisplay &display)
+{
+  static const char *samplers[6] = { "posMat0", "posMat1", "posMat2",
+                                     "normal0", "normal1", "normal2" };
+  directShader->use();
+  for (GLuint i = 0; i < 6; i++)
+  {
+    glActiveTexture(GL_TEXTURE0 + i);
+    glBindTexture(GL_TEXTURE_2D, display.directHits[i]);
+    directShader->setUniform(samplers[i], int(i));
+  }
+  glActiveTexture(GL_TEXTURE0 + 6);
+  glBindTexture(GL_TEXTURE_2D, texture);
+  directShader->setUniform("customTex", 6);
+  glActiveTexture(GL_TEXTURE0 + 7);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, skyMap);
+  directShader->setUniform("skyMap", 7);
+  directShader->setUniform("hasSkyMap", skyMap ? 1 : 0);
+  directShader->setUniform("skyLod", skyLod);
+  directShader->setUniform("iTime", time);
+  directShader->setUniform("renderSwitch", renderSwitch);
+  directShader->setUniform("ri", display.ri);
+  directShader->setUniform("bi", display.bi);
+  glActiveTexture(GL_TEXTURE0);
+
+  glBindVertexArray(display.VAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindVertexArray(0);
+  directShader->unuse();
 }
 
 void HoloPlayContext::renderScene()
@@ -367,7 +798,8 @@ void HoloPlayContext::renderScene()
 
   glCheckError(__FILE__, __LINE__);
   glBindVertexArray(VAO);
-  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  // when interpolating, only the key views are shaded, into their own texture
+  glBindFramebuffer(GL_FRAMEBUFFER, keyViewStep > 1 ? keyFBO : FBO);
   for (GLuint i = 0; i < 2; i++) {
     glActiveTexture(GL_TEXTURE0 + i);
     glBindTexture(GL_TEXTURE_2D, hitAttachments[i]);
@@ -383,9 +815,90 @@ void HoloPlayContext::renderScene()
   glBindTexture(GL_TEXTURE_2D, texture);
   glCheckError(__FILE__, __LINE__);
   colorShader->setUniform("customTex", 2);
-  glDrawArrays(GL_TRIANGLES, 0, 6);
+  // samplers of different types must not share a unit, so skyMap always
+  // gets its own even before the cubemap is loaded
+  glActiveTexture(GL_TEXTURE0 + 3);
+  glBindTexture(GL_TEXTURE_CUBE_MAP, skyMap);
+  colorShader->setUniform("skyMap", 3);
+  colorShader->setUniform("hasSkyMap", skyMap ? 1 : 0);
+  colorShader->setUniform("skyLod", skyLod);
+  colorShader->setUniform("qs_columns", qs_columns);
+  colorShader->setUniform("qs_rows", qs_rows);
+  colorShader->setUniform("qs_totalViews", qs_totalViews);
+  colorShader->setUniform("keyViewStep", keyViewStep);
+  colorShader->setUniform("shadingPass", 0);
+  if (rateTexture)
+  {
+    glActiveTexture(GL_TEXTURE0 + 4);
+    glBindTexture(GL_TEXTURE_2D, rateTexture);
+    glActiveTexture(GL_TEXTURE0 + 5);
+    glBindTexture(GL_TEXTURE_2D, coarseTexture);
+    glActiveTexture(GL_TEXTURE0);
+    colorShader->setUniform("rateTex", 4);
+    colorShader->setUniform("coarseTex", 5);
+    colorShader->setUniform("rateTile", RATE_TILE);
+    const int coarseWidth = (renderWidth + 1) / 2, coarseHeight = (renderHeight + 1) / 2;
+    colorShader->setUniform("coarseSize", glm::vec2(coarseWidth, coarseHeight));
+    colorShader->setUniform("viewIndex", -1);
+
+    // flat tiles at half the resolution first, then the full resolution
+    // pass shades the rest and upsamples them
+    GLint target;
+    glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, coarseFBO);
+    glViewport(0, 0, coarseWidth, coarseHeight);
+    colorShader->setUniform("shadingPass", 1);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+    glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+    glViewport(0, 0, renderWidth, renderHeight);
+    colorShader->setUniform("shadingPass", 2);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+  }
+  else if (viewArray)
+  {
+    // every view into its own layer
+    glViewport(0, 0, renderWidth / qs_columns, renderHeight / qs_rows);
+    for (int v = 0; v < qs_totalViews; v++)
+    {
+      glBindFramebuffer(GL_FRAMEBUFFER, layerFBOs[size_t(v)]);
+      colorShader->setUniform("viewIndex", v);
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+  }
+  else if (viewRects.empty() && !trackedViews.empty())
+  {
+    // only the views tracked eyes see, each into its tile
+    const int viewWidth = renderWidth / qs_columns, viewHeight = renderHeight / qs_rows;
+    for (int v = 0; v < qs_totalViews; v++)
+    {
+      if (!trackedViews[size_t(v)])
+        continue;
+      glViewport((v % qs_columns) * viewWidth, (v / qs_columns) * viewHeight, viewWidth,
+                 viewHeight);
+      colorShader->setUniform("viewIndex", v);
+      glDrawArrays(GL_TRIANGLES, 0, 6);
+    }
+    glViewport(0, 0, renderWidth, renderHeight);
+  }
+  else if (viewRects.empty())
+  {
+    colorShader->setUniform("viewIndex", -1);
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+  }
+  // weighted views: each into its own rect, which leaves the viewport there
+  for (size_t v = 0; v < viewRects.size(); v++)
+  {
+    const glm::ivec4 &rect = viewRects[v];
+    glViewport(rect.x, rect.y, rect.z, rect.w);
+    colorShader->setUniform("viewIndex", int(v));
+    glDrawArrays(GL_TRIANGLES, 0, 6);
+  }
   glCheckError(__FILE__, __LINE__);
   colorShader->unuse();
+  if (!trackedViews.empty())
+    copyUntrackedViews();
+  if (keyViewStep > 1)
+    interpolateViews();
   
   /*
   glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
@@ -397,6 +910,172 @@ void HoloPlayContext::renderScene()
   */
 }
 
+// the views of the current quilt that reach a tracked eye through any
+// display showing it, none while nobody is in view. Every view while the
+// tracker has lost track
+void HoloPlayContext::updateTrackedViews()
+{
+  trackedViews.clear();
+  vector<glm::vec3> eyes;
+  if (!tracker->eyes(double(time), eyes))
+    return;
+  trackedViews.assign(size_t(qs_totalViews), false);
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    if (displays[i].quiltIndex != currentQuilt)
+      continue;
+    vector<bool> visible = visibleViews(eyes, displays[i].widthMeters, viewCone,
+                                        options.trackFocus, qs_totalViews,
+                                        options.trackMargin);
+    for (size_t v = 0; v < visible.size(); v++)
+      trackedViews[v] = trackedViews[v] || visible[v];
+  }
+}
+
+// every view that wasn't shaded gets a copy of the nearest one that was, so
+// eyes that move before the next update still see about the right view
+void HoloPlayContext::copyUntrackedViews()
+{
+  vector<int> shaded;
+  for (int v = 0; v < qs_totalViews; v++)
+    if (trackedViews[size_t(v)])
+      shaded.push_back(v);
+  if (shaded.empty())
+    return;
+  const int viewWidth = renderWidth / qs_columns, viewHeight = renderHeight / qs_rows;
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    if (trackedViews[size_t(v)])
+      continue;
+    int source = shaded[0];
+    for (size_t s = 1; s < shaded.size(); s++)
+      if (abs(shaded[s] - v) < abs(source - v))
+        source = shaded[s];
+    // tiles don't overlap, so one framebuffer can be read and drawn
+    const int sx = (source % qs_columns) * viewWidth, sy = (source / qs_columns) * viewHeight;
+    const int dx = (v % qs_columns) * viewWidth, dy = (v / qs_columns) * viewHeight;
+    glBlitFramebuffer(sx, sy, sx + viewWidth, sy + viewHeight, dx, dy, dx + viewWidth,
+                      dy + viewHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glCheckError(__FILE__, __LINE__);
+}
+
+// fills the quilt from the key views shaded into keyTexture
+void HoloPlayContext::interpolateViews()
+{
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, keyTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, hitAttachments[0]);
+  interpolateShader->use();
+  interpolateShader->setUniform("keyTex", 0);
+  interpolateShader->setUniform("posMatTex", 1);
+  interpolateShader->setUniform("qs_columns", qs_columns);
+  interpolateShader->setUniform("qs_rows", qs_rows);
+  interpolateShader->setUniform("qs_totalViews", qs_totalViews);
+  interpolateShader->setUniform("qs_width", qs_width);
+  interpolateShader->setUniform("qs_height", qs_height);
+  interpolateShader->setUniform("keyViewStep", keyViewStep);
+  interpolateShader->setUniform("fillBackground", options.interpolateFillBackground ? 1 : 0);
+  interpolateShader->setUniform("keyPortion",
+                                glm::vec2(float(renderWidth) / float(qs_width),
+                                          float(renderHeight) / float(qs_height)));
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glCheckError(__FILE__, __LINE__);
+  interpolateShader->unuse();
+  glActiveTexture(GL_TEXTURE0);
+}
+
+// renders the first quilt with every view and then interpolated, and prints
+// how far the interpolated views are from the rendered ones
+void HoloPlayContext::measureInterpolationError()
+{
+  if (keyViewStep <= 1 || quiltSource)
+  {
+    cout << "[Info] every view is rendered, there is nothing to compare" << endl;
+    return;
+  }
+  selectQuilt(0);
+  const size_t bytes = size_t(qs_width) * size_t(qs_height) * 4;
+  vector<unsigned char> reference(bytes), interpolated(bytes);
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glViewport(0, 0, renderWidth, renderHeight);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  // the reference also fills in the hit buffers of the views between key
+  // views, which interpolation never reads
+  const int step = keyViewStep;
+  keyViewStep = 1;
+  renderHitBuffers();
+  glViewport(0, 0, renderWidth, renderHeight);
+  renderScene();
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+  glReadBuffer(GL_COLOR_ATTACHMENT0);
+  glReadPixels(0, 0, qs_width, qs_height, GL_RGBA, GL_UNSIGNED_BYTE, reference.data());
+
+  keyViewStep = step;
+  renderScene();
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+  glReadPixels(0, 0, qs_width, qs_height, GL_RGBA, GL_UNSIGNED_BYTE, interpolated.data());
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  // at the resolution currently rendered
+  const int viewWidth = renderWidth / qs_columns, viewHeight = renderHeight / qs_rows;
+  double totalError = 0.0, worstPsnr = 1000.0;
+  size_t samples = 0, offPixels = 0, pixels = 0;
+  int worstView = -1, largest = 0;
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    if (v % keyViewStep == 0 || v == qs_totalViews - 1)
+      continue;
+    double viewError = 0.0;
+    for (int y = 0; y < viewHeight; y++)
+    {
+      size_t row = size_t((v / qs_columns) * viewHeight + y) * size_t(qs_width);
+      for (int x = 0; x < viewWidth; x++)
+      {
+        size_t i = (row + size_t((v % qs_columns) * viewWidth + x)) * 4;
+        int pixelError = 0;
+        for (int c = 0; c < 3; c++)
+        {
+          int d = abs(int(reference[i + size_t(c)]) - int(interpolated[i + size_t(c)]));
+          viewError += double(d * d);
+          pixelError = d > pixelError ? d : pixelError;
+        }
+        largest = pixelError > largest ? pixelError : largest;
+        offPixels += pixelError > 16 ? 1 : 0;
+        pixels++;
+      }
+    }
+    size_t viewSamples = size_t(viewWidth) * size_t(viewHeight) * 3;
+    double psnr = viewError > 0.0
+                      ? 10.0 * log10(255.0 * 255.0 * double(viewSamples) / viewError)
+                      : 99.0;
+    if (psnr < worstPsnr)
+    {
+      worstPsnr = psnr;
+      worstView = v;
+    }
+    totalError += viewError;
+    samples += viewSamples;
+  }
+  double psnr = totalError > 0.0 ? 10.0 * log10(255.0 * 255.0 * double(samples) / totalError)
+                                 : 99.0;
+  cout << "[Info] views interpolated from one in " << keyViewStep << " ("
+       << (options.interpolateFillBackground ? "background" : "stretch")
+       << " fill): PSNR " << psnr << " dB, worst view " << worstView << " at "
+       << worstPsnr << " dB, largest error " << largest << "/255, "
+       << 100.0 * double(offPixels) / double(pixels ? pixels : 1)
+       << "% of pixels off by more than 16" << endl;
+}
+
 glm::mat4 HoloPlayContext::getViewMatrixOfCurrentFrame()
 {
   // cout << "[INFO] : update camera" << endl;
@@ -420,13 +1099,27 @@ bool HoloPlayContext::processInput(GLFWwindow*)
   if (debug != new_debug)
   {
     debug = new_debug;
-    lightFieldShader->use();
-    lightFieldShader->setUniform("debug", debug);
-    lightFieldShader->unuse();
+    setLightFieldDebug(debug);
   }
   return true;
 }
 
+void HoloPlayContext::setLightFieldDebug(int value)
+{
+  // the calibrated shader's debug view is a program of its own, drawLightField()
+  // picks it
+  lightFieldDebug = value;
+  // programs are shared between the contexts, so this works from the main one
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    if (displays[i].calibratedShader)
+      continue;
+    displays[i].lightFieldShader->use();
+    displays[i].lightFieldShader->setUniform("debug", value);
+    displays[i].lightFieldShader->unuse();
+  }
+}
+
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
 void HoloPlayContext::mouse_callback(GLFWwindow*,
@@ -563,29 +1256,12 @@ bool HoloPlayContext::GetLookingGlassInfo()
   return true;
 }
 
-GLuint loadTextureByPath(const char* filePath) {
-  int width, height, nrChannels;
-  unsigned char* imageData = stbi_load(filePath, &width, &height, &nrChannels, 0);
-  if (!imageData) {
-    cout << "Failed to load rocky image." << endl;
-    exit(1);
-  }
-  
-  GLuint texID;
-  glGenTextures(1, &texID);
-  glBindTexture(GL_TEXTURE_2D, texID);
-
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB32F, width, height, 0, GL_RGB,
-               GL_UNSIGNED_BYTE, imageData);
-  stbi_image_free(imageData);
-
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-
-  glBindTexture(GL_TEXTURE_2D, 0);
-  return texID;
+void HoloPlayContext::updateLoadedTextures()
+{
+  if (texture == placeholderTexture && customTexture.ready())
+    texture = customTexture.id();
+  if (!skyMap && skyMapTexture.ready())
+    skyMap = skyMapTexture.id();
 }
 
 
@@ -598,11 +1274,6 @@ void HoloPlayContext::initialize()
 
   cout << "[Info] initializing" << endl;
   glfwMakeContextCurrent(window);
-  
-  setupQuiltSettings(1);
-
-  loadLightFieldShaders();
-  glCheckError(__FILE__, __LINE__);
 
   // load my custom shader
   cout << "loading quilt shader" << endl;
@@ -615,49 +1286,350 @@ void HoloPlayContext::initialize()
   colorShader = new ShaderProgram( { vertShader, colShader } );
   glCheckError(__FILE__, __LINE__);
 
+  Shader interpolateFragShader("../interpolate.glsl", GL_FRAGMENT_SHADER);
+  interpolateShader = new ShaderProgram({vertShader, interpolateFragShader});
+  glCheckError(__FILE__, __LINE__);
 
-  // WORKING
-  // inspired by https://ogldev.org/www/tutorial35/tutorial35.html
-  // setup custom precomputation shader to precompute sdf hits
-  glGenFramebuffers(1, &hitFBO);
-  glBindFramebuffer(GL_FRAMEBUFFER, hitFBO);
-  glGenTextures(2, hitAttachments);
-  
-  for (GLuint i = 0; i < 2; i++) {
-    glBindTexture(GL_TEXTURE_2D, hitAttachments[i]);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glCheckError(__FILE__, __LINE__);
-    cout << GL_RGBA32F << " " << qs_width << " " << qs_height << endl;
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, qs_width, qs_height, 0, GL_RGBA, GL_FLOAT, NULL);
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, 
-      hitAttachments[i], 0);
+  Shader classifyFragShader("../classify.glsl", GL_FRAGMENT_SHADER);
+  classifyShader = new ShaderProgram({vertShader, classifyFragShader});
+  glCheckError(__FILE__, __LINE__);
+  if (options.meshScene &&
+      (options.directRender || options.fusedRender || options.interpolateStep > 1 ||
+       options.adaptiveShading > 0.0f || options.viewLayers))
+  {
+    // these work on the hit buffers of the SDF scene, or need a depth
+    // buffer per layer
+    cout << "[Warning] the mesh scene renders a plain quilt, --render direct|fused, "
+            "--interpolate, --adaptive-shading and --view-storage layers do nothing" << endl;
+    options.directRender = false;
+    options.fusedRender = false;
+    options.interpolateStep = 1;
+    options.adaptiveShading = 0.0f;
+    options.viewLayers = false;
   }
-  
-  // enable writing to the buffers
-  GLenum writeableAttachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
-  glDrawBuffers(2, writeableAttachments );
-
-  // make sure it went well
-  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
-  switch (status) {
-    case GL_FRAMEBUFFER_COMPLETE:
-      cout << "Finished setting up framebuffers!" << endl;
-      break;
-    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
-      cout << "Incomplete attachment." << endl;
-      break;
-    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
-      cout << "Missing attachment." << endl;
-      break;
-    case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
-      cout << "Incomplete drawbuffer." << endl;
-      break;
-    case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:
-      cout << "Incomplete read buffer." << endl;
-      break;
-    case GL_FRAMEBUFFER_UNSUPPORTED:
-      cout << "Format not support." << endl;
+  if ((options.directRender || options.fusedRender) &&
+      !(options.playback.empty() && options.sharedQuilts.empty() && options.rgbdColor.empty()))
+  {
+    cout << "[Warning] quilt sources need a quilt, rendering through one" << endl;
+    options.directRender = false;
+    options.fusedRender = false;
+  }
+  if (options.directRender || options.fusedRender)
+  {
+    // without a color quilt there is nothing for these to work on
+    if (options.interpolateStep > 1 || options.viewLayers || options.viewWeighting.enabled() ||
+        options.adaptiveShading > 0.0f || options.renderBudgetMs > 0.0f)
+      cout << "[Warning] " << (options.directRender ? "rendering directly" : "shading in the interlacer")
+           << ", the quilt options --interpolate, --view-*, --adaptive-shading and "
+              "--render-budget do nothing" << endl;
+    options.fusedRender = !options.directRender;
+    options.interpolateStep = 1;
+    options.viewLayers = false;
+    options.viewWeighting.edgeScale = 1.0f;
+    options.adaptiveShading = 0.0f;
+    options.renderBudgetMs = 0.0f;
+  }
+  if (options.directRender)
+    loadDirectShaders();
+  keyViewStep = options.interpolateStep > 1 ? options.interpolateStep : 1;
+  if (keyViewStep > 1)
+    cout << "[Info] rendering one view in " << keyViewStep
+         << " and interpolating the ones between, I compares them with a full "
+            "render" << endl;
+  if (keyViewStep > 1 && options.viewWeighting.enabled())
+  {
+    // interpolation warps between tiles of one size
+    cout << "[Warning] views can't be weighted while interpolating, rendering "
+            "them all at full size" << endl;
+    options.viewWeighting.edgeScale = 1.0f;
+  }
+  if (keyViewStep > 1 && options.viewLayers)
+  {
+    cout << "[Warning] interpolation reads and writes quilts, rendering into "
+            "the quilt instead of view layers" << endl;
+    options.viewLayers = false;
+  }
+  if (options.adaptiveShading > 0.0f && (options.viewLayers || options.viewWeighting.enabled()))
+  {
+    // the coarse pass shades the quilt in one go, views drawn one by one
+    // would each need their own
+    cout << "[Warning] adaptive shading works on whole quilts only, shading "
+            "every pixel" << endl;
+    options.adaptiveShading = 0.0f;
+  }
+  if (options.viewLayers && options.viewWeighting.enabled())
+  {
+    // every layer of the array has the same size
+    cout << "[Warning] views can't be weighted in view layers, rendering "
+            "them all at full size" << endl;
+    options.viewWeighting.edgeScale = 1.0f;
+  }
+  if (options.computeInterlace &&
+      (options.directRender || options.fusedRender || options.viewLayers ||
+       options.viewWeighting.enabled()))
+  {
+    // it reads a grid of quilt tiles
+    cout << "[Warning] the compute interlacer reads plain quilts, interlacing "
+            "with the light field shader" << endl;
+    options.computeInterlace = false;
+  }
+  if ((options.trackPort > 0 || !options.trackFile.empty()) &&
+      (options.directRender || options.fusedRender || keyViewStep > 1 || options.viewLayers ||
+       options.viewWeighting.enabled() || options.adaptiveShading > 0.0f))
+  {
+    // views are skipped as whole tiles of the quilt
+    cout << "[Warning] viewer tracking skips the tiles of a plain quilt, shading "
+            "every view" << endl;
+    options.trackPort = 0;
+    options.trackFile.clear();
+  }
+  if (options.computeInterlace && !GLEW_ARB_compute_shader)
+  {
+    cout << "[Warning] compute shaders aren't supported (GL 4.3 or "
+            "ARB_compute_shader), interlacing with the light field shader" << endl;
+    options.computeInterlace = false;
+  }
+  if (options.gpuCulling && !GLEW_VERSION_4_3)
+  {
+    // compute shaders, storage buffers and glMultiDrawElementsIndirect
+    cout << "[Warning] GPU culling needs GL 4.3, culling and drawing the meshes "
+            "on the CPU" << endl;
+    options.gpuCulling = false;
+  }
+  if (options.gpuCulling && options.meshTransformPerView)
+  {
+    // the indirect draws read the world stream
+    cout << "[Warning] GPU culling draws the vertices transformed once per frame" << endl;
+    options.meshTransformPerView = false;
+  }
+
+  // fullscreen quad vertices, the buffer is shared by every context
+  const float fsquadVerts[] = {
+      -1.0f,
+      -1.0f,
+      -1.0f,
+      1.0f,
+      1.0f,
+      1.0f,
+      1.0f,
+      1.0f,
+      1.0f,
+      -1.0f,
+      -1.0f,
+      -1.0f,
+  };
+
+  // create vbo
+  glGenBuffers(1, &VBO);
+  glBindBuffer(GL_ARRAY_BUFFER, VBO);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(fsquadVerts), fsquadVerts,
+               GL_STATIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gpuMemory.addBuffer("fullscreen quad", VBO, sizeof(fsquadVerts));
+
+  VAO = createQuadVAO();
+  glCheckError(__FILE__, __LINE__);
+
+  // make sure the quilts fit before allocating them
+  if (!options.directRender)
+    fitQuiltsToBudget();
+
+  // hit buffers and quilt for every distinct quilt layout
+  for (size_t q = 0; q < quilts.size(); q++)
+  {
+    setupQuiltSettings(quilts[q].preset);
+
+    if (options.directRender || options.fusedRender)
+    {
+      // the layout stays for the light field shaders, the interlacer shades
+      // the hit buffers when fused and nothing is allocated when direct
+      quiltTexture = FBO = hitFBO = 0;
+      hitAttachments[0] = hitAttachments[1] = 0;
+      if (options.fusedRender)
+        setupHitBuffers();
+      keyTexture = keyFBO = 0;
+      viewArray = 0;
+      layerFBOs.clear();
+      rateTexture = rateFBO = coarseTexture = coarseFBO = 0;
+      depthBuffer = 0;
+      storeQuilt(int(q));
+      continue;
+    }
+
+    if (options.meshScene)
+    {
+      hitFBO = 0;
+      hitAttachments[0] = hitAttachments[1] = 0;
+    }
+    else
+      setupHitBuffers();
+    glCheckError(__FILE__, __LINE__);
+
+    setupQuilt();
+    glCheckError(__FILE__, __LINE__);
+
+    if (!viewRects.empty())
+      cout << "[Info] weighted views shade "
+           << int(100.0f * shadedFraction(viewRects, qs_width / qs_columns,
+                                          qs_height / qs_rows) + 0.5f)
+           << "% of the pixels of a " << qs_width << "x" << qs_height
+           << " quilt" << endl;
+
+    storeQuilt(int(q));
+  }
+
+  // textures load in the background, until they are ready the scene samples
+  // a white placeholder
+  const unsigned char white[4] = {255, 255, 255, 255};
+  glGenTextures(1, &placeholderTexture);
+  glBindTexture(GL_TEXTURE_2D, placeholderTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gpuMemory.addTexture("placeholder", placeholderTexture, GL_RGBA8, 1, 1);
+  texture = placeholderTexture;
+
+  workers = new ThreadPool();
+  textureLoader = new TextureLoader(window, *workers, &gpuMemory);
+  TextureOptions textureOptions;
+  textureOptions.compress = options.compressTextures;
+  customTexture = textureLoader->load("../images/rocky-small.jpg", textureOptions);
+
+  // load cubemap, color.glsl keeps its procedural sky until it is ready
+  if (!options.skybox.empty())
+  {
+    const string &dir = options.skybox;
+    vector<std::string> faces = {
+      dir + "/right.jpg",
+      dir + "/left.jpg",
+      dir + "/top.jpg",
+      dir + "/bottom.jpg",
+      dir + "/front.jpg",
+      dir + "/back.jpg"
+    };
+    skyMapTexture = loadCubemap(faces);
+  }
+
+  // per display light field shader, calibration and VAO. Programs are shared
+  // but VAOs have to be created in the context that draws with them
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    LKGDisplay &display = displays[i];
+    selectQuilt(display.quiltIndex);
+
+    loadLightFieldShaders(display);
+    glCheckError(__FILE__, __LINE__);
+
+    if (options.computeInterlace)
+      loadInterlaceShader(display);
+
+    loadCalibrationIntoShader(display);
+    glCheckError(__FILE__, __LINE__);
+
+    passQuiltSettingsToShader(display);
+    glCheckError(__FILE__, __LINE__);
+
+    if (options.directRender)
+      setupDirectHits(display);
+
+    if (i == 0)
+    {
+      display.VAO = VAO;
+      if (options.computeInterlace)
+        setupInterlacedTexture(display);
+    }
+    else
+    {
+      glfwMakeContextCurrent(display.window);
+      glfwSwapInterval(0);
+      display.VAO = createQuadVAO();
+      // the texture is shared, the framebuffer reading it is not
+      if (options.computeInterlace)
+        setupInterlacedTexture(display);
+      glfwMakeContextCurrent(window);
+    }
+  }
+  lightFieldShader = displays[0].lightFieldShader;
+  selectQuilt(0);
+  glCheckError(__FILE__, __LINE__);
+
+  setupQuiltSource();
+
+  if ((options.trackPort > 0 || !options.trackFile.empty()) && !quiltSource)
+  {
+    try
+    {
+      tracker = options.trackFile.empty() ? ViewerTracker::listen(options.trackPort)
+                                          : ViewerTracker::replay(options.trackFile);
+      cout << "[Info] shading only the views that reach the eyes "
+           << (options.trackFile.empty() ? "sent to port " + to_string(options.trackPort)
+                                         : "in " + options.trackFile)
+           << ", " << options.trackMargin << " more on each side" << endl;
+    }
+    catch (const std::runtime_error &e)
+    {
+      cout << "[Error] " << e.what() << ", shading every view" << endl;
+    }
+  }
+
+  if (options.renderBudgetMs > 0.0f && !quiltSource)
+  {
+    resolution = new ResolutionController(options.renderBudgetMs, options.minRenderScale);
+    cout << "[Info] scaling the quilt resolution to render within "
+         << options.renderBudgetMs << " ms of GPU time" << endl;
+  }
+
+  // textures still loading show up in later reports (M key)
+  gpuMemory.report(cout);
+}
+
+void HoloPlayContext::setupHitBuffers()
+{
+  // WORKING
+  // inspired by https://ogldev.org/www/tutorial35/tutorial35.html
+  // setup custom precomputation shader to precompute sdf hits
+  glGenFramebuffers(1, &hitFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, hitFBO);
+  glGenTextures(2, hitAttachments);
+  
+  for (GLuint i = 0; i < 2; i++) {
+    glBindTexture(GL_TEXTURE_2D, hitAttachments[i]);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glCheckError(__FILE__, __LINE__);
+    cout << GL_RGBA32F << " " << qs_width << " " << qs_height << endl;
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, qs_width, qs_height, 0, GL_RGBA, GL_FLOAT, NULL);
+    gpuMemory.addTexture(i == 0 ? "hit positions / materials" : "hit normals",
+                         hitAttachments[i], GL_RGBA32F, qs_width, qs_height);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0 + i, GL_TEXTURE_2D, 
+      hitAttachments[i], 0);
+  }
+  
+  // enable writing to the buffers
+  GLenum writeableAttachments[] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+  glDrawBuffers(2, writeableAttachments );
+
+  // make sure it went well
+  GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+  switch (status) {
+    case GL_FRAMEBUFFER_COMPLETE:
+      cout << "Finished setting up framebuffers!" << endl;
+      break;
+    case GL_FRAMEBUFFER_INCOMPLETE_ATTACHMENT:
+      cout << "Incomplete attachment." << endl;
+      break;
+    case GL_FRAMEBUFFER_INCOMPLETE_MISSING_ATTACHMENT:
+      cout << "Missing attachment." << endl;
+      break;
+    case GL_FRAMEBUFFER_INCOMPLETE_DRAW_BUFFER:
+      cout << "Incomplete drawbuffer." << endl;
+      break;
+    case GL_FRAMEBUFFER_INCOMPLETE_READ_BUFFER:
+      cout << "Incomplete read buffer." << endl;
+      break;
+    case GL_FRAMEBUFFER_UNSUPPORTED:
+      cout << "Format not support." << endl;
       break;
     case GL_FRAMEBUFFER_INCOMPLETE_MULTISAMPLE:
       cout << "Incomplete multisample." << endl;
@@ -672,54 +1644,296 @@ void HoloPlayContext::initialize()
   
   // unbind FBO
   glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+TextureHandle HoloPlayContext::loadCubemap(vector<std::string> faces) {
+  // faces are decoded in parallel and uploaded with immutable storage and a
+  // full mip chain, so the sky can be sampled blurred for rough lookups
+  TextureOptions cubemapOptions;
+  cubemapOptions.compress = options.compressTextures;
+  return textureLoader->loadCubemap(faces, cubemapOptions);
+}
 
+// choose the devices to drive and group them by quilt layout
+void HoloPlayContext::setupDisplays()
+{
+  int numDevices = hpc_GetNumDevices();
+  int first = options.firstDevice < 0 ? 0 : options.firstDevice;
+  int last = numDevices;
+  if (options.maxDisplays > 0 && first + options.maxDisplays < last)
+    last = first + options.maxDisplays;
 
-  texture = loadTextureByPath("../images/rocky-small.jpg");
+  for (int dev = first; dev < last; dev++)
+  {
+    LKGDisplay display;
+    display.devIndex = dev;
+    display.window = NULL;
+    display.win_w = hpc_GetDevicePropertyScreenW(dev);
+    display.win_h = hpc_GetDevicePropertyScreenH(dev);
+    display.win_x = hpc_GetDevicePropertyWinX(dev);
+    display.win_y = hpc_GetDevicePropertyWinY(dev);
+    display.VAO = 0;
+    display.lightFieldShader = NULL;
+    display.calibratedShader = false;
+    display.debugShader = NULL;
+    display.directFBO = 0;
+    display.directHits[0] = display.directHits[1] = display.directHits[2] = 0;
+    display.directHits[3] = display.directHits[4] = display.directHits[5] = 0;
+    display.directWidth = display.directHeight = 0;
+    display.interlaceShader = NULL;
+    display.interlacedTexture = display.interlacedFBO = 0;
+    display.interlacedWidth = display.interlacedHeight = 0;
+
+    // device properties can't be read while the button poller runs
+    float dpi = hpc_GetDevicePropertyFloat(dev, "/calibration/DPI/value");
+    display.widthMeters = dpi > 0.0f ? float(display.win_w) / dpi * 0.0254f : 0.2f;
+    display.pitch = hpc_GetDevicePropertyPitch(dev);
+    display.tilt = hpc_GetDevicePropertyTilt(dev);
+    display.center = hpc_GetDevicePropertyCenter(dev);
+    display.subp = hpc_GetDevicePropertySubp(dev);
+    display.displayAspect = hpc_GetDevicePropertyDisplayAspect(dev);
+    display.invView = hpc_GetDevicePropertyInvView(dev);
+    display.ri = hpc_GetDevicePropertyRi(dev);
+    display.bi = hpc_GetDevicePropertyBi(dev);
+    char serial[256] = "";
+    hpc_GetDeviceSerial(dev, serial, sizeof(serial));
+    display.serial = serial;
+
+    int preset = presetForDevice(dev);
+    float cone = hpc_GetDevicePropertyFloat(dev, "/calibration/viewCone/value");
+    float aspect = display.displayAspect;
+
+    // displays with the same layout, view cone and aspect render exactly the
+    // same views, so they share one quilt. Only an exact match shares:
+    // displays whose cones merely overlap see views at other angles, which
+    // a shared quilt would have to render over the union of the cones at
+    // the finest spacing of the two, and get a quilt each
+    display.quiltIndex = -1;
+    for (size_t q = 0; q < quilts.size(); q++)
+    {
+      if (quilts[q].preset == preset &&
+          fabs(quilts[q].viewCone - cone) < 0.01f &&
+          fabs(quilts[q].aspect - aspect) < 0.001f)
+      {
+        display.quiltIndex = int(q);
+        break;
+      }
+    }
+    if (display.quiltIndex < 0)
+    {
+      QuiltTarget quilt = QuiltTarget();
+      quilt.preset = preset;
+      quilt.viewCone = cone;
+      quilt.aspect = aspect;
+      quilts.push_back(quilt);
+      display.quiltIndex = int(quilts.size()) - 1;
+    }
 
-  /*
-  TODO: get cubemap working
-  // load cubemap
-  vector<std::string> faces = {
-    "images/skybox/right.jpg",
-    "images/skybox/left.jpg",
-    "images/skybox/top.jpg",
-    "images/skybox/bottom.jpg",
-    "images/skybox/front.jpg",
-    "images/skybox/back.jpg"
-  };
-  
-  skyMap = loadCubemap(faces);
-  */
-  
-  loadCalibrationIntoShader();
-  glCheckError(__FILE__, __LINE__);
+    cout << "[Info] driving display " << dev << " with quilt "
+         << display.quiltIndex << " (preset " << preset << ")" << endl;
+    displays.push_back(display);
+  }
+}
 
-  passQuiltSettingsToShader();
-  glCheckError(__FILE__, __LINE__);
+// preset used for a device, either the one asked for or one that suits the
+// device type
+int HoloPlayContext::presetForDevice(int devIndex)
+{
+  if (options.quiltPreset >= 0)
+    return options.quiltPreset;
+
+  char type[256];
+  hpc_GetDeviceType(devIndex, type, sizeof(type));
+  string deviceType(type);
+  if (deviceType == "standard")
+    return 0;
+  if (deviceType == "8k")
+    return 2;
+  return 1;
+}
 
-  setupQuilt();
-  glCheckError(__FILE__, __LINE__);
+// bytes taken by the quilt texture and the two hit buffers of a preset, all
+// RGBA32F, or the quilt and its depth buffer for the mesh scene. Leaves the
+// qs_* members describing the preset.
+size_t HoloPlayContext::quiltBytes(int preset)
+{
+  setupQuiltSettings(preset);
+  if (options.meshScene)
+    return GpuMemoryRegistry::textureBytes(GL_RGBA32F, qs_width, qs_height) +
+           GpuMemoryRegistry::textureBytes(GL_DEPTH_COMPONENT24, qs_width, qs_height);
+  size_t bytes = (options.fusedRender ? 2 : 3) *
+                 GpuMemoryRegistry::textureBytes(GL_RGBA32F, qs_width, qs_height);
+  if (options.interpolateStep > 1)
+    bytes += GpuMemoryRegistry::textureBytes(GL_RGBA8, qs_width, qs_height);
+  if (options.viewLayers)
+    bytes += GpuMemoryRegistry::textureBytes(GL_RGBA32F, qs_width / qs_columns,
+                                             qs_height / qs_rows, 1, qs_totalViews);
+  if (options.adaptiveShading > 0.0f)
+    bytes += GpuMemoryRegistry::textureBytes(GL_RGBA8, (qs_width + 1) / 2, (qs_height + 1) / 2);
+  return bytes;
 }
 
-GLuint HoloPlayContext::loadCubemap(vector<std::string> faces) {
-  
-  GLuint cubemapID;
-  glGenTextures(1, &cubemapID);
-  glBindTexture(GL_TEXTURE_CUBE_MAP, cubemapID);
+// --gpu-budget, or 90% of the memory the driver reports free, and what of
+// the allocations so far counts against it. False when neither is known
+bool HoloPlayContext::gpuBudget(size_t &budget, size_t &allocated)
+{
+  budget = size_t(options.gpuBudgetMB) << 20;
+  // an explicit budget covers everything allocated so far, the memory the
+  // driver reports free already excludes it
+  allocated = budget ? gpuMemory.totalBytes() : 0;
+  if (budget)
+    return true;
+  GpuMemoryRegistry::DeviceMemory device = GpuMemoryRegistry::queryDeviceMemory();
+  if (!device.known)
+    return false;
+  // leave some room for the window surfaces, driver overhead and other
+  // applications
+  budget = device.available - device.available / 10;
+  return true;
+}
 
-  int width, height, nrChannels;
-  for (GLuint i = 0; i < faces.size(); i++) {
-    unsigned char* data = stbi_load(faces[i].c_str(), &width, &height, &nrChannels, 0);
-    if (data) {
-      glTexImage2D(GL_TEXTURE_CUBE_MAP_POSITIVE_X + i, 0, GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+void HoloPlayContext::fitQuiltsToBudget()
+{
+  size_t budget, allocated;
+  if (!gpuBudget(budget, allocated))
+  {
+    cout << "[Info] the driver doesn't report GPU memory, quilts are not "
+            "checked against a budget" << endl;
+    return;
+  }
+
+  for (;;)
+  {
+    size_t needed = allocated;
+    int views = 0, viewHeight = 0;
+    for (size_t q = 0; q < quilts.size(); q++)
+    {
+      needed += quiltBytes(quilts[q].preset);
+      views = max(views, qs_totalViews);
+      viewHeight = max(viewHeight, qs_height / qs_rows);
+    }
+    // what the scene allocates once the quilts exist
+    size_t scene = 0;
+    if (options.sceneGpuBytes)
+      scene = options.sceneGpuBytes(options, views, viewHeight, cameraSize);
+    needed += scene;
+    if (needed <= budget)
+    {
+      cout << "[Info] quilts";
+      if (scene)
+        cout << " and scene (" << GpuMemoryRegistry::formatBytes(scene) << ")";
+      cout << " need " << GpuMemoryRegistry::formatBytes(needed)
+           << " of the GPU memory budget of "
+           << GpuMemoryRegistry::formatBytes(budget) << endl;
+      break;
     }
-    else {
-      std::cout << "Failed to load cubemap with path \"" << faces[i] << "\"" << std::endl;
+
+    // presets grow with their number, shrink the largest quilt first
+    int largest = -1;
+    for (size_t q = 0; q < quilts.size(); q++)
+    {
+      if (quilts[q].preset > 0 &&
+          (largest < 0 || quilts[q].preset > quilts[size_t(largest)].preset))
+        largest = int(q);
     }
-    stbi_image_free(data);
+    string overBudget = "quilts need " + GpuMemoryRegistry::formatBytes(needed) +
+                        ", over the GPU memory budget of " +
+                        GpuMemoryRegistry::formatBytes(budget);
+    if (!options.downgradePresets || largest < 0)
+    {
+      cout << "[Error] " << overBudget << endl;
+      throw std::runtime_error(overBudget);
+    }
+    QuiltTarget &quilt = quilts[size_t(largest)];
+    cout << "[Warning] " << overBudget << ", quilt " << largest
+         << " falls back from preset " << quilt.preset << " to "
+         << quilt.preset - 1 << endl;
+    quilt.preset--;
   }
 
-  return cubemapID;
+  mergeQuilts();
+}
+
+// after downgrading, displays that asked for different presets may share one
+void HoloPlayContext::mergeQuilts()
+{
+  for (size_t q = quilts.size(); q-- > 1;)
+  {
+    for (size_t p = 0; p < q; p++)
+    {
+      if (quilts[p].preset != quilts[q].preset ||
+          fabs(quilts[p].viewCone - quilts[q].viewCone) >= 0.01f ||
+          fabs(quilts[p].aspect - quilts[q].aspect) >= 0.001f)
+        continue;
+      for (size_t i = 0; i < displays.size(); i++)
+      {
+        if (displays[i].quiltIndex == int(q))
+          displays[i].quiltIndex = int(p);
+        else if (displays[i].quiltIndex > int(q))
+          displays[i].quiltIndex--;
+      }
+      quilts.erase(quilts.begin() + long(q));
+      break;
+    }
+  }
+}
+
+// the qs_* members and quilt resources always describe the current quilt, so
+// renderScene() overrides work unchanged whichever quilt is being rendered
+void HoloPlayContext::selectQuilt(int index)
+{
+  const QuiltTarget &quilt = quilts[size_t(index)];
+  currentQuilt = index;
+  viewCone = quilt.viewCone;
+  qs_width = quilt.qs_width;
+  qs_height = quilt.qs_height;
+  qs_rows = quilt.qs_rows;
+  qs_columns = quilt.qs_columns;
+  qs_totalViews = quilt.qs_totalViews;
+  quiltTexture = quilt.quiltTexture;
+  FBO = quilt.FBO;
+  hitFBO = quilt.hitFBO;
+  hitAttachments[0] = quilt.hitAttachments[0];
+  hitAttachments[1] = quilt.hitAttachments[1];
+  keyTexture = quilt.keyTexture;
+  keyFBO = quilt.keyFBO;
+  renderWidth = quilt.renderWidth;
+  renderHeight = quilt.renderHeight;
+  viewRects = quilt.viewRects;
+  viewArray = quilt.viewArray;
+  layerFBOs = quilt.layerFBOs;
+  rateTexture = quilt.rateTexture;
+  rateFBO = quilt.rateFBO;
+  coarseTexture = quilt.coarseTexture;
+  coarseFBO = quilt.coarseFBO;
+  depthBuffer = quilt.depthBuffer;
+}
+
+void HoloPlayContext::storeQuilt(int index)
+{
+  QuiltTarget &quilt = quilts[size_t(index)];
+  quilt.qs_width = qs_width;
+  quilt.qs_height = qs_height;
+  quilt.qs_rows = qs_rows;
+  quilt.qs_columns = qs_columns;
+  quilt.qs_totalViews = qs_totalViews;
+  quilt.quiltTexture = quiltTexture;
+  quilt.FBO = FBO;
+  quilt.hitFBO = hitFBO;
+  quilt.hitAttachments[0] = hitAttachments[0];
+  quilt.hitAttachments[1] = hitAttachments[1];
+  quilt.keyTexture = keyTexture;
+  quilt.keyFBO = keyFBO;
+  quilt.renderWidth = renderWidth;
+  quilt.renderHeight = renderHeight;
+  quilt.viewRects = viewRects;
+  quilt.viewArray = viewArray;
+  quilt.layerFBOs = layerFBOs;
+  quilt.rateTexture = rateTexture;
+  quilt.rateFBO = rateFBO;
+  quilt.coarseTexture = coarseTexture;
+  quilt.coarseFBO = coarseFBO;
+  quilt.depthBuffer = depthBuffer;
 }
 
 // set up the quilt settings
@@ -751,26 +1965,102 @@ void HoloPlayContext::setupQuiltSettings(int preset)
     qs_totalViews = 45;
     break;
   }
+  renderWidth = qs_width;
+  renderHeight = qs_height;
+  layoutViews();
+}
+
+void HoloPlayContext::layoutViews()
+{
+  viewRects.clear();
+  if (options.viewWeighting.enabled())
+    viewRects = weightedViewRects(options.viewWeighting, renderWidth / qs_columns,
+                                  renderHeight / qs_rows, qs_columns, qs_rows,
+                                  qs_totalViews);
 }
 // pass quilt values to shader
-void HoloPlayContext::passQuiltSettingsToShader()
+void HoloPlayContext::passQuiltSettingsToShader(LKGDisplay &display)
 {
-  lightFieldShader->use();
-  lightFieldShader->setUniform("overscan", 0);
-  glCheckError(__FILE__, __LINE__);
+  QuiltLayout layout;
+  layout.width = renderWidth;
+  layout.height = renderHeight;
+  layout.columns = qs_columns;
+  layout.rows = qs_rows;
+  layout.views = qs_totalViews;
+  passQuiltLayoutToShader(display, layout, qs_width, qs_height);
+  // the calibrated shader and its debug view have the layout compiled in
+  ShaderProgram *programs[2] = { display.lightFieldShader, display.debugShader };
+  for (int p = 0; p < 2 && programs[p]; p++)
+  {
+    ShaderProgram *lightFieldShader = programs[p];
+    lightFieldShader->use();
+    if (viewArray)
+    {
+      if (!display.calibratedShader)
+        lightFieldShader->setUniform("useLayers", 1);
+      lightFieldShader->setUniform(
+          "layerPortion", glm::vec2(float(renderWidth / qs_columns) / float(qs_width / qs_columns),
+                                    float(renderHeight / qs_rows) / float(qs_height / qs_rows)));
+      glCheckError(__FILE__, __LINE__);
+    }
+    if (!viewRects.empty())
+    {
+      vector<glm::vec4> rects(viewRects.size());
+      for (size_t v = 0; v < viewRects.size(); v++)
+        rects[v] = glm::vec4(viewRects[v]) /
+                   glm::vec4(qs_width, qs_height, qs_width, qs_height);
+      if (!display.calibratedShader)
+        lightFieldShader->setUniform("useRects", 1);
+      glUniform4fv(lightFieldShader->uniform("viewRects"), GLsizei(rects.size()),
+                   &rects[0].x);
+      glCheckError(__FILE__, __LINE__);
+    }
+    lightFieldShader->unuse();
+  }
+}
 
-  lightFieldShader->setUniform("tile",
-                               glm::vec3(qs_columns, qs_rows, qs_totalViews));
-  glCheckError(__FILE__, __LINE__);
+// the layout may cover only part of the quilt texture, viewPortion tells the
+// shader how much of it
+void HoloPlayContext::passQuiltLayoutToShader(LKGDisplay &display,
+                                              const QuiltLayout &layout,
+                                              int textureWidth, int textureHeight)
+{
+  int viewWidth = layout.width / layout.columns;
+  int viewHeight = layout.height / layout.rows;
+
+  // the compute interlacer and the calibrated shader's debug view take the
+  // same uniforms
+  ShaderProgram *programs[3] = { display.lightFieldShader, display.interlaceShader,
+                                 display.debugShader };
+  for (int p = 0; p < 3; p++)
+  {
+    ShaderProgram *lightFieldShader = programs[p];
+    if (!lightFieldShader)
+      continue;
+    lightFieldShader->use();
+    if (p == 1 || !display.calibratedShader)
+      lightFieldShader->setUniform("overscan", 0);
+    glCheckError(__FILE__, __LINE__);
 
-  int qs_viewWidth = qs_width / qs_columns;
-  int qs_viewHeight = qs_height / qs_rows;
+    lightFieldShader->setUniform("tile",
+                                 glm::vec3(layout.columns, layout.rows, layout.views));
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform(
-      "viewPortion", glm::vec2(float(qs_viewWidth * qs_columns) / float(qs_width),
-                               float(qs_viewHeight * qs_rows) / float(qs_height)));
-  glCheckError(__FILE__, __LINE__);
-  lightFieldShader->unuse();
+    lightFieldShader->setUniform(
+        "viewPortion", glm::vec2(float(viewWidth * layout.columns) / float(textureWidth),
+                                 float(viewHeight * layout.rows) / float(textureHeight)));
+    glCheckError(__FILE__, __LINE__);
+    lightFieldShader->unuse();
+  }
+  // the rect table and the view layers are only used for rendered quilts,
+  // the calibrated shader is compiled for a plain grid when a source shows
+  if ((options.viewWeighting.enabled() || options.viewLayers) && !display.calibratedShader)
+  {
+    display.lightFieldShader->use();
+    display.lightFieldShader->setUniform("useRects", 0);
+    display.lightFieldShader->setUniform("useLayers", 0);
+    display.lightFieldShader->unuse();
+  }
 }
 
 void HoloPlayContext::setupQuilt()
@@ -781,6 +2071,7 @@ void HoloPlayContext::setupQuilt()
 
   glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, qs_width, qs_height, 0, GL_RGBA,
                GL_UNSIGNED_BYTE, NULL);
+  gpuMemory.addTexture("quilt", quiltTexture, GL_RGBA32F, qs_width, qs_height);
 
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
   glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
@@ -796,33 +2087,141 @@ void HoloPlayContext::setupQuilt()
   // bind the quilt texture as the color attachment of the framebuffer
   glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, quiltTexture, 0);
 
-  // vbo and vao
-  glGenVertexArrays(1, &VAO);
-  glGenBuffers(1, &VBO);
+  // meshes are depth tested, the SDF scene is marched
+  depthBuffer = 0;
+  if (options.meshScene)
+  {
+    glGenRenderbuffers(1, &depthBuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, qs_width, qs_height);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+    gpuMemory.addRenderbuffer("quilt depth", depthBuffer, GL_DEPTH_COMPONENT24, qs_width,
+                              qs_height);
+  }
 
-  // set up the vertex array object
-  glBindVertexArray(VAO);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-  // fullscreen quad vertices
-  const float fsquadVerts[] = {
-      -1.0f,
-      -1.0f,
-      -1.0f,
-      1.0f,
-      1.0f,
-      1.0f,
-      1.0f,
-      1.0f,
-      1.0f,
-      -1.0f,
-      -1.0f,
-      -1.0f,
-  };
+  // the key views are shaded into a texture of their own, the interpolation
+  // pass reads them while writing the quilt
+  keyTexture = 0;
+  keyFBO = 0;
+  if (options.interpolateStep > 1)
+  {
+    glGenTextures(1, &keyTexture);
+    glBindTexture(GL_TEXTURE_2D, keyTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, qs_width, qs_height, 0, GL_RGBA,
+                 GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    gpuMemory.addTexture("key views", keyTexture, GL_RGBA8, qs_width, qs_height);
+
+    glGenFramebuffers(1, &keyFBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, keyFBO);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, keyTexture, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  }
 
-  // create vbo
+  viewArray = 0;
+  layerFBOs.clear();
+  if (options.viewLayers)
+    setupViewLayers();
+
+  rateTexture = 0;
+  rateFBO = 0;
+  coarseTexture = 0;
+  coarseFBO = 0;
+  if (options.adaptiveShading > 0.0f)
+    setupAdaptiveShading();
+}
+
+void HoloPlayContext::setupAdaptiveShading()
+{
+  const int tilesX = (qs_width + RATE_TILE - 1) / RATE_TILE;
+  const int tilesY = (qs_height + RATE_TILE - 1) / RATE_TILE;
+  glGenTextures(1, &rateTexture);
+  glBindTexture(GL_TEXTURE_2D, rateTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, tilesX, tilesY, 0, GL_RED, GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  gpuMemory.addTexture("shading rates", rateTexture, GL_R8, tilesX, tilesY);
+  glGenFramebuffers(1, &rateFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, rateFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, rateTexture, 0);
+
+  const int coarseWidth = (qs_width + 1) / 2, coarseHeight = (qs_height + 1) / 2;
+  glGenTextures(1, &coarseTexture);
+  glBindTexture(GL_TEXTURE_2D, coarseTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, coarseWidth, coarseHeight, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  gpuMemory.addTexture("coarse shading", coarseTexture, GL_RGBA8, coarseWidth, coarseHeight);
+  glGenFramebuffers(1, &coarseFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, coarseFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, coarseTexture, 0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// every view gets a layer of its own, with a framebuffer to render into it.
+// The quilt texture stays for quilt sources and capture
+void HoloPlayContext::setupViewLayers()
+{
+  const int viewWidth = qs_width / qs_columns, viewHeight = qs_height / qs_rows;
+  glGenTextures(1, &viewArray);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, viewArray);
+  glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_RGBA32F, viewWidth, viewHeight,
+               qs_totalViews, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  // views don't touch, so nothing bleeds in from a neighbour
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+  gpuMemory.addTexture("view layers", viewArray, GL_RGBA32F, viewWidth, viewHeight,
+                       1, qs_totalViews);
+
+  layerFBOs.resize(size_t(qs_totalViews));
+  glGenFramebuffers(GLsizei(layerFBOs.size()), &layerFBOs[0]);
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, layerFBOs[size_t(v)]);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, viewArray, 0, v);
+  }
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    cout << "[Error] the view layer framebuffers are incomplete" << endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+// lays the rendered layers out as a quilt in the quilt texture
+void HoloPlayContext::copyLayersToQuilt()
+{
+  const int viewWidth = renderWidth / qs_columns, viewHeight = renderHeight / qs_rows;
+  glBindFramebuffer(GL_DRAW_FRAMEBUFFER, FBO);
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    int x = (v % qs_columns) * viewWidth, y = (v / qs_columns) * viewHeight;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, layerFBOs[size_t(v)]);
+    glBlitFramebuffer(0, 0, viewWidth, viewHeight, x, y, x + viewWidth, y + viewHeight,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+  }
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+GLuint HoloPlayContext::createQuadVAO()
+{
+  GLuint vao;
+  glGenVertexArrays(1, &vao);
+
+  // set up the vertex array object
+  glBindVertexArray(vao);
   glBindBuffer(GL_ARRAY_BUFFER, VBO);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(fsquadVerts), fsquadVerts,
-               GL_STATIC_DRAW);
 
   // setup the attribute pointers
   // note: using only 2 floats per vert, not 3
@@ -832,59 +2231,219 @@ void HoloPlayContext::setupQuilt()
   // unbind stuff
   glBindBuffer(GL_ARRAY_BUFFER, 0);
   glBindVertexArray(0);
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  return vao;
 }
 
-void HoloPlayContext::loadLightFieldShaders()
+void HoloPlayContext::loadLightFieldShaders(LKGDisplay &display)
 {
   cout << "loading quilt shader" << endl;
   Shader lightFieldVertexShader(
       GL_VERTEX_SHADER,
       (opengl_version_header + hpc_LightfieldVertShaderGLSL).c_str());
+  if (options.fusedRender)
+  {
+    // shades the hit buffers itself, with code from color.glsl
+    Shader lightFieldFragmentShader(GL_FRAGMENT_SHADER,
+                                    readShaderSource("../fused.glsl").c_str());
+    if (lightFieldFragmentShader.checkCompileError("../fused.glsl") && display.lightFieldShader)
+      return; // keeps the one loaded before
+    delete display.lightFieldShader;
+    display.lightFieldShader =
+        new ShaderProgram({lightFieldVertexShader, lightFieldFragmentShader});
+    return;
+  }
+
+  // lightfield.glsl with the calibration compiled in, and its debug view,
+  // the programs are kept per device serial. The generic shaders below are
+  // the fallback
+  string key = !display.serial.empty() ? "lightfield-" + display.serial
+                                       : "lightfield-device" + to_string(display.devIndex);
+  const string vertexSource = opengl_version_header + hpc_LightfieldVertShaderGLSL;
+  ShaderProgram *calibrated =
+      programCache.load(key, vertexSource, calibratedLightFieldSource(display, false));
+  ShaderProgram *debugView =
+      calibrated ? programCache.load(key + "-debug", vertexSource,
+                                     calibratedLightFieldSource(display, true))
+                 : NULL;
+  delete display.debugShader;
+  display.debugShader = NULL;
+  display.calibratedShader = calibrated && debugView;
+  if (display.calibratedShader)
+  {
+    delete display.lightFieldShader;
+    display.lightFieldShader = calibrated;
+    display.debugShader = debugView;
+    ShaderProgram *programs[2] = { calibrated, debugView };
+    for (int p = 0; p < 2; p++)
+    {
+      // each variant reads only the samplers and layout uniforms of its layout
+      programs[p]->allowMissingUniforms(true);
+      programs[p]->use();
+      programs[p]->setUniform("screenTex", 0);
+      programs[p]->setUniform("viewLayers", 1);
+      programs[p]->unuse();
+    }
+    return;
+  }
+  delete calibrated;
+  cout << "[Warning] the calibrated light field shader doesn't compile, using the "
+          "generic one" << endl;
+
+  if (options.viewWeighting.enabled() || options.viewLayers)
+  {
+    // the same shader, reading views of different sizes through a rect
+    // table or views from the layers of a texture array
+    Shader lightFieldFragmentShader("../lightfield.glsl", GL_FRAGMENT_SHADER);
+    delete display.lightFieldShader;
+    display.lightFieldShader =
+        new ShaderProgram({lightFieldVertexShader, lightFieldFragmentShader});
+    // samplers of different types must not share a unit
+    display.lightFieldShader->use();
+    display.lightFieldShader->setUniform("screenTex", 0);
+    display.lightFieldShader->setUniform("viewLayers", 1);
+    display.lightFieldShader->unuse();
+    return;
+  }
   Shader lightFieldFragmentShader(
       GL_FRAGMENT_SHADER,
       (opengl_version_header + hpc_LightfieldFragShaderGLSL).c_str());
-  lightFieldShader =
+  delete display.lightFieldShader;
+  display.lightFieldShader =
       new ShaderProgram({lightFieldVertexShader, lightFieldFragmentShader});
 }
 
-void HoloPlayContext::loadCalibrationIntoShader()
+// a float literal GLSL reads back to the same value
+static string glslFloat(float value)
+{
+  ostringstream text;
+  text << showpoint << setprecision(9) << value;
+  return text.str();
+}
+
+// lightfield.glsl specialized for a device, see CALIBRATED there, showing
+// the quilt or, with debugView, the debug view. The uniforms it replaces are
+// set to the same values on the generic shaders. The view layout is the one
+// rendered quilts use, quilt sources show a plain grid
+string HoloPlayContext::calibratedLightFieldSource(const LKGDisplay &display, bool debugView)
+{
+  const float displayAspect = display.displayAspect;
+  const float quiltAspect = displayAspect;
+  const int overscan = 0;
+  const int quiltInvert = 0;
+  // the aspect correction of the shader, modx picks the axis
+  const bool modx = overscan == 0 ? displayAspect >= quiltAspect : displayAspect <= quiltAspect;
+  const float aspectX = modx ? displayAspect / quiltAspect : 1.0f;
+  const float aspectY = modx ? 1.0f : quiltAspect / displayAspect;
+
+  ostringstream defines;
+  defines << "#define CALIBRATED\n"
+          << "#define PITCH " << glslFloat(display.pitch) << "\n"
+          << "#define TILT " << glslFloat(display.tilt) << "\n"
+          << "#define CENTER " << glslFloat(display.center) << "\n"
+          << "#define SUBP " << glslFloat(display.subp) << "\n"
+          << "#define INVERT " << (display.invView + quiltInvert == 1 ? "-1.0" : "1.0") << "\n"
+          << "#define ASPECT_X " << glslFloat(aspectX) << "\n"
+          << "#define ASPECT_Y " << glslFloat(aspectY) << "\n"
+          << "#define RI " << display.ri << "\n"
+          << "#define BI " << display.bi << "\n";
+  // scaled up about the center, the edges fall outside the quilt
+  if (aspectX > 1.0f || aspectY > 1.0f)
+    defines << "#define CLIP\n";
+  if (!quiltSource && options.viewLayers)
+    defines << "#define LAYERS\n";
+  else if (!quiltSource && options.viewWeighting.enabled())
+    defines << "#define RECTS\n";
+  if (debugView)
+    defines << "#define DEBUG\n";
+
+  // the defines go after the #version line
+  string source = readShaderSource("../lightfield.glsl");
+  size_t versionEnd = source.find('\n') + 1;
+  return source.substr(0, versionEnd) + defines.str() + source.substr(versionEnd);
+}
+
+void HoloPlayContext::loadCalibrationIntoShader(LKGDisplay &display)
 {
   cout << "begin assigning calibration uniforms" << endl;
-  lightFieldShader->use();
-  lightFieldShader->setUniform("pitch", hpc_GetDevicePropertyPitch(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+  // the compute interlacer takes the same uniforms
+  ShaderProgram *programs[2] = { display.lightFieldShader, display.interlaceShader };
+  for (int p = 0; p < 2 && programs[p]; p++)
+  {
+    if (p == 0 && display.calibratedShader)
+      continue;
+    ShaderProgram *lightFieldShader = programs[p];
+    lightFieldShader->use();
+    lightFieldShader->setUniform("pitch", display.pitch);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("tilt", hpc_GetDevicePropertyTilt(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("tilt", display.tilt);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("center",
-                               hpc_GetDevicePropertyCenter(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("center", display.center);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("invView",
-                               hpc_GetDevicePropertyInvView(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("invView", display.invView);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("quiltInvert", 0);
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("quiltInvert", 0);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("subp", hpc_GetDevicePropertySubp(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("subp", display.subp);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("ri", hpc_GetDevicePropertyRi(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("ri", display.ri);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("bi", hpc_GetDevicePropertyBi(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("bi", display.bi);
+    glCheckError(__FILE__, __LINE__);
 
-  lightFieldShader->setUniform("displayAspect",
-                               hpc_GetDevicePropertyDisplayAspect(DEV_INDEX));
-  glCheckError(__FILE__, __LINE__);
-  lightFieldShader->setUniform("quiltAspect",
-                               hpc_GetDevicePropertyDisplayAspect(DEV_INDEX));
+    lightFieldShader->setUniform("displayAspect", display.displayAspect);
+    glCheckError(__FILE__, __LINE__);
+    lightFieldShader->setUniform("quiltAspect", display.displayAspect);
+    glCheckError(__FILE__, __LINE__);
+    lightFieldShader->unuse();
+    glCheckError(__FILE__, __LINE__);
+  }
+}
+
+// the compute interlacer of a display, with the light field shader's
+// uniforms set by loadCalibrationIntoShader() and passQuiltSettingsToShader()
+void HoloPlayContext::loadInterlaceShader(LKGDisplay &display)
+{
+  Shader computeShader("../interlace_compute.glsl", GL_COMPUTE_SHADER);
+  if (computeShader.checkCompileError("../interlace_compute.glsl") && display.interlaceShader)
+    return; // keeps the one loaded before
+  delete display.interlaceShader;
+  display.interlaceShader = new ShaderProgram({computeShader});
+  display.interlaceShader->use();
+  display.interlaceShader->setUniform("screenTex", 0);
+  display.interlaceShader->setUniform("panel", 0); // image unit
+  display.interlaceShader->unuse();
   glCheckError(__FILE__, __LINE__);
-  lightFieldShader->unuse();
+}
+
+// the image the compute interlacer writes, at the framebuffer size, and the
+// framebuffer it is blitted to the window from. Call in display's context
+void HoloPlayContext::setupInterlacedTexture(LKGDisplay &display)
+{
+  glfwGetFramebufferSize(display.window, &display.interlacedWidth, &display.interlacedHeight);
+  glGenTextures(1, &display.interlacedTexture);
+  glBindTexture(GL_TEXTURE_2D, display.interlacedTexture);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, display.interlacedWidth, display.interlacedHeight, 0,
+               GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gpuMemory.addTexture("interlaced panel", display.interlacedTexture, GL_RGBA8,
+                       display.interlacedWidth, display.interlacedHeight);
+
+  glGenFramebuffers(1, &display.interlacedFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, display.interlacedFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         display.interlacedTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    cout << "[Error] the interlaced panel framebuffer is incomplete" << endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
   glCheckError(__FILE__, __LINE__);
 }
 
@@ -893,40 +2452,581 @@ void HoloPlayContext::loadCalibrationIntoShader()
 void HoloPlayContext::release()
 {
   cout << "[Info] HoloPlay Context releasing" << endl;
+  glfwMakeContextCurrent(window);
+  stopCapture();
+  // decodes in flight use the workers
+  delete quiltSource;
+  quiltSource = NULL;
+  for (size_t i = 1; i < displays.size(); i++)
+  {
+    // VAOs belong to the context they were created in
+    glfwMakeContextCurrent(displays[i].window);
+    glDeleteVertexArrays(1, &displays[i].VAO);
+    glDeleteFramebuffers(1, &displays[i].interlacedFBO);
+  }
+  glfwMakeContextCurrent(window);
+  glDeleteFramebuffers(1, &displays[0].interlacedFBO);
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    delete displays[i].lightFieldShader;
+    delete displays[i].debugShader;
+  }
+  lightFieldShader = NULL;
+
   glDeleteVertexArrays(1, &VAO);
+  gpuMemory.remove(GpuMemoryRegistry::Buffer, VBO);
   glDeleteBuffers(1, &VBO);
-  glDeleteFramebuffers(1, &FBO);
-  glDeleteTextures(1, &quiltTexture);
-  delete lightFieldShader;
+  for (size_t i = 0; i < rateReadbacks.size(); i++)
+  {
+    glDeleteSync(rateReadbacks[i].fence);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, rateReadbacks[i].buffer);
+    glDeleteBuffers(1, &rateReadbacks[i].buffer);
+  }
+  rateReadbacks.clear();
+  for (size_t q = 0; q < quilts.size(); q++)
+  {
+    gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].quiltTexture);
+    gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].hitAttachments[0]);
+    gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].hitAttachments[1]);
+    glDeleteFramebuffers(1, &quilts[q].FBO);
+    glDeleteTextures(1, &quilts[q].quiltTexture);
+    glDeleteFramebuffers(1, &quilts[q].hitFBO);
+    glDeleteTextures(2, quilts[q].hitAttachments);
+    if (quilts[q].keyTexture)
+    {
+      gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].keyTexture);
+      glDeleteFramebuffers(1, &quilts[q].keyFBO);
+      glDeleteTextures(1, &quilts[q].keyTexture);
+    }
+    if (quilts[q].rateTexture)
+    {
+      gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].rateTexture);
+      gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].coarseTexture);
+      glDeleteFramebuffers(1, &quilts[q].rateFBO);
+      glDeleteFramebuffers(1, &quilts[q].coarseFBO);
+      glDeleteTextures(1, &quilts[q].rateTexture);
+      glDeleteTextures(1, &quilts[q].coarseTexture);
+    }
+    if (quilts[q].viewArray)
+    {
+      gpuMemory.remove(GpuMemoryRegistry::Texture, quilts[q].viewArray);
+      glDeleteFramebuffers(GLsizei(quilts[q].layerFBOs.size()), &quilts[q].layerFBOs[0]);
+      glDeleteTextures(1, &quilts[q].viewArray);
+    }
+    if (quilts[q].depthBuffer)
+    {
+      gpuMemory.remove(GpuMemoryRegistry::Renderbuffer, quilts[q].depthBuffer);
+      glDeleteRenderbuffers(1, &quilts[q].depthBuffer);
+    }
+  }
   delete blitShader;
-
-  glDeleteFramebuffers(1, &hitFBO);
-  glDeleteTextures(2, hitAttachments);
   delete sdfShader;
+  delete interpolateShader;
+  interpolateShader = NULL;
+  delete classifyShader;
+  classifyShader = NULL;
+  delete directHitShader;
+  directHitShader = NULL;
+  delete directShader;
+  directShader = NULL;
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    if (!displays[i].directFBO)
+      continue;
+    for (int a = 0; a < 6; a++)
+      gpuMemory.remove(GpuMemoryRegistry::Texture, displays[i].directHits[a]);
+    glDeleteFramebuffers(1, &displays[i].directFBO);
+    glDeleteTextures(6, displays[i].directHits);
+  }
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    delete displays[i].interlaceShader;
+    displays[i].interlaceShader = NULL;
+    if (!displays[i].interlacedTexture)
+      continue;
+    gpuMemory.remove(GpuMemoryRegistry::Texture, displays[i].interlacedTexture);
+    glDeleteTextures(1, &displays[i].interlacedTexture);
+  }
+  delete resolution;
+  resolution = NULL;
+  delete tracker;
+  tracker = NULL;
+
+  // no decode task may outlive the loader it hands uploads to
+  delete workers;
+  workers = NULL;
+  delete textureLoader;
+  textureLoader = NULL;
+  GLuint customTextureId = customTexture.id();
+  if (customTextureId)
+  {
+    gpuMemory.remove(GpuMemoryRegistry::Texture, customTextureId);
+    glDeleteTextures(1, &customTextureId);
+  }
+  gpuMemory.remove(GpuMemoryRegistry::Texture, placeholderTexture);
+  glDeleteTextures(1, &placeholderTexture);
+  if (skyMap)
+  {
+    gpuMemory.remove(GpuMemoryRegistry::Texture, skyMap);
+    glDeleteTextures(1, &skyMap);
+  }
+}
+
+// replaces the scene with pre-rendered quilts (image files or a light field
+// container) when options.playback is set, with quilts rendered by other
+// processes when options.sharedQuilts is, or with views synthesized from a
+// color and depth image when options.rgbdColor is.
+// All displays then show the source through quilts[0]
+void HoloPlayContext::setupQuiltSource()
+{
+  if (options.playback.empty() && options.sharedQuilts.empty() &&
+      options.rgbdColor.empty())
+    return;
+
+  const QuiltTarget &target = quilts[0];
+  QuiltLayout fallback;
+  fallback.width = target.qs_width;
+  fallback.height = target.qs_height;
+  fallback.columns = target.qs_columns;
+  fallback.rows = target.qs_rows;
+  fallback.views = target.qs_totalViews;
+  if (options.playback.empty() && options.sharedQuilts.empty())
+  {
+    try
+    {
+      quiltSource = new RgbdQuiltSource(
+          options.rgbdColor, options.rgbdDepth, fallback, options.rgbd, *workers,
+          opengl_version_header + hpc_LightfieldVertShaderGLSL, VAO, &gpuMemory);
+    }
+    catch (const std::runtime_error &e)
+    {
+      cout << "[Error] " << e.what() << ", rendering the scene instead" << endl;
+      return;
+    }
+  }
+  else if (options.playback.empty())
+  {
+    vector<string> names;
+    size_t start = 0;
+    while (start <= options.sharedQuilts.size())
+    {
+      size_t comma = options.sharedQuilts.find(',', start);
+      if (comma == string::npos)
+        comma = options.sharedQuilts.size();
+      if (comma > start)
+        names.push_back(options.sharedQuilts.substr(start, comma - start));
+      start = comma + 1;
+    }
+    if (names.empty())
+      return;
+    quiltSource = new SharedQuiltSource(names, target.qs_width, target.qs_height, fallback,
+                                        &gpuMemory);
+  }
+  else
+  {
+    try
+    {
+      quiltSource = new QuiltPlayer(options.playback, *workers, options.playbackFps,
+                                    fallback, 6, &gpuMemory);
+    }
+    catch (const std::runtime_error &e)
+    {
+      cout << "[Error] " << e.what() << ", rendering the scene instead" << endl;
+      return;
+    }
+  }
+
+  // the calibrated shaders have the rendered quilts' view layout compiled
+  // in, sources are plain grids
+  const bool relayout = options.viewLayers || options.viewWeighting.enabled();
+  if (relayout)
+    reloadCalibratedShaders();
+  if (!passSourceLayoutToShaders())
+  {
+    delete quiltSource;
+    quiltSource = NULL;
+    if (relayout)
+      reloadCalibratedShaders();
+    return;
+  }
+  sourceStartTime = glfwGetTime();
+}
+
+// the calibrated light field shaders again, for the view layout of what they
+// show now
+void HoloPlayContext::reloadCalibratedShaders()
+{
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    LKGDisplay &display = displays[i];
+    if (!display.calibratedShader)
+      continue;
+    selectQuilt(display.quiltIndex);
+    loadLightFieldShaders(display);
+    loadCalibrationIntoShader(display);
+    if (!quiltSource)
+      passQuiltSettingsToShader(display);
+  }
+  lightFieldShader = displays[0].lightFieldShader;
+  selectQuilt(0);
+}
+
+bool HoloPlayContext::passSourceLayoutToShaders()
+{
+  const QuiltTarget &target = quilts[0];
+  QuiltLayout layout = quiltSource->layout();
+  int textureWidth = target.qs_width;
+  int textureHeight = target.qs_height;
+  if (quiltSource->texture())
+  {
+    textureWidth = layout.width;
+    textureHeight = layout.height;
+  }
+  else if (layout.width > target.qs_width || layout.height > target.qs_height)
+  {
+    cout << "[Error] the " << layout.width << "x" << layout.height
+         << " quilts don't fit in the " << target.qs_width << "x"
+         << target.qs_height << " quilt texture, use a larger --preset" << endl;
+    return false;
+  }
+  for (size_t i = 0; i < displays.size(); i++)
+    passQuiltLayoutToShader(displays[i], layout, textureWidth, textureHeight);
+  sourceLayout = layout;
+  return true;
+}
+
+// renders every quilt's views at scale times their full size, into the lower
+// left of the same textures, and tells the light field shaders how much of
+// the quilt is used
+void HoloPlayContext::applyRenderScale(float scale)
+{
+  for (size_t q = 0; q < quilts.size(); q++)
+  {
+    selectQuilt(int(q));
+    int viewWidth = int(float(qs_width / qs_columns) * scale);
+    int viewHeight = int(float(qs_height / qs_rows) * scale);
+    renderWidth = qs_columns * (viewWidth > 0 ? viewWidth : 1);
+    renderHeight = qs_rows * (viewHeight > 0 ? viewHeight : 1);
+    layoutViews();
+    storeQuilt(int(q));
+  }
+  for (size_t i = 0; i < displays.size(); i++)
+  {
+    selectQuilt(displays[i].quiltIndex);
+    passQuiltSettingsToShader(displays[i]);
+  }
+  selectQuilt(0);
+  cout << "[Info] rendering the quilts at " << int(scale * 100.0f + 0.5f)
+       << "% (GPU " << resolution->gpuMs() << " ms for a budget of "
+       << options.renderBudgetMs << " ms)" << endl;
+}
+
+// records the primary display's quilt, and its interlaced frame if asked to,
+// to files named after options.capturePath
+void HoloPlayContext::startCapture()
+{
+  FrameCapture::Format format;
+  if (!FrameCapture::parseFormat(options.captureFormat, format))
+  {
+    cout << "[Error] unknown capture format " << options.captureFormat
+         << ", use png, raw or y4m" << endl;
+    return;
+  }
+  string base = options.capturePath.empty() ? "capture" : options.capturePath;
+  captureTake++;
+  if (captureTake > 1)
+    base += "-" + to_string(captureTake);
+
+  const QuiltTarget &quilt = quilts[size_t(quiltShownOn(displays[0]))];
+  const bool colorQuilt = !options.directRender && !options.fusedRender;
+  if (colorQuilt)
+    quiltCapture = new FrameCapture(base + "-quilt", format, quilt.qs_width,
+                                    quilt.qs_height, options.captureFps, &gpuMemory);
+  else
+    cout << "[Info] there is no color quilt to capture, capturing the screen" << endl;
+  if (options.captureScreen || !colorQuilt)
+  {
+    int width, height;
+    glfwGetFramebufferSize(window, &width, &height);
+    screenCapture = new FrameCapture(base + "-screen", format, width, height,
+                                     options.captureFps, &gpuMemory);
+  }
+}
+
+void HoloPlayContext::stopCapture()
+{
+  delete quiltCapture;
+  quiltCapture = NULL;
+  delete screenCapture;
+  screenCapture = NULL;
+}
+
+// the camera of a view of the current quilt for renderScene() overrides
+// that draw geometry, see the README. Every view looks through the same
+// rectangle of the focal plane, which lies where currentViewMatrix puts the
+// camera, from a point moved sideways along the view cone
+void HoloPlayContext::setupVirtualCameraForView(int currentViewIndex,
+                                                glm::mat4 currentViewMatrix)
+{
+  // the aspect of the displays showing the quilt, not of the main window
+  setupVirtualCamera(float(currentViewIndex) / (float(qs_totalViews) - 1.0f),
+                     quilts[size_t(currentQuilt)].aspect, currentViewMatrix);
+}
+
+void HoloPlayContext::setupVirtualCamera(float t, float aspectRatio,
+                                         glm::mat4 currentViewMatrix)
+{
+  // The standard model Looking Glass screen is roughly 4.75" vertically. If we
+  // assume the average viewing distance for a user sitting at their desk is
+  // about 36", our field of view should be about 14 degrees
+  const float fov = glm::radians(14.0f);
+  float cameraDistance = -cameraSize / tan(fov / 2.0f);
+
+  // start at -viewCone * 0.5 and go up to viewCone * 0.5
+  float offsetAngle = (t - 0.5f) * glm::radians(viewCone);
+  float offset = cameraDistance * tan(offsetAngle);
+
+  // move the camera in its own space, so it slides along the focal plane
+  // whichever way currentViewMatrix turns it
+  viewMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, cameraDistance)) *
+               currentViewMatrix;
+
+  projectionMatrix = glm::perspective(fov, aspectRatio, 0.1f, 100.0f);
+  // shear the frustum back onto the focal plane rectangle
+  projectionMatrix[2][0] += offset / (cameraSize * aspectRatio);
 }
 
-void HoloPlayContext::drawLightField()
+void HoloPlayContext::drawLightField(const LKGDisplay &display)
 {
   // bind quilt texture
   glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, quiltTexture);
+  GLuint shown = quiltSource ? quiltSource->texture() : 0;
+  if (!shown)
+    shown = quilts[size_t(quiltShownOn(display))].quiltTexture;
+  glBindTexture(GL_TEXTURE_2D, shown);
+  if (display.interlaceShader && debug == 0)
+  {
+    interlace(display.interlaceShader, shown, display.interlacedTexture,
+              display.interlacedWidth, display.interlacedHeight);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, display.interlacedFBO);
+    glBlitFramebuffer(0, 0, display.interlacedWidth, display.interlacedHeight, 0, 0,
+                      display.interlacedWidth, display.interlacedHeight,
+                      GL_COLOR_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+    return;
+  }
+  if (options.fusedRender)
+  {
+    // what renderScene() would give the color pass
+    const QuiltTarget &quilt = quilts[size_t(quiltShownOn(display))];
+    ShaderProgram *shader = display.lightFieldShader;
+    shader->use();
+    for (GLuint i = 0; i < 2; i++)
+    {
+      glActiveTexture(GL_TEXTURE0 + i);
+      glBindTexture(GL_TEXTURE_2D, quilt.hitAttachments[i]);
+    }
+    glActiveTexture(GL_TEXTURE0 + 2);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glActiveTexture(GL_TEXTURE0 + 3);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, skyMap);
+    glActiveTexture(GL_TEXTURE0);
+    shader->setUniform("posMatTex", 0);
+    shader->setUniform("normalTex", 1);
+    shader->setUniform("customTex", 2);
+    shader->setUniform("skyMap", 3);
+    shader->setUniform("hasSkyMap", skyMap ? 1 : 0);
+    shader->setUniform("skyLod", skyLod);
+    shader->setUniform("iTime", time);
+    shader->setUniform("renderSwitch", renderSwitch);
+  }
+  if (!quiltSource && options.viewLayers)
+  {
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, quilts[size_t(quiltShownOn(display))].viewArray);
+    glActiveTexture(GL_TEXTURE0);
+  }
 
   // bind vao
-  glBindVertexArray(VAO);
+  glBindVertexArray(display.VAO);
 
   // use the shader and draw
-  lightFieldShader->use();
+  ShaderProgram *shader = lightFieldDebug && display.debugShader ? display.debugShader
+                                                                 : display.lightFieldShader;
+  shader->use();
   glDrawArrays(GL_TRIANGLES, 0, 6);
 
   // clean up
   glBindVertexArray(0);
-  lightFieldShader->unuse();
+  shader->unuse();
+}
+
+// interlaces quilt into image (RGBA8, width x height) with a compute
+// interlacer, ready to be read as a texture or through a framebuffer
+void HoloPlayContext::interlace(ShaderProgram *shader, GLuint quilt, GLuint image,
+                                int width, int height)
+{
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, quilt);
+  glBindImageTexture(0, image, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+  shader->use();
+  // 16x16 workgroups, see interlace_compute.glsl
+  glDispatchCompute(GLuint((width + 15) / 16), GLuint((height + 15) / 16), 1);
+  shader->unuse();
+  glMemoryBarrier(GL_FRAMEBUFFER_BARRIER_BIT | GL_TEXTURE_FETCH_BARRIER_BIT);
+  glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA8);
+}
+
+// interlaces a quilt of each device type's preset onto a panel of its size
+// with the primary display's calibration, once with its light field shader
+// and once with the compute interlacer, and prints the GPU time of each.
+// Blocks until the timings are back
+void HoloPlayContext::benchmarkInterlacers()
+{
+  LKGDisplay &display = displays[0];
+  if (!display.interlaceShader)
+  {
+    cout << "[Warning] start with --interlacer compute to compare the interlacers" << endl;
+    return;
+  }
+  struct DeviceType
+  {
+    const char *name;
+    int width, height; // of the panel
+    int preset;        // as presetForDevice() picks it
+  };
+  static const DeviceType types[3] = {
+      {"standard", 2560, 1600, 0}, {"pro", 3840, 2160, 1}, {"8k", 7680, 4320, 2}};
+  static const int RUNS = 20;
+
+  size_t budget = 0, allocated = 0;
+  const bool budgeted = gpuBudget(budget, allocated);
+  const size_t room = budget > allocated ? budget - allocated : 0;
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  setLightFieldDebug(0);
+  GLuint query;
+  glGenQueries(1, &query);
+  for (int t = 0; t < 3; t++)
+  {
+    const DeviceType &type = types[t];
+    setupQuiltSettings(type.preset);
+
+    // a quilt and a panel to draw on, RGBA8: the interlacers only sample
+    // color, and 8 bits is what the panel shows. Their contents don't matter
+    // for the timings
+    const int widths[2] = { qs_width, type.width };
+    const int heights[2] = { qs_height, type.height };
+    const size_t bytes = GpuMemoryRegistry::textureBytes(GL_RGBA8, qs_width, qs_height) +
+                         GpuMemoryRegistry::textureBytes(GL_RGBA8, type.width, type.height);
+    if (budgeted && bytes > room)
+    {
+      cout << "[Warning] " << type.name << ": a " << qs_width << "x" << qs_height
+           << " quilt and its panel need " << GpuMemoryRegistry::formatBytes(bytes)
+           << ", over the " << GpuMemoryRegistry::formatBytes(room)
+           << " left of the GPU memory budget, skipped" << endl;
+      continue;
+    }
+    // so an error queued earlier isn't taken for running out of memory
+    while (glGetError() != GL_NO_ERROR)
+      ;
+    GLuint textures[2], fbos[2];
+    glGenTextures(2, textures);
+    glGenFramebuffers(2, fbos);
+    for (int i = 0; i < 2; i++)
+    {
+      glBindTexture(GL_TEXTURE_2D, textures[i]);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+      glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, widths[i], heights[i], 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, NULL);
+      glBindFramebuffer(GL_FRAMEBUFFER, fbos[i]);
+      glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, textures[i], 0);
+    }
+    glBindTexture(GL_TEXTURE_2D, 0);
+    bool outOfMemory = false;
+    for (GLenum error; (error = glGetError()) != GL_NO_ERROR;)
+      outOfMemory = outOfMemory || error == GL_OUT_OF_MEMORY;
+    if (outOfMemory)
+    {
+      cout << "[Warning] " << type.name << ": not enough memory for a " << qs_width << "x"
+           << qs_height << " quilt, skipped" << endl;
+      glDeleteFramebuffers(2, fbos);
+      glDeleteTextures(2, textures);
+      continue;
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, fbos[0]);
+    glViewport(0, 0, qs_width, qs_height);
+    glClearColor(0.5f, 0.5f, 0.5f, 1.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+    QuiltLayout layout;
+    layout.width = qs_width;
+    layout.height = qs_height;
+    layout.columns = qs_columns;
+    layout.rows = qs_rows;
+    layout.views = qs_totalViews;
+    passQuiltLayoutToShader(display, layout, qs_width, qs_height);
+
+    double ms[2];
+    for (int method = 0; method < 2; method++)
+    {
+      // one untimed run so compilation and first touches aren't counted
+      for (int run = 0; run <= RUNS; run++)
+      {
+        if (run == 1)
+          glBeginQuery(GL_TIME_ELAPSED, query);
+        if (method == 0)
+        {
+          glBindFramebuffer(GL_FRAMEBUFFER, fbos[1]);
+          glViewport(0, 0, type.width, type.height);
+          glActiveTexture(GL_TEXTURE0);
+          glBindTexture(GL_TEXTURE_2D, textures[0]);
+          glBindVertexArray(VAO);
+          display.lightFieldShader->use();
+          glDrawArrays(GL_TRIANGLES, 0, 6);
+          display.lightFieldShader->unuse();
+          glBindVertexArray(0);
+        }
+        else
+        {
+          interlace(display.interlaceShader, textures[0], textures[1], type.width,
+                    type.height);
+        }
+      }
+      glEndQuery(GL_TIME_ELAPSED);
+      GLuint64 nanoseconds = 0;
+      glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+      ms[method] = double(nanoseconds) / 1.0e6 / RUNS;
+    }
+    cout << "[Info] interlacing a " << qs_width << "x" << qs_height << " quilt onto a "
+         << type.name << " panel (" << type.width << "x" << type.height
+         << "): fragment " << ms[0] << " ms, compute " << ms[1] << " ms" << endl;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    glDeleteFramebuffers(2, fbos);
+    glDeleteTextures(2, textures);
+  }
+  glDeleteQueries(1, &query);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  // back to what the displays show
+  setLightFieldDebug(debug);
+  selectQuilt(display.quiltIndex);
+  if (quiltSource)
+    passSourceLayoutToShaders();
+  else
+    passQuiltSettingsToShader(display);
+  selectQuilt(0);
 }
 
 // Other helper functions
 // =======================================================================
 // open window at looking glass monitor
-GLFWwindow* HoloPlayContext::openWindowOnLKG()
+GLFWwindow* HoloPlayContext::openWindowOnLKG(LKGDisplay &display,
+                                             GLFWwindow *share)
 {
   // Load GLFW and Create a Window
   glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
@@ -938,18 +3038,16 @@ GLFWwindow* HoloPlayContext::openWindowOnLKG()
   glfwWindowHint(GLFW_DECORATED, false);
   glfwWindowHint(GLFW_TRANSPARENT_FRAMEBUFFER, true);
 
-  // get the window size / coordinates
-  win_w = hpc_GetDevicePropertyScreenW(DEV_INDEX);
-  win_h = hpc_GetDevicePropertyScreenH(DEV_INDEX);
-  win_x = hpc_GetDevicePropertyWinX(DEV_INDEX);
-  win_y = hpc_GetDevicePropertyWinY(DEV_INDEX);
-  cout << "[Info] window opened at (" << win_x << ", " << win_y << "), size: ("
-       << win_w << ", " << win_h << ")" << endl;
+  // the window size / coordinates were read in setupDisplays()
+  cout << "[Info] window opened at (" << display.win_x << ", " << display.win_y
+       << "), size: (" << display.win_w << ", " << display.win_h << ")" << endl;
   // open the window
-  auto mWindow =
-      glfwCreateWindow(win_w, win_h, "Looking Glass Output", NULL, NULL);
+  auto mWindow = glfwCreateWindow(display.win_w, display.win_h,
+                                  "Looking Glass Output", NULL, share);
+  if (!mWindow)
+    return NULL;
 
-  glfwSetWindowPos(mWindow, win_x, win_y);
+  glfwSetWindowPos(mWindow, display.win_x, display.win_y);
 
   return mWindow;
 }
@@ -14,17 +14,188 @@
 #include <glm/gtx/matrix_operation.hpp>
 #include <string>
 #include <vector>
+#include "GpuMemory.hpp"
 #include "HoloPlayCore.h"
+#include "InputQueue.hpp"
+#include "ProgramCache.hpp"
+#include "QuiltSource.hpp"
+#include "ResolutionController.hpp"
+#include "RgbdQuiltSource.hpp"
 #include "Shader.hpp"
+#include "TextureLoader.hpp"
+#include "ThreadPool.hpp"
+#include "ViewWeighting.hpp"
+#include "ViewerTracker.hpp"
+
+class ButtonPoller;
+class FrameCapture;
 
 struct GLFWwindow;
 struct GLFWmonitor;
 struct hpc_Uniforms_t;
 
+// settings that have to be known before the context is initialized
+struct HoloPlayOptions
+{
+    int firstDevice = 0;  // index of the first Looking Glass to drive
+    int maxDisplays = -1; // number of Looking Glasses to drive, -1 for all
+    int quiltPreset = 1;  // quilt preset for every display (see
+                          // setupQuiltSettings), -1 picks one per device type
+    float buttonPollRate = 30.0f; // hardware button polls per second,
+                                  // 0 disables the button poller
+    bool compressTextures = false; // block compress loaded textures
+    std::string skybox;            // directory with right/left/top/bottom/
+                                   // front/back.jpg, empty for the
+                                   // procedural sky
+    int gpuBudgetMB = 0;           // GPU memory the app may use, 0 for
+                                   // what the driver reports as available
+                                   // (no limit if it reports nothing)
+    bool downgradePresets = true;  // use smaller quilt presets when over
+                                   // budget instead of refusing to start
+    std::string capturePath;       // record from the start to files named
+                                   // after this, C toggles recording anyway
+    std::string captureFormat = "png"; // png, raw or y4m
+    bool captureScreen = false;    // also record the interlaced frame
+    int captureFrames = 0;         // stop recording after this many, 0 never
+    int captureFps = 30;           // frame rate written into y4m streams
+    std::string playback;          // quilt image, numbered sequence (printf
+                                   // pattern) or light field container to
+                                   // show instead of rendering the scene
+    float playbackFps = 0.0f;      // 0: stored in the container, or 30
+    std::string sharedQuilts;      // comma separated shared memory rings to
+                                   // show quilts from, see SharedQuilt.hpp
+    std::string rgbdColor;         // color image to synthesize the quilt
+                                   // from, see RgbdQuiltSource
+    std::string rgbdDepth;         // its depth map, empty if it is the
+                                   // right half of the color image
+    RgbdSettings rgbd;
+    int interpolateStep = 1;       // render every n-th view and interpolate
+                                   // the ones between, 1 renders them all
+    bool interpolateFillBackground = true; // fill disocclusions from the far
+                                   // side of the edge, else stretch the
+                                   // near surface over them
+    float renderBudgetMs = 0.0f;   // GPU time rendering the quilts may take
+                                   // per frame, the resolution is scaled to
+                                   // fit. 0 always renders at full size
+    float minRenderScale = 0.5f;   // lowest fraction of the view size
+    ViewWeighting viewWeighting;   // smaller views towards the edges of the
+                                   // view cone
+    bool viewLayers = false;       // render every view into a layer of a 2D
+                                   // texture array instead of a quilt tile
+    float adaptiveShading = 0.0f;  // variance of the normals under which a
+                                   // tile is shaded at a quarter of the
+                                   // pixels, 0 shades every pixel
+    bool directRender = false;     // march every subpixel of the panels
+                                   // instead of rendering a quilt
+    bool fusedRender = false;      // shade the hit buffers in the light
+                                   // field shader, no color quilt
+    bool computeInterlace = false; // interlace with a compute shader into
+                                   // an image, if the GL supports them
+    int trackPort = 0;             // UDP port on this machine an eye tracker
+                                   // sends to, see ViewerTracker. 0: none
+    std::string trackFile;         // eye positions to replay instead
+    int trackMargin = 1;           // views rendered beyond the ones the
+                                   // tracked eyes see, on each side
+    float trackFocus = 0.6f;       // meters in front of the display where
+                                   // its views converge
+    bool meshScene = false;        // render SampleScene's meshes instead of
+                                   // the SDF scene, no hit buffers
+    int meshObjects = 64;          // objects in the mesh scene
+    // GPU memory a scene allocates once the context has set up, with views
+    // and viewHeight the most of any quilt. Counted against the budget
+    // before the quilts are allocated; set by the scene, NULL for none
+    size_t (*sceneGpuBytes)(const HoloPlayOptions &options, int views, int viewHeight,
+                            float cameraSize) = NULL;
+    bool textureSpaceShading = false; // light the meshes once per frame into
+                                   // an atlas the views sample, see
+                                   // SampleScene
+    bool meshTransformPerView = false; // skin and transform the meshes in
+                                   // every view instead of once per frame
+    bool gpuCulling = false;       // cull the meshes and write the draws of
+                                   // every view on the GPU, one indirect
+                                   // multi-draw for all views (GL 4.3)
+};
+
+// one quilt layout and the resources rendered for it. Displays that share a
+// preset, view cone and aspect see exactly the same views, so they sample the
+// same quilt and the scene is only rendered once for all of them
+struct QuiltTarget
+{
+    int preset;
+    float viewCone;
+    float aspect;
+    int qs_width;
+    int qs_height;
+    int qs_rows;
+    int qs_columns;
+    int qs_totalViews;
+    GLuint quiltTexture;
+    GLuint FBO;
+    GLuint hitFBO;
+    GLuint hitAttachments[2];
+    GLuint keyTexture; // key views when interpolating, 0 otherwise
+    GLuint keyFBO;
+    int renderWidth;   // part of the quilt rendered into, from its lower
+    int renderHeight;  // left corner, see ResolutionController
+    std::vector<glm::ivec4> viewRects; // x, y, width, height in pixels of
+                       // every view, empty if they all share one tile size
+    GLuint viewArray;  // one layer per view when rendering into layers,
+                       // 0 otherwise
+    std::vector<GLuint> layerFBOs; // one per layer of viewArray
+    GLuint rateTexture; // per tile of the hit buffers, 1 where it is flat
+    GLuint rateFBO;     // enough to shade coarsely. 0 without adaptive shading
+    GLuint coarseTexture; // flat tiles shaded at half the resolution
+    GLuint coarseFBO;
+    GLuint depthBuffer; // of FBO for the mesh scene, 0 for the SDF scene
+};
+
+// everything needed to present on one Looking Glass. Every window after the
+// first shares the first window's GL context, so textures, buffers and
+// programs are shared while VAOs (container objects) are kept per window
+struct LKGDisplay
+{
+    int devIndex;     // HoloPlay Core device index
+    GLFWwindow *window;
+    int win_w;
+    int win_h;
+    int win_x;
+    int win_y;
+    int quiltIndex;   // index into HoloPlayContext::quilts
+    float widthMeters; // of the screen, from its calibrated DPI
+    // its calibration, read once in setupDisplays(): HoloPlay Core can't be
+    // queried while the button poller runs
+    float pitch;
+    float tilt;
+    float center;
+    float subp;
+    float displayAspect;
+    int invView;
+    int ri;
+    int bi;
+    std::string serial; // "" when the device has none
+    GLuint VAO;       // fullscreen quad VAO created in this window's context
+    ShaderProgram *lightFieldShader; // holds this device's calibration
+    bool calibratedShader; // it is compiled in, there are no calibration
+                           // uniforms
+    ShaderProgram *debugShader; // the calibrated shader's debug view, NULL
+                           // with the generic one
+    GLuint directFBO; // subpixel hits when rendering directly, in the main
+    GLuint directHits[6]; // context: position and material of subpixels 0-2,
+    int directWidth;      // then their normals. 0 when rendering a quilt
+    int directHeight;
+    ShaderProgram *interlaceShader; // compute interlacer, NULL when the
+                          // light field shader interlaces
+    GLuint interlacedTexture; // what it writes, at the framebuffer size
+    GLuint interlacedFBO; // reads it, in this window's context
+    int interlacedWidth;
+    int interlacedHeight;
+};
+
 class HoloPlayContext
 {
 public:
-    HoloPlayContext(bool capture_mouse = true);
+    HoloPlayContext(bool capture_mouse = true,
+                    const HoloPlayOptions &options = HoloPlayOptions());
     virtual ~HoloPlayContext();
 
     static HoloPlayContext &getInstance();
@@ -63,6 +234,15 @@ public:
                                  double xoffset,
                                  double yoffset);
     virtual void key_callback(GLFWwindow* window, int key, int scancode, int action, int mods);
+    virtual void button_callback(int device, int button, int action); // Looking Glass
+                                                   // hardware buttons, action is
+                                                   // GLFW_PRESS or GLFW_RELEASE
+
+    // events from the GLFW callbacks and the button poller, drained by run()
+    InputQueue &getInputQueue() { return inputQueue; }
+
+    // the GPU allocations made so far, printed at startup and with M
+    const GpuMemoryRegistry &getGpuMemory() const { return gpuMemory; }
 
 private:
     enum class State
@@ -91,6 +271,13 @@ private:
     bool windowChanged;
     void detectWindowChange();
 
+    InputQueue inputQueue;
+    ButtonPoller *buttonPoller = NULL;
+    std::vector<InputEvent> pendingEvents;
+    bool quitRequested = false; // set by Q, run() exits once dispatch returns
+    void dispatchInputEvents(); // hand queued events to the callbacks
+    void detectWindowChange(LKGDisplay &display);
+
     // storing matrix of each view
     glm::mat4 projectionMatrix = glm::mat4(1.0);
     glm::mat4 viewMatrix = glm::mat4(1.0);
@@ -110,11 +297,17 @@ protected:
 
     bool autoRecompile; // determines whether or not to recompile shaders automatically
 
-    GLuint skyMap; // gl texture id of cubemap for skybox
+    GLuint skyMap = 0;           // gl texture id of cubemap for skybox, 0
+                                 // until skyMapTexture has loaded
+    TextureHandle skyMapTexture;
+    float skyLod = 0.0f;         // mip level the sky is sampled at, higher
+                                 // values give a blurrier (rougher) sky
     
     // lkg related:
-    const int DEV_INDEX = 0; // the index of device we are rendering on,
-                             // default is 0, the first Looking Glass detected
+    HoloPlayOptions options;
+    std::vector<LKGDisplay> displays; // displays[0] owns the main context
+    std::vector<QuiltTarget> quilts;  // one per distinct quilt layout
+    int currentQuilt = 0;             // quilt mirrored in the qs_* members
     float cameraSize = 5;    // size of the holoplay camera,
                              // changeable without limitation
     float viewCone = 40.0;   // view cone of hardware, always around 40
@@ -147,7 +340,117 @@ protected:
     // GLuint positionMaterialAttachment; // RGBA = 4f = 3f (xyz) + 1f (material_id)
     // GLuint normalAttachment; // RGBA, xyz wasting A
     GLuint hitAttachments[2];
-    GLuint texture;
+    GLuint texture; // customTex in color.glsl, placeholderTexture until
+                    // customTexture has finished loading
+
+    // asynchronous resource loading
+    ThreadPool *workers = NULL;           // CPU work off the render thread
+    TextureLoader *textureLoader = NULL;  // decodes on workers, uploads on
+                                          // its own shared context
+    TextureHandle customTexture;
+    GLuint placeholderTexture = 0;        // 1x1 white
+    void updateLoadedTextures();          // swap in textures that finished
+                                          // loading, never blocks
+    GpuMemoryRegistry gpuMemory;          // every allocation worth counting
+
+    // recording, see FrameCapture
+    FrameCapture *quiltCapture = NULL;  // quilt of the primary display
+    FrameCapture *screenCapture = NULL; // interlaced frame of the primary display
+    int captureTake = 0;                // recordings started so far
+    void startCapture();
+    void stopCapture(); // writes the frames still in flight
+
+    // content that replaces renderScene(), drawn through quilts[0]
+    QuiltSource *quiltSource = NULL;
+    double sourceStartTime = 0.0;
+    QuiltLayout sourceLayout = QuiltLayout(); // passed to the shaders last
+    void setupQuiltSource(); // from options, NULL renders the scene
+    bool passSourceLayoutToShaders(); // false if the frames don't fit
+    int quiltShownOn(const LKGDisplay &display) const
+    {
+        return quiltSource ? 0 : display.quiltIndex;
+    }
+
+    // view interpolation: only key views (every keyViewStep-th one and the
+    // last) are rendered into keyTexture, interpolate.glsl warps them into
+    // the views between
+    int keyViewStep = 1;
+    GLuint keyTexture = 0;
+    GLuint keyFBO = 0;
+    ShaderProgram *interpolateShader = NULL;
+    void interpolateViews();          // key views into the whole quilt
+    void measureInterpolationError(); // against every view rendered
+
+    // dynamic resolution: the views are rendered smaller when the GPU falls
+    // behind, into the lower left of the same quilt textures
+    ResolutionController *resolution = NULL;
+    int renderWidth = 0;  // of the quilt in the qs_* members
+    int renderHeight = 0;
+    void applyRenderScale(float scale); // to every quilt and light field shader
+
+    // view weighting: views shrink towards the edges of the view cone and
+    // are packed into the quilt by rect, see ViewWeighting.hpp
+    std::vector<glm::ivec4> viewRects; // of the quilt in the qs_* members
+    void layoutViews(); // viewRects from renderWidth and renderHeight
+
+    // view layers: views rendered into a GL_TEXTURE_2D_ARRAY, the light
+    // field shader samples them by layer
+    GLuint viewArray = 0; // of the quilt in the qs_* members
+    std::vector<GLuint> layerFBOs;
+    void setupViewLayers(); // create viewArray and layerFBOs
+    void copyLayersToQuilt(); // into the quilt texture, for capture
+
+    // adaptive shading: tiles of the hit buffers with one material, even
+    // normals and no depth edge are shaded at half the resolution in both
+    // directions and upsampled, see classify.glsl and color.glsl
+    GLuint rateTexture = 0; // of the quilt in the qs_* members
+    GLuint rateFBO = 0;
+    GLuint coarseTexture = 0;
+    GLuint coarseFBO = 0;
+    ShaderProgram *classifyShader = NULL;
+    void setupAdaptiveShading(); // create the rate and coarse textures
+    void classifyTiles();        // rateTexture from the hit buffers
+
+    // the rates read back for the log without stalling, a few frames later
+    struct RateReadback
+    {
+        GLuint buffer;
+        GLsync fence;
+        int quiltWidth, quiltHeight;
+    };
+    std::vector<RateReadback> rateReadbacks;
+    void reportShadingRates(); // of the readbacks that have finished
+
+    // depth attachment of FBO when the meshes of SampleScene are rendered
+    // instead of the SDF scene
+    GLuint depthBuffer = 0; // of the quilt in the qs_* members
+
+    // direct rendering: no quilt, the scene is marched for every subpixel of
+    // each panel once (direct_hits.glsl) and those hits are shaded every
+    // frame (direct.glsl)
+    ShaderProgram *directHitShader = NULL;
+    ShaderProgram *directShader = NULL;
+    void loadDirectShaders();  // a shader that doesn't compile keeps the last
+    void setupDirectHits(LKGDisplay &display); // its subpixel hit buffers
+    void renderDirectHits();   // of every display
+    void drawDirect(const LKGDisplay &display); // shade into its window
+
+    // viewer tracking: only the views that reach a tracked eye are shaded,
+    // the others are copies of the nearest shaded view
+    ViewerTracker *tracker = NULL;
+    std::vector<bool> trackedViews; // of the quilt in the qs_* members, set
+                          // before it is rendered. Empty shades every view
+    void updateTrackedViews(); // from the displays showing the current quilt
+    void copyUntrackedViews(); // into the views that weren't shaded
+
+    // compute interlacer: interlace_compute.glsl writes the panel into an
+    // image a workgroup tile at a time, staging the quilt texels the tile
+    // reads in shared memory. The image is then blitted to the window
+    void loadInterlaceShader(LKGDisplay &display); // keeps the last on errors
+    void setupInterlacedTexture(LKGDisplay &display); // and its FBO
+    void interlace(ShaderProgram *shader, GLuint quilt, GLuint image,
+                   int width, int height); // dispatch into image
+    void benchmarkInterlacers(); // fragment against compute, per device type
 
     int renderSwitch;
     
@@ -170,19 +473,44 @@ protected:
     // set up functions
     void initialize(); // calls all the functions necessary to set up the
                        // HoloPlay Context
-    GLuint loadCubemap(std::vector<std::string> faces);
-    void setupQuilt(); // create the quiltTexture, VBO, VAO, and FBO
+    TextureHandle loadCubemap(std::vector<std::string> faces); // +x -x +y -y +z -z
+    void setupDisplays();  // pick the devices to drive and group them by
+                           // quilt layout
+    int presetForDevice(int devIndex); // quilt preset used for a device
+    size_t quiltBytes(int preset); // quilt texture and hit buffers of a preset
+    bool gpuBudget(size_t &budget, size_t &allocated); // false if unknown
+    void fitQuiltsToBudget(); // downgrade presets or refuse to start when the
+                              // quilts don't fit in GPU memory
+    void mergeQuilts();       // share quilts that became identical
+    void setupHitBuffers(); // create the hitFBO and its attachments
+    void setupQuilt(); // create the quiltTexture and FBO
+    GLuint createQuadVAO(); // create a VAO for the fullscreen quad VBO in
+                            // the current context
+    void selectQuilt(int index); // mirror quilts[index] into the qs_* members
+    void storeQuilt(int index);  // copy the qs_* members into quilts[index]
     void setupQuiltSettings(
         int preset);                  // Set up the quilt settings according to the preset passed
                                       // 0: 32 views
                                       // 1: 45 views, normally used one
                                       // 2: 45 views for 8k display
                                       // Feel free to customize if you want
-    void passQuiltSettingsToShader(); // assign quilt settings to light-field
-                                      // shader uniforms
-    void loadCalibrationIntoShader(); // assign calibration to light-field shader
-                                      // uniforms
-    void loadLightFieldShaders();     // create and compile light-field shader
+    void passQuiltSettingsToShader(LKGDisplay &display); // assign quilt settings
+                                      // to light-field shader uniforms
+    void passQuiltLayoutToShader(LKGDisplay &display, const QuiltLayout &layout,
+                                 int textureWidth, int textureHeight);
+    void loadCalibrationIntoShader(LKGDisplay &display); // assign calibration
+                                      // to light-field shader uniforms
+    void loadLightFieldShaders(LKGDisplay &display); // create and compile
+                                      // light-field shader
+    std::string calibratedLightFieldSource(const LKGDisplay &display,
+                                           bool debugView); // lightfield.glsl
+                                      // with a device's calibration and the
+                                      // view layout defined
+    ProgramCache programCache;        // specialized light field shaders by
+                                      // device serial
+    void reloadCalibratedShaders(); // after the view layout they show changed
+    void setLightFieldDebug(int value); // toggle quilt debug view on every display
+    int lightFieldDebug = 0;          // what setLightFieldDebug() last set
 
     // release function
     void release(); // Destroys / releases all buffers and objects creating
@@ -193,9 +521,13 @@ protected:
         int currentViewIndex,       // accoriding to the view index and the
                                     // currentViewMatrix
         glm::mat4 currentViewMatrix);
+    // the same for a camera at t along the view cone, 0 for the first view
+    // and 1 for the last, and displays of aspectRatio
+    void setupVirtualCamera(float t, float aspectRatio, glm::mat4 currentViewMatrix);
 
-    void drawLightField();          // Uses the lightfieldShader program,
-                                    // binds the quiltTexture, and draws a fullscreen
+    void drawLightField(const LKGDisplay &display); // Uses the display's
+                                    // lightfieldShader program, binds its
+                                    // quiltTexture, and draws a fullscreen
                                     // quad. Call this after all the views have been
                                     // rendered.
 
@@ -204,7 +536,8 @@ protected:
     GetLookingGlassInfo(); // get all the information of all connected looking
                            // glass retuyrn false if no looking glass detected
     GLFWwindow *
-    openWindowOnLKG(); // open a full-szie window on the looking glass
+    openWindowOnLKG(LKGDisplay &display, GLFWwindow *share); // open a full-size
+                       // window on the looking glass, sharing objects with share
 
     // some get functions
     unsigned int getQuiltTexture() { return quiltTexture; }
@@ -0,0 +1,60 @@
+/**
+ * InputQueue.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_INPUT_QUEUE_HPP
+#define HOLOPLAY_INPUT_QUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <vector>
+
+struct GLFWwindow;
+
+// one keyboard or Looking Glass button event, as seen by the render thread
+struct InputEvent
+{
+    enum Source
+    {
+        Key,         // GLFW key callback
+        DeviceButton // hardware button on a Looking Glass
+    };
+
+    Source source;
+    GLFWwindow *window; // window that received a key, NULL for buttons
+    int device;         // HoloPlay Core device index, -1 for keys
+    int code;           // GLFW key, or button number 0..3
+    int scancode;
+    int action;         // GLFW_PRESS or GLFW_RELEASE (GLFW_REPEAT for keys)
+    int mods;
+};
+
+// Thread safe queue that the GLFW callbacks and the button poller push into
+// and the render thread drains once per frame.
+class InputQueue
+{
+public:
+    void push(const InputEvent &event)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        events.push_back(event);
+    }
+
+    // move every pending event into out, in arrival order
+    void drain(std::vector<InputEvent> &out)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        out.insert(out.end(), events.begin(), events.end());
+        events.clear();
+    }
+
+private:
+    std::mutex mutex;
+    std::deque<InputEvent> events;
+};
+
+#endif // HOLOPLAY_INPUT_QUEUE_HPP
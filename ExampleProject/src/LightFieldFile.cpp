@@ -0,0 +1,529 @@
+/**
+ * LightFieldFile.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "LightFieldFile.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+using namespace std;
+
+static const char MAGIC[4] = {'H', 'P', 'L', 'F'};
+
+// little endian helpers
+// =========================================================
+static void put32(unsigned char *out, uint32_t value)
+{
+  out[0] = (unsigned char)value;
+  out[1] = (unsigned char)(value >> 8);
+  out[2] = (unsigned char)(value >> 16);
+  out[3] = (unsigned char)(value >> 24);
+}
+
+static void put64(unsigned char *out, uint64_t value)
+{
+  put32(out, uint32_t(value));
+  put32(out + 4, uint32_t(value >> 32));
+}
+
+static uint32_t get32(const unsigned char *in)
+{
+  return uint32_t(in[0]) | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16 |
+         uint32_t(in[3]) << 24;
+}
+
+static uint64_t get64(const unsigned char *in)
+{
+  return uint64_t(get32(in)) | uint64_t(get32(in + 4)) << 32;
+}
+
+static uint32_t floatBits(float value)
+{
+  uint32_t bits;
+  memcpy(&bits, &value, sizeof(bits));
+  return bits;
+}
+
+static float bitsFloat(uint32_t bits)
+{
+  float value;
+  memcpy(&value, &bits, sizeof(value));
+  return value;
+}
+
+static void writeHeader(unsigned char *out, const LightFieldHeader &header)
+{
+  memset(out, 0, LightFieldHeader::SIZE);
+  memcpy(out, MAGIC, 4);
+  put32(out + 4, header.version);
+  put32(out + 8, header.flags);
+  put32(out + 12, header.frameCount);
+  put32(out + 16, header.columns);
+  put32(out + 20, header.rows);
+  put32(out + 24, header.views);
+  put32(out + 28, header.viewWidth);
+  put32(out + 32, header.viewHeight);
+  put32(out + 36, header.format);
+  put32(out + 40, floatBits(header.fps));
+  put32(out + 44, floatBits(header.aspect));
+  put64(out + 48, header.indexOffset);
+}
+
+static void readHeader(const unsigned char *in, LightFieldHeader &header)
+{
+  header.version = get32(in + 4);
+  header.flags = get32(in + 8);
+  header.frameCount = get32(in + 12);
+  header.columns = get32(in + 16);
+  header.rows = get32(in + 20);
+  header.views = get32(in + 24);
+  header.viewWidth = get32(in + 28);
+  header.viewHeight = get32(in + 32);
+  header.format = get32(in + 36);
+  header.fps = bitsFloat(get32(in + 40));
+  header.aspect = bitsFloat(get32(in + 44));
+  header.indexOffset = get64(in + 48);
+}
+
+// BC1
+// =========================================================
+static uint16_t pack565(const int *rgb)
+{
+  return uint16_t(((rgb[0] * 31 + 127) / 255) << 11 |
+                  ((rgb[1] * 63 + 127) / 255) << 5 |
+                  ((rgb[2] * 31 + 127) / 255));
+}
+
+static void unpack565(uint16_t color, int *rgb)
+{
+  int r = (color >> 11) & 31, g = (color >> 5) & 63, b = color & 31;
+  rgb[0] = (r << 3) | (r >> 2);
+  rgb[1] = (g << 2) | (g >> 4);
+  rgb[2] = (b << 3) | (b >> 2);
+}
+
+// bounding box end points, inset a little as the extremes are rarely the
+// best fit, then the nearest of the four palette colors per pixel
+void encodeBc1Block(const unsigned char *rgba, size_t stride, unsigned char *block)
+{
+  int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+  for (int y = 0; y < 4; y++)
+  {
+    for (int x = 0; x < 4; x++)
+    {
+      const unsigned char *p = rgba + size_t(y) * stride + size_t(x) * 4;
+      for (int c = 0; c < 3; c++)
+      {
+        lo[c] = min(lo[c], int(p[c]));
+        hi[c] = max(hi[c], int(p[c]));
+      }
+    }
+  }
+  for (int c = 0; c < 3; c++)
+  {
+    int inset = (hi[c] - lo[c]) / 16;
+    lo[c] += inset;
+    hi[c] -= inset;
+  }
+
+  uint16_t c0 = pack565(hi), c1 = pack565(lo);
+  if (c0 < c1)
+    swap(c0, c1);
+  block[0] = (unsigned char)c0;
+  block[1] = (unsigned char)(c0 >> 8);
+  block[2] = (unsigned char)c1;
+  block[3] = (unsigned char)(c1 >> 8);
+  uint32_t indices = 0;
+  if (c0 != c1)
+  {
+    int palette[4][3];
+    unpack565(c0, palette[0]);
+    unpack565(c1, palette[1]);
+    for (int c = 0; c < 3; c++)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    for (int i = 0; i < 16; i++)
+    {
+      const unsigned char *p = rgba + size_t(i / 4) * stride + size_t(i % 4) * 4;
+      int best = 0, bestDistance = 1 << 30;
+      for (int k = 0; k < 4; k++)
+      {
+        int dr = p[0] - palette[k][0], dg = p[1] - palette[k][1], db = p[2] - palette[k][2];
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance < bestDistance)
+        {
+          bestDistance = distance;
+          best = k;
+        }
+      }
+      indices |= uint32_t(best) << (2 * i);
+    }
+  }
+  put32(block + 4, indices);
+}
+
+void decodeBc1Block(const unsigned char *block, unsigned char *rgba, size_t stride)
+{
+  uint16_t c0 = uint16_t(block[0] | block[1] << 8);
+  uint16_t c1 = uint16_t(block[2] | block[3] << 8);
+  int palette[4][4];
+  unpack565(c0, palette[0]);
+  unpack565(c1, palette[1]);
+  palette[0][3] = palette[1][3] = palette[2][3] = 255;
+  for (int c = 0; c < 3; c++)
+  {
+    if (c0 > c1)
+    {
+      palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+      palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+    }
+    else
+    {
+      palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+      palette[3][c] = 0;
+    }
+  }
+  palette[3][3] = c0 > c1 ? 255 : 0;
+
+  uint32_t indices = get32(block + 4);
+  for (int i = 0; i < 16; i++)
+  {
+    const int *color = palette[(indices >> (2 * i)) & 3];
+    unsigned char *p = rgba + size_t(i / 4) * stride + size_t(i % 4) * 4;
+    for (int c = 0; c < 4; c++)
+      p[c] = (unsigned char)color[c];
+  }
+}
+
+// mean squared error per channel between a block of pixels and what a BC1
+// block decodes to
+static float blockError(const unsigned char *rgba, size_t stride, const unsigned char *block)
+{
+  unsigned char decoded[16 * 4];
+  decodeBc1Block(block, decoded, 16);
+  int sum = 0;
+  for (int y = 0; y < 4; y++)
+  {
+    for (int x = 0; x < 4; x++)
+    {
+      const unsigned char *p = rgba + size_t(y) * stride + size_t(x) * 4;
+      const unsigned char *q = decoded + y * 16 + x * 4;
+      for (int c = 0; c < 3; c++)
+        sum += (p[c] - q[c]) * (p[c] - q[c]);
+    }
+  }
+  return float(sum) / 48.0f;
+}
+
+// writer
+// =========================================================
+LightFieldWriter::LightFieldWriter()
+    : file(NULL), position(0), literals(0), copies(0)
+{
+  memset(&header, 0, sizeof(header));
+}
+
+LightFieldWriter::~LightFieldWriter()
+{
+  if (file)
+    fclose(file);
+}
+
+bool LightFieldWriter::open(const std::string &path, int columns, int rows,
+                            int views, int viewWidth, int viewHeight, float fps,
+                            float aspect, std::string &error)
+{
+  if (columns <= 0 || rows <= 0 || views <= 0 || views > columns * rows)
+  {
+    error = "invalid quilt layout";
+    return false;
+  }
+  if (viewWidth <= 0 || viewHeight <= 0 || viewWidth % 4 || viewHeight % 4)
+  {
+    error = "view sizes have to be multiples of 4";
+    return false;
+  }
+  file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    error = "couldn't open " + path + " for writing";
+    return false;
+  }
+
+  header.version = LightFieldHeader::VERSION;
+  header.flags = 0;
+  header.frameCount = 0;
+  header.columns = uint32_t(columns);
+  header.rows = uint32_t(rows);
+  header.views = uint32_t(views);
+  header.viewWidth = uint32_t(viewWidth);
+  header.viewHeight = uint32_t(viewHeight);
+  header.format = LightFieldHeader::FORMAT_BC1;
+  header.fps = fps;
+  header.aspect = aspect;
+  header.indexOffset = 0;
+
+  // rewritten by close() once the index offset is known
+  unsigned char bytes[LightFieldHeader::SIZE];
+  writeHeader(bytes, header);
+  fwrite(bytes, 1, sizeof(bytes), file);
+  position = LightFieldHeader::SIZE;
+  return true;
+}
+
+bool LightFieldWriter::addFrame(const unsigned char *quilt, int width, int height,
+                                float threshold, std::string &error)
+{
+  if (!file)
+  {
+    error = "not open";
+    return false;
+  }
+  if (width < header.quiltWidth() || height < header.quiltHeight())
+  {
+    error = "the quilt is smaller than the layout";
+    return false;
+  }
+
+  const int blocksX = int(header.viewWidth / 4);
+  const int blocksY = int(header.viewHeight / 4);
+  const size_t blocks = header.blocksPerView();
+  const size_t stride = size_t(width) * 4;
+  vector<unsigned char> previous(blocks * 8), current(blocks * 8);
+  vector<unsigned char> mask((blocks + 7) / 8);
+  vector<unsigned char> record;
+  vector<unsigned char> frame;
+
+  for (uint32_t v = 0; v < header.views; v++)
+  {
+    const size_t x0 = size_t(v % header.columns) * header.viewWidth;
+    const size_t y0 = size_t(v / header.columns) * header.viewHeight;
+    fill(mask.begin(), mask.end(), 0);
+    record.clear();
+
+    uint32_t literalCount = 0;
+    for (int by = 0; by < blocksY; by++)
+    {
+      for (int bx = 0; bx < blocksX; bx++)
+      {
+        const size_t i = size_t(by) * size_t(blocksX) + size_t(bx);
+        const unsigned char *pixels =
+            quilt + (y0 + size_t(by) * 4) * stride + (x0 + size_t(bx) * 4) * 4;
+        unsigned char *block = &current[i * 8];
+        encodeBc1Block(pixels, stride, block);
+
+        bool copy = false;
+        if (v > 0)
+        {
+          const unsigned char *before = &previous[i * 8];
+          copy = memcmp(block, before, 8) == 0 ||
+                 (threshold > 0.0f && blockError(pixels, stride, before) <= threshold);
+        }
+        if (copy)
+        {
+          mask[i / 8] |= (unsigned char)(1 << (i % 8));
+          memcpy(block, &previous[i * 8], 8);
+          copies++;
+        }
+        else
+        {
+          record.insert(record.end(), block, block + 8);
+          literalCount++;
+          literals++;
+        }
+      }
+    }
+
+    unsigned char count[4];
+    put32(count, literalCount);
+    frame.insert(frame.end(), count, count + 4);
+    if (v > 0)
+      frame.insert(frame.end(), mask.begin(), mask.end());
+    frame.insert(frame.end(), record.begin(), record.end());
+    previous.swap(current);
+  }
+
+  if (fwrite(frame.data(), 1, frame.size(), file) != frame.size())
+  {
+    error = "write failed";
+    return false;
+  }
+  offsets.push_back(position);
+  sizes.push_back(uint32_t(frame.size()));
+  position += frame.size();
+  header.frameCount++;
+  return true;
+}
+
+bool LightFieldWriter::close(std::string &error)
+{
+  if (!file)
+  {
+    error = "not open";
+    return false;
+  }
+  header.indexOffset = position;
+  for (size_t i = 0; i < offsets.size(); i++)
+  {
+    unsigned char entry[16];
+    put64(entry, offsets[i]);
+    put32(entry + 8, sizes[i]);
+    put32(entry + 12, 0);
+    fwrite(entry, 1, sizeof(entry), file);
+  }
+  unsigned char bytes[LightFieldHeader::SIZE];
+  writeHeader(bytes, header);
+  fseek(file, 0, SEEK_SET);
+  bool written = fwrite(bytes, 1, sizeof(bytes), file) == sizeof(bytes);
+  written = fclose(file) == 0 && written;
+  file = NULL;
+  if (!written)
+    error = "write failed";
+  return written;
+}
+
+// reader
+// =========================================================
+bool LightFieldReader::isLightFieldFile(const std::string &path)
+{
+  FILE *f = fopen(path.c_str(), "rb");
+  if (!f)
+    return false;
+  char magic[4];
+  bool matches = fread(magic, 1, 4, f) == 4 && memcmp(magic, MAGIC, 4) == 0;
+  fclose(f);
+  return matches;
+}
+
+bool LightFieldReader::open(const std::string &path, std::string &error)
+{
+  index = NULL;
+  if (!file.open(path))
+  {
+    error = "couldn't open " + path;
+    return false;
+  }
+  if (file.size() < LightFieldHeader::SIZE || memcmp(file.data(), MAGIC, 4) != 0)
+  {
+    error = path + " is not a light field file";
+    return false;
+  }
+  readHeader(file.data(), header);
+  if (header.version != LightFieldHeader::VERSION ||
+      header.format != LightFieldHeader::FORMAT_BC1)
+  {
+    error = path + " has an unsupported version or format";
+    return false;
+  }
+  if (header.columns == 0 || header.rows == 0 || header.views == 0 ||
+      header.views > header.columns * header.rows || header.viewWidth == 0 ||
+      header.viewHeight == 0 || header.viewWidth % 4 || header.viewHeight % 4 ||
+      header.frameCount == 0)
+  {
+    error = path + " has an invalid layout";
+    return false;
+  }
+  if (header.indexOffset > file.size() ||
+      (file.size() - header.indexOffset) / 16 < header.frameCount)
+  {
+    error = path + " is truncated";
+    return false;
+  }
+  index = file.data() + header.indexOffset;
+  return true;
+}
+
+bool LightFieldReader::readFrame(int frame, unsigned char *quilt, std::string &error) const
+{
+  if (!index || frame < 0 || uint32_t(frame) >= header.frameCount)
+  {
+    error = "no frame " + to_string(frame);
+    return false;
+  }
+  const unsigned char *entry = index + size_t(frame) * 16;
+  uint64_t offset = get64(entry);
+  uint64_t size = get32(entry + 8);
+  if (offset > file.size() || size > file.size() - offset)
+  {
+    error = "frame " + to_string(frame) + " lies outside the file";
+    return false;
+  }
+
+  const unsigned char *p = file.data() + offset;
+  const unsigned char *end = p + size;
+  const size_t blocksX = header.viewWidth / 4;
+  const size_t blocksY = header.viewHeight / 4;
+  const size_t blocks = header.blocksPerView();
+  const size_t maskBytes = (blocks + 7) / 8;
+  const size_t rowBlocks = blocksX * header.columns; // per block row of the quilt
+
+  for (uint32_t v = 0; v < header.views; v++)
+  {
+    if (end - p < 4)
+      break;
+    uint32_t literalCount = get32(p);
+    p += 4;
+    const unsigned char *mask = NULL;
+    if (v > 0)
+    {
+      if (size_t(end - p) < maskBytes)
+        break;
+      mask = p;
+      p += maskBytes;
+    }
+    if (literalCount > blocks || size_t(end - p) < size_t(literalCount) * 8)
+      break;
+    const unsigned char *literal = p;
+    p += size_t(literalCount) * 8;
+
+    // first (bottom left) block of this view and of the previous one
+    const size_t origin = size_t(v / header.columns) * blocksY * rowBlocks +
+                          size_t(v % header.columns) * blocksX;
+    const size_t previousOrigin = v == 0 ? 0 :
+        size_t((v - 1) / header.columns) * blocksY * rowBlocks +
+        size_t((v - 1) % header.columns) * blocksX;
+    uint32_t used = 0;
+    for (size_t by = 0; by < blocksY; by++)
+    {
+      for (size_t bx = 0; bx < blocksX; bx++)
+      {
+        const size_t i = by * blocksX + bx;
+        unsigned char *block = quilt + (origin + by * rowBlocks + bx) * 8;
+        if (mask && (mask[i / 8] >> (i % 8)) & 1)
+        {
+          memcpy(block, quilt + (previousOrigin + by * rowBlocks + bx) * 8, 8);
+        }
+        else
+        {
+          if (used == literalCount)
+          {
+            error = "frame " + to_string(frame) + " is corrupt";
+            return false;
+          }
+          memcpy(block, literal + size_t(used) * 8, 8);
+          used++;
+        }
+      }
+    }
+    if (used != literalCount)
+    {
+      error = "frame " + to_string(frame) + " is corrupt";
+      return false;
+    }
+    if (v + 1 == header.views)
+      return true;
+  }
+  error = "frame " + to_string(frame) + " is truncated";
+  return false;
+}
@@ -0,0 +1,142 @@
+/**
+ * LightFieldFile.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_LIGHT_FIELD_FILE_HPP
+#define HOLOPLAY_LIGHT_FIELD_FILE_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+// Light field container (.hlf), version 1
+// =========================================================
+// A sequence of quilts stored as block compressed views. All integers are
+// little endian.
+//
+//   header        64 bytes at offset 0: the magic "HPLF", then the fields
+//                 of LightFieldHeader in order (4 bytes each, 8 for
+//                 indexOffset), zero padded
+//   frames        anywhere after the header, located through the index
+//   index         frameCount entries of 16 bytes at header.indexOffset:
+//                   uint64 offset, uint32 size, uint32 reserved (0)
+//
+// Views are in quilt order: view 0 is the bottom left tile and views go left
+// to right, then bottom to top. Each view is viewWidth x viewHeight pixels
+// (multiples of 4) stored as BC1 (DXT1) blocks of 8 bytes per 4x4 pixels,
+// block rows and the pixel rows inside a block bottom to top, as OpenGL
+// expects. The whole quilt is therefore a BC1 texture of
+// columns * viewWidth x rows * viewHeight that can be uploaded as is.
+//
+// A frame holds its views one after the other, each as
+//
+//   uint32 literalCount               blocks stored in this record
+//   uint8  copyMask[(blocks + 7) / 8] every view but the first: bit i (least
+//                                     significant first) set means block i
+//                                     is block i of the previous view
+//   uint8  literals[literalCount * 8] the remaining blocks, in order
+//
+// Neighbouring views differ little, so most background blocks are copies.
+// Reconstructing a frame only moves 8 byte blocks around; nothing is decoded
+// on the CPU. Frames don't refer to each other, any frame can be read after
+// a seek.
+
+struct LightFieldHeader
+{
+    static const uint32_t VERSION = 1;
+    static const uint32_t FORMAT_BC1 = 1;
+    static const size_t SIZE = 64;
+
+    uint32_t version;
+    uint32_t flags;      // 0
+    uint32_t frameCount;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t views;      // at most columns * rows
+    uint32_t viewWidth;
+    uint32_t viewHeight;
+    uint32_t format;     // FORMAT_BC1
+    float fps;
+    float aspect;        // of a view as it is meant to be seen, 0 if unknown
+    uint64_t indexOffset;
+
+    int quiltWidth() const { return int(columns * viewWidth); }
+    int quiltHeight() const { return int(rows * viewHeight); }
+    size_t blocksPerView() const { return size_t(viewWidth / 4) * size_t(viewHeight / 4); }
+    size_t quiltBytes() const { return blocksPerView() * columns * rows * 8; }
+};
+
+// BC1 with four colors, no punch through alpha
+void encodeBc1Block(const unsigned char *rgba, size_t stride, unsigned char *block);
+void decodeBc1Block(const unsigned char *block, unsigned char *rgba, size_t stride);
+
+// Writes a container frame by frame. Not thread safe.
+class LightFieldWriter
+{
+public:
+    LightFieldWriter();
+    ~LightFieldWriter(); // closes without an index if close() wasn't called
+
+    // views are viewWidth x viewHeight, multiples of 4
+    bool open(const std::string &path, int columns, int rows, int views,
+              int viewWidth, int viewHeight, float fps, float aspect,
+              std::string &error);
+
+    // quilt is RGBA8 with rows bottom to top and at least the header's quilt
+    // size. A block whose colors differ from the same block of the previous
+    // view by no more than threshold (mean squared error per channel, 0 for
+    // exact block matches only) is stored as a copy.
+    bool addFrame(const unsigned char *quilt, int width, int height,
+                  float threshold, std::string &error);
+
+    bool close(std::string &error); // writes the index
+
+    uint64_t literalBlocks() const { return literals; }
+    uint64_t copiedBlocks() const { return copies; }
+
+private:
+    LightFieldWriter(const LightFieldWriter &);
+    LightFieldWriter &operator=(const LightFieldWriter &);
+
+    FILE *file;
+    LightFieldHeader header;
+    std::vector<uint64_t> offsets;
+    std::vector<uint32_t> sizes;
+    uint64_t position; // where the next frame goes
+    uint64_t literals;
+    uint64_t copies;
+};
+
+// Reads a container through a memory mapping. readFrame() may be called from
+// several threads at once.
+class LightFieldReader
+{
+public:
+    LightFieldReader() : index(NULL) {}
+
+    bool open(const std::string &path, std::string &error);
+    const LightFieldHeader &getHeader() const { return header; }
+
+    // rebuilds frame into quilt, header.quiltBytes() of BC1 blocks laid out
+    // as the quilt texture
+    bool readFrame(int frame, unsigned char *quilt, std::string &error) const;
+
+    static bool isLightFieldFile(const std::string &path); // by its magic
+
+private:
+    LightFieldReader(const LightFieldReader &);
+    LightFieldReader &operator=(const LightFieldReader &);
+
+    MappedFile file;
+    LightFieldHeader header;
+    const unsigned char *index;
+};
+
+#endif // HOLOPLAY_LIGHT_FIELD_FILE_HPP
@@ -0,0 +1,135 @@
+/**
+ * MappedFile.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "MappedFile.hpp"
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : bytes(NULL),
+      length(0)
+#ifdef WIN32
+      ,
+      file(NULL),
+      mapping(NULL)
+#endif
+{
+}
+
+MappedFile::MappedFile(const std::string &path)
+    : bytes(NULL),
+      length(0)
+#ifdef WIN32
+      ,
+      file(NULL),
+      mapping(NULL)
+#endif
+{
+  open(path);
+}
+
+MappedFile::~MappedFile()
+{
+  close();
+}
+
+#ifdef WIN32
+
+bool MappedFile::open(const std::string &path)
+{
+  close();
+  HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                              OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  if (handle == INVALID_HANDLE_VALUE)
+    return false;
+  LARGE_INTEGER fileSize;
+  if (!GetFileSizeEx(handle, &fileSize) || fileSize.QuadPart == 0)
+  {
+    CloseHandle(handle);
+    return false;
+  }
+  HANDLE view = CreateFileMappingA(handle, NULL, PAGE_READONLY, 0, 0, NULL);
+  if (!view)
+  {
+    CloseHandle(handle);
+    return false;
+  }
+  void *address = MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0);
+  if (!address)
+  {
+    CloseHandle(view);
+    CloseHandle(handle);
+    return false;
+  }
+  file = handle;
+  mapping = view;
+  bytes = static_cast<const unsigned char *>(address);
+  length = size_t(fileSize.QuadPart);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (bytes)
+    UnmapViewOfFile(bytes);
+  if (mapping)
+    CloseHandle(mapping);
+  if (file)
+    CloseHandle(file);
+  bytes = NULL;
+  length = 0;
+  mapping = NULL;
+  file = NULL;
+}
+
+#else
+
+bool MappedFile::open(const std::string &path)
+{
+  close();
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size == 0)
+  {
+    ::close(fd);
+    return false;
+  }
+  void *address = mmap(NULL, size_t(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+  // the mapping keeps the file referenced
+  ::close(fd);
+  if (address == MAP_FAILED)
+    return false;
+  bytes = static_cast<const unsigned char *>(address);
+  length = size_t(info.st_size);
+  return true;
+}
+
+void MappedFile::close()
+{
+  if (bytes)
+    munmap(const_cast<unsigned char *>(bytes), length);
+  bytes = NULL;
+  length = 0;
+}
+
+#endif
@@ -0,0 +1,44 @@
+/**
+ * MappedFile.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_MAPPED_FILE_HPP
+#define HOLOPLAY_MAPPED_FILE_HPP
+
+#include <cstddef>
+#include <string>
+
+// Read only memory mapping of a whole file. Pages are read in on first access
+// instead of being copied through a read buffer, so large quilt files cost
+// nothing until they are decoded.
+class MappedFile
+{
+public:
+    MappedFile();
+    explicit MappedFile(const std::string &path); // check isOpen()
+    ~MappedFile();
+
+    bool open(const std::string &path); // closes the previous file
+    void close();
+
+    bool isOpen() const { return bytes != NULL; }
+    const unsigned char *data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    MappedFile(const MappedFile &);
+    MappedFile &operator=(const MappedFile &);
+
+    const unsigned char *bytes;
+    size_t length;
+#ifdef WIN32
+    void *file;    // HANDLE
+    void *mapping; // HANDLE
+#endif
+};
+
+#endif // HOLOPLAY_MAPPED_FILE_HPP
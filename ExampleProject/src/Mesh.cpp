@@ -0,0 +1,116 @@
+/**
+ * Mesh.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "Mesh.hpp"
+
+#include <cmath>
+
+using namespace std;
+
+static const float PI = 3.14159265358979f;
+
+// (columns + 1) x (rows + 1) vertices from position(u, v), two triangles per
+// cell. u and v run from 0 to 1 and are the uvs
+template <typename Surface>
+static void addGrid(Mesh &mesh, int columns, int rows, Surface surface)
+{
+  const GLuint first = GLuint(mesh.vertices.size());
+  for (int j = 0; j <= rows; j++)
+  {
+    for (int i = 0; i <= columns; i++)
+    {
+      MeshVertex v;
+      v.uv = glm::vec2(float(i) / float(columns), float(j) / float(rows));
+      surface(v.uv.x, v.uv.y, v.position, v.normal);
+      mesh.vertices.push_back(v);
+    }
+  }
+  const GLuint stride = GLuint(columns + 1);
+  for (int j = 0; j < rows; j++)
+  {
+    for (int i = 0; i < columns; i++)
+    {
+      GLuint a = first + GLuint(j) * stride + GLuint(i);
+      GLuint b = a + 1, c = a + stride, d = c + 1;
+      mesh.indices.push_back(a);
+      mesh.indices.push_back(b);
+      mesh.indices.push_back(d);
+      mesh.indices.push_back(a);
+      mesh.indices.push_back(d);
+      mesh.indices.push_back(c);
+    }
+  }
+}
+
+Mesh makeSphere(int slices, int stacks)
+{
+  Mesh mesh;
+  mesh.radius = 1.0f;
+  // the seam and the poles repeat vertices, so the chart is the whole square
+  addGrid(mesh, slices, stacks, [](float u, float v, glm::vec3 &p, glm::vec3 &n) {
+    float phi = u * 2.0f * PI, theta = (1.0f - v) * PI;
+    n = glm::vec3(sin(theta) * cos(phi), cos(theta), -sin(theta) * sin(phi));
+    p = n;
+  });
+  return mesh;
+}
+
+Mesh makeTorus(float tubeRadius, int segments, int sides)
+{
+  Mesh mesh;
+  mesh.radius = 1.0f + tubeRadius;
+  addGrid(mesh, segments, sides, [tubeRadius](float u, float v, glm::vec3 &p, glm::vec3 &n) {
+    float phi = u * 2.0f * PI, theta = v * 2.0f * PI;
+    glm::vec3 ring(cos(phi), 0.0f, -sin(phi));
+    n = ring * cos(theta) + glm::vec3(0.0f, sin(theta), 0.0f);
+    p = ring + tubeRadius * n;
+  });
+  return mesh;
+}
+
+Mesh makeBox()
+{
+  Mesh mesh;
+  mesh.radius = sqrt(3.0f);
+  // normal, and the directions u and v run along on that face
+  static const float faces[6][9] = {
+      {1, 0, 0, 0, 0, -1, 0, 1, 0},  {-1, 0, 0, 0, 0, 1, 0, 1, 0},
+      {0, 1, 0, 1, 0, 0, 0, 0, -1},  {0, -1, 0, 1, 0, 0, 0, 0, 1},
+      {0, 0, 1, 1, 0, 0, 0, 1, 0},   {0, 0, -1, -1, 0, 0, 0, 1, 0}};
+  for (int f = 0; f < 6; f++)
+  {
+    glm::vec3 n(faces[f][0], faces[f][1], faces[f][2]);
+    glm::vec3 du(faces[f][3], faces[f][4], faces[f][5]);
+    glm::vec3 dv(faces[f][6], faces[f][7], faces[f][8]);
+    const GLuint first = GLuint(mesh.vertices.size());
+    addGrid(mesh, 1, 1, [n, du, dv](float u, float v, glm::vec3 &p, glm::vec3 &normal) {
+      p = n + (2.0f * u - 1.0f) * du + (2.0f * v - 1.0f) * dv;
+      normal = n;
+    });
+    // into the face's cell of the grid
+    glm::vec2 cell(float(f % 3), float(f / 3));
+    for (size_t i = first; i < mesh.vertices.size(); i++)
+      mesh.vertices[i].uv = (cell + mesh.vertices[i].uv) / glm::vec2(3.0f, 2.0f);
+  }
+  return mesh;
+}
+
+Mesh makeGround(float size, int cells)
+{
+  Mesh mesh;
+  mesh.radius = size * 0.5f * sqrt(2.0f);
+  addGrid(mesh, cells, cells, [size](float u, float v, glm::vec3 &p, glm::vec3 &n) {
+    p = glm::vec3((u - 0.5f) * size, 0.0f, (0.5f - v) * size);
+    n = glm::vec3(0.0f, 1.0f, 0.0f);
+  });
+  return mesh;
+}
@@ -0,0 +1,45 @@
+/**
+ * Mesh.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_MESH_HPP
+#define HOLOPLAY_MESH_HPP
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <vector>
+
+struct MeshVertex
+{
+    glm::vec3 position;
+    glm::vec3 normal;
+    glm::vec2 uv;
+};
+
+// Procedural meshes for the sample scene, as indexed triangle lists.
+//
+// Every mesh is unwrapped so that its uv charts tile the unit square without
+// gaps or overlaps. Rasterized in uv space, a mesh then covers every texel of
+// a texture, which is what texture space shading needs: no texel of an
+// object's atlas tile is left unshaded for the views to sample.
+struct Mesh
+{
+    std::vector<MeshVertex> vertices;
+    std::vector<GLuint> indices;
+    float radius; // of the smallest sphere around the origin holding it
+};
+
+// radius 1, u around the y axis and v from pole to pole
+Mesh makeSphere(int slices, int stacks);
+// ring radius 1 around the y axis, u along the ring and v around the tube
+Mesh makeTorus(float tubeRadius, int segments, int sides);
+// from -1 to 1, the faces in a 3x2 grid of the uv square
+Mesh makeBox();
+// size x size in the xz plane at y 0 facing up, cells x cells quads
+Mesh makeGround(float size, int cells);
+
+#endif // HOLOPLAY_MESH_HPP
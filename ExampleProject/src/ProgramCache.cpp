@@ -0,0 +1,116 @@
+/**
+ * ProgramCache.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "ProgramCache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <vector>
+
+using namespace std;
+
+static const char MAGIC[4] = {'H', 'P', 'P', 'B'};
+
+// FNV-1a, the same on every run unlike std::hash
+static uint64_t hashText(uint64_t hash, const string &text)
+{
+  for (size_t i = 0; i < text.size(); i++)
+  {
+    hash ^= uint64_t((unsigned char)text[i]);
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+static string glString(GLenum name)
+{
+  const GLubyte *text = glGetString(name);
+  return text ? string((const char *)text) : string();
+}
+
+ProgramCache::ProgramCache(const string &directory) : directory(directory)
+{
+  if (!this->directory.empty() && this->directory.back() != '/' && this->directory.back() != '\\')
+    this->directory += '/';
+}
+
+string ProgramCache::path(const string &key) const
+{
+  string name;
+  for (size_t i = 0; i < key.size(); i++)
+    if (isalnum((unsigned char)key[i]) || key[i] == '-' || key[i] == '_')
+      name += key[i];
+  return directory + name + ".glbin";
+}
+
+ShaderProgram *ProgramCache::load(const string &key, const string &vertexSource,
+                                  const string &fragmentSource)
+{
+  // the sources are separated so moving text between them changes the hash
+  uint64_t hash = 14695981039346656037ull;
+  hash = hashText(hash, glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" +
+                            glString(GL_VERSION) + "\n");
+  hash = hashText(hash, vertexSource + "\n// fragment\n" + fragmentSource);
+  const string file = path(key);
+
+  if (GLEW_ARB_get_program_binary)
+  {
+    ifstream in(file.c_str(), ios_base::binary);
+    char magic[4];
+    uint64_t storedHash = 0;
+    uint32_t format = 0;
+    if (in.read(magic, 4) && equal(magic, magic + 4, MAGIC) &&
+        in.read((char *)&storedHash, sizeof(storedHash)) && storedHash == hash &&
+        in.read((char *)&format, sizeof(format)))
+    {
+      vector<char> binary((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+      ShaderProgram *program = new ShaderProgram(GLenum(format), binary);
+      if (program->linked())
+      {
+        cout << "[Info] loaded program " << file << endl;
+        return program;
+      }
+      // the driver changed in a way its version doesn't show
+      delete program;
+    }
+  }
+
+  Shader vertexShader(GL_VERTEX_SHADER, vertexSource.c_str());
+  Shader fragmentShader(GL_FRAGMENT_SHADER, fragmentSource.c_str());
+  if (vertexShader.checkCompileError(key) || fragmentShader.checkCompileError(key))
+    return NULL;
+  ShaderProgram *program = new ShaderProgram({vertexShader, fragmentShader});
+  if (!program->linked())
+  {
+    delete program;
+    return NULL;
+  }
+
+  GLenum format = 0;
+  vector<char> binary;
+  if (program->getBinary(format, binary))
+  {
+    ofstream out(file.c_str(), ios_base::binary | ios_base::trunc);
+    const uint32_t format32 = uint32_t(format);
+    out.write(MAGIC, 4);
+    out.write((const char *)&hash, sizeof(hash));
+    out.write((const char *)&format32, sizeof(format32));
+    out.write(binary.data(), streamsize(binary.size()));
+    if (!out)
+      cout << "[Warning] couldn't write the program cache " << file << endl;
+  }
+  return program;
+}
@@ -0,0 +1,43 @@
+/**
+ * ProgramCache.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_PROGRAM_CACHE_HPP
+#define HOLOPLAY_PROGRAM_CACHE_HPP
+
+#include <string>
+
+#include "Shader.hpp"
+
+// Keeps linked program binaries on disk, one file per key, so a program
+// built from the same sources by the same driver is loaded on later runs
+// instead of compiled again.
+//
+// A file holds a hash of the sources and of the driver (GL_VENDOR,
+// GL_RENDERER, GL_VERSION) next to the binary, and is only used if both
+// match; anything else, or a binary the driver refuses, is compiled and
+// written over. Without program binaries (GL 4.1 or ARB_get_program_binary)
+// every program is compiled.
+class ProgramCache
+{
+public:
+    // files are written into directory, "" for the working directory
+    explicit ProgramCache(const std::string &directory = "");
+
+    // the program of a vertex and fragment shader, from the file of key
+    // (letters, digits, - and _ are kept) if it holds these sources. NULL if
+    // a shader doesn't compile. Needs a current context
+    ShaderProgram *load(const std::string &key, const std::string &vertexSource,
+                        const std::string &fragmentSource);
+
+private:
+    std::string path(const std::string &key) const;
+
+    std::string directory;
+};
+
+#endif // HOLOPLAY_PROGRAM_CACHE_HPP
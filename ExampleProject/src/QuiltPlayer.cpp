@@ -0,0 +1,515 @@
+/**
+ * QuiltPlayer.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "QuiltPlayer.hpp"
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <set>
+#include <stdexcept>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "LightFieldFile.hpp"
+#include "MappedFile.hpp"
+#include "stb_image.h"
+
+using namespace std;
+
+// the names in directory, one listing instead of a file system call per frame
+static void listDirectory(const std::string &directory, std::set<std::string> &names)
+{
+#ifdef WIN32
+  WIN32_FIND_DATAA entry;
+  HANDLE find = FindFirstFileA((directory + "\\*").c_str(), &entry);
+  if (find == INVALID_HANDLE_VALUE)
+    return;
+  do
+    names.insert(entry.cFileName);
+  while (FindNextFileA(find, &entry));
+  FindClose(find);
+#else
+  DIR *dir = opendir(directory.c_str());
+  if (!dir)
+    return;
+  while (struct dirent *entry = readdir(dir))
+    names.insert(entry->d_name);
+  closedir(dir);
+#endif
+}
+
+// The pattern of a numbered sequence becomes a printf format, so it may only
+// hold one int conversion (%d, %i or %u with flags, width and precision) and
+// escaped percent signs
+static bool isSequencePattern(const std::string &pattern)
+{
+  int conversions = 0;
+  for (size_t i = 0; i < pattern.size(); i++)
+  {
+    if (pattern[i] != '%')
+      continue;
+    if (++i < pattern.size() && pattern[i] == '%')
+      continue;
+    while (i < pattern.size() && strchr("-+ #0", pattern[i]))
+      i++;
+    while (i < pattern.size() && isdigit((unsigned char)pattern[i]))
+      i++;
+    if (i < pattern.size() && pattern[i] == '.')
+    {
+      i++;
+      while (i < pattern.size() && isdigit((unsigned char)pattern[i]))
+        i++;
+    }
+    if (i >= pattern.size() || !strchr("diu", pattern[i]))
+      return false;
+    conversions++;
+  }
+  return conversions == 1;
+}
+
+// a quilt image or a numbered sequence of them
+class ImageSequenceReader : public QuiltFrameReader
+{
+public:
+  ImageSequenceReader(const std::string &pattern, const QuiltLayout &fallback)
+  {
+    // a numbered sequence runs until the first missing file
+    if (pattern.find('%') == string::npos)
+    {
+      files.push_back(pattern);
+    }
+    else
+    {
+      if (!isSequencePattern(pattern))
+        throw std::runtime_error(pattern + " isn't a sequence pattern, it needs exactly "
+                                           "one integer conversion like %04d");
+      // the directories the names fall in, listed once each
+      map<string, set<string>> listings;
+      for (int i = 0;; i++)
+      {
+        char name[1024];
+        snprintf(name, sizeof(name), pattern.c_str(), i);
+        string path = name;
+        size_t slash = path.find_last_of("/\\");
+        string directory = slash == string::npos ? "." : path.substr(0, slash);
+        if (slash == 0)
+          directory = "/";
+        map<string, set<string>>::iterator listing = listings.find(directory);
+        if (listing == listings.end())
+        {
+          listing = listings.insert(make_pair(directory, set<string>())).first;
+          listDirectory(directory, listing->second);
+        }
+        if (!listing->second.count(slash == string::npos ? path : path.substr(slash + 1)))
+          break;
+        files.push_back(path);
+      }
+    }
+    if (files.empty())
+      throw std::runtime_error("no quilt frames match " + pattern);
+
+    // every frame has to match the first one
+    MappedFile first(files[0]);
+    int width, height, channels;
+    if (!first.isOpen() ||
+        !stbi_info_from_memory(first.data(), int(first.size()), &width, &height, &channels))
+      throw std::runtime_error("couldn't read the quilt " + files[0]);
+
+    quiltLayout = fallback;
+    quiltLayout.width = width;
+    quiltLayout.height = height;
+    if (QuiltPlayer::parseLayout(files[0], quiltLayout.columns, quiltLayout.rows))
+      quiltLayout.views = quiltLayout.columns * quiltLayout.rows;
+  }
+
+  int frameCount() const { return int(files.size()); }
+  QuiltLayout layout() const { return quiltLayout; }
+  PixelFormat format() const { return RGBA8; }
+  size_t frameBytes() const
+  {
+    return size_t(quiltLayout.width) * size_t(quiltLayout.height) * 4;
+  }
+
+  bool readFrame(int frame, unsigned char *pixels, std::string &error)
+  {
+    const string &path = files[size_t(frame)];
+    MappedFile file(path);
+    int width = 0, height = 0, channels;
+    unsigned char *data = NULL;
+    if (file.isOpen())
+      data = stbi_load_from_memory(file.data(), int(file.size()), &width, &height,
+                                   &channels, 4);
+    if (!data || width != quiltLayout.width || height != quiltLayout.height)
+    {
+      error = "couldn't decode quilt frame " + path;
+      if (data)
+        error += ": size differs from the first frame";
+      stbi_image_free(data);
+      return false;
+    }
+    // images start with the top row, textures with the bottom one
+    const size_t rowBytes = size_t(width) * 4;
+    for (int y = 0; y < height; y++)
+      memcpy(pixels + size_t(height - 1 - y) * rowBytes, data + size_t(y) * rowBytes,
+             rowBytes);
+    stbi_image_free(data);
+    return true;
+  }
+
+private:
+  std::vector<std::string> files;
+  QuiltLayout quiltLayout;
+};
+
+// a light field container. Frames stay block compressed unless the GPU can't
+// sample BC1, then they are decoded here
+class LightFieldFrames : public QuiltFrameReader
+{
+public:
+  LightFieldFrames(const std::string &path, bool gpuBlocks) : gpuBlocks(gpuBlocks)
+  {
+    string error;
+    if (!reader.open(path, error))
+      throw std::runtime_error(error);
+  }
+
+  int frameCount() const { return int(reader.getHeader().frameCount); }
+  QuiltLayout layout() const
+  {
+    const LightFieldHeader &header = reader.getHeader();
+    QuiltLayout layout;
+    layout.width = header.quiltWidth();
+    layout.height = header.quiltHeight();
+    layout.columns = int(header.columns);
+    layout.rows = int(header.rows);
+    layout.views = int(header.views);
+    return layout;
+  }
+  PixelFormat format() const { return gpuBlocks ? BC1 : RGBA8; }
+  size_t frameBytes() const
+  {
+    const LightFieldHeader &header = reader.getHeader();
+    return gpuBlocks ? header.quiltBytes()
+                     : size_t(header.quiltWidth()) * size_t(header.quiltHeight()) * 4;
+  }
+  float fps() const { return reader.getHeader().fps; }
+
+  bool readFrame(int frame, unsigned char *pixels, std::string &error)
+  {
+    if (gpuBlocks)
+      return reader.readFrame(frame, pixels, error);
+
+    const LightFieldHeader &header = reader.getHeader();
+    vector<unsigned char> blocks(header.quiltBytes());
+    if (!reader.readFrame(frame, blocks.data(), error))
+      return false;
+    const size_t width = size_t(header.quiltWidth());
+    const size_t blocksX = width / 4;
+    const size_t blocksY = size_t(header.quiltHeight()) / 4;
+    for (size_t by = 0; by < blocksY; by++)
+      for (size_t bx = 0; bx < blocksX; bx++)
+        decodeBc1Block(&blocks[(by * blocksX + bx) * 8],
+                       pixels + (by * 4 * width + bx * 4) * 4, width * 4);
+    return true;
+  }
+
+private:
+  LightFieldReader reader;
+  bool gpuBlocks;
+};
+
+QuiltPlayer::QuiltPlayer(const std::string &path, ThreadPool &pool, float fps,
+                         const QuiltLayout &fallback, int ringSize,
+                         GpuMemoryRegistry *memory)
+    : pool(pool),
+      memory(memory),
+      persistent(GLEW_ARB_buffer_storage ? true : false),
+      compressedTexture(0),
+      shownFrame(-1),
+      lateFrame(-1),
+      late(0),
+      skippedFrame(-1),
+      skipped(0)
+{
+  if (LightFieldReader::isLightFieldFile(path))
+    reader.reset(new LightFieldFrames(path, GLEW_EXT_texture_compression_s3tc ? true : false));
+  else
+    reader.reset(new ImageSequenceReader(path, fallback));
+
+  if (fps > 0.0f)
+    this->fps = fps;
+  else
+    this->fps = reader->fps() > 0.0f ? reader->fps() : 30.0f;
+
+  // short sequences are read once and stay in memory
+  int slotCount = ringSize < frameCount() ? ringSize : frameCount();
+  for (int i = 0; i < slotCount; i++)
+    slots.push_back(std::unique_ptr<Slot>(new Slot()));
+
+  const QuiltLayout quilt = reader->layout();
+  const size_t frameBytes = reader->frameBytes();
+  // the workers read the frames straight into the buffers they are
+  // uploaded from
+  for (size_t i = 0; i < slots.size(); i++)
+  {
+    Slot &slot = *slots[i];
+    glGenBuffers(1, &slot.pbo);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+    if (persistent)
+    {
+      GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+      glBufferStorage(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(frameBytes), NULL, flags);
+      slot.mapped = static_cast<unsigned char *>(
+          glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(frameBytes), flags));
+    }
+    else
+    {
+      glBufferData(GL_PIXEL_UNPACK_BUFFER, GLsizeiptr(frameBytes), NULL, GL_STREAM_DRAW);
+    }
+    if (memory)
+      memory->addBuffer("quilt playback frame", slot.pbo, frameBytes);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // block compressed frames can't go into the float quilt texture
+  if (reader->format() == QuiltFrameReader::BC1)
+  {
+    const GLenum format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    glGenTextures(1, &compressedTexture);
+    glBindTexture(GL_TEXTURE_2D, compressedTexture);
+    if (GLEW_ARB_texture_storage)
+      glTexStorage2D(GL_TEXTURE_2D, 1, format, quilt.width, quilt.height);
+    else
+      glCompressedTexImage2D(GL_TEXTURE_2D, 0, format, quilt.width, quilt.height, 0,
+                             GLsizei(frameBytes), NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (memory)
+      memory->addTexture("quilt playback (BC1)", compressedTexture, format,
+                         quilt.width, quilt.height);
+  }
+
+  cout << "[Info] playing " << frameCount() << " quilt frames of " << quilt.width
+       << "x" << quilt.height << " (" << quilt.columns << "x" << quilt.rows
+       << " views" << (compressedTexture ? ", BC1" : "") << ") at " << this->fps
+       << " fps, " << slotCount << " frames read ahead" << endl;
+  prefetch(0);
+}
+
+QuiltPlayer::~QuiltPlayer()
+{
+  for (size_t i = 0; i < slots.size(); i++)
+  {
+    if (slots[i]->task.valid())
+      slots[i]->task.wait();
+  }
+  for (size_t i = 0; i < slots.size(); i++)
+  {
+    Slot &slot = *slots[i];
+    if (slot.uploaded)
+      glDeleteSync(slot.uploaded);
+    if (slot.mapped)
+    {
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+      glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    }
+    if (memory)
+      memory->remove(GpuMemoryRegistry::Buffer, slot.pbo);
+    glDeleteBuffers(1, &slot.pbo);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (compressedTexture)
+  {
+    if (memory)
+      memory->remove(GpuMemoryRegistry::Texture, compressedTexture);
+    glDeleteTextures(1, &compressedTexture);
+  }
+  if (late)
+    cout << "[Info] quilt playback: " << late << " frames were not ready in time" << endl;
+  if (skipped)
+    cout << "[Info] quilt playback: " << skipped << " frames couldn't be read and were "
+         << "skipped" << endl;
+}
+
+bool QuiltPlayer::parseLayout(const std::string &fileName, int &columns, int &rows)
+{
+  size_t slash = fileName.find_last_of("/\\");
+  size_t at = fileName.find("_qs", slash == string::npos ? 0 : slash);
+  int c, r;
+  if (at == string::npos || sscanf(fileName.c_str() + at, "_qs%dx%d", &c, &r) != 2 ||
+      c <= 0 || r <= 0)
+    return false;
+  columns = c;
+  rows = r;
+  return true;
+}
+
+QuiltPlayer::Slot &QuiltPlayer::slotFor(int frame)
+{
+  return *slots[size_t(frame) % slots.size()];
+}
+
+void QuiltPlayer::prefetch(int frame)
+{
+  // the frames from the one due onwards each have their own slot, as the
+  // ring is never longer than the sequence
+  for (size_t i = 0; i < slots.size(); i++)
+  {
+    int f = int((size_t(frame) + i) % size_t(frameCount()));
+    Slot &slot = slotFor(f);
+    if (slot.frame == f && slot.state != Free)
+    {
+      // a failed read may have been transient, try again a few times
+      if (slot.state != Failed || slot.attempts >= READ_ATTEMPTS)
+        continue;
+    }
+    else
+    {
+      // still busy with a frame that was skipped, claim it next time
+      if (slot.state == Reading)
+        continue;
+      if (!mapSlot(slot))
+        continue;
+      slot.frame = f;
+      slot.attempts = 0;
+    }
+    slot.attempts++;
+    slot.state = Reading;
+    Slot *target = &slot;
+    slot.task = pool.submit([this, target]() { read(*target); });
+  }
+}
+
+// somewhere for the worker to write, never waits: a persistent slot whose
+// last frame the GPU may still be reading is claimed next time, others are
+// orphaned
+bool QuiltPlayer::mapSlot(Slot &slot)
+{
+  if (slot.uploaded)
+  {
+    GLenum status = glClientWaitSync(slot.uploaded, 0, 0);
+    if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED)
+      return false;
+    glDeleteSync(slot.uploaded);
+    slot.uploaded = 0;
+  }
+  if (slot.mapped)
+    return true;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+  slot.mapped = static_cast<unsigned char *>(
+      glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, GLsizeiptr(reader->frameBytes()),
+                       GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT));
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  return slot.mapped != NULL;
+}
+
+void QuiltPlayer::read(Slot &slot)
+{
+  string error;
+  if (!reader->readFrame(slot.frame, slot.mapped, error))
+  {
+    cout << "[Error] " << error << endl;
+    slot.state = Failed;
+    return;
+  }
+  slot.state = Ready;
+}
+
+bool QuiltPlayer::update(GLuint quiltTexture, double time)
+{
+  int due = int(floor(time * double(fps)));
+  if (due < 0)
+    due = 0;
+  due %= frameCount();
+  prefetch(due);
+  if (due == shownFrame)
+    return false;
+
+  Slot &slot = slotFor(due);
+  if (slot.frame == due && slot.state == Failed && slot.attempts >= READ_ATTEMPTS)
+  {
+    // unreadable, the previous frame stays up in its place
+    if (skippedFrame != due)
+    {
+      skipped++;
+      cout << "[Warning] skipping quilt frame " << due << ", it failed to read "
+           << READ_ATTEMPTS << " times" << endl;
+    }
+    skippedFrame = due;
+    return false;
+  }
+  if (slot.frame != due || slot.state != Ready)
+  {
+    // keep the previous frame up rather than wait for the read
+    if (lateFrame != due)
+      late++;
+    lateFrame = due;
+    return false;
+  }
+  if (!upload(slot, quiltTexture))
+    return false;
+  shownFrame = due;
+  return true;
+}
+
+bool QuiltPlayer::upload(Slot &slot, GLuint quiltTexture)
+{
+  const QuiltLayout quilt = reader->layout();
+  const size_t frameBytes = reader->frameBytes();
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.pbo);
+  if (!persistent && slot.mapped)
+  {
+    // the frame stays in the buffer, looping sequences upload it again
+    slot.mapped = NULL;
+    if (!glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER))
+    {
+      // the contents were lost, read the frame again
+      glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+      slot.state = Free;
+      return false;
+    }
+  }
+
+  if (compressedTexture)
+  {
+    glBindTexture(GL_TEXTURE_2D, compressedTexture);
+    glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quilt.width, quilt.height,
+                              GL_COMPRESSED_RGB_S3TC_DXT1_EXT, GLsizei(frameBytes), NULL);
+  }
+  else
+  {
+    glBindTexture(GL_TEXTURE_2D, quiltTexture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quilt.width, quilt.height, GL_RGBA,
+                    GL_UNSIGNED_BYTE, NULL);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  // a persistent slot may only be read into again once this has executed
+  if (persistent)
+    slot.uploaded = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  return true;
+}
@@ -0,0 +1,133 @@
+/**
+ * QuiltPlayer.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_QUILT_PLAYER_HPP
+#define HOLOPLAY_QUILT_PLAYER_HPP
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GpuMemory.hpp"
+#include "QuiltSource.hpp"
+#include "ThreadPool.hpp"
+
+// Where QuiltPlayer gets its frames from. readFrame() runs on the worker
+// pool, for several frames at once.
+class QuiltFrameReader
+{
+public:
+    enum PixelFormat
+    {
+        RGBA8, // uploaded into the quilt texture
+        BC1    // uploaded as is into a compressed texture of the player's
+    };
+
+    virtual ~QuiltFrameReader() {}
+
+    virtual int frameCount() const = 0;
+    virtual QuiltLayout layout() const = 0;
+    virtual PixelFormat format() const = 0;
+    virtual size_t frameBytes() const = 0;
+    virtual float fps() const { return 0.0f; } // 0 if the frames don't say
+
+    // writes frame into pixels (frameBytes() long), rows bottom to top
+    virtual bool readFrame(int frame, unsigned char *pixels, std::string &error) = 0;
+};
+
+// Plays back pre-rendered quilts from
+//  - a single quilt image,
+//  - a numbered sequence of them, given as a printf pattern such as
+//    "take-quilt_%06d.png" and numbered from 0. The layout is read from the
+//    usual "_qs<columns>x<rows>" file name suffix, or taken from the
+//    fallback,
+//  - a light field container (see LightFieldFile.hpp), whose block
+//    compressed frames go to the GPU without being decoded.
+//
+// Files are memory mapped and frames read on the worker pool into a bounded
+// ring of pixel unpack buffers ahead of the one on screen, persistently
+// mapped with ARB_buffer_storage, else mapped from when a read is queued
+// until the frame is uploaded. update() picks the frame due at the target
+// frame rate and uploads it from its buffer, the render thread never copies
+// pixels. A frame that isn't ready in time is counted as late and the previous one
+// stays up; sequences that fit in the ring are read once and then loop
+// without touching the files again.
+class QuiltPlayer : public QuiltSource
+{
+public:
+    // needs the context update() is called in current. Throws
+    // std::runtime_error if path can't be played. fps 0 takes the rate
+    // stored with the frames, or 30.
+    QuiltPlayer(const std::string &path, ThreadPool &pool, float fps,
+                const QuiltLayout &fallback, int ringSize = 6,
+                GpuMemoryRegistry *memory = NULL);
+    ~QuiltPlayer(); // waits for the reads in flight, same context
+
+    QuiltLayout layout() const { return reader->layout(); }
+    bool update(GLuint quiltTexture, double time);
+    GLuint texture() const { return compressedTexture; }
+
+    int frameCount() const { return reader->frameCount(); }
+    int framesLate() const { return late; }
+    int framesSkipped() const { return skipped; } // unreadable
+
+    // the "_qs<columns>x<rows>" suffix of a quilt file name, false if none
+    static bool parseLayout(const std::string &fileName, int &columns, int &rows);
+
+private:
+    QuiltPlayer(const QuiltPlayer &);
+    QuiltPlayer &operator=(const QuiltPlayer &);
+
+    enum SlotState
+    {
+        Free,
+        Reading,
+        Ready,
+        Failed
+    };
+
+    struct Slot
+    {
+        Slot() : frame(-1), attempts(0), state(Free), pbo(0), mapped(NULL),
+                 uploaded(0) {}
+        int frame;
+        int attempts;                        // reads of frame so far
+        std::atomic<int> state;              // written last by the worker
+        GLuint pbo;                          // reader->frameBytes()
+        unsigned char *mapped;               // where the worker writes,
+                                             // NULL while unmapped
+        GLsync uploaded; // after the last upload from a persistent mapping
+        std::future<void> task;
+    };
+
+    Slot &slotFor(int frame);
+    void prefetch(int frame); // queue reads for frame and the ones after it
+    bool mapSlot(Slot &slot); // false while the GPU may still read it
+    void read(Slot &slot);
+    bool upload(Slot &slot, GLuint quiltTexture); // false if the frame was lost
+
+    std::unique_ptr<QuiltFrameReader> reader;
+    ThreadPool &pool;
+    float fps;
+    GpuMemoryRegistry *memory;
+
+    std::vector<std::unique_ptr<Slot>> slots;
+    static const int READ_ATTEMPTS = 3; // before a frame is skipped
+
+    bool persistent; // slots stay mapped, ARB_buffer_storage
+    GLuint compressedTexture; // for BC1 frames, 0 otherwise
+    int shownFrame; // uploaded last, -1 before the first upload
+    int lateFrame;  // last frame counted as late
+    int late;
+    int skippedFrame; // last frame counted as skipped
+    int skipped;
+};
+
+#endif // HOLOPLAY_QUILT_PLAYER_HPP
@@ -0,0 +1,47 @@
+/**
+ * QuiltSource.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_QUILT_SOURCE_HPP
+#define HOLOPLAY_QUILT_SOURCE_HPP
+
+#include <GL/glew.h>
+
+// how the views of a quilt frame are laid out
+struct QuiltLayout
+{
+    int width;   // pixels used in the texture, from its lower left corner
+    int height;
+    int columns;
+    int rows;
+    int views;   // may be less than columns * rows
+};
+
+// Content for the quilt that doesn't come from renderScene(): pre-rendered
+// playback, frames from other processes, ... HoloPlayContext calls update()
+// every frame instead of rendering the scene and draws whatever ended up in
+// the quilt texture.
+class QuiltSource
+{
+public:
+    virtual ~QuiltSource() {}
+
+    virtual QuiltLayout layout() const = 0;
+
+    // called on the render thread with the main context current. Puts the
+    // frame due at time (seconds since playback started) into quiltTexture,
+    // which is at least layout().width x layout().height. Returns false if
+    // the texture still holds the previous frame.
+    virtual bool update(GLuint quiltTexture, double time) = 0;
+
+    // a texture of the source's own to draw instead of quiltTexture, for
+    // frames that can't go into it (block compressed ones). Its size is
+    // layout().width x layout().height. 0 draws quiltTexture.
+    virtual GLuint texture() const { return 0; }
+};
+
+#endif // HOLOPLAY_QUILT_SOURCE_HPP
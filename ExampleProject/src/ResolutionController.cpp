@@ -0,0 +1,142 @@
+/**
+ * ResolutionController.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "ResolutionController.hpp"
+
+#include <cmath>
+
+using namespace std;
+
+// samples after a change before the controller acts again
+static const int SETTLE = 8;
+// consecutive smoothed samples over budget before the scale drops
+static const int OVER = 3;
+// consecutive smoothed samples under LOW * budget before it grows
+static const int UNDER = 60;
+static const float LOW = 0.7f;
+// weight of a new sample in the smoothed time
+static const float SMOOTHING = 0.2f;
+
+ResolutionController::ResolutionController(float budgetMs, float minScale, float step)
+    : next(0),
+      oldest(0),
+      timing(false),
+      budgetMs(budgetMs),
+      minScale(minScale),
+      step(step),
+      currentScale(1.0f),
+      generation(0),
+      smoothedMs(0.0f),
+      samples(0),
+      over(0),
+      under(0)
+{
+  glGenQueries(QUERIES, queries);
+  for (int i = 0; i < QUERIES; i++)
+  {
+    inFlight[i] = false;
+    generations[i] = 0;
+  }
+}
+
+ResolutionController::~ResolutionController()
+{
+  glDeleteQueries(QUERIES, queries);
+}
+
+void ResolutionController::beginFrame()
+{
+  // the query from QUERIES frames ago hasn't come back, skip this frame
+  timing = !inFlight[next];
+  if (timing)
+    glBeginQuery(GL_TIME_ELAPSED, queries[next]);
+}
+
+void ResolutionController::endFrame()
+{
+  if (!timing)
+    return;
+  glEndQuery(GL_TIME_ELAPSED);
+  inFlight[next] = true;
+  generations[next] = generation;
+  next = (next + 1) % QUERIES;
+  timing = false;
+}
+
+bool ResolutionController::update()
+{
+  const float before = currentScale;
+  // results come back in order, stop at the first that isn't ready
+  while (inFlight[oldest])
+  {
+    GLint available = 0;
+    glGetQueryObjectiv(queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+    GLuint64 nanoseconds = 0;
+    glGetQueryObjectui64v(queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+    inFlight[oldest] = false;
+    if (generations[oldest] == generation)
+      addSample(float(double(nanoseconds) / 1.0e6));
+    oldest = (oldest + 1) % QUERIES;
+  }
+  return currentScale != before;
+}
+
+void ResolutionController::addSample(float ms)
+{
+  smoothedMs = samples == 0 ? ms : smoothedMs + SMOOTHING * (ms - smoothedMs);
+  if (++samples < SETTLE)
+    return;
+
+  if (smoothedMs > budgetMs)
+  {
+    over++;
+    under = 0;
+  }
+  else if (smoothedMs < LOW * budgetMs)
+  {
+    under++;
+    over = 0;
+  }
+  else
+  {
+    over = 0;
+    under = 0;
+  }
+
+  if (over >= OVER && currentScale > minScale)
+  {
+    // the cost goes with the pixel count, the square of the scale. Drop
+    // straight to where the budget should be met, with a little headroom
+    float wanted = currentScale * sqrt(budgetMs / smoothedMs) * 0.95f;
+    float quantized = floor(wanted / step) * step;
+    if (quantized > currentScale - step)
+      quantized = currentScale - step;
+    setScale(quantized < minScale ? minScale : quantized);
+  }
+  else if (under >= UNDER && currentScale < 1.0f)
+  {
+    float grown = currentScale + step;
+    setScale(grown > 1.0f ? 1.0f : grown);
+  }
+}
+
+void ResolutionController::setScale(float scale)
+{
+  currentScale = scale;
+  // frames already in flight were rendered at the old scale
+  generation++;
+  samples = 0;
+  over = 0;
+  under = 0;
+}
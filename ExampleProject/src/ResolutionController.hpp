@@ -0,0 +1,66 @@
+/**
+ * ResolutionController.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_RESOLUTION_CONTROLLER_HPP
+#define HOLOPLAY_RESOLUTION_CONTROLLER_HPP
+
+#include <GL/glew.h>
+
+// Picks the fraction of the quilt resolution to render at so the GPU time
+// of a frame stays within a budget.
+//
+// The frame is timed with GL_TIME_ELAPSED queries kept in a small ring and
+// read back a few frames later, so timing never stalls the pipeline; a frame
+// whose query slot is still busy just isn't timed. The scale drops as soon
+// as the smoothed time has been over budget for a few frames, and only
+// grows again, one step at a time, after a long stretch well under budget.
+// Scales are quantized and timings of frames rendered before a change are
+// dropped, so the resolution doesn't flicker between two values.
+class ResolutionController
+{
+public:
+    // needs a current context, the same one as every other call
+    ResolutionController(float budgetMs, float minScale, float step = 0.05f);
+    ~ResolutionController();
+
+    void beginFrame(); // times the GPU work issued until endFrame()
+    void endFrame();
+
+    // collects finished timings, true if scale() changed
+    bool update();
+
+    float scale() const { return currentScale; }  // of each view's width and height
+    float gpuMs() const { return smoothedMs; }    // smoothed frame time
+
+private:
+    ResolutionController(const ResolutionController &);
+    ResolutionController &operator=(const ResolutionController &);
+
+    static const int QUERIES = 4;
+
+    void addSample(float ms);
+    void setScale(float scale);
+
+    GLuint queries[QUERIES];
+    bool inFlight[QUERIES];
+    int generations[QUERIES]; // scale generation the frame was rendered at
+    int next;
+    int oldest;
+    bool timing; // between beginFrame() and endFrame() of a timed frame
+
+    float budgetMs;
+    float minScale;
+    float step;
+    float currentScale;
+    int generation;
+    float smoothedMs;
+    int samples; // since the last change
+    int over, under;
+};
+
+#endif // HOLOPLAY_RESOLUTION_CONTROLLER_HPP
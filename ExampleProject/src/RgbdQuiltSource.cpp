@@ -0,0 +1,370 @@
+/**
+ * RgbdQuiltSource.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "RgbdQuiltSource.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <stdexcept>
+
+#include "stb_image.h"
+
+using namespace std;
+
+// depth step treated as an occlusion edge, as in rgbd.glsl
+static const float EDGE = 0.05f;
+
+static double secondsSince(const chrono::steady_clock::time_point &start)
+{
+  return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// part of an 8 or 16 bit image, top row first
+struct ImageRegion
+{
+  const unsigned char *data8;
+  const unsigned short *data16;
+  int stride;   // pixels per row
+  int channels;
+  int x, width, height;
+
+  float at(int px, int py, int channel) const
+  {
+    px = px < 0 ? 0 : (px >= width ? width - 1 : px);
+    py = py < 0 ? 0 : (py >= height ? height - 1 : py);
+    size_t i = (size_t(py) * size_t(stride) + size_t(x + px)) * size_t(channels) +
+               size_t(channel);
+    return data16 ? data16[i] / 65535.0f : data8[i] / 255.0f;
+  }
+
+  // bilinear, u and v from 0 to 1 over the region with v going up
+  float sample(float u, float v, int channel) const
+  {
+    float fx = u * width - 0.5f, fy = (1.0f - v) * height - 0.5f;
+    int x0 = int(floor(fx)), y0 = int(floor(fy));
+    float tx = fx - x0, ty = fy - y0;
+    float top = at(x0, y0, channel) * (1.0f - tx) + at(x0 + 1, y0, channel) * tx;
+    float bottom = at(x0, y0 + 1, channel) * (1.0f - tx) + at(x0 + 1, y0 + 1, channel) * tx;
+    return top * (1.0f - ty) + bottom * ty;
+  }
+};
+
+RgbdQuiltSource::RgbdQuiltSource(const std::string &colorPath,
+                                 const std::string &depthPath,
+                                 const QuiltLayout &layout, const RgbdSettings &settings,
+                                 ThreadPool &pool, const std::string &vertexShader,
+                                 GLuint quadVAO, GpuMemoryRegistry *memory)
+    : quilt(layout),
+      settings(settings),
+      program(NULL),
+      quadVAO(quadVAO),
+      colorTexture(0),
+      depthTexture(0),
+      fbo(0),
+      memory(memory),
+      done(false)
+{
+  viewWidth = layout.width / layout.columns;
+  viewHeight = layout.height / layout.rows;
+  quilt.width = viewWidth * layout.columns;
+  quilt.height = viewHeight * layout.rows;
+
+  int width, height, channels;
+  unsigned char *colorImage = stbi_load(colorPath.c_str(), &width, &height, &channels, 4);
+  if (!colorImage)
+    throw std::runtime_error("couldn't read " + colorPath + ": " + stbi_failure_reason());
+  ImageRegion colorRegion = {colorImage, NULL, width, 4, 0, width, height};
+
+  // 16 bit depth maps keep their precision
+  unsigned char *depth8 = NULL;
+  unsigned short *depth16 = NULL;
+  ImageRegion depthRegion = colorRegion;
+  depthRegion.channels = 1;
+  if (depthPath.empty())
+  {
+    // side by side, color on the left and depth on the right
+    colorRegion.width = width / 2;
+    depthRegion = colorRegion;
+    depthRegion.x = width / 2;
+    depthRegion.channels = 4;
+  }
+  else
+  {
+    int depthWidth, depthHeight;
+    if (stbi_is_16_bit(depthPath.c_str()))
+      depth16 = stbi_load_16(depthPath.c_str(), &depthWidth, &depthHeight, &channels, 1);
+    else
+      depth8 = stbi_load(depthPath.c_str(), &depthWidth, &depthHeight, &channels, 1);
+    if (!depth8 && !depth16)
+    {
+      stbi_image_free(colorImage);
+      throw std::runtime_error("couldn't read " + depthPath + ": " + stbi_failure_reason());
+    }
+    if (depthWidth * height != width * depthHeight)
+      cout << "[Warning] " << depthPath << " and " << colorPath
+           << " differ in aspect, the depth map is stretched" << endl;
+    ImageRegion region = {depth8, depth16, depthWidth, 1, 0, depthWidth, depthHeight};
+    depthRegion = region;
+  }
+
+  // crop to the aspect of a view, then resample both to its size
+  float sourceAspect = float(colorRegion.width) / float(colorRegion.height);
+  float viewAspect = float(viewWidth) / float(viewHeight);
+  float scaleX = 1.0f, scaleY = 1.0f;
+  if (sourceAspect > viewAspect)
+    scaleX = viewAspect / sourceAspect;
+  else
+    scaleY = sourceAspect / viewAspect;
+  color.resize(size_t(viewWidth) * size_t(viewHeight) * 4);
+  depth.resize(size_t(viewWidth) * size_t(viewHeight));
+  for (int y = 0; y < viewHeight; y++)
+  {
+    float v = 0.5f + ((y + 0.5f) / viewHeight - 0.5f) * scaleY;
+    for (int x = 0; x < viewWidth; x++)
+    {
+      float u = 0.5f + ((x + 0.5f) / viewWidth - 0.5f) * scaleX;
+      size_t i = size_t(y) * size_t(viewWidth) + size_t(x);
+      for (int c = 0; c < 4; c++)
+        color[i * 4 + size_t(c)] = (unsigned char)(colorRegion.sample(u, v, c) * 255.0f + 0.5f);
+      depth[i] = depthRegion.sample(u, v, 0);
+    }
+  }
+  stbi_image_free(colorImage);
+  stbi_image_free(depth8);
+  stbi_image_free(depth16);
+
+  cout << "[Info] synthesizing " << quilt.views << " views of " << viewWidth << "x"
+       << viewHeight << " from " << colorPath << " on the "
+       << (settings.cpu ? "CPU" : "GPU") << endl;
+
+  if (settings.cpu)
+  {
+    // the CPU reference runs in the background, one view per task
+    pixels.assign(size_t(quilt.width) * size_t(quilt.height) * 4, 0);
+    finished.assign(size_t(quilt.views), 0.0);
+    startTime = chrono::steady_clock::now();
+    for (int v = 0; v < quilt.views; v++)
+      tasks.push_back(pool.submit([this, v]() { synthesizeView(v); }));
+    return;
+  }
+
+  Shader vertex(GL_VERTEX_SHADER, vertexShader.c_str());
+  Shader fragment("../rgbd.glsl", GL_FRAGMENT_SHADER);
+  if (fragment.checkCompileError("../rgbd.glsl"))
+    throw std::runtime_error("couldn't compile ../rgbd.glsl");
+  program = new ShaderProgram({vertex, fragment});
+
+  GLuint textures[2];
+  glGenTextures(2, textures);
+  colorTexture = textures[0];
+  depthTexture = textures[1];
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  for (int i = 0; i < 2; i++)
+  {
+    glBindTexture(GL_TEXTURE_2D, textures[i]);
+    if (i == 0)
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, viewWidth, viewHeight, 0, GL_RGBA,
+                   GL_UNSIGNED_BYTE, color.data());
+    else
+      glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, viewWidth, viewHeight, 0, GL_RED,
+                   GL_FLOAT, depth.data());
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  }
+  glBindTexture(GL_TEXTURE_2D, 0);
+  if (memory)
+  {
+    memory->addTexture("rgbd color", colorTexture, GL_RGBA8, viewWidth, viewHeight);
+    memory->addTexture("rgbd depth", depthTexture, GL_R32F, viewWidth, viewHeight);
+  }
+  glGenFramebuffers(1, &fbo);
+}
+
+RgbdQuiltSource::~RgbdQuiltSource()
+{
+  for (size_t i = 0; i < tasks.size(); i++)
+    tasks[i].wait();
+  if (memory && colorTexture)
+  {
+    memory->remove(GpuMemoryRegistry::Texture, colorTexture);
+    memory->remove(GpuMemoryRegistry::Texture, depthTexture);
+  }
+  if (colorTexture)
+  {
+    GLuint textures[2] = {colorTexture, depthTexture};
+    glDeleteTextures(2, textures);
+  }
+  if (fbo)
+    glDeleteFramebuffers(1, &fbo);
+  delete program;
+}
+
+void RgbdQuiltSource::synthesizeView(int view)
+{
+  const float side =
+      quilt.views > 1 ? float(view) / float(quilt.views - 1) * 2.0f - 1.0f : 0.0f;
+  // pixels a point moves per unit of depth, see rgbd.glsl
+  const float k = -side * settings.strength * float(viewWidth);
+  const size_t quiltRow = size_t(quilt.width) * 4;
+  unsigned char *tile = &pixels[size_t((view / quilt.columns) * viewHeight) * quiltRow +
+                                size_t((view % quilt.columns) * viewWidth) * 4];
+
+  vector<float> nearest(static_cast<size_t>(viewWidth));
+  vector<int> from(static_cast<size_t>(viewWidth)); // source pixel, -1 for a hole
+  for (int y = 0; y < viewHeight; y++)
+  {
+    const float *depthRow = &depth[size_t(y) * size_t(viewWidth)];
+    const unsigned char *colorRow = &color[size_t(y) * size_t(viewWidth) * 4];
+    for (int x = 0; x < viewWidth; x++)
+    {
+      nearest[size_t(x)] = -1.0f;
+      from[size_t(x)] = -1;
+    }
+
+    // forward warp, the nearest point wins. Neighbours on the same surface
+    // cover the gap between them so the surface doesn't crack
+    for (int x = 0; x < viewWidth; x++)
+    {
+      float d = depthRow[x];
+      float t0 = float(x) + k * (d - settings.focus);
+      float t1 = t0 + 1.0f;
+      if (x + 1 < viewWidth && fabs(depthRow[x + 1] - d) < EDGE)
+        t1 = float(x + 1) + k * (depthRow[x + 1] - settings.focus);
+      int first = int(floor((t0 < t1 ? t0 : t1) + 0.5f));
+      int last = int(floor((t0 < t1 ? t1 : t0) + 0.5f));
+      if (last <= first)
+        last = first + 1;
+      for (int px = first < 0 ? 0 : first; px < last && px < viewWidth; px++)
+      {
+        if (d > nearest[size_t(px)])
+        {
+          nearest[size_t(px)] = d;
+          from[size_t(px)] = x;
+        }
+      }
+    }
+
+    // holes take the farther of the points on either side, the background
+    // the near surface moved away from
+    for (int x = 0; x < viewWidth;)
+    {
+      if (from[size_t(x)] >= 0)
+      {
+        x++;
+        continue;
+      }
+      int end = x;
+      while (end < viewWidth && from[size_t(end)] < 0)
+        end++;
+      int fill = -1;
+      if (x > 0 && end < viewWidth)
+        fill = nearest[size_t(x - 1)] < nearest[size_t(end)] ? from[size_t(x - 1)]
+                                                             : from[size_t(end)];
+      else if (x > 0)
+        fill = from[size_t(x - 1)];
+      else if (end < viewWidth)
+        fill = from[size_t(end)];
+      for (int px = x; px < end; px++)
+        from[size_t(px)] = fill;
+      x = end;
+    }
+
+    unsigned char *out = tile + size_t(y) * quiltRow;
+    for (int x = 0; x < viewWidth; x++)
+    {
+      int source = from[size_t(x)];
+      for (int c = 0; c < 3; c++)
+        out[x * 4 + c] = source < 0 ? 0 : colorRow[source * 4 + c];
+      out[x * 4 + 3] = 255;
+    }
+  }
+  finished[size_t(view)] = secondsSince(startTime);
+}
+
+void RgbdQuiltSource::synthesizeOnGpu(GLuint quiltTexture)
+{
+  chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, quiltTexture, 0);
+  glViewport(0, 0, quilt.width, quilt.height);
+
+  program->use();
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, colorTexture);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_2D, depthTexture);
+  program->setUniform("colorTex", 0);
+  program->setUniform("depthTex", 1);
+  program->setUniform("columns", quilt.columns);
+  program->setUniform("rows", quilt.rows);
+  program->setUniform("views", quilt.views);
+  program->setUniform("strength", settings.strength);
+  program->setUniform("focus", settings.focus);
+  program->setUniform("viewWidth", float(viewWidth));
+  glBindVertexArray(quadVAO);
+  glDrawArrays(GL_TRIANGLES, 0, 6);
+  glBindVertexArray(0);
+  program->unuse();
+  glBindTexture(GL_TEXTURE_2D, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+
+  // once only, worth waiting for to report the time
+  glFinish();
+  cout << "[Info] synthesized the quilt on the GPU in "
+       << secondsSince(start) * 1000.0 << " ms" << endl;
+}
+
+bool RgbdQuiltSource::update(GLuint quiltTexture, double)
+{
+  if (done)
+    return false;
+
+  if (!settings.cpu)
+  {
+    synthesizeOnGpu(quiltTexture);
+    done = true;
+    return true;
+  }
+
+  // keep the placeholder up until every view is done
+  for (size_t i = 0; i < tasks.size(); i++)
+  {
+    if (tasks[i].wait_for(chrono::seconds(0)) != future_status::ready)
+      return false;
+  }
+  double slowest = 0.0;
+  for (size_t i = 0; i < finished.size(); i++)
+    slowest = finished[i] > slowest ? finished[i] : slowest;
+  cout << "[Info] synthesized the quilt on the CPU in " << slowest * 1000.0 << " ms"
+       << endl;
+
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, quiltTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, quilt.width, quilt.height, GL_RGBA,
+                  GL_UNSIGNED_BYTE, pixels.data());
+  glBindTexture(GL_TEXTURE_2D, 0);
+  tasks.clear();
+  pixels = vector<unsigned char>();
+  done = true;
+  return true;
+}
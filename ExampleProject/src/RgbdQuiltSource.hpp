@@ -0,0 +1,93 @@
+/**
+ * RgbdQuiltSource.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_RGBD_QUILT_SOURCE_HPP
+#define HOLOPLAY_RGBD_QUILT_SOURCE_HPP
+
+#include <chrono>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "GpuMemory.hpp"
+#include "QuiltSource.hpp"
+#include "Shader.hpp"
+#include "ThreadPool.hpp"
+
+struct RgbdSettings
+{
+    float strength = 0.04f; // shift of the nearest points in the outermost
+                            // views, as a fraction of the view width
+    float focus = 0.5f;     // depth that stays in place in every view
+    bool cpu = false;       // synthesize with the CPU reference
+};
+
+// Synthesizes every view of the quilt from a single color image and its
+// depth map (white is near), so one rendered or photographed view stands in
+// for the whole light field.
+//
+// Views are reprojected across the view cone by shifting points sideways in
+// proportion to their distance from the focus depth. Disoccluded areas are
+// filled from the background side of the edge that opened them. There are
+// two implementations writing the same quilt:
+//  - GPU (default): one fullscreen pass over the quilt; every pixel marches
+//    the depth map backwards, near to far, for the first surface it sees.
+//  - CPU reference: every view is forward warped with a depth test on the
+//    worker pool, row by row, then its holes are filled.
+//
+// The images are cropped to the aspect of a view. The quilt is made once.
+class RgbdQuiltSource : public QuiltSource
+{
+public:
+    // depthPath empty: the right half of the color image is the depth map.
+    // Throws std::runtime_error if the images can't be read. Needs the
+    // context update() is called in current; vertexShader and quadVAO are
+    // the fullscreen quad the scene is rendered with
+    RgbdQuiltSource(const std::string &colorPath, const std::string &depthPath,
+                    const QuiltLayout &layout, const RgbdSettings &settings,
+                    ThreadPool &pool, const std::string &vertexShader,
+                    GLuint quadVAO, GpuMemoryRegistry *memory = NULL);
+    ~RgbdQuiltSource(); // waits for the CPU reference, same context
+
+    QuiltLayout layout() const { return quilt; }
+    bool update(GLuint quiltTexture, double time);
+
+private:
+    RgbdQuiltSource(const RgbdQuiltSource &);
+    RgbdQuiltSource &operator=(const RgbdQuiltSource &);
+
+    // CPU reference: view v of the quilt into pixels, rows bottom to top
+    void synthesizeView(int view);
+    // GPU: the whole quilt into quiltTexture
+    void synthesizeOnGpu(GLuint quiltTexture);
+
+    QuiltLayout quilt;
+    RgbdSettings settings;
+    int viewWidth, viewHeight;
+
+    // source images resampled to a view, rows bottom to top
+    std::vector<unsigned char> color; // RGBA8
+    std::vector<float> depth;         // 0 far, 1 near
+
+    // CPU reference
+    std::vector<unsigned char> pixels; // the quilt, RGBA8
+    std::vector<std::future<void>> tasks;
+    std::vector<double> finished; // per view, seconds after startTime
+    std::chrono::steady_clock::time_point startTime;
+
+    // GPU
+    ShaderProgram *program;
+    GLuint quadVAO;
+    GLuint colorTexture, depthTexture;
+    GLuint fbo;
+    GpuMemoryRegistry *memory;
+
+    bool done;
+};
+
+#endif // HOLOPLAY_RGBD_QUILT_SOURCE_HPP
@@ -13,152 +13,547 @@
 #include "SampleScene.hpp"
 
 #include <GLFW/glfw3.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <functional>
 #include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/matrix_operation.hpp>
 #include <iostream>
+#include <stdexcept>
 #include <vector>
 
+#include "Mesh.hpp"
 #include "glError.hpp"
 
+using namespace std;
+
 #ifdef _DEBUG
 static const bool capture_mouse = false;
 #else
 static const bool capture_mouse = true;
 #endif
 
-struct VertexType
+// the field of objects
+static const float SPACING = 1.0f;      // between object centers
+static const float OBJECT_SCALE = 0.3f; // of the unit size meshes
+static const float GROUND_Y = -0.5f;
+static const float TORUS_TUBE = 0.35f;
+static const float TORUS_TILT = 0.5f;
+static const float SWAY_ANGLE = 0.3f;   // most the top bone turns, radians
+
+// the ground takes GROUND_TILES x GROUND_TILES object tiles of the atlas
+static const int GROUND_TILES = 4;
+
+enum MeshKind
 {
-  glm::vec3 position;
-  glm::vec3 normal;
-  glm::vec4 color;
+  SPHERE,
+  TORUS,
+  BOX,
+  GROUND,
+  MESH_KINDS
 };
 
-SampleScene::SampleScene() : HoloPlayContext(capture_mouse)
+static HoloPlayOptions withMeshes(HoloPlayOptions options)
+{
+  options.meshScene = true;
+  options.sceneGpuBytes = &SampleScene::gpuBytes;
+  return options;
+}
+
+SampleScene::SampleScene(const HoloPlayOptions &options)
+    : HoloPlayContext(capture_mouse, withMeshes(options))
 {
   glCheckError(__FILE__, __LINE__);
 
-  // creation of the mesh ------------------------------------------------------
-  std::vector<VertexType> vertices;
-  std::vector<GLuint> indices;
+  createMeshes();
+  createObjects(this->options.meshObjects);
+  layoutAtlas();
+  setupAtlas();
+  setupFrameResources();
+  if (this->options.gpuCulling)
+    setupIndirectDraws();
+  loadShaders();
+  if (!forwardShader || !atlasShader || !shadedShader || !shadowShader || !transformShader ||
+      !forwardViewShader || !shadedViewShader ||
+      (this->options.gpuCulling && (!cullShader || !forwardDrawsShader || !shadedDrawsShader)))
+    throw std::runtime_error("the mesh shaders don't compile");
+  update();
 
-  VertexType v;
-  v.normal = glm::vec3(0., 0., 1.);
-  v.color  = glm::vec4(0., 0., 1., 0.);
+  cout << "[Info] " << objects.size() - 1 << " objects, "
+       << (this->options.textureSpaceShading ? "texture space" : "forward")
+       << " shading, vertices transformed "
+       << (this->options.meshTransformPerView ? "in every view" : "once per frame")
+       << ", culled on the " << (this->options.gpuCulling ? "GPU" : "CPU")
+       << ", T times both" << endl;
+  glCheckError(__FILE__, __LINE__);
+}
 
-  for (float x = -1.; x <= 1.; x += 2) {
-    for (float y = -1.; y <= 1.; y += 2) {
-      v.position = glm::vec3(x,  y, -1.);
-      vertices.push_back(v);
-    }
+// attributes 0, 1 and 2 of MeshVertex, as the shaders fix them
+static GLuint createVertexArray(GLuint vertices, GLuint indices)
+{
+  GLuint vao;
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+  glBindBuffer(GL_ARRAY_BUFFER, vertices);
+  glEnableVertexAttribArray(0);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, position));
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, normal));
+  glEnableVertexAttribArray(2);
+  glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(MeshVertex),
+                        (void *)offsetof(MeshVertex, uv));
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indices);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  return vao;
+}
+
+// one mesh of every kind, the ground sized for objectCount objects
+static vector<Mesh> makeMeshKinds(int objectCount, float &fieldSize)
+{
+  const int side = int(ceil(sqrt(double(max(objectCount, 1)))));
+  vector<Mesh> kinds(MESH_KINDS);
+  kinds[SPHERE] = makeSphere(32, 16);
+  kinds[TORUS] = makeTorus(TORUS_TUBE, 32, 16);
+  kinds[BOX] = makeBox();
+  fieldSize = float(side + 2) * SPACING;
+  kinds[GROUND] = makeGround(fieldSize, 16);
+  return kinds;
+}
+
+// Diffuse light changes slowly over a surface, so a tile gets about two
+// texels per pixel of an object's diameter in a view, at the camera size the
+// scene starts with. The ground spans whole views and gets a block of tiles
+static void atlasGrid(int objectCount, int viewHeight, float sphereRadius, float cameraSize,
+                      int &columns, int &rows, int &tile)
+{
+  const float diameter =
+      2.0f * OBJECT_SCALE * sphereRadius * float(viewHeight) / (2.0f * cameraSize);
+  tile = 16;
+  while (float(tile) < 2.0f * diameter && tile < 256)
+    tile *= 2;
+
+  GLint maxSize = 0;
+  glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+  const int limit = min(int(maxSize), 8192);
+  const int cells = objectCount - 1 + GROUND_TILES * GROUND_TILES;
+  columns = max(GROUND_TILES, int(ceil(sqrt(double(cells)))));
+  rows = max(GROUND_TILES, (cells + columns - 1) / columns);
+  while ((columns * tile > limit || rows * tile > limit) && tile > 4)
+    tile /= 2;
+}
+
+// what the constructor allocates for these options once the quilts exist,
+// with the per view buffers sized for views. The context counts it against
+// the GPU memory budget before allocating the quilts
+size_t SampleScene::gpuBytes(const HoloPlayOptions &options, int views, int viewHeight,
+                             float cameraSize)
+{
+  float field;
+  vector<Mesh> kinds = makeMeshKinds(options.meshObjects, field);
+  const size_t objects = size_t(max(options.meshObjects, 0)) + 1; // and the ground
+  size_t vertices = 0, indices = 0;
+  for (size_t k = 0; k < kinds.size(); k++)
+  {
+    vertices += kinds[k].vertices.size();
+    indices += kinds[k].indices.size();
   }
+  size_t worldVertices = kinds[GROUND].vertices.size();
+  for (int i = 0; i < options.meshObjects; i++)
+    worldVertices += kinds[size_t(i % 3)].vertices.size();
+  int columns, rows, tile;
+  atlasGrid(int(objects), viewHeight, kinds[SPHERE].radius, cameraSize, columns, rows, tile);
 
-  // two triangles
-  indices.push_back(0);
-  indices.push_back(1);
-  indices.push_back(2);
-    
-  indices.push_back(1);
-  indices.push_back(2);
-  indices.push_back(3);
-  
-  std::cout << "vertices=" << vertices.size() << std::endl;
-  std::cout << "index=" << indices.size() << std::endl;
+  size_t bytes = (vertices + worldVertices) * sizeof(MeshVertex) + indices * sizeof(GLuint) +
+                 GpuMemoryRegistry::textureBytes(GL_RGBA16F, columns * tile, rows * tile) +
+                 sizeof(FrameBlock) +
+                 GpuMemoryRegistry::textureBytes(GL_DEPTH_COMPONENT24, SHADOW_SIZE, SHADOW_SIZE);
+  // objects, bounds, and per view its View, a draw command and a draw index
+  // per object
+  if (options.gpuCulling)
+    bytes += objects * (sizeof(GpuObject) + sizeof(glm::vec4)) +
+             size_t(views) * (sizeof(GpuView) + objects * 6 * sizeof(GLuint));
+  return bytes;
+}
+
+// creation of the meshes, one vertex and index buffer for all of them
+void SampleScene::createMeshes()
+{
+  vector<Mesh> kinds = makeMeshKinds(options.meshObjects, fieldSize);
 
-  // creation of the vertex array buffer----------------------------------------
+  vector<MeshVertex> vertices;
+  vector<GLuint> indices;
+  for (size_t k = 0; k < kinds.size(); k++)
+  {
+    MeshRange range;
+    range.baseVertex = GLint(vertices.size());
+    range.firstIndex = GLsizei(indices.size());
+    range.count = GLsizei(kinds[k].indices.size());
+    range.vertexCount = GLsizei(kinds[k].vertices.size());
+    range.radius = kinds[k].radius;
+    meshes.push_back(range);
+    vertices.insert(vertices.end(), kinds[k].vertices.begin(), kinds[k].vertices.end());
+    indices.insert(indices.end(), kinds[k].indices.begin(), kinds[k].indices.end());
+  }
 
   // vbo
   glGenBuffers(1, &vbo);
   glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(VertexType)),
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(vertices.size() * sizeof(MeshVertex)),
                vertices.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gpuMemory.addBuffer("mesh vertices", vbo, vertices.size() * sizeof(MeshVertex));
 
   // ibo
   glGenBuffers(1, &ibo);
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
   glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(indices.size() * sizeof(GLuint)),
                indices.data(), GL_STATIC_DRAW);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+  gpuMemory.addBuffer("mesh indices", ibo, indices.size() * sizeof(GLuint));
 
-  // vao
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  vao = createVertexArray(vbo, ibo);
+}
 
-  // bind vbo
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+// count objects on a square grid around the origin, resting on the ground
+void SampleScene::createObjects(int count)
+{
+  static const glm::vec3 palette[6] = {
+      glm::vec3(0.80f, 0.25f, 0.20f), glm::vec3(0.20f, 0.55f, 0.80f),
+      glm::vec3(0.90f, 0.70f, 0.20f), glm::vec3(0.30f, 0.70f, 0.35f),
+      glm::vec3(0.65f, 0.35f, 0.75f), glm::vec3(0.85f, 0.85f, 0.80f)};
+  const int side = int(ceil(sqrt(double(max(count, 1)))));
+
+  SceneObject ground = SceneObject();
+  ground.mesh = GROUND;
+  ground.position = glm::vec3(0.0f, GROUND_Y, 0.0f);
+  ground.scale = 1.0f;
+  ground.albedo = glm::vec3(0.35f, 0.33f, 0.30f);
+  ground.specularity = 0.1f;
+  objects.push_back(ground);
 
-  const char *fragmentShaderSource = R"--(
-    #version 150
+  for (int i = 0; i < count; i++)
+  {
+    SceneObject object = SceneObject();
+    object.mesh = i % 3;
+    object.scale = OBJECT_SCALE;
+    object.tilt = object.mesh == TORUS ? TORUS_TILT : 0.0f;
+    // resting on the ground at any spin
+    float lift = object.mesh == TORUS ? sin(TORUS_TILT) + TORUS_TUBE : 1.0f;
+    object.position = glm::vec3((float(i % side) - 0.5f * float(side - 1)) * SPACING,
+                                GROUND_Y + lift * OBJECT_SCALE,
+                                (float(i / side) - 0.5f * float(side - 1)) * SPACING);
+    object.spin = 0.3f + 0.1f * float(i % 7);
+    object.albedo = palette[(i / 3 + i) % 6];
+    object.specularity = object.mesh == BOX ? 0.2f : 0.8f;
+    objects.push_back(object);
+  }
+
+  // objects only spin in place, so the neighbours blocking an object's sky
+  // are fixed: the nearest ones, which the grid puts within two cells
+  for (size_t i = 1; i < objects.size(); i++)
+  {
+    const int x = int(i - 1) % side, y = int(i - 1) / side;
+    vector<pair<float, size_t> > near;
+    for (int dy = -2; dy <= 2; dy++)
+    {
+      for (int dx = -2; dx <= 2; dx++)
+      {
+        int nx = x + dx, ny = y + dy;
+        size_t n = size_t(ny * side + nx) + 1;
+        if ((dx == 0 && dy == 0) || nx < 0 || nx >= side || ny < 0 || n >= objects.size())
+          continue;
+        near.push_back(make_pair(glm::length(objects[n].position - objects[i].position), n));
+      }
+    }
+    sort(near.begin(), near.end());
+    for (size_t o = 0; o < size_t(OCCLUDERS) && o < near.size(); o++)
+    {
+      const SceneObject &n = objects[near[o].second];
+      objects[i].occluders[o] = glm::vec4(n.position, n.scale * meshes[size_t(n.mesh)].radius);
+    }
+  }
+  models.resize(objects.size());
+  sways.resize(objects.size(), glm::mat4(1.0f));
+  culler.resize(objects.size());
+  bounds.resize(objects.size());
+
+  // the world stream: every object's own copy of its mesh's vertices, drawn
+  // with the mesh's indices
+  GLint vertices = 0;
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    objects[i].worldBase = vertices;
+    vertices += meshes[size_t(objects[i].mesh)].vertexCount;
+  }
+  glGenBuffers(1, &worldVBO);
+  glBindBuffer(GL_ARRAY_BUFFER, worldVBO);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(size_t(vertices) * sizeof(MeshVertex)), NULL,
+               GL_DYNAMIC_COPY);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  gpuMemory.addBuffer("world vertices", worldVBO, size_t(vertices) * sizeof(MeshVertex));
+  worldVao = createVertexArray(worldVBO, ibo);
+}
 
-    in vec4 fPosition;
-    in vec4 fColor;
-    in vec4 fLightPosition;
-    in vec3 fNormal;
+// the ground's block of tiles in the corner, then a tile per object
+void SampleScene::layoutAtlas()
+{
+  int viewHeight = 0;
+  for (size_t q = 0; q < quilts.size(); q++)
+    viewHeight = max(viewHeight, quilts[q].qs_height / quilts[q].qs_rows);
+  int columns, rows, tile;
+  atlasGrid(int(objects.size()), viewHeight, meshes[SPHERE].radius, cameraSize, columns, rows,
+            tile);
 
-    // output
-    out vec4 color;
+  objects[0].atlasRect = glm::ivec4(0, 0, GROUND_TILES * tile, GROUND_TILES * tile);
+  int cell = 0;
+  for (size_t i = 1; i < objects.size(); i++)
+  {
+    int x, y;
+    do
+    {
+      x = cell % columns;
+      y = cell / columns;
+      cell++;
+    } while (x < GROUND_TILES && y < GROUND_TILES);
+    objects[i].atlasRect = glm::ivec4(x * tile, y * tile, tile, tile);
+  }
+  atlasWidth = columns * tile;
+  atlasHeight = rows * tile;
+  cout << "[Info] shading atlas of " << atlasWidth << "x" << atlasHeight << " texels, "
+       << tile << "x" << tile << " per object" << endl;
+}
 
-    void main(void)
-    {       
-        vec3 o =-normalize(fPosition.xyz);
-        vec3 n = normalize(fNormal);
-        vec3 r = reflect(o,n);
-        vec3 l = normalize(fLightPosition.xyz-fPosition.xyz);
+void SampleScene::setupAtlas()
+{
+  glGenTextures(1, &atlasTexture);
+  glBindTexture(GL_TEXTURE_2D, atlasTexture);
+  // light, not colors: half floats keep what is over 1 and the dark ends
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, atlasWidth, atlasHeight, 0, GL_RGBA, GL_FLOAT,
+               NULL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gpuMemory.addTexture("shading atlas", atlasTexture, GL_RGBA16F, atlasWidth, atlasHeight);
 
-        float ambient = 0.1;
-        float diffus = 0.7*max(0.0,dot(n,l));
-        float specular = 0.6*pow(max(0.0,-dot(r,l)),4.0);
+  glGenFramebuffers(1, &atlasFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, atlasFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, atlasTexture, 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    cout << "[Error] the shading atlas framebuffer is incomplete" << endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-        color = vec4(ambient + fColor.xyz * diffus + specular, fColor.w);
-    }
-  )--";
-  const char *vertexShaderSource = R"--(
-    #version 150
+// the sun never moves, so its shadow map's projection is set once
+void SampleScene::setupFrameResources()
+{
+  frame = FrameBlock();
+  frame.sunDirection = glm::vec4(glm::normalize(glm::vec3(-0.4f, 1.0f, 0.3f)), 0.0f);
+  frame.sunColor = glm::vec4(0.9f, 0.85f, 0.75f, 0.0f);
+  frame.skyColor = glm::vec4(0.25f, 0.3f, 0.4f, 0.0f);
+  const float half = 0.5f * fieldSize;
+  frame.lightGrid = glm::vec4(-half, -half, fieldSize / float(LIGHT_GRID), 0.0f);
 
-    in vec3 position;
-    in vec3 normal;
-    in vec4 color;
+  // an orthographic box around the ground and everything on it
+  const float reach = 0.75f * fieldSize;
+  glm::mat4 lightView = glm::lookAt(2.0f * reach * glm::vec3(frame.sunDirection),
+                                    glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+  frame.lightSpace =
+      glm::ortho(-reach, reach, -reach, reach, 0.0f, 4.0f * reach) * lightView;
 
-    uniform mat4 projection;
-    uniform mat4 view;
+  glGenBuffers(1, &frameUBO);
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+  glBufferData(GL_UNIFORM_BUFFER, sizeof(FrameBlock), NULL, GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  gpuMemory.addBuffer("frame block", frameUBO, sizeof(FrameBlock));
 
-    out vec4 fPosition;
-    out vec4 fColor;
-    out vec4 fLightPosition;
-    out vec3 fNormal;
+  glGenTextures(1, &shadowTexture);
+  glBindTexture(GL_TEXTURE_2D, shadowTexture);
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, SHADOW_SIZE, SHADOW_SIZE, 0,
+               GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+  // compared in the sampler, linear filtering blends four comparisons
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glBindTexture(GL_TEXTURE_2D, 0);
+  gpuMemory.addTexture("shadow map", shadowTexture, GL_DEPTH_COMPONENT24, SHADOW_SIZE,
+                       SHADOW_SIZE);
 
-    void main(void)
-    {
-        fPosition = view * vec4(position,1.0);
-        fLightPosition = view * vec4(0.0,0.0,1.0,1.0);
+  glGenFramebuffers(1, &shadowFBO);
+  glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadowTexture, 0);
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    cout << "[Error] the shadow map framebuffer is incomplete" << endl;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
 
-        fColor = color;
-        fNormal = vec3(view * vec4(normal,0.0));
+// What the cull pass and the indirect draws read of the objects doesn't
+// change, so it is uploaded once, with the world stream's ranges
+void SampleScene::setupIndirectDraws()
+{
+  vector<GpuObject> gpuObjects(objects.size());
+  const glm::vec4 atlasSize(atlasWidth, atlasHeight, atlasWidth, atlasHeight);
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    const SceneObject &o = objects[i];
+    const MeshRange &mesh = meshes[size_t(o.mesh)];
+    gpuObjects[i].color = glm::vec4(o.albedo, o.specularity);
+    gpuObjects[i].atlasRect = glm::vec4(o.atlasRect) / atlasSize;
+    gpuObjects[i].draw[0] = GLuint(mesh.count);
+    gpuObjects[i].draw[1] = GLuint(mesh.firstIndex);
+    gpuObjects[i].draw[2] = GLuint(o.worldBase);
+    gpuObjects[i].draw[3] = 0;
+    for (int n = 0; n < OCCLUDERS; n++)
+      gpuObjects[i].occluders[n] = o.occluders[n];
+  }
+  glGenBuffers(1, &objectsSSBO);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, objectsSSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(gpuObjects.size() * sizeof(GpuObject)),
+               gpuObjects.data(), GL_STATIC_DRAW);
+  gpuMemory.addBuffer("mesh objects", objectsSSBO, gpuObjects.size() * sizeof(GpuObject));
 
-        // gl_Position = projection * fPosition;
-    }
-  )--";
-  Shader vertexShader(GL_VERTEX_SHADER, vertexShaderSource);
-  Shader fragmentShader(GL_FRAGMENT_SHADER, fragmentShaderSource);
+  glGenBuffers(1, &boundsSSBO);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsSSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(objects.size() * sizeof(glm::vec4)), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  gpuMemory.addBuffer("mesh bounds", boundsSSBO, objects.size() * sizeof(glm::vec4));
 
-  shaderProgram = new ShaderProgram({vertexShader, fragmentShader});
+  glGenBuffers(1, &viewsSSBO);
+  glGenBuffers(1, &commandBuffer);
+  glGenBuffers(1, &drawIdBuffer);
+  drawVao = createVertexArray(worldVBO, ibo);
+  int views = 0;
+  for (size_t q = 0; q < quilts.size(); q++)
+    views = max(views, quilts[q].qs_totalViews);
+  reserveViews(size_t(views));
+}
 
-  // map vbo to shader attributes
-  shaderProgram->setAttribute("position", 3, sizeof(VertexType),
-                              offsetof(VertexType, position));
-  shaderProgram->setAttribute("normal", 3, sizeof(VertexType),
-                              offsetof(VertexType, normal));
-  shaderProgram->setAttribute("color", 4, sizeof(VertexType),
-                              offsetof(VertexType, color));
+// room for views in the buffers that hold something per view, kept when
+// there is already enough
+void SampleScene::reserveViews(size_t views)
+{
+  if (views <= maxViews)
+    return;
+  if (maxViews > 0)
+  {
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, viewsSSBO);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, commandBuffer);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, drawIdBuffer);
+  }
+  maxViews = views;
+  const size_t draws = objects.size() * views;
 
-  // bind the ibo
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewsSSBO);
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(views * sizeof(GpuView)), NULL,
+               GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, commandBuffer);
+  // five GLuints of DrawElementsIndirectCommand each, only the GPU writes them
+  glBufferData(GL_SHADER_STORAGE_BUFFER, GLsizeiptr(draws * 5 * sizeof(GLuint)), NULL,
+               GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  gpuMemory.addBuffer("mesh views", viewsSSBO, views * sizeof(GpuView));
+  gpuMemory.addBuffer("mesh draw commands", commandBuffer, draws * 5 * sizeof(GLuint));
 
-  // vao end
+  vector<GLuint> ids(draws);
+  for (size_t d = 0; d < draws; d++)
+    ids[d] = GLuint(d);
+  glBindBuffer(GL_ARRAY_BUFFER, drawIdBuffer);
+  glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(draws * sizeof(GLuint)), ids.data(), GL_STATIC_DRAW);
+  gpuMemory.addBuffer("mesh draw indices", drawIdBuffer, draws * sizeof(GLuint));
+  // attribute 3 of mesh_draws_vertex.glsl, one per instance: a draw's only
+  // instance reads the entry of its base instance
+  glBindVertexArray(drawVao);
+  glEnableVertexAttribArray(3);
+  glVertexAttribIPointer(3, 1, GL_UNSIGNED_INT, sizeof(GLuint), (void *)0);
+  glVertexAttribDivisor(3, 1);
   glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 }
 
-// process input: query GLFW if relevant keys are pressed/released 
+void SampleScene::loadShaders()
+{
+  // the shadow map's program last, the lit ones before it. The indirect
+  // draws' ones (DRAWS) only with gpuCulling
+  static const int PROGRAMS = 8, LIT = 7, DRAWS = 5;
+  const char *paths[PROGRAMS][2] = {
+      {"../mesh_world_vertex.glsl", "../mesh.glsl"},
+      {"../mesh_world_vertex.glsl", "../mesh_shaded.glsl"},
+      {"../mesh_vertex.glsl", "../mesh.glsl"},
+      {"../mesh_vertex.glsl", "../mesh_shaded.glsl"},
+      {"../mesh_atlas_vertex.glsl", "../mesh_atlas.glsl"},
+      {"../mesh_draws_vertex.glsl", "../mesh.glsl"},
+      {"../mesh_draws_vertex.glsl", "../mesh_shaded.glsl"},
+      {"../mesh_shadow_vertex.glsl", "../mesh_shadow.glsl"}};
+  ShaderProgram **programs[PROGRAMS] = {
+      &forwardShader,      &shadedShader,      &forwardViewShader, &shadedViewShader,
+      &atlasShader,        &forwardDrawsShader, &shadedDrawsShader, &shadowShader};
+  for (int i = 0; i < PROGRAMS; i++)
+  {
+    const bool draws = i == DRAWS || i == DRAWS + 1;
+    if (draws && !options.gpuCulling)
+      continue;
+    // the fragment shaders include the lighting of mesh.glsl, which the
+    // draws' programs compile as GLSL 4.30 with GPU_DRAWS in place of the
+    // #version line
+    string fragSource = readShaderSource(paths[i][1]);
+    if (draws)
+      fragSource = "#version 430 core\n#define GPU_DRAWS\n" +
+                   fragSource.substr(fragSource.find('\n') + 1);
+    Shader vertShader(GL_VERTEX_SHADER, readShaderSource(paths[i][0]).c_str());
+    Shader fragShader(GL_FRAGMENT_SHADER, fragSource.c_str());
+    if (vertShader.checkCompileError(paths[i][0]) || fragShader.checkCompileError(paths[i][1]))
+      continue;
+    delete *programs[i];
+    *programs[i] = new ShaderProgram({vertShader, fragShader});
+    if (i >= LIT)
+      continue;
+    // the lit programs read the frame resources where bindFrameResources() puts them
+    ShaderProgram *program = *programs[i];
+    program->bindUniformBlock("Frame", FRAME_BINDING);
+    program->use();
+    program->setUniform("shadowMap", SHADOW_UNIT);
+    if (program == shadedShader || program == shadedViewShader || program == shadedDrawsShader)
+      program->setUniform("atlas", 0);
+    if (draws)
+      program->setUniform("objectCount", int(objects.size()));
+    program->unuse();
+  }
+
+  if (options.gpuCulling)
+  {
+    Shader cull("../mesh_cull.glsl", GL_COMPUTE_SHADER);
+    if (!cull.checkCompileError("../mesh_cull.glsl"))
+    {
+      delete cullShader;
+      cullShader = new ShaderProgram({cull});
+      cullShader->use();
+      cullShader->setUniform("objectCount", int(objects.size()));
+      cullShader->unuse();
+    }
+  }
+
+  // vertex shader only, its outputs captured as MeshVertex
+  Shader transform(GL_VERTEX_SHADER, readShaderSource("../mesh_transform.glsl").c_str());
+  if (!transform.checkCompileError("../mesh_transform.glsl"))
+  {
+    delete transformShader;
+    transformShader = new ShaderProgram({transform}, {"wPosition", "wNormal", "wUV"});
+  }
+  glCheckError(__FILE__, __LINE__);
+}
+
+// process input: query GLFW if relevant keys are pressed/released
 // if ESC pressed, return false
 // ---------------------------------------------------------------------------------------------------------
 bool SampleScene::processInput(GLFWwindow *window)
@@ -174,9 +569,7 @@ bool SampleScene::processInput(GLFWwindow *window)
   if (debug != new_debug)
   {
     debug = new_debug;
-    lightFieldShader->use();
-    lightFieldShader->setUniform("debug", debug);
-    lightFieldShader->unuse();
+    setLightFieldDebug(debug);
   }
 
   // Here add your code to control the camera by keys
@@ -195,6 +588,15 @@ bool SampleScene::processInput(GLFWwindow *window)
   return true;
 }
 
+void SampleScene::key_callback(GLFWwindow *window, int key, int scancode, int action, int mods)
+{
+  HoloPlayContext::key_callback(window, key, scancode, action, mods);
+  if (key == GLFW_KEY_R && action == GLFW_PRESS)
+    loadShaders();
+  if (key == GLFW_KEY_T && action == GLFW_PRESS)
+    benchmarkShading();
+}
+
 // glfw: whenever the mouse moves, this callback is called
 // -------------------------------------------------------
 void SampleScene::mouse_callback(GLFWwindow*, double xpos, double ypos)
@@ -249,17 +651,117 @@ void SampleScene::scroll_callback(GLFWwindow*,
     cameraSize = MAX_SIZE;
 }
 
+// objects spin in place and sway, and the point lights circle the field
 void SampleScene::update()
 {
-  // add your updates for each frame here
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    const SceneObject &object = objects[i];
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), object.position);
+    model = glm::rotate(model, object.spin * time + float(i), glm::vec3(0.0f, 1.0f, 0.0f));
+    model = glm::rotate(model, object.tilt, glm::vec3(1.0f, 0.0f, 0.0f));
+    models[i] = glm::scale(model, glm::vec3(object.scale));
+    const float radius = meshes[size_t(object.mesh)].radius;
+    if (i == 0)
+    {
+      bounds[i] = glm::vec4(object.position, radius);
+      culler.setSphere(i, object.position, radius);
+      continue;
+    }
+    // the top bone bends about the bottom of the mesh, the ground stays flat
+    glm::mat4 sway = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+    sway = glm::rotate(sway, SWAY_ANGLE * sin(2.0f * time + float(i)),
+                       glm::vec3(cos(float(i)), 0.0f, sin(float(i))));
+    sways[i] = glm::translate(sway, glm::vec3(0.0f, 1.0f, 0.0f));
+    // no vertex is further than radius + 1 from the bone's pivot
+    const float reach = 2.0f * (radius + 1.0f) * sin(0.5f * SWAY_ANGLE);
+    bounds[i] = glm::vec4(object.position, object.scale * (radius + reach));
+    culler.setSphere(i, object.position, bounds[i].w);
+  }
+  // two rings of lights turning opposite ways, each reaching a few cells
+  static const glm::vec3 colors[4] = {glm::vec3(1.0f, 0.3f, 0.2f), glm::vec3(0.2f, 0.5f, 1.0f),
+                                      glm::vec3(0.3f, 1.0f, 0.4f), glm::vec3(1.0f, 0.8f, 0.3f)};
+  for (int l = 0; l < POINT_LIGHTS; l++)
+  {
+    const int ring = l % 2;
+    const float orbit = (0.2f + 0.2f * float(ring)) * fieldSize;
+    float angle = (ring ? -0.3f : 0.4f) * time + float(l) * 6.2831853f / float(POINT_LIGHTS);
+    frame.lightPositions[l] = glm::vec4(orbit * cos(angle), GROUND_Y + 0.8f, orbit * sin(angle),
+                                        2.5f * SPACING);
+    frame.lightColors[l] = glm::vec4(1.5f * colors[l % 4], 0.0f);
+  }
+  buildLightGrid();
+}
+
+// A light reaches a cell when its range touches the box over the cell that
+// holds the objects, so the shaders loop over a few lights instead of all
+void SampleScene::buildLightGrid()
+{
+  const float cell = frame.lightGrid.z;
+  const float bottom = GROUND_Y, top = GROUND_Y + 2.0f * OBJECT_SCALE * meshes[SPHERE].radius;
+  for (int y = 0; y < LIGHT_GRID; y++)
+  {
+    for (int x = 0; x < LIGHT_GRID; x++)
+    {
+      const glm::vec3 low(frame.lightGrid.x + float(x) * cell, bottom,
+                          frame.lightGrid.y + float(y) * cell);
+      const glm::vec3 high = low + glm::vec3(cell, top - bottom, cell);
+      GLuint lights = 0;
+      for (int l = 0; l < POINT_LIGHTS; l++)
+      {
+        const glm::vec3 p(frame.lightPositions[l]);
+        const glm::vec3 d = p - glm::clamp(p, low, high);
+        const float range = frame.lightPositions[l].w;
+        if (glm::dot(d, d) < range * range)
+          lights |= 1u << l;
+      }
+      frame.lightCells[y * LIGHT_GRID + x] = lights;
+    }
+  }
 }
 
 void SampleScene::onExit()
 {
   glDeleteVertexArrays(1, &vao);
+  glDeleteVertexArrays(1, &worldVao);
+  gpuMemory.remove(GpuMemoryRegistry::Buffer, vbo);
+  gpuMemory.remove(GpuMemoryRegistry::Buffer, ibo);
+  gpuMemory.remove(GpuMemoryRegistry::Buffer, worldVBO);
   glDeleteBuffers(1, &vbo);
   glDeleteBuffers(1, &ibo);
-  delete shaderProgram;
+  glDeleteBuffers(1, &worldVBO);
+  gpuMemory.remove(GpuMemoryRegistry::Texture, atlasTexture);
+  glDeleteFramebuffers(1, &atlasFBO);
+  glDeleteTextures(1, &atlasTexture);
+  gpuMemory.remove(GpuMemoryRegistry::Buffer, frameUBO);
+  gpuMemory.remove(GpuMemoryRegistry::Texture, shadowTexture);
+  glDeleteBuffers(1, &frameUBO);
+  glDeleteFramebuffers(1, &shadowFBO);
+  glDeleteTextures(1, &shadowTexture);
+  if (options.gpuCulling)
+  {
+    glDeleteVertexArrays(1, &drawVao);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, objectsSSBO);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, boundsSSBO);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, viewsSSBO);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, commandBuffer);
+    gpuMemory.remove(GpuMemoryRegistry::Buffer, drawIdBuffer);
+    glDeleteBuffers(1, &objectsSSBO);
+    glDeleteBuffers(1, &boundsSSBO);
+    glDeleteBuffers(1, &viewsSSBO);
+    glDeleteBuffers(1, &commandBuffer);
+    glDeleteBuffers(1, &drawIdBuffer);
+  }
+  delete forwardShader;
+  delete atlasShader;
+  delete shadedShader;
+  delete shadowShader;
+  delete transformShader;
+  delete forwardViewShader;
+  delete shadedViewShader;
+  delete cullShader;
+  delete forwardDrawsShader;
+  delete shadedDrawsShader;
 }
 
 glm::mat4 SampleScene::getViewMatrixOfCurrentFrame()
@@ -267,38 +769,440 @@ glm::mat4 SampleScene::getViewMatrixOfCurrentFrame()
   return glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
 }
 
-void SampleScene::renderScene()
+// What every view of the frame shares, once per frame: the frame block
+// with the lights and their grid, the objects' bounds for the cull pass,
+// the world stream and the sun's shadow map. Leaves the framebuffer and
+// viewport as they were
+void SampleScene::prepareFrame()
 {
+  glBindBuffer(GL_UNIFORM_BUFFER, frameUBO);
+  glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(FrameBlock), &frame);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  if (options.gpuCulling)
+  {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, boundsSSBO);
+    glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0,
+                    GLsizeiptr(bounds.size() * sizeof(glm::vec4)), bounds.data());
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  }
+  transformFrame();
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint target;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+  glBindFramebuffer(GL_FRAMEBUFFER, shadowFBO);
+  glViewport(0, 0, SHADOW_SIZE, SHADOW_SIZE);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  glEnable(GL_POLYGON_OFFSET_FILL);
+  glPolygonOffset(2.0f, 4.0f);
+  shadowShader->use();
+  shadowShader->setUniform("lightSpace", frame.lightSpace);
+  glBindVertexArray(worldVao);
+  for (size_t i = 0; i < objects.size(); i++)
+    drawObject(i, true);
+  glBindVertexArray(0);
+  shadowShader->unuse();
+  glDisable(GL_POLYGON_OFFSET_FILL);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
   glCheckError(__FILE__, __LINE__);
+}
 
-  // clear
-  glClear(GL_COLOR_BUFFER_BIT);
-  glClearColor(0.0, 0.0, 0.0, 1.0);
+// Every object's vertices skinned and transformed into its part of the
+// world stream, as points with the rasterizer off
+void SampleScene::transformFrame()
+{
+  glEnable(GL_RASTERIZER_DISCARD);
+  transformShader->use();
+  glBindVertexArray(vao);
+  for (size_t i = 0; i < objects.size(); i++)
+  {
+    const MeshRange &mesh = meshes[size_t(objects[i].mesh)];
+    setObject(transformShader, i, TRANSFORM);
+    glBindBufferRange(GL_TRANSFORM_FEEDBACK_BUFFER, 0, worldVBO,
+                      GLintptr(size_t(objects[i].worldBase) * sizeof(MeshVertex)),
+                      GLsizeiptr(size_t(mesh.vertexCount) * sizeof(MeshVertex)));
+    glBeginTransformFeedback(GL_POINTS);
+    glDrawArrays(GL_POINTS, mesh.baseVertex, mesh.vertexCount);
+    glEndTransformFeedback();
+  }
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  glBindVertexArray(0);
+  transformShader->unuse();
+  glDisable(GL_RASTERIZER_DISCARD);
+}
 
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+// the resources of prepareFrame() where the lit programs read them
+void SampleScene::bindFrameResources()
+{
+  glBindBufferBase(GL_UNIFORM_BUFFER, FRAME_BINDING, frameUBO);
+  glActiveTexture(GL_TEXTURE0 + SHADOW_UNIT);
+  glBindTexture(GL_TEXTURE_2D, shadowTexture);
+  glActiveTexture(GL_TEXTURE0);
+}
+
+// what a program needs of an object, uniforms of ObjectUniforms
+void SampleScene::setObject(ShaderProgram *program, size_t object, int uniforms)
+{
+  const SceneObject &o = objects[object];
+  if (uniforms & TRANSFORM)
+  {
+    program->setUniform("model", models[object]);
+    program->setUniform("sway", sways[object]);
+  }
+  if (uniforms & DIFFUSE)
+  {
+    program->setUniform("albedo", o.albedo);
+    glUniform4fv(program->uniform("occluders"), OCCLUDERS, glm::value_ptr(o.occluders[0]));
+  }
+  if (uniforms & TEXTURED)
+    program->setUniform("atlasRect",
+                        glm::vec4(o.atlasRect) /
+                            glm::vec4(atlasWidth, atlasHeight, atlasWidth, atlasHeight));
+  if (uniforms & SPECULAR)
+    program->setUniform("specularity", o.specularity);
+}
+
+// with worldVao or vao bound
+void SampleScene::drawObject(size_t object, bool world)
+{
+  const MeshRange &mesh = meshes[size_t(objects[object].mesh)];
+  glDrawElementsBaseVertex(GL_TRIANGLES, mesh.count, GL_UNSIGNED_INT,
+                           (void *)(size_t(mesh.firstIndex) * sizeof(GLuint)),
+                           world ? objects[object].worldBase : mesh.baseVertex);
+}
+
+// The objects in the union of the views of every quilt. The views of
+// quilts differ only in aspect, and a wider focal plane holds the narrower
+// ones, so the widest quilt's union is that of all
+void SampleScene::cullAtlas()
+{
+  float aspect = 0.0f;
+  for (size_t q = 0; q < quilts.size(); q++)
+    aspect = max(aspect, quilts[q].aspect);
+  const glm::mat4 frameView = getViewMatrixOfCurrentFrame();
+  setupVirtualCamera(0.0f, aspect, frameView);
+  const glm::mat4 first = GetProjectionMatrixOfCurrentView() * GetViewMatrixOfCurrentView();
+  setupVirtualCamera(1.0f, aspect, frameView);
+  const glm::mat4 last = GetProjectionMatrixOfCurrentView() * GetViewMatrixOfCurrentView();
+  atlasObjects.clear();
+  culler.cull(Frustum::unionOf(first, last), atlasObjects);
+}
+
+// the objects of atlasObjects rasterized in uv space into their tiles, lit
+// as every view will see them. Leaves the framebuffer and viewport as they
+// were
+void SampleScene::shadeAtlas()
+{
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  GLint target;
+  glGetIntegerv(GL_FRAMEBUFFER_BINDING, &target);
+  glBindFramebuffer(GL_FRAMEBUFFER, atlasFBO);
+  // uv charts don't overlap, every texel is written once
+  glDisable(GL_DEPTH_TEST);
+  bindFrameResources();
+  atlasShader->use();
+  glBindVertexArray(worldVao);
+  for (size_t a = 0; a < atlasObjects.size(); a++)
+  {
+    const size_t i = atlasObjects[a];
+    const glm::ivec4 &rect = objects[i].atlasRect;
+    glViewport(rect.x, rect.y, rect.z, rect.w);
+    setObject(atlasShader, i, DIFFUSE);
+    drawObject(i, true);
+  }
+  glBindVertexArray(0);
+  atlasShader->unuse();
+  glEnable(GL_DEPTH_TEST);
+  glBindFramebuffer(GL_FRAMEBUFFER, GLuint(target));
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
   glCheckError(__FILE__, __LINE__);
+}
+
+// where a view goes in the quilt's framebuffer: its tile, or its rect when
+// weighted
+glm::ivec4 SampleScene::viewRect(int view) const
+{
+  if (!viewRects.empty())
+    return viewRects[size_t(view)];
+  const int viewWidth = renderWidth / qs_columns, viewHeight = renderHeight / qs_rows;
+  return glm::ivec4((view % qs_columns) * viewWidth, (view / qs_columns) * viewHeight, viewWidth,
+                    viewHeight);
+}
 
-  shaderProgram->use();
+// every view of the current quilt into its tile (or rect when weighted) of
+// the bound framebuffer, skipping the ones tracked eyes don't see, with the
+// objects it sees. gpuCulling needs the indirect draws' resources, and draws
+// the world stream whatever transformPerView says
+void SampleScene::renderViews(bool textureSpace, bool transformPerView, bool gpuCulling)
+{
+  if (gpuCulling)
+    transformPerView = false;
+  ShaderProgram *program =
+      gpuCulling ? (textureSpace ? shadedDrawsShader : forwardDrawsShader)
+                 : textureSpace ? (transformPerView ? shadedViewShader : shadedShader)
+                                : (transformPerView ? forwardViewShader : forwardShader);
+  const int uniforms = (textureSpace ? TEXTURED : DIFFUSE) | SPECULAR |
+                       (transformPerView ? TRANSFORM : 0);
+  glClearColor(0.02f, 0.03f, 0.06f, 1.0f);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+
+  bindFrameResources();
+  if (textureSpace)
+    glBindTexture(GL_TEXTURE_2D, atlasTexture);
+  program->use();
+
+  // the cameras of the views rendered, and what each of them sees
+  const glm::mat4 frameView = getViewMatrixOfCurrentFrame();
+  vector<int> views;
+  vector<glm::mat4> viewMatrices, viewProjections;
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    if (!trackedViews.empty() && !trackedViews[size_t(v)])
+      continue;
+    // holoplay special camera setup for each view, don't delete
+    setupVirtualCameraForView(v, frameView);
+    views.push_back(v);
+    viewMatrices.push_back(GetViewMatrixOfCurrentView());
+    viewProjections.push_back(GetProjectionMatrixOfCurrentView() * GetViewMatrixOfCurrentView());
+  }
+  if (gpuCulling)
+  {
+    drawViewsIndirect(program, views, viewMatrices, viewProjections);
+    program->unuse();
+    return;
+  }
+  culler.cullViews(viewProjections, unionObjects, visibleObjects);
+
+  glBindVertexArray(transformPerView ? vao : worldVao);
+  for (size_t k = 0; k < views.size(); k++)
+  {
+    const glm::ivec4 rect = viewRect(views[k]);
+    glViewport(rect.x, rect.y, rect.z, rect.w);
+    program->setUniform("viewProjection", viewProjections[k]);
+    program->setUniform("eye", glm::vec3(glm::inverse(viewMatrices[k])[3]));
+
+    for (size_t o = 0; o < visibleObjects[k].size(); o++)
+    {
+      const size_t i = visibleObjects[k][o];
+      setObject(program, i, uniforms);
+      drawObject(i, !transformPerView);
+    }
+  }
+  glBindVertexArray(0);
+  program->unuse();
+  glViewport(0, 0, renderWidth, renderHeight);
+}
+
+// The cull pass writes a draw per object per view, with no instance where
+// the view doesn't see the object, and one multi-draw submits them all.
+// The views share the framebuffer's viewport: each one is scaled into its
+// rect in the vertex shader and clipped at the rect's edges. Leaves the
+// viewport at the whole framebuffer
+void SampleScene::drawViewsIndirect(ShaderProgram *program, const vector<int> &views,
+                                    const vector<glm::mat4> &viewMatrices,
+                                    const vector<glm::mat4> &viewProjections)
+{
+  glViewport(0, 0, renderWidth, renderHeight);
+  if (views.empty())
+    return;
+  reserveViews(views.size());
+  vector<GpuView> gpuViews(views.size());
+  const glm::vec2 size(renderWidth, renderHeight);
+  for (size_t k = 0; k < views.size(); k++)
+  {
+    const glm::vec4 rect(viewRect(views[k]));
+    gpuViews[k].viewProjection = viewProjections[k];
+    gpuViews[k].eye = glm::vec4(glm::vec3(glm::inverse(viewMatrices[k])[3]), 1.0f);
+    const glm::vec2 scale = glm::vec2(rect.z, rect.w) / size;
+    const glm::vec2 offset = (2.0f * glm::vec2(rect.x, rect.y) + glm::vec2(rect.z, rect.w)) / size -
+                             glm::vec2(1.0f);
+    gpuViews[k].tile = glm::vec4(scale, offset);
+    const Frustum frustum = Frustum::fromMatrix(viewProjections[k]);
+    for (int p = 0; p < 6; p++)
+      gpuViews[k].planes[p] = frustum.planes[p];
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, viewsSSBO);
+  glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, GLsizeiptr(gpuViews.size() * sizeof(GpuView)),
+                  gpuViews.data());
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, OBJECTS_BINDING, objectsSSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, VIEWS_BINDING, viewsSSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, BOUNDS_BINDING, boundsSSBO);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, COMMANDS_BINDING, commandBuffer);
+
+  const Frustum inUnion = Frustum::unionOf(viewProjections.front(), viewProjections.back());
+  cullShader->use();
+  cullShader->setUniform("viewCount", int(views.size()));
+  glUniform4fv(cullShader->uniform("unionPlanes"), 6, glm::value_ptr(inUnion.planes[0]));
+  glDispatchCompute(GLuint((objects.size() + CULL_GROUP - 1) / CULL_GROUP), 1, 1);
+  cullShader->unuse();
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT);
+
+  program->use();
+  glBindVertexArray(drawVao);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+  for (int d = 0; d < 4; d++)
+    glEnable(GLenum(GL_CLIP_DISTANCE0 + d));
+  glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL,
+                              GLsizei(objects.size() * views.size()), 0);
+  for (int d = 0; d < 4; d++)
+    glDisable(GLenum(GL_CLIP_DISTANCE0 + d));
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  glBindVertexArray(0);
   glCheckError(__FILE__, __LINE__);
+}
 
-  // holoplay special camera setup for each view, don't delete
-  shaderProgram->setUniform("view", GetViewMatrixOfCurrentView());
-  shaderProgram->setUniform("projection", GetProjectionMatrixOfCurrentView());
+void SampleScene::renderScene()
+{
   glCheckError(__FILE__, __LINE__);
 
-  // render your scene here as usual
-  glBindVertexArray(vao);
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ibo);
+  // once per frame, whichever quilts and views it is for
+  if (frameTime != time)
+  {
+    prepareFrame();
+    if (options.textureSpaceShading)
+    {
+      cullAtlas();
+      shadeAtlas();
+    }
+    frameTime = time;
+  }
+  renderViews(options.textureSpaceShading, options.meshTransformPerView, options.gpuCulling);
+  if (!trackedViews.empty())
+    copyUntrackedViews();
 
   glCheckError(__FILE__, __LINE__);
-  glDrawElements(GL_TRIANGLES,        // mode
-                 GLsizei(6), // count
-                 GL_UNSIGNED_INT,     // type
-                 NULL                 // element array buffer offset
-  );
+}
 
-  glBindVertexArray(0);
+// GPU milliseconds of one run of draw, averaged over RUNS after an untimed
+// one so first touches aren't counted. Blocks until the timing is back
+static double timeRuns(const std::function<void()> &draw)
+{
+  static const int RUNS = 20;
+  GLuint query;
+  glGenQueries(1, &query);
+  draw();
+  glBeginQuery(GL_TIME_ELAPSED, query);
+  for (int run = 0; run < RUNS; run++)
+    draw();
+  glEndQuery(GL_TIME_ELAPSED);
+  GLuint64 nanoseconds = 0;
+  glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+  glDeleteQueries(1, &query);
+  return double(nanoseconds) / 1.0e6 / RUNS;
+}
+
+// On the first quilt: renders every view with forward shading, then shades
+// the atlas and renders them with texture space shading, and prints the GPU
+// time of each. Then the views transforming their vertices themselves
+// against drawing the world stream, culling and drawing them on the CPU
+// against on the GPU, and the frame pass and the views for 1, 2, 4...
+// views: the frame pass stays the same however many views share it
+void SampleScene::benchmarkShading()
+{
+  if (quiltSource)
+  {
+    cout << "[Warning] the quilt comes from a source, there is nothing to time" << endl;
+    return;
+  }
+  selectQuilt(0);
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+  glViewport(0, 0, renderWidth, renderHeight);
+  const vector<bool> tracked = trackedViews;
+  trackedViews.clear();
+  cullAtlas();
+
+  const bool textureSpace = options.textureSpaceShading;
+  const bool perView = options.meshTransformPerView;
+  const bool gpu = options.gpuCulling;
+  const double frameMs = timeRuns([this]() { prepareFrame(); });
+  const double forwardMs = timeRuns([this, perView, gpu]() { renderViews(false, perView, gpu); });
+  const double atlasMs = timeRuns([this]() { shadeAtlas(); });
+  const double texturedMs = timeRuns([this, perView, gpu]() { renderViews(true, perView, gpu); });
+  cout << "[Info] " << objects.size() - 1 << " objects in " << qs_totalViews << " views of a "
+       << qs_width << "x" << qs_height << " quilt: forward shading " << forwardMs
+       << " ms, texture space shading " << atlasMs + texturedMs << " ms (atlas " << atlasMs
+       << " ms, views " << texturedMs << " ms), frame pass " << frameMs << " ms" << endl;
+
+  // the vertices, where the frame pass's transform is all that differs
+  const double transformMs = timeRuns([this]() { transformFrame(); });
+  const double worldMs =
+      timeRuns([this, textureSpace]() { renderViews(textureSpace, false, false); });
+  const double viewMs = timeRuns([this, textureSpace]() { renderViews(textureSpace, true, false); });
+  cout << "[Info] vertices transformed in every view " << viewMs << " ms, once per frame "
+       << transformMs + worldMs << " ms (transform " << transformMs << " ms, views " << worldMs
+       << " ms)" << endl;
+
+  // what the views draw, and the CPU time it takes to find out
+  vector<glm::mat4> viewProjections;
+  const glm::mat4 frameView = getViewMatrixOfCurrentFrame();
+  for (int v = 0; v < qs_totalViews; v++)
+  {
+    setupVirtualCameraForView(v, frameView);
+    viewProjections.push_back(GetProjectionMatrixOfCurrentView() * GetViewMatrixOfCurrentView());
+  }
+  static const int CULLS = 100;
+  auto start = chrono::steady_clock::now();
+  for (int run = 0; run < CULLS; run++)
+    culler.cullViews(viewProjections, unionObjects, visibleObjects);
+  const double cullMs =
+      chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / CULLS;
+  size_t drawn = 0;
+  for (size_t v = 0; v < visibleObjects.size(); v++)
+    drawn += visibleObjects[v].size();
+  cout << "[Info] culling " << objects.size() << " objects for " << qs_totalViews
+       << " views: " << unionObjects.size() << " in their union, " << drawn << " of "
+       << objects.size() * size_t(qs_totalViews) << " draws left, " << cullMs
+       << " ms on the CPU" << endl;
+
+  // what submitting the draws costs the CPU, culled there or on the GPU
+  if (gpu)
+  {
+    double submitMs[2], drawMs[2];
+    for (int g = 0; g < 2; g++)
+    {
+      drawMs[g] = timeRuns([this, textureSpace, g]() { renderViews(textureSpace, false, g != 0); });
+      glFinish();
+      start = chrono::steady_clock::now();
+      for (int run = 0; run < CULLS; run++)
+        renderViews(textureSpace, false, g != 0);
+      submitMs[g] =
+          chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / CULLS;
+      glFinish();
+    }
+    cout << "[Info] views culled and drawn on the CPU: " << submitMs[0] << " ms submitting, "
+         << drawMs[0] << " ms on the GPU; culled on the GPU with one indirect multi-draw: "
+         << submitMs[1] << " ms submitting, " << drawMs[1] << " ms on the GPU" << endl;
+  }
+  else
+    cout << "[Info] --mesh-culling gpu times culling on the GPU too" << endl;
+
+  // rendering only the first views, as viewer tracking does
+  for (int views = 1;; views = min(2 * views, qs_totalViews))
+  {
+    trackedViews.assign(size_t(qs_totalViews), false);
+    fill(trackedViews.begin(), trackedViews.begin() + views, true);
+    const double passMs = timeRuns([this, textureSpace]() {
+      prepareFrame();
+      if (textureSpace)
+        shadeAtlas();
+    });
+    const double viewsMs = timeRuns(
+        [this, textureSpace, perView, gpu]() { renderViews(textureSpace, perView, gpu); });
+    cout << "[Info] " << views << " views: frame pass " << passMs << " ms, views " << viewsMs
+         << " ms (" << viewsMs / views << " ms a view), the frame pass in every view would be "
+         << passMs * views << " ms" << endl;
+    if (views == qs_totalViews)
+      break;
+  }
 
-  shaderProgram->unuse();
+  trackedViews = tracked;
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
 }
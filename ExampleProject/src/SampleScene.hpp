@@ -8,15 +8,51 @@
 #ifndef OPENGL_CMAKE_SKELETON_MYAPPLICATION
 #define OPENGL_CMAKE_SKELETON_MYAPPLICATION
 
+#include <vector>
+
+#include "FrustumCuller.hpp"
 #include "HoloPlayContext.hpp"
 
+// A field of lit meshes on a ground plane, rendered into every view of the
+// quilt with the camera of setupVirtualCameraForView() (--scene meshes).
+//
+// What doesn't depend on the view is prepared once per frame and shared by
+// every view's draws: the Frame uniform block with the sun, the point lights
+// and a world space grid of which lights reach each cell, and the sun's
+// shadow map (prepareFrame(), bindFrameResources()). So are the vertices:
+// transform feedback captures every object skinned and transformed into
+// world space once per frame (mesh_transform.glsl, transformFrame()), and
+// the views, the atlas and the shadow map draw that world stream with only
+// their own projection (mesh_world_vertex.glsl). --mesh-transform view
+// transforms them again in every view instead (mesh_vertex.glsl).
+//
+// Only what a view sees is drawn into it: the objects' bounding spheres are
+// culled against the union of a quilt's view frusta, then each view's
+// frustum (FrustumCuller). The atlas only shades objects some view sees.
+// With --mesh-culling gpu a compute pass does that culling instead and
+// writes an indirect draw for every object in every view, and one
+// glMultiDrawElementsIndirect draws all the views (mesh_cull.glsl,
+// mesh_draws_vertex.glsl, drawViewsIndirect()), so the CPU's submission no
+// longer grows with objects times views.
+//
+// With texture space shading (--mesh-shading texture) the ambient and
+// diffuse light, which is the same from every view, is shaded once per
+// frame into a tile of a shading atlas per object (mesh_atlas.glsl). The
+// views then only rasterize the objects, sample their tiles and add the
+// specular highlights (mesh_shaded.glsl). Forward shading lights every pixel
+// of every view (mesh.glsl). T times both.
 class SampleScene : public HoloPlayContext
 {
 public:
-  SampleScene();
+  SampleScene(const HoloPlayOptions &options = HoloPlayOptions());
+  // GPU memory the scene allocates after the context, see
+  // HoloPlayOptions::sceneGpuBytes
+  static size_t gpuBytes(const HoloPlayOptions &options, int views, int viewHeight,
+                         float cameraSize);
   // control
   virtual void mouse_callback(GLFWwindow *window, double xpos, double ypos);
   virtual void scroll_callback(GLFWwindow *window, double xoffset, double yoffset);
+  virtual void key_callback(GLFWwindow *window, int key, int scancode, int action, int mods);
 
 protected:
   virtual void update();
@@ -25,22 +61,168 @@ protected:
   virtual glm::mat4 getViewMatrixOfCurrentFrame();
   virtual bool processInput(GLFWwindow *window);
 
-  ShaderProgram *shaderProgram;
-
 private:
+  // part of the shared vertex and index buffers
+  struct MeshRange
+  {
+    GLint baseVertex;
+    GLsizei firstIndex;
+    GLsizei count;
+    GLsizei vertexCount;
+    float radius; // of its bounding sphere
+  };
+
+  static const int OCCLUDERS = 6; // as in mesh.glsl
+
+  struct SceneObject
+  {
+    int mesh;              // index into meshes
+    glm::vec3 position;
+    float scale;
+    float tilt;            // radians around x
+    float spin;            // radians per second around y
+    glm::vec3 albedo;
+    float specularity;
+    glm::vec4 occluders[OCCLUDERS]; // bounding spheres of its nearest
+                           // neighbours, radius 0 for none
+    glm::ivec4 atlasRect;  // x, y, width, height of its atlas tile in texels
+    GLint worldBase;       // its first vertex in the world stream
+  };
+
+  // the uniforms of an object a program needs, for setObject()
+  enum ObjectUniforms
+  {
+    DIFFUSE = 1,   // albedo and occluders
+    SPECULAR = 2,  // specularity
+    TEXTURED = 4,  // atlasRect
+    TRANSFORM = 8  // model and sway, to transform the vertices per view
+  };
+
+  void createMeshes();
+  void createObjects(int count); // and the ground, and their world stream
+  void layoutAtlas();    // atlasRect of every object, atlasWidth/Height
+  void setupAtlas();     // create atlasTexture and atlasFBO
+  void setupFrameResources(); // create frameUBO, shadowTexture and shadowFBO
+  void setupIndirectDraws(); // create the storage buffers and drawVao
+  void reserveViews(size_t views); // viewsSSBO, commandBuffer and drawIdBuffer
+  void loadShaders();    // a shader that doesn't compile keeps the last
+  void buildLightGrid(); // frame.lightCells from frame.lightPositions
+  void prepareFrame();   // upload frame, transform, draw the shadow map
+  void transformFrame(); // the world stream at the current time
+  void bindFrameResources();
+  void setObject(ShaderProgram *program, size_t object, int uniforms);
+  void drawObject(size_t object, bool world); // from the world stream or
+                                              // the object space meshes
+  void cullAtlas();      // atlasObjects at the current time
+  void shadeAtlas();     // the tiles of atlasObjects at the current time
+  // every view of the current quilt, culled on the CPU or the GPU
+  void renderViews(bool textureSpace, bool transformPerView, bool gpuCulling);
+  glm::ivec4 viewRect(int view) const; // in the quilt's framebuffer
+  // the views, culled and drawn with one indirect multi-draw, program bound
+  void drawViewsIndirect(ShaderProgram *program, const std::vector<int> &views,
+                         const std::vector<glm::mat4> &viewMatrices,
+                         const std::vector<glm::mat4> &viewProjections);
+  void benchmarkShading(); // forward against texture space, transforming
+                           // once against per view, CPU against GPU culling
+                           // and the frame pass against the view count,
+                           // blocks
 
   // VBO/VAO/ibo
   GLuint vao, vbo, ibo;
+  std::vector<MeshRange> meshes;
+  std::vector<SceneObject> objects; // the ground first
+  std::vector<glm::mat4> models;    // of objects, at the current time
+  std::vector<glm::mat4> sways;     // of objects' top bones, at the current time
+  FrustumCuller culler; // bounding spheres of objects, at the current time
+  std::vector<glm::vec4> bounds; // the same spheres, xyz center and w radius
+  std::vector<uint32_t> atlasObjects;  // in a view of any quilt
+  std::vector<uint32_t> unionObjects;  // in a view of the current quilt
+  std::vector<std::vector<uint32_t> > visibleObjects; // in each view rendered
+  GLuint worldVao = 0;
+  GLuint worldVBO = 0;     // every object's vertices in world space, as
+                           // MeshVertex, written by transformFrame()
+
+  float fieldSize = 0.0f; // of the ground, centered at the origin
+
+  static const int POINT_LIGHTS = 16; // as in mesh.glsl
+  static const int LIGHT_GRID = 16;   // as in mesh.glsl
+
+  // the Frame uniform block of mesh.glsl, in its std140 layout
+  struct FrameBlock
+  {
+    glm::mat4 lightSpace;
+    glm::vec4 sunDirection;
+    glm::vec4 sunColor;
+    glm::vec4 skyColor;
+    glm::vec4 lightPositions[POINT_LIGHTS]; // w the range
+    glm::vec4 lightColors[POINT_LIGHTS];
+    glm::vec4 lightGrid;
+    GLuint lightCells[LIGHT_GRID * LIGHT_GRID];
+  };
+  FrameBlock frame;   // of the current time, uploaded by prepareFrame()
+  GLuint frameUBO = 0;
+  static const GLuint FRAME_BINDING = 0; // uniform buffer binding
+  static const int SHADOW_UNIT = 1;      // texture unit of the shadow map
+  static const int SHADOW_SIZE = 2048;
+  GLuint shadowTexture = 0;
+  GLuint shadowFBO = 0;
+  float frameTime = -1.0f; // time prepareFrame() last ran at
+
+  ShaderProgram *forwardShader = NULL;
+  ShaderProgram *atlasShader = NULL;
+  ShaderProgram *shadedShader = NULL;
+  ShaderProgram *shadowShader = NULL;
+  ShaderProgram *transformShader = NULL;
+  ShaderProgram *forwardViewShader = NULL; // transforming in every view
+  ShaderProgram *shadedViewShader = NULL;
+  ShaderProgram *cullShader = NULL;        // with gpuCulling only
+  ShaderProgram *forwardDrawsShader = NULL;
+  ShaderProgram *shadedDrawsShader = NULL;
+  GLuint atlasTexture = 0;
+  GLuint atlasFBO = 0;
+  int atlasWidth = 0;
+  int atlasHeight = 0;
+
+  // the Object and View of mesh_cull.glsl, in their std430 layout
+  struct GpuObject
+  {
+    glm::vec4 color;     // rgb the albedo, a the specularity
+    glm::vec4 atlasRect; // in atlas uv
+    GLuint draw[4];      // index count, first index, world base, unused
+    glm::vec4 occluders[OCCLUDERS];
+  };
+  struct GpuView
+  {
+    glm::mat4 viewProjection;
+    glm::vec4 eye;
+    glm::vec4 tile;      // xy scale and zw offset into the quilt's NDC
+    glm::vec4 planes[6]; // Frustum::fromMatrix()
+  };
+  // storage buffer bindings of mesh_cull.glsl
+  static const GLuint OBJECTS_BINDING = 1;
+  static const GLuint VIEWS_BINDING = 2;
+  static const GLuint BOUNDS_BINDING = 3;
+  static const GLuint COMMANDS_BINDING = 4;
+  static const GLuint CULL_GROUP = 64; // its local size
+  GLuint objectsSSBO = 0;  // GpuObject of every object, set once
+  GLuint viewsSSBO = 0;    // GpuView of every view rendered
+  GLuint boundsSSBO = 0;   // bounds, uploaded by prepareFrame()
+  GLuint commandBuffer = 0; // a DrawElementsIndirectCommand per object
+                           // per view, written by the cull pass
+  GLuint drawIdBuffer = 0; // 0, 1, 2... the index of each draw, which the
+                           // draws read through their base instance
+  GLuint drawVao = 0;      // worldVao and the draw indices
+  size_t maxViews = 0;     // commandBuffer and viewsSSBO hold this many
 
   // camera
-  glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 3.0f);
-  glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+  glm::vec3 cameraPos = glm::vec3(0.0f, 0.0f, 0.0f);
+  glm::vec3 cameraFront = glm::vec3(0.0f, -0.4226f, -0.9063f);
   glm::vec3 cameraUp = glm::vec3(0.0f, 1.0f, 0.0f);
   bool firstMouse = true;
   float yaw = -90.0f; // yaw is initialized to -90.0 degrees since a yaw of 0.0
                       // results in a direction vector pointing to the right so
                       // we initially rotate a bit to the left.
-  float pitch = 0.0f;
+  float pitch = -25.0f; // looking down on the field a little
   float lastX = 800.0f / 2.0;
   float lastY = 600.0 / 2.0;
   int debug = 0;
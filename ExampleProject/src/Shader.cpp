@@ -12,6 +12,7 @@
 #include <fstream>
 #include <glm/gtc/type_ptr.hpp>
 #include <iostream>
+#include <sstream>
 #include <stdexcept>
 #include <vector>
 #include <string>
@@ -43,6 +44,51 @@ void getFileContents(const char *filename, vector<char> &buffer)
   }
 }
 
+// the lines of a section of a shader file, see readShaderSource()
+static string shaderSection(const string &filename, const string &section)
+{
+  ifstream file(filename.c_str());
+  if (!file)
+    throw std::invalid_argument(string("The file ") + filename + " doesn't exists");
+  const string begin = "// @begin " + section, end = "// @end " + section;
+  string line, text;
+  bool inside = false;
+  while (getline(file, line))
+  {
+    if (line.compare(0, end.size(), end) == 0 && inside)
+      return text;
+    if (inside)
+      text += line + "\n";
+    if (line.compare(0, begin.size(), begin) == 0)
+      inside = true;
+  }
+  throw std::invalid_argument("no section " + section + " in " + filename);
+}
+
+string readShaderSource(const string &filename)
+{
+  ifstream file(filename.c_str());
+  if (!file)
+    throw std::invalid_argument(string("The file ") + filename + " doesn't exists");
+  const size_t slash = filename.find_last_of("/\\");
+  const string directory = slash == string::npos ? "" : filename.substr(0, slash + 1);
+  const string include = "// @include ";
+  string line, text;
+  while (getline(file, line))
+  {
+    if (line.compare(0, include.size(), include) != 0)
+    {
+      text += line + "\n";
+      continue;
+    }
+    istringstream words(line.substr(include.size()));
+    string name, section;
+    words >> name >> section;
+    text += shaderSection(directory + name, section);
+  }
+  return text;
+}
+
 Shader::Shader(const std::string &file_name, GLenum type)
 {
   filename = file_name.c_str();
@@ -135,12 +181,58 @@ ShaderProgram::ShaderProgram(std::initializer_list<Shader> shaderList)
   link();
 }
 
+ShaderProgram::ShaderProgram(std::initializer_list<Shader> shaderList,
+                             const std::vector<std::string> &feedbackVaryings)
+    : ShaderProgram()
+{
+  shaders = shaderList;
+  for (auto &s : shaders)
+    glAttachShader(handle, s.getHandle());
+
+  // they take effect at the next link
+  vector<const GLchar *> names;
+  for (size_t i = 0; i < feedbackVaryings.size(); i++)
+    names.push_back(feedbackVaryings[i].c_str());
+  glTransformFeedbackVaryings(handle, GLsizei(names.size()), names.data(),
+                              GL_INTERLEAVED_ATTRIBS);
+  link();
+}
+
+ShaderProgram::ShaderProgram(GLenum binaryFormat, const std::vector<char> &binary)
+    : ShaderProgram()
+{
+  glProgramBinary(handle, binaryFormat, binary.data(), GLsizei(binary.size()));
+}
+
+bool ShaderProgram::linked() const
+{
+  GLint result = GL_FALSE;
+  glGetProgramiv(handle, GL_LINK_STATUS, &result);
+  return result == GL_TRUE;
+}
+
+bool ShaderProgram::getBinary(GLenum &binaryFormat, std::vector<char> &binary) const
+{
+  if (!GLEW_ARB_get_program_binary)
+    return false;
+  GLint length = 0;
+  glGetProgramiv(handle, GL_PROGRAM_BINARY_LENGTH, &length);
+  if (length <= 0)
+    return false;
+  binary.resize(size_t(length));
+  glGetProgramBinary(handle, length, NULL, &binaryFormat, binary.data());
+  return true;
+}
+
 std::initializer_list<Shader> ShaderProgram::getShaders() {
   return shaders;
 }
 
 void ShaderProgram::link()
 {
+  // so getBinary() works
+  if (GLEW_ARB_get_program_binary)
+    glProgramParameteri(handle, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
   glLinkProgram(handle);
   GLint result;
   glGetProgramiv(handle, GL_LINK_STATUS, &result);
@@ -167,7 +259,7 @@ GLint ShaderProgram::uniform(const std::string &name)
   {
     // uniform that is not referenced
     GLint r = glGetUniformLocation(handle, name.c_str());
-    if (r == GL_INVALID_OPERATION || r < 0)
+    if ((r == GL_INVALID_OPERATION || r < 0) && !missingUniformsAllowed)
       cout << "[Error] uniform " << name << " doesn't exist in program" << endl;
     // add it anyways
     uniforms[name] = r;
@@ -226,6 +318,18 @@ void ShaderProgram::setAttribute(const std::string &name,
   setAttribute(name, size, stride, offset, false, GL_FLOAT);
 }
 
+bool ShaderProgram::bindUniformBlock(const std::string &name, GLuint binding)
+{
+  GLuint index = glGetUniformBlockIndex(handle, name.c_str());
+  if (index == GL_INVALID_INDEX)
+  {
+    cout << "[Error] uniform block " << name << " doesn't exist in program" << endl;
+    return false;
+  }
+  glUniformBlockBinding(handle, index, binding);
+  return true;
+}
+
 void ShaderProgram::setUniform(const std::string &name,
                                float x,
                                float y,
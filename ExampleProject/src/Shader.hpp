@@ -11,6 +11,7 @@
 #include <initializer_list>
 #include <map>
 #include <string>
+#include <vector>
 
 class Shader;
 class ShaderProgram;
@@ -43,6 +44,13 @@ private:
   friend class ShaderProgram;
 };
 
+// Reads a shader file, replacing every line
+//     // @include <file> <section>
+// with the lines between "// @begin <section>" and "// @end <section>" of
+// file, which is looked up next to the shader. Shaders share code this way.
+// Throws std::invalid_argument if a file or section doesn't exist.
+std::string readShaderSource(const std::string &filename);
+
 // A shader program is a set of shader (for instance vertex shader + pixel
 // shader) defining the rendering pipeline.
 //
@@ -53,6 +61,17 @@ class ShaderProgram
 public:
   // constructor
   ShaderProgram(std::initializer_list<Shader> shaderList);
+  // capturing the outputs feedbackVaryings, interleaved in that order, with
+  // transform feedback
+  ShaderProgram(std::initializer_list<Shader> shaderList,
+                const std::vector<std::string> &feedbackVaryings);
+  // from what getBinary() returned, possibly on an earlier run. Drivers
+  // refuse binaries of other versions, check linked()
+  ShaderProgram(GLenum binaryFormat, const std::vector<char> &binary);
+
+  bool linked() const;
+  // false if the driver keeps no binaries (GL 4.1 or ARB_get_program_binary)
+  bool getBinary(GLenum &binaryFormat, std::vector<char> &binary) const;
 
   // bind the program
   void use() const;
@@ -73,8 +92,15 @@ public:
 
   // provide uniform location
   GLint uniform(const std::string &name);
+  // no error for uniforms the program doesn't have, for variants of a shader
+  // that compile some of them out
+  void allowMissingUniforms(bool allow) { missingUniformsAllowed = allow; }
   GLint operator[](const std::string &name);
 
+  // read the uniform block name from the buffer bound to binding
+  // (glBindBufferBase). False if the program doesn't use the block
+  bool bindUniformBlock(const std::string &name, GLuint binding);
+
   // affect uniform
   void setUniform(const std::string &name, float x, float y, float z);
   void setUniform(const std::string &name, const glm::vec2 &v);
@@ -95,6 +121,7 @@ private:
 
   std::map<std::string, GLint> uniforms;
   std::map<std::string, GLint> attributes;
+  bool missingUniformsAllowed = false;
 
   // opengl id
   GLuint handle;
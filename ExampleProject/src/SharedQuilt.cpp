@@ -0,0 +1,344 @@
+/**
+ * SharedQuilt.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "SharedQuilt.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <new>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const size_t PAGE = 4096;
+
+static size_t roundToPage(size_t bytes)
+{
+  return (bytes + PAGE - 1) & ~(PAGE - 1);
+}
+
+SharedQuiltMapping::SharedQuiltMapping()
+    : memory(NULL),
+      length(0),
+      owner(false)
+#ifdef WIN32
+      ,
+      mapping(NULL)
+#endif
+{
+}
+
+SharedQuiltMapping::~SharedQuiltMapping()
+{
+  close();
+}
+
+#ifdef WIN32
+
+bool SharedQuiltMapping::create(const std::string &name, size_t bytes, std::string &error)
+{
+  close();
+  systemName = "Local\\hpquilt-" + name;
+  HANDLE view = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                                   DWORD(uint64_t(bytes) >> 32), DWORD(bytes),
+                                   systemName.c_str());
+  if (!view)
+  {
+    error = "couldn't create shared memory " + systemName;
+    return false;
+  }
+  if (GetLastError() == ERROR_ALREADY_EXISTS)
+  {
+    // or a consumer hasn't noticed its crashed predecessor yet, which takes
+    // a few seconds
+    CloseHandle(view);
+    error = "another producer already uses " + systemName;
+    return false;
+  }
+  void *address = MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+  if (!address)
+  {
+    CloseHandle(view);
+    error = "couldn't map shared memory " + systemName;
+    return false;
+  }
+  mapping = view;
+  memory = static_cast<unsigned char *>(address);
+  length = bytes;
+  owner = true;
+  return true;
+}
+
+bool SharedQuiltMapping::open(const std::string &name, std::string &error)
+{
+  close();
+  systemName = "Local\\hpquilt-" + name;
+  HANDLE view = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, systemName.c_str());
+  if (!view)
+  {
+    error = "no producer has created " + systemName + " yet";
+    return false;
+  }
+  void *address = MapViewOfFile(view, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (!address || !VirtualQuery(address, &info, sizeof(info)))
+  {
+    if (address)
+      UnmapViewOfFile(address);
+    CloseHandle(view);
+    error = "couldn't map shared memory " + systemName;
+    return false;
+  }
+  mapping = view;
+  memory = static_cast<unsigned char *>(address);
+  length = info.RegionSize;
+  owner = false;
+  return true;
+}
+
+void SharedQuiltMapping::close()
+{
+  // the mapping goes away with its last handle
+  if (memory)
+    UnmapViewOfFile(memory);
+  if (mapping)
+    CloseHandle(mapping);
+  memory = NULL;
+  mapping = NULL;
+  length = 0;
+  owner = false;
+}
+
+#else
+
+bool SharedQuiltMapping::create(const std::string &name, size_t bytes, std::string &error)
+{
+  close();
+  systemName = "/hpquilt-" + name;
+  // left over by a producer that crashed, consumers still mapping it keep
+  // their copy until they notice its heartbeat stopped
+  shm_unlink(systemName.c_str());
+  int fd = shm_open(systemName.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0)
+  {
+    error = "couldn't create shared memory " + systemName + ": " + strerror(errno);
+    return false;
+  }
+  if (ftruncate(fd, off_t(bytes)) != 0)
+  {
+    error = "couldn't size shared memory " + systemName + ": " + strerror(errno);
+    ::close(fd);
+    shm_unlink(systemName.c_str());
+    return false;
+  }
+  void *address = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED)
+  {
+    error = "couldn't map shared memory " + systemName + ": " + strerror(errno);
+    shm_unlink(systemName.c_str());
+    return false;
+  }
+  memory = static_cast<unsigned char *>(address);
+  length = bytes;
+  owner = true;
+  return true;
+}
+
+bool SharedQuiltMapping::open(const std::string &name, std::string &error)
+{
+  close();
+  systemName = "/hpquilt-" + name;
+  int fd = shm_open(systemName.c_str(), O_RDWR, 0);
+  if (fd < 0)
+  {
+    error = "no producer has created " + systemName + " yet";
+    return false;
+  }
+  struct stat info;
+  if (fstat(fd, &info) != 0 || info.st_size < off_t(sizeof(SharedQuiltHeader)))
+  {
+    ::close(fd);
+    error = systemName + " isn't set up yet";
+    return false;
+  }
+  void *address =
+      mmap(NULL, size_t(info.st_size), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (address == MAP_FAILED)
+  {
+    error = "couldn't map shared memory " + systemName + ": " + strerror(errno);
+    return false;
+  }
+  memory = static_cast<unsigned char *>(address);
+  length = size_t(info.st_size);
+  owner = false;
+  return true;
+}
+
+void SharedQuiltMapping::close()
+{
+  if (memory)
+    munmap(memory, length);
+  if (owner)
+    shm_unlink(systemName.c_str());
+  memory = NULL;
+  length = 0;
+  owner = false;
+}
+
+#endif
+
+SharedQuiltProducer::~SharedQuiltProducer()
+{
+  if (header)
+    header->closed.store(1, memory_order_release);
+}
+
+bool SharedQuiltProducer::create(const std::string &name, int width, int height,
+                                 int columns, int rows, int views, std::string &error)
+{
+  if (width <= 0 || height <= 0 || columns <= 0 || rows <= 0 || views <= 0 ||
+      views > columns * rows)
+  {
+    error = "invalid quilt layout";
+    return false;
+  }
+  const size_t slotBytes = roundToPage(size_t(width) * size_t(height) * 4);
+  const size_t dataOffset = roundToPage(sizeof(SharedQuiltHeader));
+  if (slotBytes > 0xffffffffu)
+  {
+    error = "quilt frames are too large to share";
+    return false;
+  }
+  if (!mapping.create(name, dataOffset + SharedQuiltHeader::SLOTS * slotBytes, error))
+    return false;
+
+  header = new (mapping.data()) SharedQuiltHeader();
+  header->version = SharedQuiltHeader::VERSION;
+  header->width = uint32_t(width);
+  header->height = uint32_t(height);
+  header->columns = uint32_t(columns);
+  header->rows = uint32_t(rows);
+  header->views = uint32_t(views);
+  header->slotBytes = uint32_t(slotBytes);
+  header->dataOffset = uint32_t(dataOffset);
+  header->session = uint64_t(chrono::system_clock::now().time_since_epoch().count());
+  // back 0, middle 1, front 2
+  back = 0;
+  header->middle.store(1, memory_order_relaxed);
+  header->front.store(2, memory_order_relaxed);
+  header->closed.store(0, memory_order_relaxed);
+  header->frames.store(0, memory_order_relaxed);
+  header->heartbeat.store(0, memory_order_relaxed);
+  // consumers only trust the rest once the magic is there
+  atomic_thread_fence(memory_order_release);
+  header->magic = SharedQuiltHeader::MAGIC;
+  return true;
+}
+
+unsigned char *SharedQuiltProducer::frame()
+{
+  if (!header)
+    return NULL;
+  return mapping.data() + header->dataOffset + size_t(back) * header->slotBytes;
+}
+
+void SharedQuiltProducer::publish()
+{
+  if (!header)
+    return;
+  header->frames.fetch_add(1, memory_order_relaxed);
+  // releases the frame's pixels along with the slot
+  uint32_t old = header->middle.exchange(back | SharedQuiltHeader::DIRTY,
+                                         memory_order_acq_rel);
+  back = old & ~SharedQuiltHeader::DIRTY;
+  header->heartbeat.fetch_add(1, memory_order_relaxed);
+}
+
+void SharedQuiltProducer::keepAlive()
+{
+  if (header)
+    header->heartbeat.fetch_add(1, memory_order_relaxed);
+}
+
+bool SharedQuiltConsumer::attach(const std::string &name, std::string &error)
+{
+  detach();
+  if (!mapping.open(name, error))
+    return false;
+
+  SharedQuiltHeader *candidate = reinterpret_cast<SharedQuiltHeader *>(mapping.data());
+  if (candidate->magic != SharedQuiltHeader::MAGIC)
+  {
+    error = name + " isn't set up yet";
+    mapping.close();
+    return false;
+  }
+  atomic_thread_fence(memory_order_acquire);
+  if (candidate->version != SharedQuiltHeader::VERSION)
+  {
+    error = name + " uses an unsupported version of the shared quilt ring";
+    mapping.close();
+    return false;
+  }
+  const size_t frameBytes = size_t(candidate->width) * size_t(candidate->height) * 4;
+  if (candidate->slotBytes < frameBytes || candidate->dataOffset < sizeof(SharedQuiltHeader) ||
+      mapping.size() < candidate->dataOffset +
+                           size_t(SharedQuiltHeader::SLOTS) * candidate->slotBytes ||
+      candidate->front.load() >= SharedQuiltHeader::SLOTS)
+  {
+    error = name + " is truncated or corrupt";
+    mapping.close();
+    return false;
+  }
+  header = candidate;
+  lastFrames = header->frames.load(memory_order_relaxed);
+  skipped = 0;
+  return true;
+}
+
+void SharedQuiltConsumer::detach()
+{
+  header = NULL;
+  mapping.close();
+}
+
+const unsigned char *SharedQuiltConsumer::acquire()
+{
+  if (!header)
+    return NULL;
+  // only the consumer clears the flag, so it can't go away before the swap
+  if (!(header->middle.load(memory_order_acquire) & SharedQuiltHeader::DIRTY))
+    return NULL;
+  uint32_t front = header->front.load(memory_order_relaxed);
+  uint32_t old = header->middle.exchange(front, memory_order_acq_rel);
+  front = old & ~SharedQuiltHeader::DIRTY;
+  header->front.store(front, memory_order_relaxed);
+
+  uint64_t frames = header->frames.load(memory_order_relaxed);
+  if (frames > lastFrames + 1)
+    skipped += frames - lastFrames - 1;
+  lastFrames = frames;
+  return mapping.data() + header->dataOffset + size_t(front) * header->slotBytes;
+}
@@ -0,0 +1,149 @@
+/**
+ * SharedQuilt.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_SHARED_QUILT_HPP
+#define HOLOPLAY_SHARED_QUILT_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+// Quilt frames handed from a producer process to the display process through
+// named shared memory (POSIX shm_open, a named file mapping on Windows).
+//
+// The producer creates the ring and owns it; the display process attaches to
+// it by name whenever it shows up. The memory holds a SharedQuiltHeader
+// followed by three frame slots used as a lock free triple buffer: the
+// producer writes into its back slot and swaps it with the shared middle slot
+// when the frame is complete, the consumer swaps its front slot with the
+// middle one when a new frame is flagged. Neither side ever waits for the
+// other, and the consumer always gets the latest complete frame. The atomic
+// exchanges on the middle slot are the only synchronization.
+//
+// One producer and one consumer per ring; a display process serves several
+// producers by attaching to several rings.
+//
+// A producer that crashes never sets closed. It bumps heartbeat with every
+// frame and with keepAlive(), so a consumer can tell a dead ring from a slow
+// one, let go of it (a Windows mapping lives as long as any handle to it, so
+// a restarted producer couldn't create its ring again) and recognize the
+// restarted producer's ring by its session.
+
+struct SharedQuiltHeader
+{
+    static const uint32_t MAGIC = 0x53515048; // "HPQS"
+    static const uint32_t VERSION = 2;
+    static const uint32_t SLOTS = 3;
+    static const uint32_t DIRTY = 0x80000000u; // middle holds an unseen frame
+
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;      // RGBA8, rows bottom to top
+    uint32_t height;
+    uint32_t columns;
+    uint32_t rows;
+    uint32_t views;
+    uint32_t slotBytes;  // frame size rounded up to a page
+    uint32_t dataOffset; // of slot 0 from the start of the mapping
+    uint64_t session;    // differs for every create(), even of one name
+
+    std::atomic<uint32_t> middle;   // slot index | DIRTY
+    std::atomic<uint32_t> front;    // consumer's slot, kept here so a
+                                    // restarted consumer picks it up again
+    std::atomic<uint32_t> closed;   // producer has gone away
+    std::atomic<uint64_t> frames;   // frames published so far
+    std::atomic<uint64_t> heartbeat; // bumped by publish() and keepAlive()
+};
+
+// a mapping of a named ring, shared by producer and consumer
+class SharedQuiltMapping
+{
+public:
+    SharedQuiltMapping();
+    ~SharedQuiltMapping(); // unmaps, and removes the name if created
+
+    bool create(const std::string &name, size_t bytes, std::string &error);
+    bool open(const std::string &name, std::string &error);
+    void close();
+
+    bool isOpen() const { return memory != NULL; }
+    unsigned char *data() const { return memory; }
+    size_t size() const { return length; }
+
+private:
+    SharedQuiltMapping(const SharedQuiltMapping &);
+    SharedQuiltMapping &operator=(const SharedQuiltMapping &);
+
+    unsigned char *memory;
+    size_t length;
+    std::string systemName;
+    bool owner;
+#ifdef WIN32
+    void *mapping; // HANDLE
+#endif
+};
+
+// producer side
+class SharedQuiltProducer
+{
+public:
+    SharedQuiltProducer() : header(NULL), back(0) {}
+    ~SharedQuiltProducer(); // tells the consumer and removes the ring
+
+    bool create(const std::string &name, int width, int height, int columns,
+                int rows, int views, std::string &error);
+
+    // the slot to write the next frame into, width * height RGBA8 pixels
+    unsigned char *frame();
+    void publish(); // hands the frame over, frame() then returns another slot
+    // tells consumers the producer is still there. publish() does too;
+    // producers that go longer than a second without a frame call this.
+    void keepAlive();
+
+    uint64_t framesPublished() const { return header ? header->frames.load() : 0; }
+
+private:
+    SharedQuiltProducer(const SharedQuiltProducer &);
+    SharedQuiltProducer &operator=(const SharedQuiltProducer &);
+
+    SharedQuiltMapping mapping;
+    SharedQuiltHeader *header;
+    uint32_t back;
+};
+
+// consumer side
+class SharedQuiltConsumer
+{
+public:
+    SharedQuiltConsumer() : header(NULL), lastFrames(0), skipped(0) {}
+
+    // false while the producer hasn't created the ring yet
+    bool attach(const std::string &name, std::string &error);
+    void detach();
+    bool isAttached() const { return header != NULL; }
+    bool producerClosed() const { return header && header->closed.load() != 0; }
+    uint64_t heartbeat() const { return header ? header->heartbeat.load() : 0; }
+
+    const SharedQuiltHeader *getHeader() const { return header; }
+
+    // the latest complete frame if one arrived since the last call, NULL
+    // otherwise. Stays valid until the next call.
+    const unsigned char *acquire();
+    uint64_t framesSkipped() const { return skipped; }
+
+private:
+    SharedQuiltConsumer(const SharedQuiltConsumer &);
+    SharedQuiltConsumer &operator=(const SharedQuiltConsumer &);
+
+    SharedQuiltMapping mapping;
+    SharedQuiltHeader *header;
+    uint64_t lastFrames;
+    uint64_t skipped;
+};
+
+#endif // HOLOPLAY_SHARED_QUILT_HPP
@@ -0,0 +1,180 @@
+/**
+ * SharedQuiltSource.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "SharedQuiltSource.hpp"
+
+#include <iostream>
+
+using namespace std;
+
+// how often missing producers are looked for
+static const double POLL_INTERVAL = 0.5;
+// a producer whose heartbeat didn't move for this long has crashed, its ring
+// is let go of so it can be created again when the producer restarts
+static const double STALE_AFTER = 2.0;
+
+SharedQuiltSource::SharedQuiltSource(const std::vector<std::string> &names, int maxWidth,
+                                     int maxHeight, const QuiltLayout &fallback,
+                                     GpuMemoryRegistry *memory)
+    : active(0),
+      maxWidth(maxWidth),
+      maxHeight(maxHeight),
+      shown(fallback),
+      lastPoll(-POLL_INTERVAL),
+      memory(memory),
+      frameTexture(0)
+{
+  for (size_t i = 0; i < names.size(); i++)
+  {
+    producers.push_back(std::unique_ptr<Producer>(new Producer()));
+    producers.back()->name = names[i];
+  }
+  cout << "[Info] waiting for quilts from " << names.size() << " producer"
+       << (names.size() == 1 ? "" : "s") << ", showing " << names[0] << endl;
+}
+
+SharedQuiltSource::~SharedQuiltSource()
+{
+  if (frameTexture)
+  {
+    if (memory)
+      memory->remove(GpuMemoryRegistry::Texture, frameTexture);
+    glDeleteTextures(1, &frameTexture);
+  }
+}
+
+void SharedQuiltSource::poll(Producer &producer, double time)
+{
+  SharedQuiltConsumer &consumer = producer.consumer;
+  if (consumer.producerClosed())
+  {
+    cout << "[Info] quilt producer " << producer.name << " quit";
+    if (consumer.framesSkipped())
+      cout << ", " << consumer.framesSkipped() << " of its frames were replaced before "
+           << "being shown";
+    cout << endl;
+    consumer.detach();
+    producer.session = 0;
+    producer.refused = false;
+  }
+  if (consumer.isAttached())
+  {
+    // every producer, shown or not, may crash and hold on to its name
+    uint64_t beat = consumer.heartbeat();
+    if (beat != producer.heartbeat)
+    {
+      producer.heartbeat = beat;
+      producer.lastBeat = time;
+    }
+    else if (time - producer.lastBeat > STALE_AFTER)
+    {
+      cout << "[Warning] quilt producer " << producer.name << " stopped responding" << endl;
+      producer.deadSession = consumer.getHeader()->session;
+      producer.deadBeat = beat;
+      consumer.detach();
+    }
+    return;
+  }
+
+  string error;
+  if (!consumer.attach(producer.name, error))
+    return;
+  const SharedQuiltHeader *header = consumer.getHeader();
+  // still the ring of the crashed producer (on POSIX until a new one
+  // replaces the name): let go right away, only looking costs a handle
+  if (header->session == producer.deadSession &&
+      consumer.heartbeat() == producer.deadBeat)
+  {
+    consumer.detach();
+    return;
+  }
+  producer.heartbeat = consumer.heartbeat();
+  producer.lastBeat = time;
+
+  // a producer restarted under the same name may send other quilts
+  if (int(header->width) > maxWidth || int(header->height) > maxHeight)
+  {
+    if (!producer.refused)
+      cout << "[Error] the " << header->width << "x" << header->height << " quilts of "
+           << producer.name << " don't fit in the " << maxWidth << "x" << maxHeight
+           << " quilt texture, use a larger --preset" << endl;
+    producer.refused = true;
+    consumer.detach();
+    return;
+  }
+  producer.refused = false;
+  // a slow producer that was let go of and came back is the same ring
+  if (header->session != producer.session)
+    cout << "[Info] receiving " << header->width << "x" << header->height << " quilts ("
+         << header->columns << "x" << header->rows << " views) from " << producer.name
+         << endl;
+  producer.session = header->session;
+}
+
+bool SharedQuiltSource::update(GLuint, double time)
+{
+  if (time - lastPoll >= POLL_INTERVAL)
+  {
+    for (size_t i = 0; i < producers.size(); i++)
+      poll(*producers[i], time);
+    lastPoll = time;
+  }
+
+  Producer &producer = *producers[active];
+  const unsigned char *pixels = producer.consumer.acquire();
+  if (!pixels)
+    return false;
+
+  const SharedQuiltHeader *header = producer.consumer.getHeader();
+  if (!frameTexture || int(header->width) != shown.width || int(header->height) != shown.height)
+  {
+    // the producer's size, so the layout covers all of it
+    if (frameTexture)
+    {
+      if (memory)
+        memory->remove(GpuMemoryRegistry::Texture, frameTexture);
+      glDeleteTextures(1, &frameTexture);
+    }
+    glGenTextures(1, &frameTexture);
+    glBindTexture(GL_TEXTURE_2D, frameTexture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, GLsizei(header->width), GLsizei(header->height), 0,
+                 GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    if (memory)
+      memory->addTexture("shared quilt", frameTexture, GL_RGBA8, int(header->width),
+                         int(header->height));
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_2D, frameTexture);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+  glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, GLsizei(header->width), GLsizei(header->height),
+                  GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  shown.width = int(header->width);
+  shown.height = int(header->height);
+  shown.columns = int(header->columns);
+  shown.rows = int(header->rows);
+  shown.views = int(header->views);
+  return true;
+}
+
+void SharedQuiltSource::selectNext()
+{
+  active = (active + 1) % producers.size();
+  Producer &producer = *producers[active];
+  cout << "[Info] showing quilts from " << producer.name
+       << (producer.consumer.isAttached() ? "" : " once it starts") << endl;
+}
@@ -0,0 +1,74 @@
+/**
+ * SharedQuiltSource.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_SHARED_QUILT_SOURCE_HPP
+#define HOLOPLAY_SHARED_QUILT_SOURCE_HPP
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "GpuMemory.hpp"
+#include "QuiltSource.hpp"
+#include "SharedQuilt.hpp"
+
+// Shows quilts rendered by other processes (see SharedQuilt.hpp), so the
+// display process only interlaces. Attaches to any number of named rings,
+// picking them up whenever their producer starts and letting go when it
+// quits, and shows one of them at a time; selectNext() switches.
+//
+// Frames go from the shared slot straight into an RGBA8 texture of the
+// source's own, the interlacer samples it as it is: the float quilt texture
+// would convert every frame. The slot doubles as the staging buffer: GL is
+// done with it when glTexSubImage2D returns, before the slot is handed back.
+class SharedQuiltSource : public QuiltSource
+{
+public:
+    // names of the rings, quilts larger than maxWidth x maxHeight are refused
+    SharedQuiltSource(const std::vector<std::string> &names, int maxWidth,
+                      int maxHeight, const QuiltLayout &fallback,
+                      GpuMemoryRegistry *memory = NULL);
+    ~SharedQuiltSource();
+
+    QuiltLayout layout() const { return shown; }
+    bool update(GLuint quiltTexture, double time);
+    GLuint texture() const { return frameTexture; }
+
+    void selectNext();
+
+private:
+    SharedQuiltSource(const SharedQuiltSource &);
+    SharedQuiltSource &operator=(const SharedQuiltSource &);
+
+    struct Producer
+    {
+        Producer() : heartbeat(0), lastBeat(0.0), session(0), deadSession(0),
+                     deadBeat(0), refused(false) {}
+        std::string name;
+        SharedQuiltConsumer consumer;
+        uint64_t heartbeat; // the ring's, when last looked at
+        double lastBeat;    // time it last changed
+        uint64_t session;   // of the ring last attached, 0 for none
+        uint64_t deadSession; // ring let go of because its heartbeat
+        uint64_t deadBeat;    // stopped there, not opened again until it moves
+        bool refused;     // doesn't fit, not tried again until it restarts
+    };
+
+    void poll(Producer &producer, double time);
+
+    std::vector<std::unique_ptr<Producer>> producers;
+    size_t active;
+    int maxWidth, maxHeight;
+    QuiltLayout shown; // of the frame in the texture
+    double lastPoll;
+    GpuMemoryRegistry *memory;
+    GLuint frameTexture; // 0 until the first frame, then the size of the
+                         // frame in it
+};
+
+#endif // HOLOPLAY_SHARED_QUILT_SOURCE_HPP
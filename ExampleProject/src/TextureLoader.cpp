@@ -0,0 +1,667 @@
+/**
+ * TextureLoader.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "TextureLoader.hpp"
+
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include "LightFieldFile.hpp"
+#include "stb_image.h"
+
+using namespace std;
+
+// sRGB <-> linear, so mip levels of color textures are averaged in linear space
+struct SrgbTable
+{
+  float values[256];
+  SrgbTable()
+  {
+    for (int i = 0; i < 256; i++)
+    {
+      float c = float(i) / 255.0f;
+      values[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+  }
+};
+
+static const float *srgbToLinearTable()
+{
+  static const SrgbTable table; // initialized once, even with several workers
+  return table.values;
+}
+
+static unsigned char linearToSrgb(float c)
+{
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+  return (unsigned char)(std::min(std::max(c, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+// internal / client formats for a given number of 8 bit channels
+static void chooseFormat(int channels, const TextureOptions &options, bool hasS3TC,
+                         bool &compressed, GLenum &internalFormat, GLenum &format)
+{
+  compressed = options.compress && hasS3TC && channels >= 3;
+  switch (channels)
+  {
+  case 1:
+    internalFormat = GL_R8;
+    format = GL_RED;
+    break;
+  case 2:
+    internalFormat = GL_RG8;
+    format = GL_RG;
+    break;
+  case 3:
+    format = GL_RGB;
+    if (compressed)
+      internalFormat = options.srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+                                    : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    else
+      internalFormat = options.srgb ? GL_SRGB8 : GL_RGB8;
+    break;
+  default:
+    format = GL_RGBA;
+    if (compressed)
+      internalFormat = options.srgb ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT
+                                    : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+    else
+      internalFormat = options.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+    break;
+  }
+}
+
+// bytes a level occupies on the GPU
+static size_t levelBytes(int width, int height, int channels, bool compressed)
+{
+  if (compressed)
+  {
+    size_t blocks = size_t((width + 3) / 4) * size_t((height + 3) / 4);
+    return blocks * (channels == 3 ? 8 : 16); // DXT1 / DXT5
+  }
+  return size_t(width) * size_t(height) * size_t(channels);
+}
+
+TextureLoader::TextureLoader(GLFWwindow *shareWith, ThreadPool &pool,
+                             GpuMemoryRegistry *memory, size_t stagingBytes)
+    : pool(pool),
+      memory(memory),
+      uploadWindow(NULL),
+      stopping(false),
+      slotSize(stagingBytes / STAGING_SLOTS),
+      stagingBuffer(0),
+      stagingMemory(NULL),
+      nextSlot(0)
+{
+  for (int i = 0; i < STAGING_SLOTS; i++)
+    slotFences[i] = 0;
+
+  hasBufferStorage = GLEW_ARB_buffer_storage ? true : false;
+  hasTextureStorage = GLEW_ARB_texture_storage ? true : false;
+  hasS3TC = GLEW_EXT_texture_compression_s3tc ? true : false;
+
+  // a hidden window whose context shares objects with the render context
+  glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+  uploadWindow = glfwCreateWindow(1, 1, "Texture Loader", NULL, shareWith);
+  glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+  if (!uploadWindow)
+    throw std::runtime_error("Couldn't create the texture loader context");
+
+  uploadThread = std::thread(&TextureLoader::uploadLoop, this);
+}
+
+TextureLoader::~TextureLoader()
+{
+  {
+    lock_guard<mutex> lock(queueMutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  uploadThread.join();
+  glfwDestroyWindow(uploadWindow);
+
+  // whatever was still queued will never be uploaded
+  for (size_t i = 0; i < uploads.size(); i++)
+    fail(*uploads[i]->state, "texture loader shut down");
+}
+
+TextureHandle TextureLoader::load(const std::string &path,
+                                  const TextureOptions &options)
+{
+  TextureHandle handle;
+  handle.state = make_shared<TextureHandle::State>();
+
+  shared_ptr<UploadJob> job = make_shared<UploadJob>();
+  job->state = handle.state;
+  job->options = options;
+  job->target = GL_TEXTURE_2D;
+  job->faces.resize(1);
+  job->name = path;
+
+  // decode and build the mip chain on a worker
+  pool.submit([this, job, path]() {
+    string error;
+    if (!decode(path, job->options, job->options.compress && hasS3TC, job->faces[0],
+                error))
+    {
+      cout << "[Error] failed to load texture " << path << ": " << error << endl;
+      fail(*job->state, error);
+      return;
+    }
+    enqueueUpload(job);
+  });
+  return handle;
+}
+
+TextureHandle TextureLoader::loadCubemap(const std::vector<std::string> &faces,
+                                         const TextureOptions &options)
+{
+  TextureHandle handle;
+  handle.state = make_shared<TextureHandle::State>();
+  if (faces.size() != 6)
+  {
+    fail(*handle.state, "a cubemap needs exactly 6 faces");
+    return handle;
+  }
+
+  shared_ptr<UploadJob> job = make_shared<UploadJob>();
+  job->state = handle.state;
+  job->options = options;
+  job->target = GL_TEXTURE_CUBE_MAP;
+  job->faces.resize(6);
+  job->name = faces[0] + " (cubemap)";
+
+  // one task per face, the last one to finish hands the cubemap over
+  shared_ptr<CubemapDecode> progress = make_shared<CubemapDecode>();
+  progress->remaining = 6;
+  for (size_t f = 0; f < 6; f++)
+  {
+    string path = faces[f];
+    pool.submit([this, job, progress, path, f]() {
+      string error;
+      if (!decode(path, job->options, job->options.compress && hasS3TC,
+                  job->faces[f], error))
+      {
+        cout << "[Error] failed to load cubemap face " << path << ": " << error << endl;
+        lock_guard<mutex> lock(progress->mutex);
+        if (progress->error.empty())
+          progress->error = path + ": " + error;
+      }
+      if (--progress->remaining == 0)
+        finishCubemap(job, *progress);
+    });
+  }
+  return handle;
+}
+
+void TextureLoader::finishCubemap(const std::shared_ptr<UploadJob> &job,
+                                  CubemapDecode &progress)
+{
+  if (!progress.error.empty())
+  {
+    fail(*job->state, progress.error);
+    return;
+  }
+
+  const Image &first = job->faces[0];
+  for (size_t f = 0; f < job->faces.size(); f++)
+  {
+    const Image &face = job->faces[f];
+    if (face.width != first.width || face.height != first.height ||
+        face.width != face.height || face.channels != first.channels)
+    {
+      string error = "cubemap faces must be square and of the same size and format";
+      cout << "[Error] " << job->name << ": " << error << endl;
+      fail(*job->state, error);
+      return;
+    }
+  }
+  enqueueUpload(job);
+}
+
+void TextureLoader::fail(TextureHandle::State &state, const std::string &error)
+{
+  state.error = error;
+  state.status = TextureHandle::Failed;
+  state.promise.set_value(0);
+}
+
+bool TextureLoader::decode(const std::string &path, const TextureOptions &options,
+                           bool compress, Image &image, std::string &error)
+{
+  int width, height, channels;
+  unsigned char *data = stbi_load(path.c_str(), &width, &height, &channels, 0);
+  if (!data)
+  {
+    const char *reason = stbi_failure_reason();
+    error = reason ? reason : "unknown error";
+    return false;
+  }
+
+  image.width = width;
+  image.height = height;
+  image.channels = channels;
+  image.levels.resize(1);
+  image.levels[0].assign(data, data + size_t(width) * size_t(height) * size_t(channels));
+  stbi_image_free(data);
+
+  if (options.mipmaps)
+    buildMipChain(image, options.srgb);
+  // same rule as chooseFormat, which picks the matching internal format
+  if (compress && channels >= 3)
+    compressLevels(image);
+  return true;
+}
+
+// 2x2 box filter down to 1x1, odd edges reuse the last row / column
+void TextureLoader::buildMipChain(Image &image, bool srgb)
+{
+  const float *toLinear = srgbToLinearTable();
+  const int c = image.channels;
+  int w = image.width;
+  int h = image.height;
+
+  while (w > 1 || h > 1)
+  {
+    const vector<unsigned char> &src = image.levels.back();
+    int nw = std::max(1, w / 2);
+    int nh = std::max(1, h / 2);
+    vector<unsigned char> dst(size_t(nw) * size_t(nh) * size_t(c));
+
+    for (int y = 0; y < nh; y++)
+    {
+      int y0 = std::min(2 * y, h - 1);
+      int y1 = std::min(2 * y + 1, h - 1);
+      for (int x = 0; x < nw; x++)
+      {
+        int x0 = std::min(2 * x, w - 1);
+        int x1 = std::min(2 * x + 1, w - 1);
+        const unsigned char *p[4] = {
+            &src[(size_t(y0) * w + x0) * c], &src[(size_t(y0) * w + x1) * c],
+            &src[(size_t(y1) * w + x0) * c], &src[(size_t(y1) * w + x1) * c]};
+        unsigned char *out = &dst[(size_t(y) * nw + x) * c];
+        for (int k = 0; k < c; k++)
+        {
+          // alpha (and single / dual channel data) is never sRGB encoded
+          if (srgb && c >= 3 && k < 3)
+          {
+            float sum = toLinear[p[0][k]] + toLinear[p[1][k]] +
+                        toLinear[p[2][k]] + toLinear[p[3][k]];
+            out[k] = linearToSrgb(sum * 0.25f);
+          }
+          else
+          {
+            out[k] = (unsigned char)((p[0][k] + p[1][k] + p[2][k] + p[3][k] + 2) / 4);
+          }
+        }
+      }
+    }
+
+    image.levels.push_back(std::move(dst));
+    w = nw;
+    h = nh;
+  }
+}
+
+// DXT5 alpha: 8 interpolated values between the block's extremes, 3 bit indices
+static void encodeAlphaBlock(const unsigned char *rgba, size_t stride, unsigned char *block)
+{
+  int lo = 255, hi = 0;
+  for (int i = 0; i < 16; i++)
+  {
+    int a = rgba[size_t(i / 4) * stride + size_t(i % 4) * 4 + 3];
+    lo = std::min(lo, a);
+    hi = std::max(hi, a);
+  }
+  block[0] = (unsigned char)hi;
+  block[1] = (unsigned char)lo;
+
+  uint64_t indices = 0;
+  if (hi > lo)
+  {
+    // with alpha0 > alpha1, index 0 is alpha0, 1 is alpha1 and 2..7 step
+    // from alpha0 towards alpha1
+    static const int order[8] = {1, 7, 6, 5, 4, 3, 2, 0};
+    for (int i = 0; i < 16; i++)
+    {
+      int a = rgba[size_t(i / 4) * stride + size_t(i % 4) * 4 + 3];
+      int step = ((a - lo) * 7 + (hi - lo) / 2) / (hi - lo); // 0 = lo, 7 = hi
+      indices |= uint64_t(order[step]) << (3 * i);
+    }
+  }
+  for (int b = 0; b < 6; b++)
+    block[2 + b] = (unsigned char)(indices >> (8 * b));
+}
+
+// replaces every level with DXT1 (rgb) or DXT5 (rgba) blocks, edge blocks of
+// levels that aren't a multiple of 4 repeat the last row / column
+void TextureLoader::compressLevels(Image &image)
+{
+  const int c = image.channels;
+  const int blockBytes = c == 3 ? 8 : 16;
+  for (size_t level = 0; level < image.levels.size(); level++)
+  {
+    const vector<unsigned char> &src = image.levels[level];
+    int w = std::max(1, image.width >> level);
+    int h = std::max(1, image.height >> level);
+    int bw = (w + 3) / 4;
+    int bh = (h + 3) / 4;
+    vector<unsigned char> dst(size_t(bw) * size_t(bh) * size_t(blockBytes));
+
+    unsigned char rgba[16 * 4];
+    for (int by = 0; by < bh; by++)
+    {
+      for (int bx = 0; bx < bw; bx++)
+      {
+        for (int i = 0; i < 16; i++)
+        {
+          int x = std::min(bx * 4 + i % 4, w - 1);
+          int y = std::min(by * 4 + i / 4, h - 1);
+          const unsigned char *p = &src[(size_t(y) * w + x) * c];
+          unsigned char *out = rgba + i * 4;
+          out[0] = p[0];
+          out[1] = p[1];
+          out[2] = p[2];
+          out[3] = c == 4 ? p[3] : 255;
+        }
+        unsigned char *block = &dst[(size_t(by) * bw + bx) * blockBytes];
+        if (c == 3)
+        {
+          encodeBc1Block(rgba, 16, block);
+        }
+        else
+        {
+          encodeAlphaBlock(rgba, 16, block);
+          encodeBc1Block(rgba, 16, block + 8);
+        }
+      }
+    }
+    image.levels[level].swap(dst);
+  }
+}
+
+void TextureLoader::enqueueUpload(const std::shared_ptr<UploadJob> &job)
+{
+  {
+    lock_guard<mutex> lock(queueMutex);
+    uploads.push_back(job);
+  }
+  wake.notify_one();
+}
+
+// loader thread
+// =========================================================
+void TextureLoader::uploadLoop()
+{
+  glfwMakeContextCurrent(uploadWindow);
+  createStaging();
+
+  for (;;)
+  {
+    shared_ptr<UploadJob> job;
+    {
+      unique_lock<mutex> lock(queueMutex);
+      wake.wait(lock, [this] { return stopping || !uploads.empty(); });
+      if (stopping)
+        break;
+      job = uploads.front();
+      uploads.pop_front();
+    }
+    upload(*job);
+  }
+
+  destroyStaging();
+  glfwMakeContextCurrent(NULL);
+}
+
+void TextureLoader::upload(UploadJob &job)
+{
+  const Image &base = job.faces[0];
+  bool compressed;
+  GLenum internalFormat, format;
+  chooseFormat(base.channels, job.options, hasS3TC, compressed, internalFormat, format);
+
+  const int levels = int(base.levels.size());
+  GLuint tex;
+  glGenTextures(1, &tex);
+  glBindTexture(job.target, tex);
+  glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+  // compressed levels arrive as blocks, so every format can be allocated up
+  // front and filled with sub image uploads
+  bool immutable = hasTextureStorage;
+  if (immutable)
+    glTexStorage2D(job.target, levels, internalFormat, base.width, base.height);
+
+  size_t bytes = 0;
+  for (size_t f = 0; f < job.faces.size(); f++)
+  {
+    const Image &face = job.faces[f];
+    GLenum faceTarget = job.target == GL_TEXTURE_CUBE_MAP
+                            ? GLenum(GL_TEXTURE_CUBE_MAP_POSITIVE_X + f)
+                            : job.target;
+    for (int level = 0; level < levels; level++)
+    {
+      int lw = std::max(1, face.width >> level);
+      int lh = std::max(1, face.height >> level);
+      const unsigned char *pixels = &face.levels[size_t(level)][0];
+      if (compressed)
+      {
+        if (!immutable)
+        {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // NULL must not read the ring
+          glCompressedTexImage2D(faceTarget, level, internalFormat, lw, lh, 0,
+                                 GLsizei(face.levels[size_t(level)].size()), NULL);
+        }
+        uploadCompressedLevel(faceTarget, level, internalFormat, lw, lh, pixels,
+                              face.channels == 3 ? 8 : 16);
+      }
+      else
+      {
+        if (!immutable)
+        {
+          glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // NULL must not read the ring
+          glTexImage2D(faceTarget, level, GLint(internalFormat), lw, lh, 0, format,
+                       GL_UNSIGNED_BYTE, NULL);
+        }
+        uploadLevel(faceTarget, level, lw, lh, format, pixels, face.channels);
+      }
+      bytes += levelBytes(lw, lh, face.channels, compressed);
+    }
+  }
+
+  GLenum wrap = job.target == GL_TEXTURE_CUBE_MAP ? GL_CLAMP_TO_EDGE : GLenum(job.options.wrap);
+  glTexParameteri(job.target, GL_TEXTURE_WRAP_S, GLint(wrap));
+  glTexParameteri(job.target, GL_TEXTURE_WRAP_T, GLint(wrap));
+  if (job.target == GL_TEXTURE_CUBE_MAP)
+    glTexParameteri(job.target, GL_TEXTURE_WRAP_R, GLint(wrap));
+  glTexParameteri(job.target, GL_TEXTURE_MIN_FILTER,
+                  levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+  glTexParameteri(job.target, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(job.target, GL_TEXTURE_MAX_LEVEL, levels - 1);
+  if (base.channels == 1)
+  {
+    // grey images read the same in every channel
+    glTexParameteri(job.target, GL_TEXTURE_SWIZZLE_G, GL_RED);
+    glTexParameteri(job.target, GL_TEXTURE_SWIZZLE_B, GL_RED);
+  }
+  glBindTexture(job.target, 0);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+  // the texture may only be used once the upload has executed
+  GLsync done = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  while (glClientWaitSync(done, GL_SYNC_FLUSH_COMMANDS_BIT, 100000000) == GL_TIMEOUT_EXPIRED)
+    ;
+  glDeleteSync(done);
+
+  cout << "[Info] loaded texture " << job.name << " (" << base.width << "x"
+       << base.height << ", " << levels << " levels, " << bytes / 1024 << " KB)"
+       << endl;
+  if (memory)
+    memory->addTexture(job.name, tex, internalFormat, base.width, base.height,
+                       levels, int(job.faces.size()), bytes);
+
+  TextureHandle::State &state = *job.state;
+  state.id = tex;
+  state.target = job.target;
+  state.width = base.width;
+  state.height = base.height;
+  state.internalFormat = internalFormat;
+  state.bytes = bytes;
+  state.status = TextureHandle::Ready;
+  state.promise.set_value(tex);
+}
+
+// copy a level through the staging ring, as many rows at a time as fit a slot
+void TextureLoader::uploadLevel(GLenum faceTarget, GLint level, int width, int height,
+                                GLenum format, const unsigned char *pixels, int channels)
+{
+  const size_t rowBytes = size_t(width) * size_t(channels);
+  const int rowsPerSlot = int(std::min(slotSize / rowBytes, size_t(height)));
+  if (rowsPerSlot == 0)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glTexSubImage2D(faceTarget, level, 0, 0, width, height, format,
+                    GL_UNSIGNED_BYTE, pixels);
+    return;
+  }
+
+  for (int y = 0; y < height; y += rowsPerSlot)
+  {
+    int rows = std::min(rowsPerSlot, height - y);
+    size_t offset;
+    unsigned char *dst = mapStaging(offset);
+    memcpy(dst, pixels + size_t(y) * rowBytes, size_t(rows) * rowBytes);
+    unmapStaging();
+    glTexSubImage2D(faceTarget, level, 0, y, width, rows, format, GL_UNSIGNED_BYTE,
+                    reinterpret_cast<void *>(offset));
+    fenceStaging(offset);
+  }
+}
+
+// like uploadLevel, in rows of 4x4 blocks
+void TextureLoader::uploadCompressedLevel(GLenum faceTarget, GLint level,
+                                          GLenum internalFormat, int width, int height,
+                                          const unsigned char *blocks, int blockBytes)
+{
+  const size_t rowBytes = size_t((width + 3) / 4) * size_t(blockBytes);
+  const int blockRows = (height + 3) / 4;
+  const int rowsPerSlot = int(std::min(slotSize / rowBytes, size_t(blockRows)));
+  if (rowsPerSlot == 0)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    glCompressedTexSubImage2D(faceTarget, level, 0, 0, width, height, internalFormat,
+                              GLsizei(rowBytes * size_t(blockRows)), blocks);
+    return;
+  }
+
+  for (int row = 0; row < blockRows; row += rowsPerSlot)
+  {
+    int rows = std::min(rowsPerSlot, blockRows - row);
+    size_t bytes = size_t(rows) * rowBytes;
+    size_t offset;
+    unsigned char *dst = mapStaging(offset);
+    memcpy(dst, blocks + size_t(row) * rowBytes, bytes);
+    unmapStaging();
+    // only the last chunk may end on a partial block, at the level's edge
+    int y = row * 4;
+    glCompressedTexSubImage2D(faceTarget, level, 0, y, width,
+                              std::min(rows * 4, height - y), internalFormat,
+                              GLsizei(bytes), reinterpret_cast<void *>(offset));
+    fenceStaging(offset);
+  }
+}
+
+// staging ring
+// =========================================================
+void TextureLoader::createStaging()
+{
+  glGenBuffers(1, &stagingBuffer);
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+  GLsizeiptr total = GLsizeiptr(slotSize * STAGING_SLOTS);
+  if (hasBufferStorage)
+  {
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    glBufferStorage(GL_PIXEL_UNPACK_BUFFER, total, NULL, flags);
+    stagingMemory = static_cast<unsigned char *>(
+        glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, total, flags));
+  }
+  else
+  {
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, total, NULL, GL_STREAM_DRAW);
+  }
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+  if (memory)
+    memory->addBuffer("texture loader staging", stagingBuffer, size_t(total));
+}
+
+void TextureLoader::destroyStaging()
+{
+  for (int i = 0; i < STAGING_SLOTS; i++)
+  {
+    if (slotFences[i])
+      glDeleteSync(slotFences[i]);
+    slotFences[i] = 0;
+  }
+  if (stagingMemory)
+  {
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    stagingMemory = NULL;
+  }
+  if (memory)
+    memory->remove(GpuMemoryRegistry::Buffer, stagingBuffer);
+  glDeleteBuffers(1, &stagingBuffer);
+}
+
+unsigned char *TextureLoader::mapStaging(size_t &offset)
+{
+  int slot = nextSlot;
+  nextSlot = (nextSlot + 1) % STAGING_SLOTS;
+
+  // the GPU may still be reading what was last written to this slot
+  if (slotFences[slot])
+  {
+    while (glClientWaitSync(slotFences[slot], GL_SYNC_FLUSH_COMMANDS_BIT,
+                            100000000) == GL_TIMEOUT_EXPIRED)
+      ;
+    glDeleteSync(slotFences[slot]);
+    slotFences[slot] = 0;
+  }
+
+  offset = size_t(slot) * slotSize;
+  glBindBuffer(GL_PIXEL_UNPACK_BUFFER, stagingBuffer);
+  if (stagingMemory)
+    return stagingMemory + offset;
+
+  // the slot is fenced, so there is no need for the driver to synchronize
+  return static_cast<unsigned char *>(glMapBufferRange(
+      GL_PIXEL_UNPACK_BUFFER, GLintptr(offset), GLsizeiptr(slotSize),
+      GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT));
+}
+
+void TextureLoader::unmapStaging()
+{
+  if (!stagingMemory)
+    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+}
+
+void TextureLoader::fenceStaging(size_t offset)
+{
+  int slot = int(offset / slotSize);
+  slotFences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,194 @@
+/**
+ * TextureLoader.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_TEXTURE_LOADER_HPP
+#define HOLOPLAY_TEXTURE_LOADER_HPP
+
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "GpuMemory.hpp"
+#include "ThreadPool.hpp"
+
+struct GLFWwindow;
+
+struct TextureOptions
+{
+    bool srgb = false;     // store as sRGB, sampling returns linear values
+    bool mipmaps = true;   // full mip chain, built on the worker threads
+    bool compress = false; // block compress (DXT1 / DXT5) on the worker threads
+                           // when EXT_texture_compression_s3tc is available
+    GLint wrap = GL_REPEAT;
+};
+
+// Result of an asynchronous load. Copies share the same load; the render
+// thread polls ready() each frame and never blocks on it.
+class TextureHandle
+{
+public:
+    enum Status
+    {
+        Empty,   // default constructed, nothing requested
+        Pending, // decoding or uploading
+        Ready,   // id() can be bound in any context sharing with the loader
+        Failed   // error() says why
+    };
+
+    Status status() const { return state ? Status(state->status.load()) : Empty; }
+    bool ready() const { return status() == Ready; }
+    bool failed() const { return status() == Failed; }
+
+    // only meaningful once ready()
+    GLuint id() const { return ready() ? state->id : 0; }
+    GLenum target() const { return ready() ? state->target : 0; }
+    int width() const { return ready() ? state->width : 0; }
+    int height() const { return ready() ? state->height : 0; }
+    GLenum internalFormat() const { return ready() ? state->internalFormat : 0; }
+    size_t bytes() const { return ready() ? state->bytes : 0; } // all levels
+    std::string error() const { return failed() ? state->error : std::string(); }
+
+    // blocks until the texture is uploaded, the id is 0 if loading failed.
+    // Meant for loading screens and tools, not for the render loop.
+    std::shared_future<GLuint> future() const { return state->future; }
+
+private:
+    friend class TextureLoader;
+
+    struct State
+    {
+        State() : status(Pending), id(0), target(0), width(0), height(0),
+                  internalFormat(0), bytes(0), future(promise.get_future()) {}
+        std::atomic<int> status;
+        GLuint id;
+        GLenum target;
+        int width;
+        int height;
+        GLenum internalFormat;
+        size_t bytes;
+        std::string error;
+        std::promise<GLuint> promise;
+        std::shared_future<GLuint> future;
+    };
+    std::shared_ptr<State> state;
+};
+
+// Loads image files into textures without blocking the render thread.
+//
+// Files are decoded, their mip chains built and, if asked, block compressed
+// on the worker pool. A loader thread owning a hidden context shared with the
+// render context then copies the data into a ring of persistently mapped
+// pixel unpack buffers (plain mapped PBOs without ARB_buffer_storage) and
+// uploads from there into immutable storage. 8 bit images keep 8 bit internal
+// formats; a texture is marked ready once a fence after its upload has
+// signaled.
+class TextureLoader
+{
+public:
+    // must be called on the main thread with shareWith's context current.
+    // Loaded textures and the staging ring are recorded in memory if given;
+    // whoever deletes a loaded texture removes its record.
+    TextureLoader(GLFWwindow *shareWith, ThreadPool &pool,
+                  GpuMemoryRegistry *memory = NULL,
+                  size_t stagingBytes = 32 << 20);
+    // main thread too, glfw windows are destroyed there. Destroy the pool
+    // first so no decode task is left to hand over an upload.
+    ~TextureLoader();
+
+    TextureHandle load(const std::string &path,
+                       const TextureOptions &options = TextureOptions());
+
+    // six square faces of equal size in GL order (+x, -x, +y, -y, +z, -z),
+    // decoded in parallel and uploaded as one immutable, mipmapped cubemap
+    TextureHandle loadCubemap(const std::vector<std::string> &faces,
+                              const TextureOptions &options = TextureOptions());
+
+private:
+    TextureLoader(const TextureLoader &);
+    TextureLoader &operator=(const TextureLoader &);
+
+    // a decoded image and its mip chain, levels[0] is the full image. Levels
+    // hold DXT1 / DXT5 blocks instead of pixels once compressed.
+    struct Image
+    {
+        int width;
+        int height;
+        int channels;
+        std::vector<std::vector<unsigned char>> levels;
+    };
+
+    struct UploadJob
+    {
+        std::shared_ptr<TextureHandle::State> state;
+        TextureOptions options;
+        GLenum target;
+        std::vector<Image> faces; // one for 2D textures
+        std::string name;
+    };
+
+    // progress of the parallel face decodes of one cubemap
+    struct CubemapDecode
+    {
+        std::atomic<int> remaining;
+        std::mutex mutex;
+        std::string error; // first failure, if any
+    };
+
+    static bool decode(const std::string &path, const TextureOptions &options,
+                       bool compress, Image &image, std::string &error);
+    static void fail(TextureHandle::State &state, const std::string &error);
+    void finishCubemap(const std::shared_ptr<UploadJob> &job, CubemapDecode &progress);
+    static void buildMipChain(Image &image, bool srgb);
+    static void compressLevels(Image &image);
+
+    void enqueueUpload(const std::shared_ptr<UploadJob> &job);
+    void uploadLoop();
+    void upload(UploadJob &job);
+    void uploadLevel(GLenum faceTarget, GLint level, int width, int height,
+                     GLenum format, const unsigned char *pixels, int channels);
+    void uploadCompressedLevel(GLenum faceTarget, GLint level, GLenum internalFormat,
+                               int width, int height, const unsigned char *blocks,
+                               int blockBytes);
+    unsigned char *mapStaging(size_t &offset); // waits for the slot's fence
+    void unmapStaging();                // before the GL call reading the slot
+    void fenceStaging(size_t offset);   // after the GL call reading the slot
+    void createStaging();
+    void destroyStaging();
+
+    ThreadPool &pool;
+    GpuMemoryRegistry *memory;
+    GLFWwindow *uploadWindow; // hidden, only its context is used
+    std::thread uploadThread;
+
+    std::mutex queueMutex;
+    std::condition_variable wake;
+    std::deque<std::shared_ptr<UploadJob>> uploads;
+    bool stopping;
+
+    // capabilities, queried on the main thread
+    bool hasBufferStorage;
+    bool hasTextureStorage;
+    bool hasS3TC;
+
+    // staging ring, only touched by the loader thread
+    static const int STAGING_SLOTS = 3;
+    size_t slotSize;
+    GLuint stagingBuffer;
+    unsigned char *stagingMemory; // persistent mapping, NULL without it
+    GLsync slotFences[STAGING_SLOTS];
+    int nextSlot;
+};
+
+#endif // HOLOPLAY_TEXTURE_LOADER_HPP
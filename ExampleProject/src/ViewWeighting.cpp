@@ -0,0 +1,63 @@
+/**
+ * ViewWeighting.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "ViewWeighting.hpp"
+
+#include <cmath>
+
+using namespace std;
+
+float ViewWeighting::scale(int view, int views) const
+{
+  if (!enabled() || views < 2)
+    return 1.0f;
+  float t = fabs(2.0f * float(view) / float(views - 1) - 1.0f);
+  return 1.0f - (1.0f - edgeScale) * pow(t, falloff);
+}
+
+vector<glm::ivec4> weightedViewRects(const ViewWeighting &weighting,
+                                     int viewWidth, int viewHeight,
+                                     int columns, int rows, int views)
+{
+  vector<glm::ivec4> rects;
+  int y = 0;
+  for (int row = 0; row < rows; row++)
+  {
+    int x = 0, rowHeight = 0;
+    for (int column = 0; column < columns; column++)
+    {
+      int view = row * columns + column;
+      if (view >= views)
+        break;
+      float s = weighting.scale(view, views);
+      // rounding down keeps every row within columns * viewWidth
+      int width = int(float(viewWidth) * s);
+      int height = int(float(viewHeight) * s);
+      width = width > 0 ? width : 1;
+      height = height > 0 ? height : 1;
+      rects.push_back(glm::ivec4(x, y, width, height));
+      x += width;
+      rowHeight = height > rowHeight ? height : rowHeight;
+    }
+    y += rowHeight;
+  }
+  return rects;
+}
+
+float shadedFraction(const vector<glm::ivec4> &rects, int viewWidth, int viewHeight)
+{
+  double shaded = 0.0;
+  for (size_t i = 0; i < rects.size(); i++)
+    shaded += double(rects[i].z) * double(rects[i].w);
+  double full = double(viewWidth) * double(viewHeight) * double(rects.size());
+  return full > 0.0 ? float(shaded / full) : 1.0f;
+}
@@ -0,0 +1,42 @@
+/**
+ * ViewWeighting.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_VIEW_WEIGHTING_HPP
+#define HOLOPLAY_VIEW_WEIGHTING_HPP
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// How much smaller views get towards the edges of the view cone, where they
+// are seen less and at oblique angles. A view at distance t from the center
+// (0 at the center, 1 for the outermost views) is rendered at
+//     1 - (1 - edgeScale) * pow(t, falloff)
+// of the full view width and height.
+struct ViewWeighting
+{
+    float edgeScale = 1.0f; // of the outermost views, 1 turns weighting off
+    float falloff = 2.0f;   // 1 shrinks linearly, higher keeps more views sharp
+
+    bool enabled() const { return edgeScale < 1.0f; }
+    float scale(int view, int views) const;
+};
+
+// Packs views of viewWidth x viewHeight, scaled by weighting, into a quilt
+// of columns x rows. The quilt order is kept: views go left to right from
+// the bottom row up, every row of tiles as high as its largest view. The
+// result never takes more than columns * viewWidth x rows * viewHeight.
+// Rects are x, y, width, height in pixels.
+std::vector<glm::ivec4> weightedViewRects(const ViewWeighting &weighting,
+                                          int viewWidth, int viewHeight,
+                                          int columns, int rows, int views);
+
+// shaded pixels of rects against views of viewWidth x viewHeight each
+float shadedFraction(const std::vector<glm::ivec4> &rects, int viewWidth,
+                     int viewHeight);
+
+#endif // HOLOPLAY_VIEW_WEIGHTING_HPP
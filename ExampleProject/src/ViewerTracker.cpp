@@ -0,0 +1,228 @@
+/**
+ * ViewerTracker.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include "ViewerTracker.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <winsock2.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// seconds without a datagram after which the eyes are unknown
+static const double STALE = 1.0;
+
+static double now()
+{
+  return chrono::duration<double>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void closeSocket(long long socket)
+{
+#ifdef WIN32
+  closesocket(SOCKET(socket));
+  WSACleanup();
+#else
+  close(int(socket));
+#endif
+}
+
+// "x y z" triples separated by spaces, ';', ',' or newlines, a partial
+// triple at the end is dropped
+static vector<glm::vec3> parseEyes(string text)
+{
+  replace(text.begin(), text.end(), ';', ' ');
+  replace(text.begin(), text.end(), ',', ' ');
+  istringstream values(text);
+  vector<glm::vec3> eyes;
+  glm::vec3 eye;
+  while (values >> eye.x >> eye.y >> eye.z)
+    eyes.push_back(eye);
+  return eyes;
+}
+
+ViewerTracker::ViewerTracker() : latestTime(-1.0), running(false), socket(-1)
+{
+}
+
+ViewerTracker::~ViewerTracker()
+{
+  if (running)
+  {
+    running = false;
+    thread.join();
+  }
+  if (socket >= 0)
+    closeSocket(socket);
+}
+
+ViewerTracker *ViewerTracker::listen(int port)
+{
+  const string where = "127.0.0.1:" + to_string(port);
+#ifdef WIN32
+  WSADATA wsa;
+  if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0)
+    throw runtime_error("couldn't start Winsock to listen for viewers");
+  SOCKET handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (handle == INVALID_SOCKET)
+  {
+    WSACleanup();
+    throw runtime_error("couldn't open a socket to listen for viewers on " + where);
+  }
+  long long s = (long long)handle;
+  DWORD timeout = 200;
+#else
+  int handle = ::socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+  if (handle < 0)
+    throw runtime_error("couldn't open a socket to listen for viewers on " + where);
+  long long s = handle;
+  timeval timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_usec = 200000;
+#endif
+  sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons((unsigned short)port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (::bind(handle, (const sockaddr *)&address, sizeof(address)) != 0)
+  {
+    closeSocket(s);
+    throw runtime_error("couldn't listen for viewers on " + where +
+                        ", is another program using the port?");
+  }
+  // recv() wakes up now and then so the thread notices when to stop
+  setsockopt(handle, SOL_SOCKET, SO_RCVTIMEO, (const char *)&timeout, sizeof(timeout));
+
+  ViewerTracker *tracker = new ViewerTracker();
+  tracker->socket = s;
+  tracker->running = true;
+  tracker->thread = std::thread(&ViewerTracker::receiveLoop, tracker);
+  return tracker;
+}
+
+ViewerTracker *ViewerTracker::replay(const string &path)
+{
+  ifstream file(path.c_str());
+  if (!file)
+    throw runtime_error("couldn't read the track file " + path);
+  ViewerTracker *tracker = new ViewerTracker();
+  string line;
+  while (getline(file, line))
+  {
+    istringstream values(line);
+    Moment moment;
+    if (line.empty() || line[0] == '#' || !(values >> moment.time))
+      continue;
+    string rest;
+    getline(values, rest);
+    moment.eyes = parseEyes(rest);
+    tracker->track.push_back(moment);
+  }
+  if (tracker->track.empty())
+  {
+    delete tracker;
+    throw runtime_error("the track file " + path + " holds no eye positions");
+  }
+  stable_sort(tracker->track.begin(), tracker->track.end(),
+              [](const Moment &a, const Moment &b) { return a.time < b.time; });
+  return tracker;
+}
+
+void ViewerTracker::receiveLoop()
+{
+  char buffer[4096];
+  while (running)
+  {
+#ifdef WIN32
+    int received = recv(SOCKET(socket), buffer, sizeof(buffer), 0);
+#else
+    long received = recv(int(socket), buffer, sizeof(buffer), 0);
+#endif
+    if (received < 0)
+      continue; // timed out
+    vector<glm::vec3> eyes = parseEyes(string(buffer, size_t(received)));
+    lock_guard<std::mutex> lock(mutex);
+    latest.swap(eyes);
+    latestTime = now();
+  }
+}
+
+bool ViewerTracker::eyes(double time, vector<glm::vec3> &positions)
+{
+  if (!track.empty())
+  {
+    // looped, the last moment holds until the track starts over
+    double length = track.back().time;
+    double t = length > 0.0 ? fmod(time, length) : 0.0;
+    size_t i = 0;
+    while (i + 1 < track.size() && track[i + 1].time <= t)
+      i++;
+    positions = track[i].eyes;
+    return true;
+  }
+  lock_guard<std::mutex> lock(mutex);
+  if (latestTime < 0.0 || now() - latestTime > STALE)
+    return false;
+  positions = latest;
+  return true;
+}
+
+vector<bool> visibleViews(const vector<glm::vec3> &eyes, float widthMeters,
+                          float viewConeDegrees, float focusDistance,
+                          int views, int margin)
+{
+  // points across the screen, the views an eye sees change along it
+  static const int SAMPLES = 9;
+  const float cone = glm::radians(viewConeDegrees);
+  vector<bool> visible(size_t(views), false);
+  for (size_t e = 0; e < eyes.size(); e++)
+  {
+    const glm::vec3 &eye = eyes[e];
+    if (eye.z <= 0.0f)
+      continue; // behind the screen
+    float lo = 1e9f, hi = -1e9f;
+    for (int s = 0; s < SAMPLES; s++)
+    {
+      float x = widthMeters * (float(s) / float(SAMPLES - 1) - 0.5f);
+      // every point's cone is centered on the focus point
+      float angle = atan2(eye.x - x, eye.z) - atan2(-x, focusDistance);
+      float u = angle / cone + 0.5f;
+      lo = min(lo, u);
+      hi = max(hi, u);
+    }
+    // the interlacer blends the two views on either side of u * views
+    int first = int(floor(lo * float(views))) - margin;
+    int last = int(ceil(hi * float(views))) + margin;
+    if (last - first + 1 >= views)
+      return vector<bool>(size_t(views), true);
+    for (int v = first; v <= last; v++)
+      visible[size_t(((v % views) + views) % views)] = true;
+  }
+  return visible;
+}
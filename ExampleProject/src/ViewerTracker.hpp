@@ -0,0 +1,78 @@
+/**
+ * ViewerTracker.hpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+#ifndef HOLOPLAY_VIEWER_TRACKER_HPP
+#define HOLOPLAY_VIEWER_TRACKER_HPP
+
+#include <atomic>
+#include <glm/glm.hpp>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Eye positions of the people in front of the display, in meters from the
+// center of the screen: x to the right, y up, z out of the screen.
+//
+// They come from either
+//  - an external tracker sending UDP datagrams to a local port. A datagram
+//    holds every eye seen at that moment as "x y z" triples, separated by
+//    spaces, ';' or newlines, and replaces the eyes before it. An empty
+//    datagram means nobody is in view.
+//  - a track file replayed in a loop, one moment per line:
+//        t x y z [x y z ...]
+//    with t in seconds from the start. Lines starting with # are skipped.
+// The socket is read on a background thread, eyes() never blocks.
+class ViewerTracker
+{
+public:
+    // listens on 127.0.0.1:port. Throws std::runtime_error if it can't
+    static ViewerTracker *listen(int port);
+    // throws std::runtime_error if the file can't be read or holds no moment
+    static ViewerTracker *replay(const std::string &path);
+    ~ViewerTracker();
+
+    // the eyes at time (seconds, replays only). False while the tracker has
+    // sent nothing for a while, the eyes are unknown then
+    bool eyes(double time, std::vector<glm::vec3> &positions);
+
+private:
+    ViewerTracker();
+    ViewerTracker(const ViewerTracker &);
+    ViewerTracker &operator=(const ViewerTracker &);
+
+    struct Moment
+    {
+        double time;
+        std::vector<glm::vec3> eyes;
+    };
+
+    void receiveLoop();
+
+    // replay
+    std::vector<Moment> track; // by time
+
+    // socket
+    std::mutex mutex;
+    std::vector<glm::vec3> latest;
+    double latestTime; // seconds on the steady clock, < 0 before the first
+    std::atomic<bool> running;
+    std::thread thread;
+    long long socket; // SOCKET on Windows, a descriptor elsewhere
+};
+
+// Which views reach any of eyes on a display widthMeters wide, that shows
+// views views over a cone of viewConeDegrees centered on a viewer
+// focusDistance meters in front of it. Views are counted from the left, the
+// cone repeats beyond its edges. margin views on each side are added, for
+// eyes that move before the next update.
+std::vector<bool> visibleViews(const std::vector<glm::vec3> &eyes, float widthMeters,
+                               float viewConeDegrees, float focusDistance,
+                               int views, int margin);
+
+#endif // HOLOPLAY_VIEWER_TRACKER_HPP
@@ -13,16 +13,177 @@
 
 #include "SampleScene.hpp"
 
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
 using namespace std;
 
-#define UNUSED(x) [&x]{}()
+// command line options:
+//   --device <index>    first Looking Glass to drive (default 0)
+//   --displays <count>  number of Looking Glasses to drive (default all)
+//   --preset <0|1|2|auto> quilt preset, auto picks one per device type
+//   --button-rate <hz>  hardware button polls per second, 0 disables them
+//   --compress-textures <0|1> block compress loaded textures
+//   --skybox <dir>      cubemap faces (right/left/top/bottom/front/back.jpg)
+//   --gpu-budget <MB>   GPU memory the app may use (default: what the
+//                       driver reports as available)
+//   --over-budget <downgrade|refuse> smaller quilt presets or exit with an
+//                       error when the quilts don't fit
+//   --capture <name>    record the quilt from the start to <name>-quilt...
+//   --capture-format <png|raw|y4m> image sequence or video stream
+//   --capture-screen <0|1> record the interlaced frame too
+//   --capture-frames <count> stop recording after count frames
+//   --capture-fps <fps> frame rate of y4m streams
+//   --play <file>       show a quilt image, a sequence given as a printf
+//                       pattern (quilt_%06d.png) or a light field container
+//                       (.hlf) instead of the scene
+//   --play-fps <fps>    frame rate of the sequence (default: the
+//                       container's, or 30)
+//   --shared-quilt <name>[,<name>...] show quilts shared by other processes
+//                       (see quiltproducer), P switches between them
+//   --rgbd <image>      synthesize the quilt from a color image and its
+//                       depth map (white is near)
+//   --rgbd-depth <image> the depth map, by default the right half of the
+//                       color image
+//   --rgbd-strength <s> shift of the nearest points in the outermost views,
+//                       a fraction of the view width (default 0.04)
+//   --rgbd-focus <d>    depth that stays in place (default 0.5)
+//   --rgbd-synthesis <gpu|cpu> shader pass or multithreaded CPU reference
+//   --interpolate <n>   render every n-th view and interpolate the rest,
+//                       I prints the error against rendering them all
+//   --interpolate-fill <background|stretch> how disoccluded areas are filled
+//   --render-budget <ms> GPU time the quilts may take per frame, their
+//                       resolution is lowered while it is exceeded
+//   --min-render-scale <s> lowest fraction of the view size (default 0.5)
+//   --view-edge-scale <s> size of the outermost views against the center
+//                       ones (default 1, every view full size)
+//   --view-falloff <p>  how fast views shrink towards the edges, 1 is
+//                       linear (default 2)
+//   --view-storage <quilt|layers> render the views into quilt tiles or into
+//                       the layers of a 2D texture array
+//   --adaptive-shading <v> shade tiles with one material, normals varying
+//                       less than v and no depth edge at a quarter rate
+//   --render <quilt|direct|fused> render a quilt and interlace it, march
+//                       the scene for every subpixel of the panel, or shade
+//                       the hit buffers inside the interlacer
+//   --interlacer <fragment|compute> interlace with the light field shader
+//                       or a compute shader, B times both per device type
+//   --track-port <port> shade only the views that reach the eyes an eye
+//                       tracker sends to this UDP port on 127.0.0.1
+//   --track-file <path> replay eye positions from a file instead
+//   --track-margin <n>  views shaded beyond the ones the eyes see (default 1)
+//   --track-focus <m>   distance in meters where the views converge
+//                       (default 0.6)
+//   --scene <sdf|meshes> the raymarched scene, or a field of lit meshes
+//   --mesh-objects <n>  objects in the mesh scene (default 64)
+//   --mesh-shading <forward|texture> light every pixel of every view, or
+//                       the diffuse light once per frame into an atlas
+//   --mesh-transform <frame|view> skin and transform the vertices once per
+//                       frame for every view, or again in every view
+//   --mesh-culling <cpu|gpu> cull the meshes and draw each view's on the
+//                       CPU, or cull on the GPU and draw all views with one
+//                       indirect multi-draw (GL 4.3)
+static HoloPlayOptions parseOptions(int argc, const char *argv[])
+{
+  HoloPlayOptions options;
+  for (int i = 1; i + 1 < argc; i += 2)
+  {
+    const char *value = argv[i + 1];
+    if (strcmp(argv[i], "--device") == 0)
+      options.firstDevice = atoi(value);
+    else if (strcmp(argv[i], "--displays") == 0)
+      options.maxDisplays = atoi(value);
+    else if (strcmp(argv[i], "--preset") == 0)
+      options.quiltPreset = strcmp(value, "auto") == 0 ? -1 : atoi(value);
+    else if (strcmp(argv[i], "--button-rate") == 0)
+      options.buttonPollRate = float(atof(value));
+    else if (strcmp(argv[i], "--compress-textures") == 0)
+      options.compressTextures = atoi(value) != 0;
+    else if (strcmp(argv[i], "--skybox") == 0)
+      options.skybox = value;
+    else if (strcmp(argv[i], "--gpu-budget") == 0)
+      options.gpuBudgetMB = atoi(value);
+    else if (strcmp(argv[i], "--over-budget") == 0)
+      options.downgradePresets = strcmp(value, "refuse") != 0;
+    else if (strcmp(argv[i], "--capture") == 0)
+      options.capturePath = value;
+    else if (strcmp(argv[i], "--capture-format") == 0)
+      options.captureFormat = value;
+    else if (strcmp(argv[i], "--capture-screen") == 0)
+      options.captureScreen = atoi(value) != 0;
+    else if (strcmp(argv[i], "--capture-frames") == 0)
+      options.captureFrames = atoi(value);
+    else if (strcmp(argv[i], "--capture-fps") == 0)
+      options.captureFps = atoi(value);
+    else if (strcmp(argv[i], "--play") == 0)
+      options.playback = value;
+    else if (strcmp(argv[i], "--play-fps") == 0)
+      options.playbackFps = float(atof(value));
+    else if (strcmp(argv[i], "--shared-quilt") == 0)
+      options.sharedQuilts = value;
+    else if (strcmp(argv[i], "--rgbd") == 0)
+      options.rgbdColor = value;
+    else if (strcmp(argv[i], "--rgbd-depth") == 0)
+      options.rgbdDepth = value;
+    else if (strcmp(argv[i], "--rgbd-strength") == 0)
+      options.rgbd.strength = float(atof(value));
+    else if (strcmp(argv[i], "--rgbd-focus") == 0)
+      options.rgbd.focus = float(atof(value));
+    else if (strcmp(argv[i], "--rgbd-synthesis") == 0)
+      options.rgbd.cpu = strcmp(value, "cpu") == 0;
+    else if (strcmp(argv[i], "--interpolate") == 0)
+      options.interpolateStep = atoi(value);
+    else if (strcmp(argv[i], "--interpolate-fill") == 0)
+      options.interpolateFillBackground = strcmp(value, "stretch") != 0;
+    else if (strcmp(argv[i], "--render-budget") == 0)
+      options.renderBudgetMs = float(atof(value));
+    else if (strcmp(argv[i], "--min-render-scale") == 0)
+      options.minRenderScale = float(atof(value));
+    else if (strcmp(argv[i], "--view-edge-scale") == 0)
+      options.viewWeighting.edgeScale = float(atof(value));
+    else if (strcmp(argv[i], "--view-falloff") == 0)
+      options.viewWeighting.falloff = float(atof(value));
+    else if (strcmp(argv[i], "--view-storage") == 0)
+      options.viewLayers = strcmp(value, "layers") == 0;
+    else if (strcmp(argv[i], "--adaptive-shading") == 0)
+      options.adaptiveShading = float(atof(value));
+    else if (strcmp(argv[i], "--render") == 0)
+    {
+      options.directRender = strcmp(value, "direct") == 0;
+      options.fusedRender = strcmp(value, "fused") == 0;
+    }
+    else if (strcmp(argv[i], "--interlacer") == 0)
+      options.computeInterlace = strcmp(value, "compute") == 0;
+    else if (strcmp(argv[i], "--track-port") == 0)
+      options.trackPort = atoi(value);
+    else if (strcmp(argv[i], "--track-file") == 0)
+      options.trackFile = value;
+    else if (strcmp(argv[i], "--track-margin") == 0)
+      options.trackMargin = atoi(value);
+    else if (strcmp(argv[i], "--track-focus") == 0)
+      options.trackFocus = float(atof(value));
+    else if (strcmp(argv[i], "--scene") == 0)
+      options.meshScene = strcmp(value, "meshes") == 0;
+    else if (strcmp(argv[i], "--mesh-objects") == 0)
+      options.meshObjects = atoi(value);
+    else if (strcmp(argv[i], "--mesh-shading") == 0)
+      options.textureSpaceShading = strcmp(value, "texture") == 0;
+    else if (strcmp(argv[i], "--mesh-transform") == 0)
+      options.meshTransformPerView = strcmp(value, "view") == 0;
+    else if (strcmp(argv[i], "--mesh-culling") == 0)
+      options.gpuCulling = strcmp(value, "gpu") == 0;
+    else
+      cout << "[Warning] unknown option " << argv[i] << endl;
+  }
+  return options;
+}
 
 int main(int argc, const char *argv[])
 {
-  UNUSED(argc);
-  UNUSED(argv);
-
-  HoloPlayContext* hpc = new HoloPlayContext(false);
+  HoloPlayOptions options = parseOptions(argc, argv);
+  HoloPlayContext* hpc = options.meshScene ? new SampleScene(options)
+                                           : new HoloPlayContext(false, options);
   hpc->run();
   return 0;
 }
\ No newline at end of file
@@ -0,0 +1,214 @@
+/**
+ * lfencode.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+// Packs quilt images into a light field container (see LightFieldFile.hpp)
+// for playback with ./main --play.
+//
+//   lfencode <input> <output.hlf> [options]
+//
+//   <input>              a quilt image or a numbered sequence given as a
+//                        printf pattern, e.g. take-quilt_%06d.png
+//   --columns <n>        views per row    (default: from the "_qs<c>x<r>"
+//   --rows <n>           views per column  file name suffix)
+//   --views <n>          number of views (default columns * rows)
+//   --fps <fps>          playback rate stored in the file (default 30)
+//   --aspect <a>         aspect of a view (default: the "a<aspect>" suffix)
+//   --threshold <mse>    store blocks that are this close to the same block
+//                        of the previous view as copies (default 0, exact)
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "../LightFieldFile.hpp"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+using namespace std;
+
+// "_qs<columns>x<rows>a<aspect>", the aspect being optional
+static void parseSuffix(const string &fileName, int &columns, int &rows, float &aspect)
+{
+  size_t slash = fileName.find_last_of("/\\");
+  size_t at = fileName.find("_qs", slash == string::npos ? 0 : slash);
+  if (at == string::npos)
+    return;
+  int c, r;
+  float a;
+  int matched = sscanf(fileName.c_str() + at, "_qs%dx%da%f", &c, &r, &a);
+  if (matched >= 2 && c > 0 && r > 0)
+  {
+    columns = c;
+    rows = r;
+  }
+  if (matched == 3 && a > 0.0f)
+    aspect = a;
+}
+
+int main(int argc, const char *argv[])
+{
+  if (argc < 3)
+  {
+    cout << "usage: lfencode <input> <output.hlf> [--columns n] [--rows n] "
+            "[--views n] [--fps fps] [--aspect a] [--threshold mse]"
+         << endl;
+    return 1;
+  }
+  const string input = argv[1];
+  const string output = argv[2];
+  int columns = 0, rows = 0, views = 0;
+  float fps = 30.0f, aspect = 0.0f, threshold = 0.0f;
+  float givenAspect = 0.0f;
+  for (int i = 3; i + 1 < argc; i += 2)
+  {
+    const char *value = argv[i + 1];
+    if (strcmp(argv[i], "--columns") == 0)
+      columns = atoi(value);
+    else if (strcmp(argv[i], "--rows") == 0)
+      rows = atoi(value);
+    else if (strcmp(argv[i], "--views") == 0)
+      views = atoi(value);
+    else if (strcmp(argv[i], "--fps") == 0)
+      fps = float(atof(value));
+    else if (strcmp(argv[i], "--aspect") == 0)
+      givenAspect = float(atof(value));
+    else if (strcmp(argv[i], "--threshold") == 0)
+      threshold = float(atof(value));
+    else
+      cout << "[Warning] unknown option " << argv[i] << endl;
+  }
+
+  // the frames, a sequence runs until the first missing file
+  vector<string> files;
+  if (input.find('%') == string::npos)
+  {
+    files.push_back(input);
+  }
+  else
+  {
+    for (int i = 0;; i++)
+    {
+      char name[1024];
+      snprintf(name, sizeof(name), input.c_str(), i);
+      FILE *file = fopen(name, "rb");
+      if (!file)
+        break;
+      fclose(file);
+      files.push_back(name);
+    }
+  }
+  if (files.empty())
+  {
+    cout << "[Error] no quilt frames match " << input << endl;
+    return 1;
+  }
+
+  int suffixColumns = 0, suffixRows = 0;
+  parseSuffix(files[0], suffixColumns, suffixRows, aspect);
+  if (!columns)
+    columns = suffixColumns;
+  if (!rows)
+    rows = suffixRows;
+  if (givenAspect > 0.0f)
+    aspect = givenAspect;
+  if (columns <= 0 || rows <= 0)
+  {
+    cout << "[Error] the layout isn't in the file name, pass --columns and --rows"
+         << endl;
+    return 1;
+  }
+  if (!views)
+    views = columns * rows;
+
+  LightFieldWriter writer;
+  vector<unsigned char> packed;
+  int width = 0, height = 0, viewWidth = 0, viewHeight = 0;
+  for (size_t f = 0; f < files.size(); f++)
+  {
+    int w, h, channels;
+    unsigned char *image = stbi_load(files[f].c_str(), &w, &h, &channels, 4);
+    if (!image)
+    {
+      cout << "[Error] couldn't read " << files[f] << ": " << stbi_failure_reason() << endl;
+      return 1;
+    }
+
+    string error;
+    if (f == 0)
+    {
+      width = w;
+      height = h;
+      // BC1 works on 4x4 blocks, views are cropped to fit
+      viewWidth = (width / columns) & ~3;
+      viewHeight = (height / rows) & ~3;
+      if (viewWidth != width / columns || viewHeight != height / rows)
+        cout << "[Warning] views are cropped to " << viewWidth << "x" << viewHeight
+             << " pixels, multiples of 4" << endl;
+      if (!writer.open(output, columns, rows, views, viewWidth, viewHeight, fps,
+                       aspect, error))
+      {
+        cout << "[Error] " << error << endl;
+        stbi_image_free(image);
+        return 1;
+      }
+      packed.resize(size_t(columns * viewWidth) * size_t(rows * viewHeight) * 4);
+    }
+    else if (w != width || h != height)
+    {
+      cout << "[Error] " << files[f] << " differs in size from the first frame" << endl;
+      stbi_image_free(image);
+      return 1;
+    }
+
+    // tiles keep their bottom left corner, rows go bottom to top
+    const size_t packedRow = size_t(columns * viewWidth) * 4;
+    const int tileWidth = width / columns, tileHeight = height / rows;
+    for (int v = 0; v < columns * rows; v++)
+    {
+      int cx = v % columns, ry = v / columns;
+      for (int y = 0; y < viewHeight; y++)
+      {
+        int sourceY = height - 1 - (ry * tileHeight + y);
+        memcpy(&packed[size_t(ry * viewHeight + y) * packedRow + size_t(cx * viewWidth) * 4],
+               image + (size_t(sourceY) * size_t(width) + size_t(cx * tileWidth)) * 4,
+               size_t(viewWidth) * 4);
+      }
+    }
+    stbi_image_free(image);
+
+    if (!writer.addFrame(packed.data(), columns * viewWidth, rows * viewHeight,
+                         threshold, error))
+    {
+      cout << "[Error] " << error << endl;
+      return 1;
+    }
+    cout << "\r[Info] encoded frame " << f + 1 << " / " << files.size() << flush;
+  }
+  cout << endl;
+
+  string error;
+  if (!writer.close(error))
+  {
+    cout << "[Error] " << error << endl;
+    return 1;
+  }
+  uint64_t total = writer.literalBlocks() + writer.copiedBlocks();
+  cout << "[Info] wrote " << output << ": " << files.size() << " frames of "
+       << columns << "x" << rows << " views, " << writer.copiedBlocks() << " of "
+       << total << " blocks (" << (total ? 100 * writer.copiedBlocks() / total : 0)
+       << "%) copied from the previous view" << endl;
+  return 0;
+}
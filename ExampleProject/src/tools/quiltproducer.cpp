@@ -0,0 +1,162 @@
+/**
+ * quiltproducer.cpp
+ * Contributors:
+ *      * Looking Glass Factory Inc.
+ * Licence:
+ *      * MIT
+ */
+
+// Renders a test quilt on the CPU and shares it with ./main --shared-quilt,
+// as an example of a producer process (see SharedQuilt.hpp).
+//
+//   quiltproducer <name> [options]
+//
+//   --width <pixels>     quilt size (default 4096x4096)
+//   --height <pixels>
+//   --columns <n>        views per row (default 8)
+//   --rows <n>           views per column (default 6)
+//   --views <n>          number of views (default columns * rows)
+//   --fps <fps>          frames per second (default 30)
+//   --frames <count>     quit after count frames (default: on Ctrl-C)
+
+#ifdef WIN32
+#pragma warning(disable : 4464 4820 4514 5045 4201 5039 4061 4710)
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "../SharedQuilt.hpp"
+
+using namespace std;
+
+static atomic<bool> running(true);
+
+static void stop(int)
+{
+  running = false;
+}
+
+// a checkerboard behind a square that moves across the views as if it
+// floated in front of the screen, and circles over time
+static void drawQuilt(unsigned char *pixels, int width, int height, int columns,
+                      int rows, int views, int frame)
+{
+  const int viewWidth = width / columns, viewHeight = height / rows;
+  const int size = viewHeight / 4;
+  const double angle = frame * 0.05;
+  for (int v = 0; v < columns * rows; v++)
+  {
+    const int x0 = (v % columns) * viewWidth, y0 = (v / columns) * viewHeight;
+    // parallax, views go from left to right
+    const double shift = views > 1 ? (double(v) / (views - 1) - 0.5) * viewWidth * 0.1 : 0.0;
+    const int cx = int(viewWidth / 2 + cos(angle) * viewWidth / 4 + shift);
+    const int cy = int(viewHeight / 2 + sin(angle) * viewHeight / 4);
+    for (int y = 0; y < viewHeight; y++)
+    {
+      unsigned char *row = pixels + (size_t(y0 + y) * size_t(width) + size_t(x0)) * 4;
+      for (int x = 0; x < viewWidth; x++)
+      {
+        unsigned char *p = row + size_t(x) * 4;
+        bool inside = v < views && abs(x - cx) < size / 2 && abs(y - cy) < size / 2;
+        if (inside)
+        {
+          p[0] = 255;
+          p[1] = 160;
+          p[2] = 40;
+        }
+        else
+        {
+          unsigned char c = ((x / 32 + y / 32) & 1) ? 90 : 50;
+          p[0] = c;
+          p[1] = c;
+          p[2] = (unsigned char)(c + 30);
+        }
+        p[3] = 255;
+      }
+    }
+  }
+}
+
+int main(int argc, const char *argv[])
+{
+  if (argc < 2)
+  {
+    cout << "usage: quiltproducer <name> [--width px] [--height px] [--columns n] "
+            "[--rows n] [--views n] [--fps fps] [--frames count]"
+         << endl;
+    return 1;
+  }
+  const string name = argv[1];
+  int width = 4096, height = 4096, columns = 8, rows = 6, views = 0, frames = 0;
+  double fps = 30.0;
+  for (int i = 2; i + 1 < argc; i += 2)
+  {
+    const char *value = argv[i + 1];
+    if (strcmp(argv[i], "--width") == 0)
+      width = atoi(value);
+    else if (strcmp(argv[i], "--height") == 0)
+      height = atoi(value);
+    else if (strcmp(argv[i], "--columns") == 0)
+      columns = atoi(value);
+    else if (strcmp(argv[i], "--rows") == 0)
+      rows = atoi(value);
+    else if (strcmp(argv[i], "--views") == 0)
+      views = atoi(value);
+    else if (strcmp(argv[i], "--fps") == 0)
+      fps = atof(value);
+    else if (strcmp(argv[i], "--frames") == 0)
+      frames = atoi(value);
+    else
+      cout << "[Warning] unknown option " << argv[i] << endl;
+  }
+  if (!views)
+    views = columns * rows;
+  if (fps <= 0.0)
+    fps = 30.0;
+
+  SharedQuiltProducer producer;
+  string error;
+  // after a crash, the display process holds on to the old ring until it
+  // notices the heartbeat stopped
+  for (int attempt = 0; !producer.create(name, width, height, columns, rows, views, error);
+       attempt++)
+  {
+    if (attempt == 10)
+    {
+      cout << "[Error] " << error << endl;
+      return 1;
+    }
+    this_thread::sleep_for(chrono::milliseconds(500));
+  }
+  signal(SIGINT, stop);
+  signal(SIGTERM, stop);
+  cout << "[Info] sharing " << width << "x" << height << " quilts (" << columns << "x"
+       << rows << " views) as " << name << ", Ctrl-C to stop" << endl;
+
+  const chrono::duration<double> period(1.0 / fps);
+  chrono::steady_clock::time_point next = chrono::steady_clock::now();
+  for (int frame = 0; running && (!frames || frame < frames); frame++)
+  {
+    drawQuilt(producer.frame(), width, height, columns, rows, views, frame);
+    producer.publish();
+    next += chrono::duration_cast<chrono::steady_clock::duration>(period);
+    // at low rates, the consumer would take the gaps between frames for a
+    // crash
+    while (running && chrono::steady_clock::now() + chrono::milliseconds(500) < next)
+    {
+      this_thread::sleep_for(chrono::milliseconds(500));
+      producer.keepAlive();
+    }
+    this_thread::sleep_until(next);
+  }
+  cout << "[Info] shared " << producer.framesPublished() << " frames" << endl;
+  return 0;
+}